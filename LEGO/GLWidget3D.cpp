@@ -13,6 +13,7 @@
 #include "util/ContourUtils.h"
 #include "simp/BuildingSimplification.h"
 #include "util/DisjointVoxelData.h"
+#include "util/SliceLoader.h"
 #include "util/OBJWriter.h"
 #include "util/PlyWriter.h"
 #include "util/TopFaceWriter.h"
@@ -315,12 +316,15 @@ void GLWidget3D::loadVoxelData(const QString& filename) {
 	// get directory
 	QDir dir = QFileInfo(filename).absoluteDir();
 
-	// scan all the files in the directory to get a voxel data
+	// scan all the files in the directory to get a voxel data (the first file is not used as a slice)
 	QStringList files = dir.entryList(QDir::NoDotAndDotDot | QDir::Files, QDir::DirsFirst);
-	std::vector<cv::Mat_<uchar>> voxel_data(files.size());
-	for (int i = 1; i < files.size(); i++) {
-		voxel_data[i - 1] = cv::imread((dir.absolutePath() + "/" + files[i]).toUtf8().constData(), cv::IMREAD_GRAYSCALE);
+	std::vector<std::string> names;
+	for (int i = 0; i < files.size(); i++) {
+		names.push_back(files[i].toUtf8().constData());
 	}
+	util::SliceLoader loader;
+	std::vector<cv::Mat_<uchar>> voxel_data = loader.load(util::SliceLoader::sliceFilenames(dir.absolutePath().toUtf8().constData(), names, true));
+	loader.printThroughput(std::cout);
 	vdb_size = cv::Point3i(voxel_data[0].cols, voxel_data[0].rows, voxel_data.size());
 
 	voxel_buildings = util::DisjointVoxelData::disjoint(voxel_data);
@@ -4079,9 +4083,10 @@ void GLWidget3D::update3DGeometry(const std::vector<util::VoxelBuilding>& voxel_
 
 	std::vector<Vertex> vertices;
 	for (int i = 0; i < voxel_buildings.size(); i++) {
-		for (int z = 0; z < voxel_buildings[i].node_stack.size(); z++) {
-			for (auto voxel_node : voxel_buildings[i].node_stack[z]) {
-				update3DGeometry(voxel_node, color, vertices);
+		for (int z = 0; z < voxel_buildings[i].numSlices(); z++) {
+			std::vector<util::Polygon> footprints = voxel_buildings[i].contours(z);
+			for (int j = 0; j < footprints.size(); j++) {
+				update3DGeometry(footprints[j], voxel_buildings[i].heights[voxel_buildings[i].sliceBegin(z) + j], color, vertices);
 			}
 		}
 	}
@@ -4095,18 +4100,18 @@ void GLWidget3D::update3DGeometry(const std::vector<util::VoxelBuilding>& voxel_
 	renderManager.updateShadowMap(this, light_dir, light_mvpMatrix);
 }
 
-void GLWidget3D::update3DGeometry(const std::shared_ptr<util::VoxelNode>& voxel_node, glm::vec4& color, std::vector<Vertex>& vertices) {
-	std::vector<glm::dvec2> footprint(voxel_node->contour.contour.size());
-	for (int i = 0; i < voxel_node->contour.contour.size(); i++) {
-		cv::Point2f pt = voxel_node->contour.contour.getActualPoint(i);
+void GLWidget3D::update3DGeometry(const util::Polygon& contour, int z, glm::vec4& color, std::vector<Vertex>& vertices) {
+	std::vector<glm::dvec2> footprint(contour.contour.size());
+	for (int i = 0; i < contour.contour.size(); i++) {
+		cv::Point2f pt = contour.contour.getActualPoint(i);
 		footprint[i] = glm::dvec2(pt.x * scale, pt.y * scale);
 	}
-	std::vector<std::vector<glm::dvec2>> holes(voxel_node->contour.holes.size());
-	for (int i = 0; i < voxel_node->contour.holes.size(); i++) {
-		if (voxel_node->contour.holes[i].size() < 3) continue;
-		holes[i].resize(voxel_node->contour.holes[i].size());
-		for (int j = 0; j < voxel_node->contour.holes[i].size(); j++) {
-			cv::Point2f pt = voxel_node->contour.holes[i].getActualPoint(j);
+	std::vector<std::vector<glm::dvec2>> holes(contour.holes.size());
+	for (int i = 0; i < contour.holes.size(); i++) {
+		if (contour.holes[i].size() < 3) continue;
+		holes[i].resize(contour.holes[i].size());
+		for (int j = 0; j < contour.holes[i].size(); j++) {
+			cv::Point2f pt = contour.holes[i].getActualPoint(j);
 			holes[i][j] = glm::dvec2(pt.x * scale, pt.y * scale);
 		}
 	}
@@ -4117,7 +4122,7 @@ void GLWidget3D::update3DGeometry(const std::shared_ptr<util::VoxelNode>& voxel_
 		glutils::correct(holes[i]);
 	}
 
-	glm::mat4 mat = glm::translate(glm::mat4(), glm::vec3(0, 0, voxel_node->height * scale));
+	glm::mat4 mat = glm::translate(glm::mat4(), glm::vec3(0, 0, z * scale));
 	double h = scale;
 
 	// top face
@@ -99,7 +99,7 @@ public:
 	void generateRoofImages(QString roofImagesPath, int imageNum, bool bDataAugmentaion, int roofType, int width, int height, std::pair<int, int> roofWidth, std::pair<double, double> roofAspect, std::pair<double, double> roofSlope, std::pair<double, double> roofRidge, bool bRoofDis, double roofDisRatio);
 	void update3DGeometry();
 	void update3DGeometry(const std::vector<util::VoxelBuilding>& voxel_buildings);
-	void update3DGeometry(const std::shared_ptr<util::VoxelNode>& voxel_node, glm::vec4& color, std::vector<Vertex>& vertices);
+	void update3DGeometry(const util::Polygon& contour, int z, glm::vec4& color, std::vector<Vertex>& vertices);
 	void update3DGeometryWithoutRoof(const std::vector<std::shared_ptr<util::BuildingLayer>>& buildings);
 	void update3DGeometryWithoutRoof(std::shared_ptr<util::BuildingLayer> building, glm::vec4& color, const QString& facade_texture, const QString& roof_texture, QMap<QString, std::vector<Vertex>>& vertices);
 	//void update3DGeometryWithRoof(const std::vector<std::shared_ptr<util::BuildingLayer>>& buildings);
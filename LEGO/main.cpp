@@ -1,8 +1,10 @@
 #include "MainWindow.h"
 #include <QtWidgets/QApplication>
+#include "util/Log.h"
 
 int main(int argc, char *argv[])
 {
+	util::Log::setEnabled(true);
 	QApplication a(argc, argv);
 	MainWindow w;
 	w.show();
@@ -14,12 +14,14 @@ namespace efficient_ransac {
 		_end_point = point;
 	}
 
-	void CurveDetector::detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error_ratio_to_radius, float cluster_epsilon, float min_angle, float min_radius, float max_radius, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& circles) {
+	void CurveDetector::detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error_ratio_to_radius, float cluster_epsilon, float min_angle, float min_radius, float max_radius, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& circles, SPRT* sprt) {
 		circles.clear();
 		//srand(1);
 		boost::random::mt19937 gen;
 		// generate a random number from 0 ~ 1000000
 		boost::random::uniform_int_distribution<> dist(0, 1000000);
+		// a separate generator for the preemptive verification keeps the sequence of the hypotheses unchanged
+		boost::random::mt19937 sprt_gen(12345);
 		int N = polygon.size();
 		if (N < min_points) return;
 
@@ -66,6 +68,9 @@ namespace efficient_ransac {
 				std::shared_ptr<Circle> circle = circleFromPoints(index1, polygon[index1].pos, polygon[index2].pos, polygon[index3].pos);
 				if (circle->radius() < min_radius || circle->radius() > max_radius) continue;
 
+				// preemptively reject the hypothesis that is unlikely to be supported by more points than the best one
+				if (sprt != NULL && !preverify(polygon, *circle, circle->radius() * max_error_ratio_to_radius, std::max(max_num_points + 1, min_points), best_circle, sprt_gen, *sprt)) continue;
+
 				// check whether the points are supporting this circle
 				std::vector<cv::Point2f> supporting_points;
 				std::vector<int> supporting_indices;
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "EfficientRANSAC.h"
+#include "SPRT.h"
 
 namespace efficient_ransac {
 
@@ -118,7 +119,7 @@ namespace efficient_ransac {
 		CurveDetector() {}
 
 	public:
-		static void detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error_ratio_to_radius, float cluster_epsilon, float min_angle, float min_radius, float max_radius, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& circles);
+		static void detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error_ratio_to_radius, float cluster_epsilon, float min_angle, float min_radius, float max_radius, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& circles, SPRT* sprt = NULL);
 		static std::shared_ptr<Circle> circleFromPoints(int index, const cv::Point2f& p1, const cv::Point2f& p2, const cv::Point2f& p3);
 		static float crossProduct(const cv::Point2f& a, const cv::Point2f& b);
 	};
@@ -4,7 +4,7 @@
 
 namespace efficient_ransac {
 
-	EfficientRANSAC::EfficientRANSAC() {
+	EfficientRANSAC::EfficientRANSAC() : _preemptive_verification(false), _num_accepted(0), _num_rejected(0) {
 	}
 
 	EfficientRANSAC::~EfficientRANSAC() {
@@ -18,13 +18,18 @@ namespace efficient_ransac {
 
 		// detect circles
 		std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>> shapes;
-		CurveDetector::detect(points, curve_num_iterations, curve_min_points, curve_max_error_ratio_to_radius, curve_cluster_epsilon, curve_min_angle, curve_min_radius, curve_max_radius, shapes);
+		SPRT curve_sprt;
+		CurveDetector::detect(points, curve_num_iterations, curve_min_points, curve_max_error_ratio_to_radius, curve_cluster_epsilon, curve_min_angle, curve_min_radius, curve_max_radius, shapes, _preemptive_verification ? &curve_sprt : NULL);
 
 		// detect lines based on the principal orientations
 		std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>> results;
-		LineDetector::detect(points, line_num_iterations, line_min_points, line_max_error, line_cluster_epsilon, line_min_length, principal_orientations, line_angle_threshold, results);
+		SPRT line_sprt;
+		LineDetector::detect(points, line_num_iterations, line_min_points, line_max_error, line_cluster_epsilon, line_min_length, principal_orientations, line_angle_threshold, results, _preemptive_verification ? &line_sprt : NULL);
 		shapes.insert(shapes.end(), results.begin(), results.end());
 
+		_num_accepted += curve_sprt.num_accepted + line_sprt.num_accepted;
+		_num_rejected += curve_sprt.num_rejected + line_sprt.num_rejected;
+
 		return shapes;
 	}
 
@@ -36,7 +41,10 @@ namespace efficient_ransac {
 
 		// detect circles
 		std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>> shapes;
-		CurveDetector::detect(points, curve_num_iterations, curve_min_points, curve_max_error_ratio_to_radius, curve_cluster_epsilon, curve_min_angle, curve_min_radius, curve_max_radius, shapes);
+		SPRT sprt;
+		CurveDetector::detect(points, curve_num_iterations, curve_min_points, curve_max_error_ratio_to_radius, curve_cluster_epsilon, curve_min_angle, curve_min_radius, curve_max_radius, shapes, _preemptive_verification ? &sprt : NULL);
+		_num_accepted += sprt.num_accepted;
+		_num_rejected += sprt.num_rejected;
 
 		return shapes;
 	}
@@ -49,7 +57,10 @@ namespace efficient_ransac {
 
 		// detect lines based on the principal orientations
 		std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>> shapes;
-		LineDetector::detect(points, line_num_iterations, line_min_points, line_max_error, line_cluster_epsilon, line_min_length, principal_orientations, line_angle_threshold, shapes);
+		SPRT sprt;
+		LineDetector::detect(points, line_num_iterations, line_min_points, line_max_error, line_cluster_epsilon, line_min_length, principal_orientations, line_angle_threshold, shapes, _preemptive_verification ? &sprt : NULL);
+		_num_accepted += sprt.num_accepted;
+		_num_rejected += sprt.num_rejected;
 
 		return shapes;
 	}
@@ -37,10 +37,24 @@ namespace efficient_ransac {
 	};
 
 	class EfficientRANSAC {
+	private:
+		/** Reject the hypotheses preemptively by SPRT before counting their supporting points (off by default until testEfficientRansac shows no mismatches) */
+		bool _preemptive_verification;
+
+		/** Number of the hypotheses that passed the preemptive verification */
+		int _num_accepted;
+
+		/** Number of the hypotheses that were rejected by the preemptive verification */
+		int _num_rejected;
+
 	public:
 		EfficientRANSAC();
 		~EfficientRANSAC();
 
+		void setPreemptiveVerification(bool preemptive_verification) { _preemptive_verification = preemptive_verification; }
+		int numAcceptedHypotheses() const { return _num_accepted; }
+		int numRejectedHypotheses() const { return _num_rejected; }
+
 	public:
 		std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>> detect(const std::vector<cv::Point2f>& polygon, int curve_num_iterations, int curve_min_points, float curve_max_error_ratio_to_radius, float curve_cluster_epsilon, float curve_min_angle, float curve_min_radius, float curve_max_radius, int line_num_iterations, int line_min_points, float line_max_error, float line_cluster_epsilon, float line_min_length, float line_angle_threshold, std::vector<float>& principal_orientations);
 
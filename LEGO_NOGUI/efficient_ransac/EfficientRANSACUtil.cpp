@@ -52,4 +52,41 @@ namespace efficient_ransac {
 		}
 	}
 
+	/**
+	 * Test whether the shape can be supported by at least the given number of points, by applying SPRT to randomly sampled points.
+	 * The supporting points of such a shape form a contiguous run that contains the start point,
+	 * so at least half of the points within the window of the same size around the start point are expected to be consistent.
+	 *
+	 * @param polygon				points
+	 * @param shape					shape hypothesis whose start index is the sampled point
+	 * @param max_error				maximum distance of the consistent points to the shape
+	 * @param min_supporting_points	number of the supporting points that the shape has to have
+	 * @param best_shape			the best shape so far (can be null)
+	 * @param gen					random number generator for sampling the points
+	 * @param sprt					SPRT
+	 * @return						false if the shape is rejected
+	 */
+	bool preverify(const std::vector<Point>& polygon, const PrimitiveShape& shape, float max_error, int min_supporting_points, const std::shared_ptr<PrimitiveShape>& best_shape, boost::random::mt19937& gen, SPRT& sprt) {
+		int N = polygon.size();
+		int window = std::min(min_supporting_points, N / 2);
+		if (window <= 0) return true;
+
+		// the density of the supporting points of the best shape is used to estimate the consistent ratio of a good shape
+		float density = 1.0f;
+		if (best_shape) {
+			density = (float)best_shape->points().size() / (best_shape->endIndex() - best_shape->startIndex() + 1);
+		}
+		sprt.setEpsilon(density * 0.5f);
+		if (!sprt.isActive()) return true;
+
+		sprt.begin();
+		for (int i = 0; i < window * 2 + 1; i++) {
+			int idx = (shape.startIndex() + (int)(gen() % (window * 2 + 1)) - window + N) % N;
+			if (sprt.update(!polygon[idx].used && shape.distance(polygon[idx].pos) < max_error)) return false;
+		}
+
+		sprt.accept();
+		return true;
+	}
+
 }
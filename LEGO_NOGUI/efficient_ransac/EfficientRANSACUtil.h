@@ -5,11 +5,14 @@
 #include <opencv2/highgui.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
+#include "EfficientRANSAC.h"
+#include "SPRT.h"
 
 namespace efficient_ransac {
 
 	float angle_difference(float x, float xi);
 	float regularize_angle_PI(float x);
 	float distance(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, bool segment_only);
+	bool preverify(const std::vector<Point>& polygon, const PrimitiveShape& shape, float max_error, int min_supporting_points, const std::shared_ptr<PrimitiveShape>& best_shape, boost::random::mt19937& gen, SPRT& sprt);
 
 }
@@ -15,12 +15,14 @@ namespace efficient_ransac {
 		_right_angle = false;
 	}
 
-	void LineDetector::detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error, float cluster_epsilon, float min_length, std::vector<float>& principal_angles, float angle_threshold, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& lines) {
+	void LineDetector::detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error, float cluster_epsilon, float min_length, std::vector<float>& principal_angles, float angle_threshold, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& lines, SPRT* sprt) {
 		lines.clear();
 		//srand(1);
 		boost::random::mt19937 gen;
 		// generate a random number from 0 ~ 1000000
 		boost::random::uniform_int_distribution<> dist(0, 1000000);
+		// a separate generator for the preemptive verification keeps the sequence of the hypotheses unchanged
+		boost::random::mt19937 sprt_gen(12345);
 		int N = polygon.size();
 		if (N < min_points) return;
 
@@ -87,6 +89,9 @@ namespace efficient_ransac {
 					}
 				}
 
+				// preemptively reject the hypothesis that is unlikely to be supported by more points than the best one
+				if (sprt != NULL && !preverify(polygon, *line, max_error, std::max(max_num_points + 1, min_points), best_line, sprt_gen, *sprt)) continue;
+
 				// check whether the points are supporting this line
 				std::vector<cv::Point2f> supporting_points;
 				std::vector<int> supporting_indices;
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "EfficientRANSAC.h"
+#include "SPRT.h"
 
 namespace efficient_ransac {
 
@@ -63,7 +64,7 @@ namespace efficient_ransac {
 		LineDetector() {}
 
 	public:
-		static void detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error, float cluster_epsilon, float min_length, std::vector<float>& principal_angles, float angle_threshold, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& lines);
+		static void detect(std::vector<Point>& polygon, int num_iter, int min_points, float max_error, float cluster_epsilon, float min_length, std::vector<float>& principal_angles, float angle_threshold, std::vector<std::pair<int, std::shared_ptr<PrimitiveShape>>>& lines, SPRT* sprt = NULL);
 	};
 
 }
\ No newline at end of file
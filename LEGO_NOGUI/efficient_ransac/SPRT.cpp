@@ -0,0 +1,93 @@
+#include "SPRT.h"
+#include <cmath>
+#include <algorithm>
+
+namespace efficient_ransac {
+
+	const float SPRT::HYPOTHESIS_COST = 100.0f;
+
+	SPRT::SPRT() : epsilon(0.5f), delta(0.1f), likelihood_ratio(1.0f), num_tested(0), num_consistent(0), rejected_tested(0), rejected_consistent(0), num_accepted(0), num_rejected(0) {
+		updateThreshold();
+	}
+
+	/**
+	 * Set the probability that a point is consistent with a good hypothesis.
+	 */
+	void SPRT::setEpsilon(float epsilon) {
+		epsilon = std::min(std::max(epsilon, 0.01f), 0.99f);
+		if (epsilon == this->epsilon) return;
+
+		this->epsilon = epsilon;
+		updateThreshold();
+	}
+
+	/**
+	 * Start testing a new hypothesis.
+	 */
+	void SPRT::begin() {
+		likelihood_ratio = 1.0f;
+		num_tested = 0;
+		num_consistent = 0;
+	}
+
+	/**
+	 * Update the likelihood ratio by the next point.
+	 *
+	 * @param consistent	true if the point is consistent with the hypothesis
+	 * @return				true if the hypothesis is rejected
+	 */
+	bool SPRT::update(bool consistent) {
+		num_tested++;
+		if (consistent) {
+			num_consistent++;
+			likelihood_ratio *= delta / epsilon;
+		}
+		else {
+			likelihood_ratio *= (1.0f - delta) / (1.0f - epsilon);
+		}
+
+		if (likelihood_ratio > threshold) {
+			num_rejected++;
+
+			// update the estimate of delta by the points tested for the rejected hypotheses
+			rejected_tested += num_tested;
+			rejected_consistent += num_consistent;
+			float new_delta = (float)((rejected_consistent + 1.0) / (rejected_tested + 10.0));
+			if (std::abs(new_delta - delta) > delta * 0.05f) {
+				delta = new_delta;
+				updateThreshold();
+			}
+			return true;
+		}
+		else {
+			return false;
+		}
+	}
+
+	/**
+	 * Accept the hypothesis that was not rejected after testing all the points.
+	 */
+	void SPRT::accept() {
+		num_accepted++;
+	}
+
+	/**
+	 * Calculate the decision threshold that minimizes the average verification time
+	 * by the fixed-point iteration of A = K + log(A).
+	 */
+	void SPRT::updateThreshold() {
+		if (!isActive()) {
+			threshold = 1e30f;
+			return;
+		}
+
+		double C = (1.0 - delta) * std::log((1.0 - delta) / (1.0 - epsilon)) + delta * std::log(delta / epsilon);
+		double K = HYPOTHESIS_COST * C + 1.0;
+		double A = K;
+		for (int i = 0; i < 10; i++) {
+			A = K + std::log(A);
+		}
+		threshold = (float)A;
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+namespace efficient_ransac {
+
+	/**
+	 * Wald's sequential probability ratio test for the preemptive verification of hypotheses (Matas and Chum, 2008).
+	 * The points are tested in a random order, and the likelihood ratio of the hypothesis being bad to being good
+	 * is updated by each point. The hypothesis is rejected as soon as the ratio exceeds the decision threshold,
+	 * and accepted for the full verification only after all the sampled points are tested.
+	 *
+	 * epsilon is the probability that a point is consistent with a good hypothesis, which is given by the caller.
+	 * delta is the probability that a point is consistent with a bad hypothesis, which is estimated from the points
+	 * tested for the rejected hypotheses. The decision threshold is updated whenever these probabilities change.
+	 */
+	class SPRT {
+	private:
+		/** Cost of generating and fully verifying a hypothesis in the unit of testing a point */
+		static const float HYPOTHESIS_COST;
+
+		float epsilon;
+		float delta;
+		float threshold;
+		float likelihood_ratio;
+		int num_tested;
+		int num_consistent;
+		double rejected_tested;
+		double rejected_consistent;
+
+	public:
+		/** Number of the hypotheses that passed the test */
+		int num_accepted;
+
+		/** Number of the hypotheses that were rejected by the test */
+		int num_rejected;
+
+	public:
+		SPRT();
+
+		void setEpsilon(float epsilon);
+		bool isActive() const { return delta < epsilon; }
+		void begin();
+		bool update(bool consistent);
+		void accept();
+
+	private:
+		void updateThreshold();
+	};
+
+}
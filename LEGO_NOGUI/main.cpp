@@ -2,14 +2,22 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <QDir>
 #include <QString>
 #include <QTextStream>
 #include "util/DisjointVoxelData.h"
+#include "util/VoxelVolume.h"
+#include "util/SliceLoader.h"
+#include "util/ComponentStream.h"
 #include "simp/BuildingSimplification.h"
 #include "util/OBJWriter.h"
 #include "util/TopFaceWriter.h"
 #include "util/PlyWriter.h"
+#include "util/Profiler.h"
+#include "util/ThreadPool.h"
+#include "util/Pipeline.h"
+#include "util/Log.h"
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -244,167 +252,655 @@ std::vector<regularizer::Config> readRegularizerParams(rapidjson::Value& node) {
 	return regularizer_configs;
 }
 
-int main(int argc, const char* argv[]) {
-	if (argc == 2) {
-		////////////////////////////////////////////////////////////////////////////////////
-		// the new interface
-		QFile file(argv[1]);
-		if (!file.open(QIODevice::ReadOnly)) {
-			std::cerr << "File was not readable: " << argv[1] << std::endl;
-			return -1;
+/**
+ * Make the file paths of the slice images from the files in the directory.
+ *
+ * @param skip_first_file	true if the first file in the directory is not a slice
+ */
+std::vector<std::string> sliceFilenames(const QDir& dir, const QStringList& files, bool skip_first_file) {
+	std::vector<std::string> names;
+	for (int i = 0; i < files.size(); i++) {
+		names.push_back(files[i].toUtf8().constData());
+	}
+	return util::SliceLoader::sliceFilenames(dir.absolutePath().toUtf8().constData(), names, skip_first_file);
+}
+
+/**
+ * Return the file path of the voxel cache of the slice directory in the cache directory.
+ * The cache file is named after the slice directory and its parent, so that the clusters that share a cache directory do not collide.
+ */
+QString voxelCacheFilename(const QString& cache_dir, const QDir& slice_dir) {
+	QDir parent_dir(slice_dir.absolutePath());
+	parent_dir.cdUp();
+	return QDir(cache_dir).absoluteFilePath(parent_dir.dirName() + "_" + slice_dir.dirName() + ".voxcache");
+}
+
+/**
+ * Load the bit-packed voxel volume of the slice images.
+ * If the cache filename is given, the volume is memory-mapped from the cache file,
+ * which is built from the slice images when it does not exist or is outdated.
+ * If the directory of the cache file cannot be created, the volume is built without the cache.
+ */
+void loadVoxelVolume(const std::vector<std::string>& filenames, const QString& cache_filename, int num_threads, util::VoxelVolume& volume) {
+	if (cache_filename.isEmpty() || !QDir().mkpath(QFileInfo(cache_filename).absolutePath())) {
+		volume.build(filenames, 128, num_threads);
+	}
+	else if (volume.load(filenames, cache_filename.toUtf8().constData(), 128, num_threads)) {
+		std::cout << "Voxel data was loaded from the cache: " << cache_filename.toUtf8().constData() << std::endl;
+	}
+}
+
+/**
+ * Parse the json file.
+ * Errors are thrown as string messages.
+ */
+void parseJsonFile(const QString& filename, rapidjson::Document& doc) {
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly)) {
+		std::cerr << "File was not readable: " << filename.toUtf8().constData() << std::endl;
+		throw "File was not readable.";
+	}
+	QTextStream in(&file);
+	doc.Parse(in.readAll().toUtf8().constData());
+	if (doc.HasParseError() || !doc.IsObject()) {
+		std::cerr << "Invalid json file: " << filename.toUtf8().constData() << std::endl;
+		throw "Invalid json file.";
+	}
+}
+
+/**
+ * Merge the members of the source object into the target object.
+ * The nested objects are merged member by member, and the other values are replaced by the copies of the source values.
+ */
+void mergeJsonObject(rapidjson::Value& target, const rapidjson::Value& source, rapidjson::Document::AllocatorType& allocator) {
+	for (rapidjson::Value::ConstMemberIterator it = source.MemberBegin(); it != source.MemberEnd(); ++it) {
+		rapidjson::Value::MemberIterator target_it = target.FindMember(it->name);
+		if (target_it == target.MemberEnd()) {
+			rapidjson::Value name(it->name, allocator);
+			rapidjson::Value value(it->value, allocator);
+			target.AddMember(name, value, allocator);
 		}
-		QTextStream in(&file);
-		rapidjson::Document doc;
-		doc.Parse(in.readAll().toUtf8().constData());
-		
-		std::vector<cv::Mat_<uchar>> voxel_data;
-		
-		// read input filename
-		bool do_voxel_model = readBoolValue(doc, "do_voxel_model", false);
-		
-		// read input filename
-		QString input_slice_filename;
-		try {
-			input_slice_filename = readStringValue(doc, "input_slice_filename");
+		else if (target_it->value.IsObject() && it->value.IsObject()) {
+			mergeJsonObject(target_it->value, it->value, allocator);
 		}
-		catch (...) {
-			std::cerr << "Invalid data for input_slice_filename in the json file." << std::endl;
-			return -1;
+		else {
+			target_it->value.CopyFrom(it->value, allocator);
 		}
-		
-		// read output obj output_mesh
-		QString output_mesh;
+	}
+}
+
+/**
+ * Parameters and intermediate data of a cluster, which are passed through the load, simplify, and write stages.
+ */
+struct ClusterJob {
+	bool do_voxel_model;
+	std::vector<std::string> slice_filenames;
+	int num_decoding_threads;
+	QString voxel_cache;
+	size_t slab_budget;
+	QString spill_file;
+	QString output_mesh;
+	QString output_top_face;
+	double offset_x;
+	double offset_y;
+	double offset_z;
+	double scale;
+	double contour_simplification_weight;
+	double layering_threshold;
+	double contour_snapping_threshold;
+	double orientation;
+	double min_contour_area;
+	double max_obb_ratio;
+	bool allow_triangle_contour;
+	bool allow_overhang;
+	double min_hole_ratio;
+	double min_layer_height;
+	int num_threads;
+	std::map<int, std::vector<double>> algorithms;
+	std::vector<regularizer::Config> regularizer_configs;
+
+	// intermediate data
+	int width;
+	int height;
+	std::vector<util::VoxelBuilding> voxel_buildings;
+	std::vector<std::shared_ptr<util::BuildingLayer>> buildings;
+
+	ClusterJob() : do_voxel_model(false), slab_budget(0), width(0), height(0) {}
+};
+
+/**
+ * Read the parameters of a cluster from the configuration of the new interface.
+ * The slices are read from input_slice_dir, or from the directory of input_slice_filename.
+ * Errors are thrown as string messages.
+ *
+ * @param doc	json configuration
+ * @param job	the parameters are stored
+ */
+void readClusterJob(rapidjson::Document& doc, ClusterJob& job) {
+	// read input filename
+	job.do_voxel_model = readBoolValue(doc, "do_voxel_model", false);
+
+	// get directory
+	QDir dir;
+	if (doc.HasMember("input_slice_dir")) {
 		try {
-			output_mesh = readStringValue(doc, "output_mesh");
+			dir = QDir(readStringValue(doc, "input_slice_dir"));
 		}
 		catch (...) {
-			std::cerr << "Invalid data for output_mesh in the json file." << std::endl;
-			return -1;
+			throw "Invalid data for input_slice_dir in the json file.";
 		}
-		
-		// read output topface filename
-		QString output_top_face;
+		if (!dir.exists()) {
+			std::cerr << "Input directory was not found: " << dir.path().toUtf8().constData() << std::endl;
+			throw "Input directory was not found.";
+		}
+	}
+	else {
+		// read input filename
+		QString input_slice_filename;
 		try {
-			output_top_face = readStringValue(doc, "output_top_face");
+			input_slice_filename = readStringValue(doc, "input_slice_filename");
 		}
 		catch (...) {
-			std::cerr << "Invalid data for output_top_face in the json file." << std::endl;
-			return -1;
+			throw "Invalid data for input_slice_filename in the json file.";
 		}
 
-		// get directory
 		QFileInfo finfo(input_slice_filename);
 		if (!finfo.exists()) {
 			std::cerr << "Input file was not found: " << input_slice_filename.toUtf8().constData() << std::endl;
-			return -1;
+			throw "Input file was not found.";
 		}
-		QDir dir = finfo.absoluteDir();
-		
-		// scan all the files in the directory to get a voxel data
-		QStringList files = dir.entryList(QDir::NoDotAndDotDot | QDir::Files, QDir::DirsFirst);
-		voxel_data.resize(files.size());
-		for (int i = 1; i < files.size(); i++) {
-			voxel_data[i - 1] = cv::imread((dir.absolutePath() + "/" + files[i]).toUtf8().constData(), cv::IMREAD_GRAYSCALE);
-		}
-		
-		// the following 4 parameters are necessary, we should throw an error if they are not provided, so removing defautl values.
-		
-		// read offset_x
-		double offset_x = readDoubleValue(doc, "offset_x");
+		dir = finfo.absoluteDir();
+	}
 
-		// read offset_y
-		double offset_y = readDoubleValue(doc, "offset_y");
+	// read output obj output_mesh
+	try {
+		job.output_mesh = readStringValue(doc, "output_mesh");
+	}
+	catch (...) {
+		throw "Invalid data for output_mesh in the json file.";
+	}
 
-		// read offset_z
-		double offset_z = readDoubleValue(doc, "offset_z");
+	// read output topface filename
+	try {
+		job.output_top_face = readStringValue(doc, "output_top_face");
+	}
+	catch (...) {
+		throw "Invalid data for output_top_face in the json file.";
+	}
 
-		// read scale
-		double scale = readDoubleValue(doc, "scale");
+	// scan all the files in the directory
+	// (the first file is not used as a slice by default for compatibility with the existing configurations)
+	QStringList files = dir.entryList(QDir::NoDotAndDotDot | QDir::Files, QDir::DirsFirst);
+	job.slice_filenames = sliceFilenames(dir, files, readBoolValue(doc, "skip_first_slice_file", true));
 
-		// do voxel model (for debug)
-		if (do_voxel_model) {
-		  std::cout<< "Doing voxel model" << std::endl;
-		  voxel_model::voxel_model(voxel_data, output_mesh.toStdString(), offset_x, offset_y, offset_z, scale);
-		  return 0;
+	// read the number of threads for decoding the slice images (0 - use all the hardware threads)
+	job.num_decoding_threads = readNumber(doc, "num_decoding_threads", 0);
+
+	// read the cache file of the voxel data (the cache is disabled by default)
+	// the cache is placed in voxel_cache_dir if it is given, or in the directory of the output mesh otherwise
+	if (readBoolValue(doc, "use_voxel_cache", false)) {
+		try {
+			job.voxel_cache = readStringValue(doc, "voxel_cache");
 		}
-		
-		// read contour simplificaton weight
-		double contour_simplification_weight = readNumber(doc, "contour_simplification_weight", 0.5);
-		
-		// read layering threshold
-		double layering_threshold = readNumber(doc, "layering_threshold", 0.7);
+		catch (...) {
+			QString cache_dir;
+			try {
+				cache_dir = readStringValue(doc, "voxel_cache_dir");
+			}
+			catch (...) {
+				cache_dir = QFileInfo(job.output_mesh).absolutePath();
+			}
+			job.voxel_cache = voxelCacheFilename(cache_dir, dir);
+		}
+	}
 
-		// read snapping threshold
-		double contour_snapping_threshold = readNumber(doc, "contour_snapping_threshold", 2.5) / scale;
-				
-		// read orientation
-		double orientation = readNumber(doc, "bulk_orientation", 0.0) / 180.0 * CV_PI;
+	// read the slab budget of the streaming labeling (0 - the whole volume is kept in memory)
+	// the runs of the voxels are spilled to the spill file, which is placed next to the slice directory by default
+	job.slab_budget = (size_t)(std::max(0.0, readNumber(doc, "streaming_slab_budget_mb", 0.0)) * 1024 * 1024);
+	if (job.slab_budget > 0) {
+		try {
+			job.spill_file = readStringValue(doc, "spill_file");
+		}
+		catch (...) {
+			job.spill_file = dir.absolutePath() + ".spill";
+		}
+	}
 
-		// read minimum contour area
-		double min_contour_area = readNumber(doc, "minimum_contour_area", 2.0) / scale / scale;
+	// the following 4 parameters are necessary, we should throw an error if they are not provided, so removing defautl values.
 
-		// read maximum obb ratio
-		double max_obb_ratio = readNumber(doc, "maximum_obb_ratio", 10.0);
+	// read offset_x
+	job.offset_x = readDoubleValue(doc, "offset_x");
 
-		// read the flag whether a triangle contour is allowed
-		bool allow_triangle_contour = readBoolValue(doc, "allow_triangle_contour", false);
+	// read offset_y
+	job.offset_y = readDoubleValue(doc, "offset_y");
 
-		// read the flag whether overhang is allowed
-		bool allow_overhang = readBoolValue(doc, "allow_overhang", false);
+	// read offset_z
+	job.offset_z = readDoubleValue(doc, "offset_z");
 
-		// read minimum hole ratio
-		double min_hole_ratio = readNumber(doc, "min_hole_ratio", 0.02);
+	// read scale
+	job.scale = readDoubleValue(doc, "scale");
 
-		// read minimum height of layer
-		double min_layer_height = readNumber(doc, "minimum_layer_height", 2.5) / scale;
+	// the voxel model (for debug) does not use the other parameters
+	if (job.do_voxel_model) return;
 
-		// read algorithms
-		std::map<int, std::vector<double>> algorithms;
-		rapidjson::Value& algs = doc["contour_simplification_algorithms"];			
-		
-		try {
-			algorithms[simp::BuildingSimplification::ALG_DP] = readAlgorithmParams(algs, "douglas_peucker");
-		}
-		catch (...) {
+	// read contour simplificaton weight
+	job.contour_simplification_weight = readNumber(doc, "contour_simplification_weight", 0.5);
+
+	// read layering threshold
+	job.layering_threshold = readNumber(doc, "layering_threshold", 0.7);
+
+	// read snapping threshold
+	job.contour_snapping_threshold = readNumber(doc, "contour_snapping_threshold", 2.5) / job.scale;
+
+	// read orientation
+	job.orientation = readNumber(doc, "bulk_orientation", 0.0) / 180.0 * CV_PI;
+
+	// read minimum contour area
+	job.min_contour_area = readNumber(doc, "minimum_contour_area", 2.0) / job.scale / job.scale;
+
+	// read maximum obb ratio
+	job.max_obb_ratio = readNumber(doc, "maximum_obb_ratio", 10.0);
+
+	// read the flag whether a triangle contour is allowed
+	job.allow_triangle_contour = readBoolValue(doc, "allow_triangle_contour", false);
+
+	// read the flag whether overhang is allowed
+	job.allow_overhang = readBoolValue(doc, "allow_overhang", false);
+
+	// read minimum hole ratio
+	job.min_hole_ratio = readNumber(doc, "min_hole_ratio", 0.02);
+
+	// read minimum height of layer
+	job.min_layer_height = readNumber(doc, "minimum_layer_height", 2.5) / job.scale;
+
+	// read the number of threads for simplification (0 - use all the hardware threads)
+	job.num_threads = readNumber(doc, "num_threads", 1);
+
+	// read algorithms
+	if (!doc.HasMember("contour_simplification_algorithms")) throw "No contour simplification algorithm is specified in the json file.";
+	rapidjson::Value& algs = doc["contour_simplification_algorithms"];
+
+	try {
+		job.algorithms[simp::BuildingSimplification::ALG_DP] = readAlgorithmParams(algs, "douglas_peucker");
+	}
+	catch (...) {
+	}
+	try {
+		job.algorithms[simp::BuildingSimplification::ALG_RIGHTANGLE] = readAlgorithmParams(algs, "right_angle");
+	}
+	catch (...) {
+	}
+	try {
+		job.algorithms[simp::BuildingSimplification::ALG_CURVE] = readAlgorithmParams(algs, "curve");
+	}
+	catch (...) {
+	}
+	try {
+		job.algorithms[simp::BuildingSimplification::ALG_CURVE_RIGHTANGLE] = readAlgorithmParams(algs, "curvepp");
+	}
+	catch (...) {
+	}
+	try {
+		job.algorithms[simp::BuildingSimplification::ALG_EFFICIENT_RANSAC] = readAlgorithmParams(algs, "efficient_ransac");
+	}
+	catch (...) {
+	}
+
+	// read regularizer
+	if (!doc.HasMember("regularizer")) throw "No regularizer is specified in the json file.";
+	job.regularizer_configs = readRegularizerParams(doc["regularizer"]);
+}
+
+/**
+ * Estimate the peak memory of loading the cluster, i.e., the bit-packed voxel volume, the label images of two slices,
+ * and the runs of the voxels, from the size of the first slice image, which is read from its header. Zero is returned if the size cannot be read.
+ * The number of the runs is not known before the slices are read. They are charged as one run per 64 voxels of each row,
+ * which is generous for building footprints but not a bound for noisy slices.
+ * The slab budget is returned for the streaming labeling, which charges it with the label images, the union-find, and the component records as well.
+ */
+size_t estimateLoadBytes(const ClusterJob& job) {
+	if (job.slab_budget > 0) return job.slab_budget;
+	cv::Size size;
+	if (job.slice_filenames.size() == 0 || !util::SliceLoader::readSize(job.slice_filenames[0], size)) return 0;
+	size_t words_per_row = (size.width + 63) / 64;
+	size_t packed_bytes = (size_t)size.height * words_per_row * sizeof(uint64_t);
+	size_t label_bytes = (size_t)size.height * size.width * sizeof(int) * 2;
+	size_t run_bytes = (size_t)size.height * words_per_row * 36;	// a run (16 bytes), its label (4 bytes), and its copy grouped by building (16 bytes)
+	return packed_bytes * job.slice_filenames.size() + label_bytes + run_bytes * job.slice_filenames.size();
+}
+
+/**
+ * Return the memory of the voxel data of the buildings that the cluster keeps until it is simplified.
+ */
+size_t voxelBuildingBytes(const ClusterJob& job) {
+	size_t bytes = 0;
+	for (int i = 0; i < job.voxel_buildings.size(); i++) {
+		bytes += job.voxel_buildings[i].memoryBytes();
+	}
+	return bytes;
+}
+
+/**
+ * Make the voxel model of the slices (for debug), and write it to the output mesh.
+ */
+void runVoxelModel(const ClusterJob& job) {
+	util::SliceLoader loader(job.num_decoding_threads);
+	std::vector<cv::Mat_<uchar>> voxel_data = loader.load(job.slice_filenames);
+	loader.printThroughput(std::cout);
+	std::cout << "Doing voxel model" << std::endl;
+	voxel_model::voxel_model(voxel_data, job.output_mesh.toStdString(), job.offset_x, job.offset_y, job.offset_z, job.scale);
+}
+
+/**
+ * Load stage: decode the slices into the voxel volume, and separate it into the voxel data of the buildings.
+ * The volume itself is released before returning.
+ * If the slab budget is given, the slices are labeled one by one without the volume instead.
+ */
+void loadCluster(ClusterJob& job) {
+	if (job.slab_budget > 0) {
+		util::ComponentStream stream(job.slab_budget, job.spill_file.toUtf8().constData());
+		{
+			util::ScopedTimer timer("stream_voxels");
+			util::SliceLoader loader(job.num_decoding_threads);
+			loader.stream(job.slice_filenames, [&](int i, const cv::Mat_<uchar>& slice) {
+				stream.addSlice(slice);
+			});
+			stream.finish();
+			loader.printThroughput(std::cout);
+		}
+		std::cout << "Streaming labeling: peak slab " << stream.peakSlabBytes() / 1024.0 / 1024.0 << " MB, spilled " << stream.spilledBytes() / 1024.0 / 1024.0 << " MB" << std::endl;
+		job.width = stream.getWidth();
+		job.height = stream.getHeight();
+		{
+			util::ScopedTimer timer("disjoint");
+			job.voxel_buildings = util::DisjointVoxelData::disjoint(stream);
+		}
+		return;
+	}
+
+	util::VoxelVolume volume;
+	{
+		util::ScopedTimer timer("load_voxels");
+		loadVoxelVolume(job.slice_filenames, job.voxel_cache, job.num_decoding_threads, volume);
+	}
+	job.width = volume.getWidth();
+	job.height = volume.getHeight();
+	{
+		util::ScopedTimer timer("disjoint");
+		job.voxel_buildings = util::DisjointVoxelData::disjoint(volume);
+	}
+}
+
+/**
+ * Simplify stage: generate the buildings from the voxel data, which is released afterwards.
+ */
+void simplifyCluster(ClusterJob& job) {
+	util::ScopedTimer timer("simplify_buildings");
+	job.buildings = simp::BuildingSimplification::simplifyBuildings(job.voxel_buildings, job.algorithms, false, job.min_layer_height, job.contour_simplification_weight, job.layering_threshold, job.contour_snapping_threshold, job.orientation, job.min_contour_area, job.max_obb_ratio, job.allow_triangle_contour, job.allow_overhang, job.min_hole_ratio, job.regularizer_configs, job.num_threads);
+	std::vector<util::VoxelBuilding>().swap(job.voxel_buildings);
+}
+
+/**
+ * Write stage: write the buildings to the output obj file and the top face file.
+ */
+void writeCluster(const ClusterJob& job) {
+	{
+		util::ScopedTimer timer("write_obj");
+		util::obj::OBJWriter::write(job.output_mesh.toUtf8().constData(), job.width, job.height, job.offset_x, job.offset_y, job.offset_z, job.scale, job.buildings);
+	}
+	{
+		util::ScopedTimer timer("write_top_face");
+		util::topface::TopFaceWriter::write(job.output_top_face.toUtf8().constData(), job.width, job.height, job.offset_x, job.offset_y, job.offset_z, job.scale, job.buildings);
+	}
+}
+
+/**
+ * Generate the buildings for the configuration of the new interface, and write them to the output files.
+ * Errors are thrown as string messages.
+ *
+ * @param doc	json configuration
+ * @return		the number of the generated buildings
+ */
+int runConfig(rapidjson::Document& doc) {
+	ClusterJob job;
+	readClusterJob(doc, job);
+
+	// do voxel model (for debug)
+	if (job.do_voxel_model) {
+		runVoxelModel(job);
+		return 0;
+	}
+
+	loadCluster(job);
+	simplifyCluster(job);
+	writeCluster(job);
+
+	return job.buildings.size();
+}
+
+/**
+ * Run a stage of a cluster unless the cluster has already failed.
+ * The error of the stage is stored as the message of the cluster.
+ */
+void runClusterStage(std::string& error, const std::function<void()>& stage) {
+	if (!error.empty()) return;
+	try {
+		stage();
+	}
+	catch (const char* msg) {
+		error = msg;
+	}
+	catch (const std::exception& ex) {
+		error = ex.what();
+	}
+	catch (...) {
+		error = "Unknown error.";
+	}
+}
+
+/**
+ * Process the clusters listed in the manifest in this process.
+ *
+ * The manifest has the base configuration ("config", a json filename or an object of the same format as the new interface),
+ * the output directory ("output_dir"), and the clusters ("clusters"). Each cluster has its name and the members that override
+ * the base configuration, e.g., input_slice_dir, offset_x, offset_y, offset_z, and scale. The outputs of each cluster are
+ * written to <output_dir>/<name>/ unless they are overridden. A cluster that fails is logged and skipped.
+ *
+ * The clusters flow through the load, simplify, and write stages, which overlap with each other. The number of the clusters
+ * loaded and simplified concurrently is given by "num_concurrent_loads" and "num_concurrent_clusters", and the number of the
+ * clusters waiting between two stages by "queue_capacity". The loaded clusters that are not simplified yet are limited by
+ * "memory_budget_mb" (0 means unlimited). Each cluster is charged with the estimated peak memory of its load, i.e., the voxel
+ * volume and the labels, when it is admitted, and then with the actual size of its voxel buildings after it is loaded.
+ * The utilization of each stage is printed at the end.
+ *
+ * @param manifest_filename		manifest json filename
+ * @return						0 if all the clusters succeeded, -1 otherwise
+ */
+int runBatch(const QString& manifest_filename) {
+	rapidjson::Document manifest;
+	rapidjson::Document base_config;
+	try {
+		parseJsonFile(manifest_filename, manifest);
+		if (!manifest.HasMember("clusters") || !manifest["clusters"].IsArray()) throw "No cluster is listed in the manifest.";
+
+		if (manifest.HasMember("config") && manifest["config"].IsObject()) {
+			base_config.CopyFrom(manifest["config"], base_config.GetAllocator());
+		}
+		else if (manifest.HasMember("config") && manifest["config"].IsString()) {
+			parseJsonFile(QFileInfo(manifest_filename).absoluteDir().absoluteFilePath(manifest["config"].GetString()), base_config);
+		}
+		else {
+			base_config.SetObject();
 		}
-		try {
-			algorithms[simp::BuildingSimplification::ALG_RIGHTANGLE] = readAlgorithmParams(algs, "right_angle");
+	}
+	catch (const char* msg) {
+		std::cerr << msg << std::endl;
+		return -1;
+	}
+
+	QDir output_dir(QString("."));
+	if (manifest.HasMember("output_dir") && manifest["output_dir"].IsString()) output_dir = QDir(QString(manifest["output_dir"].GetString()));
+	int num_concurrent_clusters = util::ThreadPool::resolveNumThreads(readNumber(manifest, "num_concurrent_clusters", 1));
+	int num_concurrent_loads = util::ThreadPool::resolveNumThreads(readNumber(manifest, "num_concurrent_loads", 1));
+	int queue_capacity = readNumber(manifest, "queue_capacity", 1);
+	size_t memory_budget = (size_t)(std::max(0.0, readNumber(manifest, "memory_budget_mb", 0)) * 1024 * 1024);
+
+	// read the output filename of the profile trace of the whole batch
+	QString profile_trace;
+	if (manifest.HasMember("profile_trace") && manifest["profile_trace"].IsString()) {
+		profile_trace = QString(manifest["profile_trace"].GetString());
+		util::Profiler::setEnabled(true);
+	}
+
+	// make the configuration of each cluster
+	const rapidjson::Value& clusters = manifest["clusters"];
+	std::vector<std::string> names(clusters.Size());
+	std::vector<std::shared_ptr<rapidjson::Document>> configs(clusters.Size());
+	for (int i = 0; i < clusters.Size(); i++) {
+		names[i] = clusters[i].HasMember("name") && clusters[i]["name"].IsString() ? clusters[i]["name"].GetString() : std::to_string(i);
+
+		QString cluster_output_dir = output_dir.absoluteFilePath(QString::fromStdString(names[i]));
+		QString output_mesh = cluster_output_dir + "/" + QString::fromStdString(names[i]) + "_building.obj";
+		QString output_top_face = cluster_output_dir + "/" + QString::fromStdString(names[i]) + "_building.txt";
+
+		configs[i] = std::make_shared<rapidjson::Document>();
+		rapidjson::Document& config = *configs[i];
+		rapidjson::Document::AllocatorType& allocator = config.GetAllocator();
+		config.CopyFrom(base_config, allocator);
+		rapidjson::Value outputs(rapidjson::kObjectType);
+		rapidjson::Value output_mesh_value(output_mesh.toUtf8().constData(), allocator);
+		rapidjson::Value output_top_face_value(output_top_face.toUtf8().constData(), allocator);
+		outputs.AddMember("output_mesh", output_mesh_value, allocator);
+		outputs.AddMember("output_top_face", output_top_face_value, allocator);
+		mergeJsonObject(config, outputs, allocator);
+		if (clusters[i].IsObject()) mergeJsonObject(config, clusters[i], allocator);
+	}
+
+	// read the parameters of each cluster (a cluster whose parameters are invalid is skipped by all the stages)
+	std::vector<ClusterJob> jobs(clusters.Size());
+	std::vector<std::string> errors(clusters.Size());
+	for (int i = 0; i < clusters.Size(); i++) {
+		runClusterStage(errors[i], [&]() {
+			QDir().mkpath(QFileInfo(readStringValue(*configs[i], "output_mesh")).absolutePath());
+			QDir().mkpath(QFileInfo(readStringValue(*configs[i], "output_top_face")).absolutePath());
+			readClusterJob(*configs[i], jobs[i]);
+		});
+	}
+
+	// process the clusters through the load, simplify, and write stages
+	std::vector<uchar> succeeded(clusters.Size(), 0);
+	std::vector<long long> cluster_starts(clusters.Size(), 0);
+	long long start = util::Profiler::now();
+	util::Pipeline pipeline(queue_capacity);
+	pipeline.addStage("load", std::min(num_concurrent_loads, (int)clusters.Size()), [&](int i) {
+		cluster_starts[i] = util::Profiler::now();
+		runClusterStage(errors[i], [&]() {
+			if (jobs[i].do_voxel_model) runVoxelModel(jobs[i]);
+			else loadCluster(jobs[i]);
+		});
+	});
+	pipeline.addStage("simplify", std::min(num_concurrent_clusters, (int)clusters.Size()), [&](int i) {
+		runClusterStage(errors[i], [&]() {
+			if (!jobs[i].do_voxel_model) simplifyCluster(jobs[i]);
+		});
+	});
+	pipeline.addStage("write", 1, [&](int i) {
+		runClusterStage(errors[i], [&]() {
+			if (!jobs[i].do_voxel_model) writeCluster(jobs[i]);
+		});
+
+		if (errors[i].empty()) {
+			succeeded[i] = 1;
+			std::cout << "[" << names[i] << "] " << jobs[i].buildings.size() << " buildings are generated in " << (util::Profiler::now() - cluster_starts[i]) * 1e-6 << " sec." << std::endl;
+		}
+		else {
+			std::cerr << "[" << names[i] << "] skipped: " << errors[i] << std::endl;
+		}
+		std::vector<std::shared_ptr<util::BuildingLayer>>().swap(jobs[i].buildings);
+	});
+	pipeline.setMemoryBudget(memory_budget, [&](int i) {
+		return errors[i].empty() ? estimateLoadBytes(jobs[i]) : 0;
+	}, 1, [&](int i) {
+		return voxelBuildingBytes(jobs[i]);
+	});
+	pipeline.run(clusters.Size());
+
+	int num_failed = 0;
+	for (int i = 0; i < clusters.Size(); i++) {
+		if (!succeeded[i]) num_failed++;
+	}
+	std::cout << clusters.Size() - num_failed << " of " << clusters.Size() << " clusters were processed in " << (util::Profiler::now() - start) * 1e-6 << " sec." << std::endl;
+	if (num_failed > 0) {
+		std::cerr << num_failed << " clusters failed:";
+		for (int i = 0; i < clusters.Size(); i++) {
+			if (!succeeded[i]) std::cerr << " " << names[i];
 		}
-		catch (...) {
+		std::cerr << std::endl;
+	}
+	pipeline.printUtilization(std::cout);
+
+	if (util::Profiler::isEnabled()) {
+		util::Profiler::printSummary(std::cout);
+		if (!util::Profiler::writeChromeTrace(profile_trace.toUtf8().constData())) {
+			std::cerr << "Profile trace could not be written: " << profile_trace.toUtf8().constData() << std::endl;
 		}
+	}
+
+	return num_failed == 0 ? 0 : -1;
+}
+
+int main(int argc, const char* argv[]) {
+	util::Log::setEnabled(true);
+
+	if (argc == 3 && std::string(argv[1]) == "--batch") {
+		////////////////////////////////////////////////////////////////////////////////////
+		// the batch interface
+		return runBatch(QString(argv[2]));
+	}
+	else if (argc == 2) {
+		////////////////////////////////////////////////////////////////////////////////////
+		// the new interface
+		rapidjson::Document doc;
 		try {
-			algorithms[simp::BuildingSimplification::ALG_CURVE] = readAlgorithmParams(algs, "curve");
+			parseJsonFile(QString(argv[1]), doc);
 		}
-		catch (...) {
+		catch (const char* msg) {
+			std::cerr << msg << std::endl;
+			return -1;
 		}
+
+		// read the output filename of the profile trace (the profiler is enabled only if this is specified)
+		QString profile_trace;
 		try {
-			algorithms[simp::BuildingSimplification::ALG_CURVE_RIGHTANGLE] = readAlgorithmParams(algs, "curvepp");
+			profile_trace = readStringValue(doc, "profile_trace");
+			util::Profiler::setEnabled(true);
 		}
 		catch (...) {
 		}
+
+		int num_buildings = 0;
 		try {
-			algorithms[simp::BuildingSimplification::ALG_EFFICIENT_RANSAC] = readAlgorithmParams(algs, "efficient_ransac");
+			num_buildings = runConfig(doc);
 		}
-		catch (...) {
+		catch (const char* msg) {
+			std::cerr << msg << std::endl;
+			return -1;
 		}
 
-		// read regularizer
-		std::vector<regularizer::Config> regularizer_configs = readRegularizerParams(doc["regularizer"]);
-
-		std::vector<util::VoxelBuilding> voxel_buildings = util::DisjointVoxelData::disjoint(voxel_data);
-
-		std::vector<std::shared_ptr<util::BuildingLayer>> buildings;
-		buildings = simp::BuildingSimplification::simplifyBuildings(voxel_buildings, algorithms, false, min_layer_height, contour_simplification_weight, layering_threshold, contour_snapping_threshold, orientation, min_contour_area, max_obb_ratio, allow_triangle_contour, allow_overhang, min_hole_ratio, regularizer_configs);
-
-		util::obj::OBJWriter::write(output_mesh.toUtf8().constData(), voxel_data[0].cols, voxel_data[0].rows, offset_x, offset_y, offset_z, scale, buildings);
-		util::topface::TopFaceWriter::write(output_top_face.toUtf8().constData(), voxel_data[0].cols, voxel_data[0].rows, offset_x, offset_y, offset_z, scale, buildings);
+		std::cout << num_buildings << " buildings are generated." << std::endl;
 
-		std::cout << buildings.size() << " buildings are generated." << std::endl;
+		if (util::Profiler::isEnabled()) {
+			util::Profiler::printSummary(std::cout);
+			if (!util::Profiler::writeChromeTrace(profile_trace.toUtf8().constData())) {
+				std::cerr << "Profile trace could not be written: " << profile_trace.toUtf8().constData() << std::endl;
+			}
+		}
 	}
 	else {
 		if (argc < 9) {
-			std::cerr << "Usage: \n" << argv[0] << " <slice image filename> <weight [0-1]> <algorithm option: 1 - All, 2 - DP> <offset_x> <offset_y> <offset_z> <scale> <output obj filename> <output topface filename>" << std::endl;
+			std::cerr << "Usage: \n" << argv[0] << " <slice image filename> <weight [0-1]> <algorithm option: 1 - All, 2 - DP> <offset_x> <offset_y> <offset_z> <scale> <output obj filename> <output topface filename> [--log] [--voxel-cache]" << std::endl;
 			std::cerr << argv[0] << " <config json filename> " << std::endl;
+			std::cerr << argv[0] << " --batch <manifest json filename> " << std::endl;
 			return -1;
 		}
 
@@ -416,8 +912,11 @@ int main(int argc, const char* argv[]) {
 		if (argc >= 10) {
 			topface_file = std::string(argv[9]);
 		}
-		if (argc == 11 && std::string(argv[10]) == "--log") {
-			record_stats = true;
+		// the voxel cache is written to the directory of the output obj file only if --voxel-cache is given
+		bool use_voxel_cache = false;
+		for (int i = 10; i < argc; i++) {
+			if (std::string(argv[i]) == "--log") record_stats = true;
+			else if (std::string(argv[i]) == "--voxel-cache") use_voxel_cache = true;
 		}
 
 		double offset_x = std::stod(argv[4]);
@@ -426,7 +925,6 @@ int main(int argc, const char* argv[]) {
 		double scale = std::stod(argv[7]);
 
 		QString input_filename(argv[1]);
-		std::vector<cv::Mat_<uchar>> voxel_data;
 
 		// The weight ratio of the accuracy term to the simplicity term for the cost function.
 		double alpha = std::stod(argv[2]);
@@ -442,10 +940,8 @@ int main(int argc, const char* argv[]) {
 
 		// scan all the files in the directory to get a voxel data
 		QStringList files = dir.entryList(QDir::NoDotAndDotDot | QDir::Files, QDir::DirsFirst);
-		voxel_data.resize(files.size());
-		for (int i = 0; i < files.size(); i++) {
-			voxel_data[i] = cv::imread((dir.absolutePath() + "/" + files[i]).toUtf8().constData(), cv::IMREAD_GRAYSCALE);
-		}	
+		util::VoxelVolume volume;
+		loadVoxelVolume(sliceFilenames(dir, files, false), use_voxel_cache ? voxelCacheFilename(QFileInfo(argv[8]).absolutePath(), dir) : QString(), 0, volume);
 		
 		// determine the layering threshold based on the weight ratio
 		double threshold = 0.01;
@@ -490,10 +986,10 @@ int main(int argc, const char* argv[]) {
 		int min_num_slices_per_layer = 2.5 / scale;
 		double min_hole_ratio = 0.02;
 
-		time_t start = clock();
-		std::vector<util::VoxelBuilding> voxel_buildings = util::DisjointVoxelData::disjoint(voxel_data);
-		time_t end = clock();
-		std::cout << "Time elapsed: " << (double)(end - start) / CLOCKS_PER_SEC << " sec." << std::endl;
+		long long start = util::Profiler::now();
+		std::vector<util::VoxelBuilding> voxel_buildings = util::DisjointVoxelData::disjoint(volume);
+		long long end = util::Profiler::now();
+		std::cout << "Time elapsed: " << (end - start) * 1e-6 << " sec." << std::endl;
 		
 		std::vector<std::shared_ptr<util::BuildingLayer>> buildings;
 		if (std::stoi(argv[3]) == 1) {
@@ -512,9 +1008,9 @@ int main(int argc, const char* argv[]) {
 			buildings = simp::BuildingSimplification::simplifyBuildings(voxel_buildings, simp::BuildingSimplification::ALG_CURVE_RIGHTANGLE, record_stats, min_num_slices_per_layer, alpha, threshold, epsilon, resolution, curve_threshold, angle_threshold, min_hole_ratio);
 		}
 
-		util::obj::OBJWriter::write(std::string(argv[8]), voxel_data[0].cols, voxel_data[0].rows, offset_x, offset_y, offset_z, scale, buildings);
+		util::obj::OBJWriter::write(std::string(argv[8]), volume.getWidth(), volume.getHeight(), offset_x, offset_y, offset_z, scale, buildings);
 		if (topface_file.size() > 0) {
-			util::topface::TopFaceWriter::write(topface_file, voxel_data[0].cols, voxel_data[0].rows, offset_x, offset_y, offset_z, scale, buildings);
+			util::topface::TopFaceWriter::write(topface_file, volume.getWidth(), volume.getHeight(), offset_x, offset_y, offset_z, scale, buildings);
 		}
 
 		std::cout << buildings.size() << " buildings are generated." << std::endl;
@@ -0,0 +1,731 @@
+#include "ScoreGradient.h"
+#include <algorithm>
+#include <climits>
+#include "../util/ContourUtils.h"
+#include "../util/BinaryMask.h"
+
+namespace regularizer {
+
+	namespace {
+
+		double cross(const cv::Point2d& v1, const cv::Point2d& v2) {
+			return v1.x * v2.y - v1.y * v2.x;
+		}
+
+		std::vector<cv::Point2f> mirrorPolygon(const std::vector<cv::Point2f>& polygon, const cv::Point2f& a, const cv::Point2f& b) {
+			std::vector<cv::Point2f> polygon_symmetry;
+			for (int i = 0; i < polygon.size(); i++) {
+				polygon_symmetry.push_back(util::mirrorPoint(a, b, polygon[i]));
+			}
+			return polygon_symmetry;
+		}
+
+		/**
+		 * Return whether the pixel that contains the point is set. The pixels outside the mask are not set.
+		 */
+		bool maskValue(const util::BinaryMask& mask, const cv::Point2d& p) {
+			int x = (int)std::floor(p.x);
+			int y = (int)std::floor(p.y);
+			return x >= 0 && y >= 0 && x < mask.width && y < mask.height && mask.get(x, y);
+		}
+
+		/**
+		 * Calculate the derivatives of the filled area of the rasterized polygon and of its overlap with the other mask
+		 * with respect to each vertex, in the pixel coordinates.
+		 * Moving a piece of an edge by d along its normal changes the filled area by d times the fill behind the edge
+		 * minus the fill ahead of it, and the overlap by the same amount where the other mask is set.
+		 * The fills are read from the mask two pixels off the edge, beyond the pixels that the rasterization adds along the edge,
+		 * so this also holds for the self-intersecting polygons. The parts thinner than four pixels are not differentiated correctly.
+		 * Each edge is sampled every half pixel, and the motion of a sample is interpolated from the two vertices of the edge.
+		 *
+		 * @param points		vertices of the polygon in the pixel coordinates
+		 * @param mask			rasterized polygon
+		 * @param other_mask	rasterized other polygon
+		 * @param area_grad		derivative of the filled area with respect to each vertex
+		 * @param inter_grad	derivative of the overlap with respect to each vertex
+		 */
+		void boundaryGradient(const std::vector<cv::Point2d>& points, const util::BinaryMask& mask, const util::BinaryMask& other_mask, std::vector<cv::Point2d>& area_grad, std::vector<cv::Point2d>& inter_grad) {
+			area_grad.assign(points.size(), cv::Point2d(0, 0));
+			inter_grad.assign(points.size(), cv::Point2d(0, 0));
+			for (int i = 0; i < points.size(); i++) {
+				int next = (i + 1) % points.size();
+				cv::Point2d edge = points[next] - points[i];
+				double length = std::sqrt(edge.dot(edge));
+				if (length == 0) continue;
+				cv::Point2d normal(edge.y / length, -edge.x / length);
+
+				int num_samples = (int)std::ceil(length * 2);
+				for (int k = 0; k < num_samples; k++) {
+					double t = (k + 0.5) / num_samples;
+					cv::Point2d p = points[i] + edge * t;
+					int fill = (int)maskValue(mask, p - normal * 2) - (int)maskValue(mask, p + normal * 2);
+					if (fill == 0) continue;
+
+					cv::Point2d d = normal * (fill * length / num_samples);
+					area_grad[i] += d * (1 - t);
+					area_grad[next] += d * t;
+					if (maskValue(other_mask, p)) {
+						inter_grad[i] += d * (1 - t);
+						inter_grad[next] += d * t;
+					}
+				}
+			}
+		}
+
+		/**
+		 * Add the derivative with respect to the mirror image of the polygon to the derivative with respect to the polygon.
+		 * The mirror is the reflection I - 2 n n^T, which is symmetric.
+		 */
+		void addMirrorGradient(const cv::Point2f& a, const cv::Point2f& b, const std::vector<cv::Point2d>& grad_symmetry, std::vector<cv::Point2d>& grad) {
+			cv::Point2d n(b.y - a.y, a.x - b.x);
+			double norm_n = std::sqrt(n.dot(n));
+			if (norm_n == 0) return;
+			n *= 1.0 / norm_n;
+			for (int i = 0; i < grad.size(); i++) {
+				grad[i] += grad_symmetry[i] - n * (2.0 * n.dot(grad_symmetry[i]));
+			}
+		}
+
+		/**
+		 * Return the score and its slope with respect to the angle if the angle is within the threshold of the target,
+		 * i.e., (angle - target + threshold) / threshold on (target - threshold, target],
+		 * and (target + threshold - angle) / threshold on (target, target + threshold].
+		 */
+		bool peakScore(float angle, float target, int angle_threshold, float& score, double& slope) {
+			if (angle > target - angle_threshold && angle <= target) {
+				score = (angle - target + angle_threshold) / angle_threshold;
+				slope = 1.0 / angle_threshold;
+				return true;
+			}
+			else if (angle > target && angle <= target + angle_threshold) {
+				score = (target + angle_threshold - angle) / angle_threshold;
+				slope = -1.0 / angle_threshold;
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		 * Add the derivative of an angle-based score of two line segments (a, b) and (c, d) to the vertices.
+		 */
+		void addAngleGradient(std::vector<cv::Point2d>& grad, int a, int b, int c, int d, const cv::Point2d& grad_u, const cv::Point2d& grad_v, double slope) {
+			grad[a] -= grad_u * slope;
+			grad[b] += grad_u * slope;
+			grad[c] -= grad_v * slope;
+			grad[d] += grad_v * slope;
+		}
+
+		double signedArea(const std::vector<cv::Point2d>& polygon) {
+			double area = 0;
+			for (int i = 0; i < polygon.size(); i++) {
+				area += cross(polygon[i], polygon[(i + 1) % polygon.size()]);
+			}
+			return area * 0.5;
+		}
+
+		bool isInside(const std::vector<cv::Point2d>& polygon, const cv::Point2d& pt) {
+			bool inside = false;
+			for (int i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+				if ((polygon[i].y > pt.y) != (polygon[j].y > pt.y)) {
+					double x = polygon[j].x + (pt.y - polygon[j].y) * (polygon[i].x - polygon[j].x) / (polygon[i].y - polygon[j].y);
+					if (pt.x < x) inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		/**
+		 * Integrate over the part of the boundary of the polygon that is inside the other polygon.
+		 * Return the contribution of this part to the area of the intersection, and store the derivative of
+		 * the intersection area with respect to the vertices of the polygon, which is the integral of the
+		 * normal velocity of the boundary.
+		 *
+		 * @param polygon	polygon whose boundary is integrated
+		 * @param other		the other polygon
+		 * @param grad		derivative of the intersection area
+		 * @return			contribution to the intersection area
+		 */
+		double integrateBoundaryInside(const std::vector<cv::Point2d>& polygon, const std::vector<cv::Point2d>& other, std::vector<cv::Point2d>& grad) {
+			grad.assign(polygon.size(), cv::Point2d(0, 0));
+			double orientation = signedArea(polygon) >= 0 ? 1.0 : -1.0;
+
+			double area = 0;
+			std::vector<double> ts;
+			for (int i = 0; i < polygon.size(); i++) {
+				int i2 = (i + 1) % polygon.size();
+				cv::Point2d p = polygon[i];
+				cv::Point2d d = polygon[i2] - polygon[i];
+				if (d.x == 0 && d.y == 0) continue;
+
+				// split the edge at the intersections with the other polygon
+				ts.clear();
+				ts.push_back(0);
+				ts.push_back(1);
+				for (int j = 0; j < other.size(); j++) {
+					cv::Point2d q = other[j];
+					cv::Point2d e = other[(j + 1) % other.size()] - other[j];
+					double denom = cross(d, e);
+					if (denom == 0) continue;
+					double t = cross(q - p, e) / denom;
+					double s = cross(q - p, d) / denom;
+					if (t > 0 && t < 1 && s >= 0 && s <= 1) ts.push_back(t);
+				}
+				std::sort(ts.begin(), ts.end());
+
+				// outward normal scaled by the edge length
+				cv::Point2d normal = cv::Point2d(d.y, -d.x) * orientation;
+				for (int k = 0; k + 1 < ts.size(); k++) {
+					double t0 = ts[k];
+					double t1 = ts[k + 1];
+					if (t1 <= t0) continue;
+					if (!isInside(other, p + d * ((t0 + t1) * 0.5))) continue;
+
+					area += cross(p + d * t0, p + d * t1) * 0.5 * orientation;
+					grad[i] += normal * ((t1 - t0) - (t1 * t1 - t0 * t0) * 0.5);
+					grad[i2] += normal * ((t1 * t1 - t0 * t0) * 0.5);
+				}
+			}
+
+			return area;
+		}
+
+	}
+
+	/**
+	 * Calculate the angle in degree between (a, b) and (c, d) in the same way as util::lineLineAngle,
+	 * and its derivative with respect to u = b - a and v = d - c.
+	 */
+	double lineLineAngleGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, const cv::Point2f& d, cv::Point2d& grad_u, cv::Point2d& grad_v) {
+		cv::Point2d u(b.x - a.x, b.y - a.y);
+		cv::Point2d v(d.x - c.x, d.y - c.y);
+		double norm_u = std::sqrt(u.dot(u));
+		double norm_v = std::sqrt(v.dot(v));
+		grad_u = cv::Point2d(0, 0);
+		grad_v = cv::Point2d(0, 0);
+		if (norm_u == 0 || norm_v == 0) return 0;
+
+		double cos_angle = std::max(-1.0, std::min(1.0, u.dot(v) / norm_u / norm_v));
+		double sin_angle = std::sqrt(1.0 - cos_angle * cos_angle);
+
+		// the derivative of acos diverges at 0 and 180 degrees
+		if (sin_angle > 1e-12) {
+			double scale = -180.0 / CV_PI / sin_angle;
+			grad_u = (v * (1.0 / norm_u / norm_v) - u * (cos_angle / norm_u / norm_u)) * scale;
+			grad_v = (u * (1.0 / norm_u / norm_v) - v * (cos_angle / norm_v / norm_v)) * scale;
+		}
+
+		return std::acos(cos_angle) / CV_PI * 180;
+	}
+
+	/**
+	 * Calculate the distance from c to the segment (a, b) in the same way as util::distance(a, b, c, true),
+	 * and its derivative with respect to a, b, and c.
+	 */
+	double pointSegmentDistanceGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, cv::Point2d& grad_a, cv::Point2d& grad_b, cv::Point2d& grad_c) {
+		grad_a = cv::Point2d(0, 0);
+		grad_b = cv::Point2d(0, 0);
+		grad_c = cv::Point2d(0, 0);
+
+		cv::Point2d u(b.x - a.x, b.y - a.y);
+		cv::Point2d w(c.x - a.x, c.y - a.y);
+		double r_denomenator = u.dot(u);
+
+		if (r_denomenator <= 0.0) {
+			double dist = std::sqrt(w.dot(w));
+			if (dist > 0) {
+				grad_c = w * (1.0 / dist);
+				grad_a = -grad_c;
+			}
+			return dist;
+		}
+
+		double r = w.dot(u) / r_denomenator;
+		if (r < 0 || r > 1) {
+			cv::Point2d w2(c.x - b.x, c.y - b.y);
+			double dist1 = std::sqrt(w.dot(w));
+			double dist2 = std::sqrt(w2.dot(w2));
+			if (dist1 < dist2) {
+				if (dist1 > 0) {
+					grad_c = w * (1.0 / dist1);
+					grad_a = -grad_c;
+				}
+				return dist1;
+			}
+			else {
+				if (dist2 > 0) {
+					grad_c = w2 * (1.0 / dist2);
+					grad_b = -grad_c;
+				}
+				return dist2;
+			}
+		}
+		else {
+			double norm_u = std::sqrt(r_denomenator);
+			double s = cross(w, u);
+			double sign = s >= 0 ? 1.0 : -1.0;
+			grad_c = cv::Point2d(u.y, -u.x) * (sign / norm_u);
+			grad_b = cv::Point2d(-w.y, w.x) * (sign / norm_u) - u * (std::abs(s) / norm_u / r_denomenator);
+			grad_a = -grad_b - grad_c;
+			return std::abs(s) / norm_u;
+		}
+	}
+
+	/**
+	 * Calculate the distance between the segments (a, b) and (c, d) in the same way as util::distance(a, b, c, d),
+	 * and its derivative with respect to a, b, c, and d.
+	 */
+	double segmentSegmentDistanceGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, const cv::Point2f& d, cv::Point2d& grad_a, cv::Point2d& grad_b, cv::Point2d& grad_c, cv::Point2d& grad_d) {
+		grad_a = cv::Point2d(0, 0);
+		grad_b = cv::Point2d(0, 0);
+		grad_c = cv::Point2d(0, 0);
+		grad_d = cv::Point2d(0, 0);
+
+		// the segment end points in the order of dis_a, dis_b, dis_c, dis_d of util::distance
+		const cv::Point2f* seg1[4] = { &c, &c, &a, &a };
+		const cv::Point2f* seg2[4] = { &d, &d, &b, &b };
+		const cv::Point2f* pt[4] = { &a, &b, &c, &d };
+		double dist[4];
+		cv::Point2d grads[4][3];
+		for (int i = 0; i < 4; i++) {
+			dist[i] = pointSegmentDistanceGradient(*seg1[i], *seg2[i], *pt[i], grads[i][0], grads[i][1], grads[i][2]);
+		}
+
+		// std::min returns the first argument if they are equal
+		int min1 = dist[1] < dist[0] ? 1 : 0;
+		int min2 = dist[3] < dist[2] ? 3 : 2;
+		int best = dist[min2] < dist[min1] ? min2 : min1;
+
+		cv::Point2d* ga = &grad_a;
+		cv::Point2d* gb = &grad_b;
+		cv::Point2d* gc = &grad_c;
+		cv::Point2d* gd = &grad_d;
+		if (best < 2) {
+			*gc += grads[best][0];
+			*gd += grads[best][1];
+			*(best == 0 ? ga : gb) += grads[best][2];
+		}
+		else {
+			*ga += grads[best][0];
+			*gb += grads[best][1];
+			*(best == 2 ? gc : gd) += grads[best][2];
+		}
+
+		return dist[best];
+	}
+
+	/**
+	 * Same as util::calculateScoreRaOpt with the derivative with respect to the vertices of the polygon.
+	 */
+	float scoreRaOpt(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& init_polygon, int angle_threshold, std::vector<cv::Point2d>& grad) {
+		grad.assign(polygon.size(), cv::Point2d(0, 0));
+
+		float score = 0.0f;
+		int total_segments = polygon.size();
+		int valid_segments = 0;
+		for (int i = 0; i < total_segments; i++) {
+			int first_start = i;
+			int first_end = (i + 1) % total_segments;
+			int second_start = (i + 1) % total_segments;
+			int second_end = (i + 2) % total_segments;
+
+			float angle_init = util::lineLineAngle(init_polygon[first_start], init_polygon[first_end], init_polygon[second_start], init_polygon[second_end]);
+			float angle = util::lineLineAngle(polygon[first_start], polygon[first_end], polygon[second_start], polygon[second_end]);
+
+			if (std::abs(angle - angle_init) > 2 * angle_threshold) {
+				grad.assign(polygon.size(), cv::Point2d(0, 0));
+				return 0;
+			}
+
+			bool diagonal = std::abs(angle_init - 45) <= angle_threshold;
+			bool right = !diagonal && std::abs(angle_init - 90) <= angle_threshold;
+			diagonal = diagonal || (!right && std::abs(angle_init - 135) <= angle_threshold);
+			if (!diagonal && !right) continue;
+
+			if (std::abs(angle - angle_init) > angle_threshold) {
+				grad.assign(polygon.size(), cv::Point2d(0, 0));
+				return 0;
+			}
+			valid_segments++;
+
+			float segment_score;
+			double slope;
+			bool found;
+			if (diagonal) {
+				found = peakScore(angle, 45, angle_threshold, segment_score, slope) || peakScore(angle, 135, angle_threshold, segment_score, slope);
+			}
+			else {
+				found = peakScore(angle, 90, angle_threshold, segment_score, slope);
+			}
+			if (!found) continue;
+
+			score += segment_score;
+			cv::Point2d grad_u, grad_v;
+			lineLineAngleGradient(polygon[first_start], polygon[first_end], polygon[second_start], polygon[second_end], grad_u, grad_v);
+			addAngleGradient(grad, first_start, first_end, second_start, second_end, grad_u, grad_v, slope);
+		}
+
+		if (valid_segments == 0) return score;
+		for (int i = 0; i < grad.size(); i++) {
+			grad[i] *= 1.0 / valid_segments;
+		}
+		return score / valid_segments;
+	}
+
+	/**
+	 * Same as util::calculateScoreParallelOpt with the derivative with respect to the vertices of the polygon.
+	 */
+	float scoreParallelOpt(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& init_polygon, int angle_threshold, std::vector<cv::Point2d>& grad) {
+		grad.assign(polygon.size(), cv::Point2d(0, 0));
+
+		float score = 0.0f;
+		int total_segments = polygon.size();
+		int valid_segments = 0;
+		for (int i = 0; i < total_segments; i++) {
+			int first_start = i;
+			int first_end = (i + 1) % total_segments;
+			int second_start = (i + 1) % total_segments;
+			int second_end = (i + 2) % total_segments;
+
+			float angle_init = util::lineLineAngle(init_polygon[first_start], init_polygon[first_end], init_polygon[second_start], init_polygon[second_end]);
+			float angle = util::lineLineAngle(polygon[first_start], polygon[first_end], polygon[second_start], polygon[second_end]);
+
+			if (std::abs(angle - angle_init) > 2 * angle_threshold) {
+				grad.assign(polygon.size(), cv::Point2d(0, 0));
+				return 0;
+			}
+
+			double slope = 0;
+			if (std::abs(angle_init) <= angle_threshold) {
+				if (std::abs(angle - angle_init) > angle_threshold) {
+					grad.assign(polygon.size(), cv::Point2d(0, 0));
+					return 0;
+				}
+				valid_segments++;
+
+				// 0 ~ threshold
+				if (angle >= 0 && angle <= angle_threshold) {
+					score += (angle_threshold - angle) / angle_threshold;
+					slope = -1.0 / angle_threshold;
+				}
+			}
+			else if (std::abs(angle_init - 180) <= angle_threshold) {
+				if (std::abs(angle - angle_init) > angle_threshold) {
+					grad.assign(polygon.size(), cv::Point2d(0, 0));
+					return 0;
+				}
+				valid_segments++;
+
+				// 180 - threshold ~ 180
+				if (angle > 180 - angle_threshold && angle <= 180) {
+					score += (angle - 180 + angle_threshold) / angle_threshold;
+					slope = 1.0 / angle_threshold;
+				}
+			}
+
+			if (slope != 0) {
+				cv::Point2d grad_u, grad_v;
+				lineLineAngleGradient(polygon[first_start], polygon[first_end], polygon[second_start], polygon[second_end], grad_u, grad_v);
+				addAngleGradient(grad, first_start, first_end, second_start, second_end, grad_u, grad_v, slope);
+			}
+		}
+
+		if (valid_segments == 0) return score;
+		for (int i = 0; i < grad.size(); i++) {
+			grad[i] *= 1.0 / valid_segments;
+		}
+		return score / valid_segments;
+	}
+
+	/**
+	 * Same as util::calculateScorePointOpt with the derivative with respect to the vertices of the source polygon
+	 * and the polygons of the destination layer.
+	 */
+	float scorePointOpt(const std::vector<cv::Point2f>& src_polygon, const std::vector<cv::Point2f>& init_src_polygon, const std::vector<std::vector<cv::Point2f>>& des_layer_polygons, const std::vector<std::vector<cv::Point2f>>& des_ini_layer_polygons, float dis_threshold, std::vector<cv::Point2d>& grad_src, std::vector<std::vector<cv::Point2d>>& grad_des) {
+		grad_src.assign(src_polygon.size(), cv::Point2d(0, 0));
+		grad_des.resize(des_layer_polygons.size());
+		for (int i = 0; i < des_layer_polygons.size(); i++) {
+			grad_des[i].assign(des_layer_polygons[i].size(), cv::Point2d(0, 0));
+		}
+
+		int valid_points = 0;
+		float score = 0.0f;
+		for (int k = 0; k < src_polygon.size(); k++) {
+			for (int i = 0; i < des_layer_polygons.size(); i++) {
+				for (int j = 0; j < des_layer_polygons[i].size(); j++) {
+					cv::Point2f init_diff = init_src_polygon[k] - des_ini_layer_polygons[i][j];
+					float dis_init = std::sqrt(init_diff.x * init_diff.x + init_diff.y * init_diff.y);
+					if (dis_init > dis_threshold) continue;
+
+					cv::Point2d diff(src_polygon[k].x - des_layer_polygons[i][j].x, src_polygon[k].y - des_layer_polygons[i][j].y);
+					double dis = std::sqrt(diff.dot(diff));
+					if (dis < dis_threshold) {
+						score += (dis_threshold - dis) / dis_threshold;
+						if (dis > 0) {
+							cv::Point2d g = diff * (-1.0 / dis / dis_threshold);
+							grad_src[k] += g;
+							grad_des[i][j] -= g;
+						}
+					}
+					valid_points++;
+				}
+			}
+		}
+
+		if (valid_points == 0) return score;
+		for (int k = 0; k < grad_src.size(); k++) {
+			grad_src[k] *= 1.0 / valid_points;
+		}
+		for (int i = 0; i < grad_des.size(); i++) {
+			for (int j = 0; j < grad_des[i].size(); j++) {
+				grad_des[i][j] *= 1.0 / valid_points;
+			}
+		}
+		return score / valid_points;
+	}
+
+	/**
+	 * Same as util::calculateScoreSegOpt with the derivative with respect to the vertices of the source polygon
+	 * and the polygons of the destination layer.
+	 */
+	float scoreSegOpt(const std::vector<cv::Point2f>& src_polygon, const std::vector<cv::Point2f>& init_src_polygon, const std::vector<std::vector<cv::Point2f>>& des_layer_polygons, const std::vector<std::vector<cv::Point2f>>& des_ini_layer_polygons, float dis_threshold, float angle_threshold, std::vector<cv::Point2d>& grad_src, std::vector<std::vector<cv::Point2d>>& grad_des) {
+		grad_src.assign(src_polygon.size(), cv::Point2d(0, 0));
+		grad_des.resize(des_layer_polygons.size());
+		for (int i = 0; i < des_layer_polygons.size(); i++) {
+			grad_des[i].assign(des_layer_polygons[i].size(), cv::Point2d(0, 0));
+		}
+
+		float score = 0.0f;
+		int valid_segments = 0;
+		int total_seg_src = src_polygon.size();
+		for (int k = 0; k < total_seg_src; k++) {
+			int k2 = (k + 1) % total_seg_src;
+			for (int i = 0; i < des_layer_polygons.size(); i++) {
+				int total_seg_des = des_layer_polygons[i].size();
+				for (int j = 0; j < total_seg_des; j++) {
+					int j2 = (j + 1) % total_seg_des;
+
+					// distance and angle checks of the initial segments
+					float dis_init = util::distance(init_src_polygon[k], init_src_polygon[k2], des_ini_layer_polygons[i][j], des_ini_layer_polygons[i][j2]);
+					if (dis_init > dis_threshold) continue;
+					float angle_init = util::lineLineAngle(init_src_polygon[k], init_src_polygon[k2], des_ini_layer_polygons[i][j], des_ini_layer_polygons[i][j2]);
+					if (!(std::abs(angle_init) <= angle_threshold || std::abs(180 - angle_init) <= angle_threshold)) continue;
+
+					// angle score
+					float raw_angle = util::lineLineAngle(src_polygon[k], src_polygon[k2], des_layer_polygons[i][j], des_layer_polygons[i][j2]);
+					float angle = std::min(std::abs(raw_angle), std::abs(180 - raw_angle));
+					if (angle < angle_threshold) {
+						score += 0.5 * (angle_threshold - angle) / angle_threshold;
+
+						cv::Point2d grad_u, grad_v;
+						lineLineAngleGradient(src_polygon[k], src_polygon[k2], des_layer_polygons[i][j], des_layer_polygons[i][j2], grad_u, grad_v);
+						double slope = -0.5 / angle_threshold * (std::abs(180 - raw_angle) < std::abs(raw_angle) ? -1.0 : 1.0);
+						grad_src[k] -= grad_u * slope;
+						grad_src[k2] += grad_u * slope;
+						grad_des[i][j] -= grad_v * slope;
+						grad_des[i][j2] += grad_v * slope;
+					}
+
+					// distance score
+					cv::Point2d grad_a, grad_b, grad_c, grad_d;
+					float dis = segmentSegmentDistanceGradient(src_polygon[k], src_polygon[k2], des_layer_polygons[i][j], des_layer_polygons[i][j2], grad_a, grad_b, grad_c, grad_d);
+					if (dis < dis_threshold) {
+						score += 0.5 * (dis_threshold - dis) / dis_threshold;
+
+						double slope = -0.5 / dis_threshold;
+						grad_src[k] += grad_a * slope;
+						grad_src[k2] += grad_b * slope;
+						grad_des[i][j] += grad_c * slope;
+						grad_des[i][j2] += grad_d * slope;
+					}
+
+					valid_segments++;
+				}
+			}
+		}
+
+		if (valid_segments == 0) return score;
+		for (int k = 0; k < grad_src.size(); k++) {
+			grad_src[k] *= 1.0 / valid_segments;
+		}
+		for (int i = 0; i < grad_des.size(); i++) {
+			for (int j = 0; j < grad_des[i].size(); j++) {
+				grad_des[i][j] *= 1.0 / valid_segments;
+			}
+		}
+		return score / valid_segments;
+	}
+
+	/**
+	 * Calculate the IOU of two simple polygons and its derivative with respect to their vertices.
+	 * The intersection area is obtained by integrating along the parts of the boundaries inside the other polygon,
+	 * and its derivative is the integral of the normal velocity along the part of the moving boundary.
+	 *
+	 * @param polygon1		first polygon
+	 * @param polygon2		second polygon
+	 * @param grad1			derivative of the IOU with respect to the vertices of the first polygon
+	 * @param grad2			derivative of the IOU with respect to the vertices of the second polygon
+	 * @return				IOU
+	 */
+	double iouGradient(const std::vector<cv::Point2f>& polygon1, const std::vector<cv::Point2f>& polygon2, std::vector<cv::Point2d>& grad1, std::vector<cv::Point2d>& grad2) {
+		grad1.assign(polygon1.size(), cv::Point2d(0, 0));
+		grad2.assign(polygon2.size(), cv::Point2d(0, 0));
+		if (polygon1.size() < 3 || polygon2.size() < 3) return 0;
+
+		std::vector<cv::Point2d> pol1(polygon1.begin(), polygon1.end());
+		std::vector<cv::Point2d> pol2(polygon2.begin(), polygon2.end());
+
+		std::vector<cv::Point2d> inter_grad1;
+		std::vector<cv::Point2d> inter_grad2;
+		double inter_area = integrateBoundaryInside(pol1, pol2, inter_grad1) + integrateBoundaryInside(pol2, pol1, inter_grad2);
+		double area1 = signedArea(pol1);
+		double area2 = signedArea(pol2);
+		double union_area = std::abs(area1) + std::abs(area2) - inter_area;
+		if (union_area <= 0) return 0;
+
+		// derivative of the absolute area by the shoelace formula
+		double sign1 = area1 >= 0 ? 0.5 : -0.5;
+		double sign2 = area2 >= 0 ? 0.5 : -0.5;
+		for (int i = 0; i < pol1.size(); i++) {
+			const cv::Point2d& prev = pol1[(i - 1 + pol1.size()) % pol1.size()];
+			const cv::Point2d& next = pol1[(i + 1) % pol1.size()];
+			cv::Point2d area_grad = cv::Point2d(next.y - prev.y, prev.x - next.x) * sign1;
+			grad1[i] = (inter_grad1[i] * union_area - (area_grad - inter_grad1[i]) * inter_area) * (1.0 / union_area / union_area);
+		}
+		for (int i = 0; i < pol2.size(); i++) {
+			const cv::Point2d& prev = pol2[(i - 1 + pol2.size()) % pol2.size()];
+			const cv::Point2d& next = pol2[(i + 1) % pol2.size()];
+			cv::Point2d area_grad = cv::Point2d(next.y - prev.y, prev.x - next.x) * sign2;
+			grad2[i] = (inter_grad2[i] * union_area - (area_grad - inter_grad2[i]) * inter_area) * (1.0 / union_area / union_area);
+		}
+
+		return inter_area / union_area;
+	}
+
+	/**
+	 * Calculate the IOU between the polygon and its mirror image with respect to the line (a, b),
+	 * and its derivative with respect to the vertices of the polygon.
+	 */
+	double symmetryIOUGradient(const std::vector<cv::Point2f>& polygon, const cv::Point2f& a, const cv::Point2f& b, std::vector<cv::Point2d>& grad) {
+		std::vector<cv::Point2f> polygon_symmetry = mirrorPolygon(polygon, a, b);
+
+		std::vector<cv::Point2d> grad_symmetry;
+		double iou = iouGradient(polygon, polygon_symmetry, grad, grad_symmetry);
+		addMirrorGradient(a, b, grad_symmetry, grad);
+		return iou;
+	}
+
+	/**
+	 * Calculate the IOU between the polygons by util::calculateIOUbyImage, and its derivative with respect to
+	 * the vertices of both polygons. The polygons are rasterized once in the same way as util::calculateIOUbyImage,
+	 * and the derivatives of the areas and the overlap are integrated along the edges by boundaryGradient.
+	 * The cost is the two rasterizations plus a walk along the edges every half pixel,
+	 * instead of four rasterizations per vertex for the numerical derivative.
+	 * Although the IOU by the image is piecewise constant, this is the derivative of the IOU of the filled regions,
+	 * which the pixel counts approximate.
+	 *
+	 * @param polygon1		first polygon
+	 * @param polygon2		second polygon
+	 * @param image_size	size of the image
+	 * @param grad1			derivative with respect to each vertex of the first polygon
+	 * @param grad2			derivative with respect to each vertex of the second polygon
+	 * @return				IOU (the same value as util::calculateIOUbyImage)
+	 */
+	double imageIOUGradient(const std::vector<cv::Point2f>& polygon1, const std::vector<cv::Point2f>& polygon2, int image_size, std::vector<cv::Point2d>& grad1, std::vector<cv::Point2d>& grad2) {
+		grad1.assign(polygon1.size(), cv::Point2d(0, 0));
+		grad2.assign(polygon2.size(), cv::Point2d(0, 0));
+
+		int min_x = INT_MAX;
+		int min_y = INT_MAX;
+		int max_x = INT_MIN;
+		int max_y = INT_MIN;
+		for (int i = 0; i < polygon1.size() + polygon2.size(); i++) {
+			const cv::Point2f& p = i < polygon1.size() ? polygon1[i] : polygon2[i - polygon1.size()];
+			min_x = std::min(min_x, (int)p.x);
+			min_y = std::min(min_y, (int)p.y);
+			max_x = std::max(max_x, (int)(p.x + 0.5));
+			max_y = std::max(max_y, (int)(p.y + 0.5));
+		}
+		float scale = (float)image_size / std::max(max_x - min_x, max_y - min_y);
+
+		// rasterize the polygons at the same integer vertices as util::calculateIOUbyImage
+		std::vector<std::vector<cv::Point>> contour_points1(1, std::vector<cv::Point>(polygon1.size()));
+		std::vector<cv::Point2d> points1(polygon1.size());
+		for (int i = 0; i < polygon1.size(); i++) {
+			contour_points1[0][i] = cv::Point((polygon1[i].x - min_x) * scale, (polygon1[i].y - min_y) * scale);
+			points1[i] = cv::Point2d(contour_points1[0][i].x, contour_points1[0][i].y);
+		}
+		std::vector<std::vector<cv::Point>> contour_points2(1, std::vector<cv::Point>(polygon2.size()));
+		std::vector<cv::Point2d> points2(polygon2.size());
+		for (int i = 0; i < polygon2.size(); i++) {
+			contour_points2[0][i] = cv::Point((polygon2[i].x - min_x) * scale, (polygon2[i].y - min_y) * scale);
+			points2[i] = cv::Point2d(contour_points2[0][i].x, contour_points2[0][i].y);
+		}
+		util::BinaryMask mask1(image_size, image_size);
+		if (polygon1.size() > 0) mask1.fillPoly(contour_points1);
+		util::BinaryMask mask2(image_size, image_size);
+		if (polygon2.size() > 0) mask2.fillPoly(contour_points2);
+
+		long long inter_cnt;
+		long long union_cnt;
+		util::BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
+		if (union_cnt == 0) return 0;
+
+		// the derivative of the IOU in the pixel coordinates is scaled to the one in the coordinates of the polygons
+		std::vector<cv::Point2d> area_grad;
+		std::vector<cv::Point2d> inter_grad;
+		double inter_area = inter_cnt;
+		double union_area = union_cnt;
+		boundaryGradient(points1, mask1, mask2, area_grad, inter_grad);
+		for (int i = 0; i < polygon1.size(); i++) {
+			grad1[i] = (inter_grad[i] * union_area - (area_grad[i] - inter_grad[i]) * inter_area) * (scale / union_area / union_area);
+		}
+		boundaryGradient(points2, mask2, mask1, area_grad, inter_grad);
+		for (int i = 0; i < polygon2.size(); i++) {
+			grad2[i] = (inter_grad[i] * union_area - (area_grad[i] - inter_grad[i]) * inter_area) * (scale / union_area / union_area);
+		}
+
+		return inter_area / union_area;
+	}
+
+	/**
+	 * Calculate the accuracy score of the regularizer objectives and its derivative with respect to the vertices of the polygon.
+	 * The objectives use the IOU by CGAL if both polygons are simple, and the IOU by the image otherwise.
+	 * The analytic derivative of iouGradient is valid only for the former, so the latter is differentiated by imageIOUGradient,
+	 * which costs two rasterizations of IOU_IMAGE_SIZE x IOU_IMAGE_SIZE and a walk along the edges.
+	 *
+	 * @param polygon	polygon being optimized
+	 * @param target	target polygon
+	 * @param grad		derivative with respect to each vertex of the polygon
+	 * @return			IOU
+	 */
+	double accuracyGradient(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& target, std::vector<cv::Point2d>& grad) {
+		std::vector<cv::Point2d> grad_target;
+		if (util::isSimple(polygon) && util::isSimple(target)) {
+			return iouGradient(polygon, target, grad, grad_target);
+		}
+		return imageIOUGradient(polygon, target, IOU_IMAGE_SIZE, grad, grad_target);
+	}
+
+	/**
+	 * Calculate the symmetry score of the regularizer objectives and its derivative with respect to the vertices of the polygon.
+	 * As in accuracyGradient, the analytic derivative is used only if the polygon and its mirror image are simple.
+	 *
+	 * @param polygon	polygon being optimized
+	 * @param a			first point of the symmetry line
+	 * @param b			second point of the symmetry line
+	 * @param grad		derivative with respect to each vertex of the polygon
+	 * @return			IOU between the polygon and its mirror image
+	 */
+	double symmetryGradient(const std::vector<cv::Point2f>& polygon, const cv::Point2f& a, const cv::Point2f& b, std::vector<cv::Point2d>& grad) {
+		std::vector<cv::Point2f> polygon_symmetry = mirrorPolygon(polygon, a, b);
+		if (util::isSimple(polygon) && util::isSimple(polygon_symmetry)) {
+			return symmetryIOUGradient(polygon, a, b, grad);
+		}
+
+		std::vector<cv::Point2d> grad_symmetry;
+		double iou = imageIOUGradient(polygon, polygon_symmetry, IOU_IMAGE_SIZE, grad, grad_symmetry);
+		addMirrorGradient(a, b, grad_symmetry, grad);
+		return iou;
+	}
+
+}
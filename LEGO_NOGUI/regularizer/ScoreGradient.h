@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace regularizer {
+
+	/**
+	 * Analytic derivatives of the regularization scores used by ShapeFitLayer and ShapeFitLayersAll.
+	 * Each score function returns the same value as its counterpart in util (calculateScoreRaOpt, etc.),
+	 * and stores the derivative of the score with respect to each vertex in the gradient arrays.
+	 * The scores are piecewise smooth, so the derivative is exact except on the boundaries of the pieces.
+	 */
+
+	double lineLineAngleGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, const cv::Point2f& d, cv::Point2d& grad_u, cv::Point2d& grad_v);
+	double pointSegmentDistanceGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, cv::Point2d& grad_a, cv::Point2d& grad_b, cv::Point2d& grad_c);
+	double segmentSegmentDistanceGradient(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c, const cv::Point2f& d, cv::Point2d& grad_a, cv::Point2d& grad_b, cv::Point2d& grad_c, cv::Point2d& grad_d);
+
+	float scoreRaOpt(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& init_polygon, int angle_threshold, std::vector<cv::Point2d>& grad);
+	float scoreParallelOpt(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& init_polygon, int angle_threshold, std::vector<cv::Point2d>& grad);
+	float scorePointOpt(const std::vector<cv::Point2f>& src_polygon, const std::vector<cv::Point2f>& init_src_polygon, const std::vector<std::vector<cv::Point2f>>& des_layer_polygons, const std::vector<std::vector<cv::Point2f>>& des_ini_layer_polygons, float dis_threshold, std::vector<cv::Point2d>& grad_src, std::vector<std::vector<cv::Point2d>>& grad_des);
+	float scoreSegOpt(const std::vector<cv::Point2f>& src_polygon, const std::vector<cv::Point2f>& init_src_polygon, const std::vector<std::vector<cv::Point2f>>& des_layer_polygons, const std::vector<std::vector<cv::Point2f>>& des_ini_layer_polygons, float dis_threshold, float angle_threshold, std::vector<cv::Point2d>& grad_src, std::vector<std::vector<cv::Point2d>>& grad_des);
+
+	double iouGradient(const std::vector<cv::Point2f>& polygon1, const std::vector<cv::Point2f>& polygon2, std::vector<cv::Point2d>& grad1, std::vector<cv::Point2d>& grad2);
+	double symmetryIOUGradient(const std::vector<cv::Point2f>& polygon, const cv::Point2f& a, const cv::Point2f& b, std::vector<cv::Point2d>& grad);
+	double imageIOUGradient(const std::vector<cv::Point2f>& polygon1, const std::vector<cv::Point2f>& polygon2, int image_size, std::vector<cv::Point2d>& grad1, std::vector<cv::Point2d>& grad2);
+
+	// image size of util::calculateIOUbyImage, which the objectives use when the polygons are not simple
+	const int IOU_IMAGE_SIZE = 1000;
+
+	double accuracyGradient(const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2f>& target, std::vector<cv::Point2d>& grad);
+	double symmetryGradient(const std::vector<cv::Point2f>& polygon, const cv::Point2f& a, const cv::Point2f& b, std::vector<cv::Point2d>& grad);
+
+}
@@ -5,6 +5,7 @@
 #include <dlib/optimization.h>
 #include "../util/ContourUtils.h"
 #include "Config.h"
+#include "ScoreGradient.h"
 
 class ShapeFitLayer {
 		
@@ -87,7 +88,7 @@ class ShapeFitLayer {
 								float iou = 0.0f;
 								if (!util::isSimple(polygons[i]) || !util::isSimple(polygon_symmetry)){
 									//std::cout << "image method" << std::endl;
-									iou = util::calculateIOUbyImage(polygons[i], polygon_symmetry, 1000);
+									iou = util::calculateIOUbyImage(polygons[i], polygon_symmetry, regularizer::IOU_IMAGE_SIZE);
 								}
 								else{
 									iou = util::calculateIOUbyCGAL(polygons[i], polygon_symmetry);
@@ -106,7 +107,7 @@ class ShapeFitLayer {
 							float accuracy_score = 0.0f;
 							if (!util::isSimple(polygons[i]) || !util::isSimple(target_polygons[i])){
 								//std::cout << "image method" << std::endl;
-								accuracy_score = util::calculateIOUbyImage(polygons[i], target_polygons[i], 1000);
+								accuracy_score = util::calculateIOUbyImage(polygons[i], target_polygons[i], regularizer::IOU_IMAGE_SIZE);
 							}
 							else{
 								//std::cout << "cgal method" << std::endl;
@@ -134,6 +135,72 @@ class ShapeFitLayer {
 				return 0;
 			}
 		}
+
+		/**
+		 * Analytic derivative of the objective function with respect to the vertex coordinates.
+		 * The angle-based scores are differentiated through the angles, and the IOU-based scores
+		 * are differentiated by the normal velocity of the polygon boundary. When the objective falls back to the IOU
+		 * by the image for non-simple polygons, the IOU-based scores are differentiated numerically instead.
+		 */
+		column_vector derivative(const column_vector& arg) const {
+			std::vector<std::vector<cv::Point2f>> polygons;
+			polygons.resize(init_polygons.size());
+			int start_index = 0;
+			for (int i = 0; i < init_polygons.size(); i++){
+				for (int j = 0; j < init_polygons[i].size(); j++) {
+					polygons[i].push_back(cv::Point2f(arg((j + start_index) * 2), arg((j + start_index) * 2 + 1)));
+				}
+				start_index += init_polygons[i].size();
+			}
+
+			column_vector der = dlib::zeros_matrix<double>(arg.size(), 1);
+			try {
+				std::vector<cv::Point2d> grad;
+				int valid_polygons = 0;
+				start_index = 0;
+				for (int i = 0; i < init_polygons.size(); i++){
+					if (init_polygons[i].size() != 0){
+						if (bUseRaOpt){
+							regularizer::scoreRaOpt(polygons[i], init_polygons[i], angle_threshold_RA, grad);
+							addGradient(der, start_index, grad, raWeight);
+						}
+						if (bUseParallelOpt){
+							regularizer::scoreParallelOpt(polygons[i], init_polygons[i], angle_threshold_parallel, grad);
+							addGradient(der, start_index, grad, parallelWeight);
+						}
+						if (bUseSymmetryLineOpt && symmetry_lines[i].size() != 0){
+							regularizer::symmetryGradient(polygons[i], symmetry_lines[i][0], symmetry_lines[i][1], grad);
+							addGradient(der, start_index, grad, symmetryWeight);
+						}
+						if (bUseAccuracy){
+							regularizer::accuracyGradient(polygons[i], target_polygons[i], grad);
+							addGradient(der, start_index, grad, accuracyWeight);
+						}
+						if (bUseSymmetryLineOpt && !bUseRaOpt && !bUseParallelOpt && !bUseAccuracy){
+							if (symmetry_lines[i].size() != 0)
+								valid_polygons++;
+						}
+						else
+							valid_polygons++;
+					}
+					start_index += init_polygons[i].size();
+				}
+				if (valid_polygons > 0)
+					der = der / valid_polygons;
+			}
+			catch (...) {
+				der = dlib::zeros_matrix<double>(arg.size(), 1);
+			}
+			return der;
+		}
+
+	private:
+		static void addGradient(column_vector& der, int start_index, const std::vector<cv::Point2d>& grad, double weight) {
+			for (int j = 0; j < grad.size(); j++) {
+				der((j + start_index) * 2) += grad[j].x * weight;
+				der((j + start_index) * 2 + 1) += grad[j].y * weight;
+			}
+		}
 	};
 
 protected:
@@ -6,6 +6,7 @@
 #include "../util/ContourUtils.h"
 #include "../util/BuildingLayer.h"
 #include "Config.h"
+#include "ScoreGradient.h"
 
 class ShapeFitLayersAll {
 		
@@ -84,7 +85,7 @@ class ShapeFitLayersAll {
 									float iou = 0.0f;
 									if (!util::isSimple(polygons[k][i]) || !util::isSimple(polygon_symmetry)){
 										//std::cout << "image method" << std::endl;
-										iou = util::calculateIOUbyImage(polygons[k][i], polygon_symmetry, 1000);
+										iou = util::calculateIOUbyImage(polygons[k][i], polygon_symmetry, regularizer::IOU_IMAGE_SIZE);
 									}
 									else{
 										iou = util::calculateIOUbyCGAL(polygons[k][i], polygon_symmetry);
@@ -103,7 +104,7 @@ class ShapeFitLayersAll {
 								float accuracy_score = 0.0f;
 								if (!util::isSimple(polygons[k][i]) || !util::isSimple(target_layers_polygons[k][i])){
 									//std::cout << "image method" << std::endl;
-									accuracy_score += util::calculateIOUbyImage(polygons[k][i], target_layers_polygons[k][i], 1000);
+									accuracy_score += util::calculateIOUbyImage(polygons[k][i], target_layers_polygons[k][i], regularizer::IOU_IMAGE_SIZE);
 								}
 								else{
 									//std::cout << "cgal method" << std::endl;
@@ -180,6 +181,126 @@ class ShapeFitLayersAll {
 				return 0;
 			}
 		}
+
+		/**
+		 * Analytic derivative of the objective function with respect to the vertex coordinates.
+		 * The snapping scores also depend on the polygons of the parent layers, so their derivatives
+		 * are accumulated to the vertices of both the source polygon and the parent polygons.
+		 * The IOU-based scores are differentiated numerically when the objective falls back to the IOU by the image.
+		 */
+		column_vector derivative(const column_vector& arg) const {
+			std::vector<layer_polygons> polygons;
+			std::vector<std::vector<int>> start_indices;
+			polygons.resize(init_layers_polygons.size());
+			start_indices.resize(init_layers_polygons.size());
+			int start_index = 0;
+			for (int k = 0; k < init_layers_polygons.size(); k++){
+				polygons[k].resize(init_layers_polygons[k].size());
+				for (int i = 0; i < init_layers_polygons[k].size(); i++){
+					for (int j = 0; j < init_layers_polygons[k][i].size(); j++) {
+						polygons[k][i].push_back(cv::Point2f(arg((j + start_index) * 2), arg((j + start_index) * 2 + 1)));
+					}
+					start_indices[k].push_back(start_index);
+					start_index += init_layers_polygons[k][i].size();
+				}
+			}
+
+			column_vector der = dlib::zeros_matrix<double>(arg.size(), 1);
+			try {
+				// weight of each layer in the averaged score
+				std::vector<double> layer_weights(init_layers_polygons.size(), 0.0);
+				int valid_layers = 0;
+				for (int k = 0; k < init_layers_polygons.size(); k++){
+					int valid_layer_polygons = 0;
+					for (int i = 0; i < init_layers_polygons[k].size(); i++){
+						for (int p = 0; p < 6; p++){
+							if (validity_layer_polygons[k][i][p]){
+								valid_layer_polygons++;
+								break;
+							}
+						}
+					}
+					if (valid_layer_polygons > 0){
+						valid_layers++;
+						layer_weights[k] = 1.0 / valid_layer_polygons;
+					}
+				}
+				if (valid_layers > 0){
+					for (int k = 0; k < layer_weights.size(); k++)
+						layer_weights[k] /= valid_layers;
+				}
+
+				std::vector<cv::Point2d> grad;
+				std::vector<std::vector<cv::Point2d>> grad_des;
+				for (int k = 0; k < init_layers_polygons.size(); k++){
+					if (layer_weights[k] == 0) continue;
+					for (int i = 0; i < init_layers_polygons[k].size(); i++){
+						if (init_layers_polygons[k][i].size() == 0) continue;
+						double weight = layer_weights[k];
+						if (config.bUseRaOpt && validity_layer_polygons[k][i][0]){
+							regularizer::scoreRaOpt(polygons[k][i], init_layers_polygons[k][i], config.angle_threshold_RA, grad);
+							addGradient(der, start_indices[k][i], grad, weight * config.raWeight * config.intraWeight);
+						}
+						if (config.bUseParallelOpt && validity_layer_polygons[k][i][1]){
+							regularizer::scoreParallelOpt(polygons[k][i], init_layers_polygons[k][i], config.angle_threshold_parallel, grad);
+							addGradient(der, start_indices[k][i], grad, weight * config.parallelWeight * config.intraWeight);
+						}
+						if (config.bUseSymmetryLineOpt && validity_layer_polygons[k][i][2] && layers_symmetry_lines[k][i].size() != 0){
+							regularizer::symmetryGradient(polygons[k][i], layers_symmetry_lines[k][i][0], layers_symmetry_lines[k][i][1], grad);
+							addGradient(der, start_indices[k][i], grad, weight * config.symmetryWeight * config.intraWeight);
+						}
+						if (config.bUseAccuracyOpt){
+							regularizer::accuracyGradient(polygons[k][i], target_layers_polygons[k][i], grad);
+							addGradient(der, start_indices[k][i], grad, weight * config.accuracyWeight * config.intraWeight);
+						}
+						if (config.bUsePointSnapOpt && validity_layer_polygons[k][i][4]){
+							column_vector snap_der = dlib::zeros_matrix<double>(arg.size(), 1);
+							int valid_num = 0;
+							for (int j = 0; j < tree_info[k].first.size(); j++){
+								int parent = tree_info[k].first[j];
+								float score_tmp = regularizer::scorePointOpt(polygons[k][i], init_layers_polygons[k][i], polygons[parent], init_layers_polygons[parent], config.pointDisThreshold, grad, grad_des);
+								if (abs(score_tmp) > 0.1){
+									valid_num++;
+									addGradient(snap_der, start_indices[k][i], grad, 1.0);
+									for (int l = 0; l < grad_des.size(); l++)
+										addGradient(snap_der, start_indices[parent][l], grad_des[l], 1.0);
+								}
+							}
+							if (valid_num > 0)
+								der += snap_der * (weight * config.pointWeight * config.interWeight / valid_num);
+						}
+						if (config.bUseSegSnapOpt && validity_layer_polygons[k][i][5]){
+							column_vector snap_der = dlib::zeros_matrix<double>(arg.size(), 1);
+							int valid_num = 0;
+							for (int j = 0; j < tree_info[k].first.size(); j++){
+								int parent = tree_info[k].first[j];
+								float score_tmp = regularizer::scoreSegOpt(polygons[k][i], init_layers_polygons[k][i], polygons[parent], init_layers_polygons[parent], config.segDisThreshold, config.segAngleThreshold, grad, grad_des);
+								if (abs(score_tmp) > 0.1){
+									valid_num++;
+									addGradient(snap_der, start_indices[k][i], grad, 1.0);
+									for (int l = 0; l < grad_des.size(); l++)
+										addGradient(snap_der, start_indices[parent][l], grad_des[l], 1.0);
+								}
+							}
+							if (valid_num > 0)
+								der += snap_der * (weight * config.segWeight * config.interWeight / valid_num);
+						}
+					}
+				}
+			}
+			catch (...) {
+				der = dlib::zeros_matrix<double>(arg.size(), 1);
+			}
+			return der;
+		}
+
+	private:
+		static void addGradient(column_vector& der, int start_index, const std::vector<cv::Point2d>& grad, double weight) {
+			for (int j = 0; j < grad.size(); j++) {
+				der((j + start_index) * 2) += grad[j].x * weight;
+				der((j + start_index) * 2 + 1) += grad[j].y * weight;
+			}
+		}
 	};
 
 protected:
@@ -9,6 +9,9 @@
 #include "../util/EfficientRansacCurveDetector.h"
 #include "../regularizer/ShapeFitLayer.h"
 #include "../regularizer/ShapeFitLayersAll.h"
+#include "../util/ThreadPool.h"
+#include "../util/Profiler.h"
+#include "../util/Log.h"
 
 namespace simp {
 
@@ -26,45 +29,43 @@ namespace simp {
 	 * @param min_contour_area			Minimum area of the contour [pixel^2]. Note: the unit is already converted from m^2 to pixel^2.
 	 * @param allow_triangle_contour	True if a triangle is allowed as a simplified contour shape
 	 * @param min_hole_ratio			The minimum area ratio of a hole to the contour. If the area of the hole is too small, it will be removed.
+	 * @param regularizer_configs		Configurations of the regularizer runs
+	 * @param num_threads				The number of threads to simplify the buildings concurrently (0 - all the hardware threads, 1 - serial)
 	 */
-	std::vector<std::shared_ptr<util::BuildingLayer>> BuildingSimplification::simplifyBuildings(std::vector<util::VoxelBuilding>& voxel_buildings, std::map<int, std::vector<double>>& algorithms, bool record_stats, int min_num_slices_per_layer, float alpha, float layering_threshold, float snapping_threshold, float orientation, float min_contour_area, float max_obb_ratio, bool allow_triangle_contour, bool allow_overhang, float min_hole_ratio, const std::vector<regularizer::Config>& regularizer_configs) {
+	std::vector<std::shared_ptr<util::BuildingLayer>> BuildingSimplification::simplifyBuildings(std::vector<util::VoxelBuilding>& voxel_buildings, std::map<int, std::vector<double>>& algorithms, bool record_stats, int min_num_slices_per_layer, float alpha, float layering_threshold, float snapping_threshold, float orientation, float min_contour_area, float max_obb_ratio, bool allow_triangle_contour, bool allow_overhang, float min_hole_ratio, const std::vector<regularizer::Config>& regularizer_configs, int num_threads) {
 		std::vector<std::shared_ptr<util::BuildingLayer>> buildings;
 
 		std::vector<std::tuple<float, long long, int>> records;
 
-		time_t start = clock();
-		setbuf(stdout, NULL);
-		for (int i = 0; i < voxel_buildings.size(); i++) {
-			std::vector<std::shared_ptr<util::BuildingLayer>> components = util::DisjointVoxelData::layering(voxel_buildings[i], layering_threshold, min_num_slices_per_layer);
-			for (auto component : components) {
-				try {
-					// Better approach using efficient RANSAC
-					//int height = component->getTopHeight();
-					//bool curve_preferred = height < 121 && (component->top_height - component->bottom_height < 37) && component->top_height < 53 && util::EfficientRansacCurveDetector::detect2(component->raw_footprints);
-					bool curve_preferred = false;
-					/*
-					int height = component->getTopHeight();
-					bool curve_preferred = height < 121 && (component->top_height - component->bottom_height < 37) && component->top_height < 53 && util::EfficientRansacCurveDetector::detect(contours[0]);
-					*/
-
-					std::shared_ptr<util::BuildingLayer> building;
-					building = simplifyBuildingByAll(i, component, {}, algorithms, alpha, snapping_threshold, orientation, min_contour_area, max_obb_ratio, allow_triangle_contour, allow_overhang, min_hole_ratio, curve_preferred, records);
-					// regularizer
-					if (regularizer_configs.size() >= 0 && algorithms.find(ALG_EFFICIENT_RANSAC) != algorithms.end())
-					{
-						std::vector<std::shared_ptr<util::BuildingLayer>>layers;
-						std::vector<std::pair<int, int>>layers_relationship;
-						generateVectorForAllLayers(building, 0, layers, layers_relationship);
-						building = regularizerBuilding(layers, layers_relationship, regularizer_configs, snapping_threshold);
-					}
+		// Each building has its own output and stats buffer, which are concatenated in the building order
+		// at the end so that the result does not depend on the number of threads.
+		std::vector<std::vector<std::shared_ptr<util::BuildingLayer>>> buildings_per_voxel_building(voxel_buildings.size());
+		std::vector<std::vector<std::tuple<float, long long, int>>> records_per_voxel_building(voxel_buildings.size());
 
-					buildings.push_back(building);
-				}
-				catch (...) {}
+		long long start = util::Profiler::now();
+		num_threads = std::min(util::ThreadPool::resolveNumThreads(num_threads), (int)voxel_buildings.size());
+		if (num_threads <= 1) {
+			for (int i = 0; i < voxel_buildings.size(); i++) {
+				simplifyBuilding(i, voxel_buildings[i], algorithms, min_num_slices_per_layer, alpha, layering_threshold, snapping_threshold, orientation, min_contour_area, max_obb_ratio, allow_triangle_contour, allow_overhang, min_hole_ratio, regularizer_configs, buildings_per_voxel_building[i], records_per_voxel_building[i]);
 			}
 		}
-		time_t end = clock();
-		std::cout << "Time elapsed " << (double)(end - start) / CLOCKS_PER_SEC << " sec." << std::endl;
+		else {
+			util::ThreadPool pool(num_threads);
+			for (int i = 0; i < voxel_buildings.size(); i++) {
+				pool.enqueue([&, i]() {
+					// std::map::operator[] is not guaranteed to be thread-safe, so each task uses its own copy.
+					std::map<int, std::vector<double>> local_algorithms = algorithms;
+					simplifyBuilding(i, voxel_buildings[i], local_algorithms, min_num_slices_per_layer, alpha, layering_threshold, snapping_threshold, orientation, min_contour_area, max_obb_ratio, allow_triangle_contour, allow_overhang, min_hole_ratio, regularizer_configs, buildings_per_voxel_building[i], records_per_voxel_building[i]);
+				});
+			}
+			pool.wait();
+		}
+		for (int i = 0; i < voxel_buildings.size(); i++) {
+			buildings.insert(buildings.end(), buildings_per_voxel_building[i].begin(), buildings_per_voxel_building[i].end());
+			records.insert(records.end(), records_per_voxel_building[i].begin(), records_per_voxel_building[i].end());
+		}
+		long long end = util::Profiler::now();
+		util::Log::out() << "Time elapsed " << (end - start) * 1e-6 << " sec." << std::endl;
 
 		if (record_stats) {
 			std::ofstream out("records.txt");
@@ -80,6 +81,55 @@ namespace simp {
 		return buildings;
 	}
 
+	/**
+	 * Layer, simplify, and regularize one voxel building.
+	 * This function only touches its own output buffers, so it can be called concurrently for different buildings.
+	 *
+	 * @param building_id				The index of the voxel building
+	 * @param voxel_building			Input building
+	 * @param buildings					The simplified components of the building will be appended to this array.
+	 * @param records					The statistics of the building will be appended to this array.
+	 */
+	void BuildingSimplification::simplifyBuilding(int building_id, const util::VoxelBuilding& voxel_building, std::map<int, std::vector<double>>& algorithms, int min_num_slices_per_layer, float alpha, float layering_threshold, float snapping_threshold, float orientation, float min_contour_area, float max_obb_ratio, bool allow_triangle_contour, bool allow_overhang, float min_hole_ratio, const std::vector<regularizer::Config>& regularizer_configs, std::vector<std::shared_ptr<util::BuildingLayer>>& buildings, std::vector<std::tuple<float, long long, int>>& records) {
+		util::ScopedTimer building_timer("building", building_id);
+
+		std::vector<std::shared_ptr<util::BuildingLayer>> components;
+		{
+			util::ScopedTimer timer("layering");
+			components = util::DisjointVoxelData::layering(voxel_building, layering_threshold, min_num_slices_per_layer);
+		}
+		for (auto component : components) {
+			try {
+				// Better approach using efficient RANSAC
+				//int height = component->getTopHeight();
+				//bool curve_preferred = height < 121 && (component->top_height - component->bottom_height < 37) && component->top_height < 53 && util::EfficientRansacCurveDetector::detect2(component->raw_footprints);
+				bool curve_preferred = false;
+				/*
+				int height = component->getTopHeight();
+				bool curve_preferred = height < 121 && (component->top_height - component->bottom_height < 37) && component->top_height < 53 && util::EfficientRansacCurveDetector::detect(contours[0]);
+				*/
+
+				std::shared_ptr<util::BuildingLayer> building;
+				{
+					util::ScopedTimer timer("simplification");
+					building = simplifyBuildingByAll(building_id, component, {}, algorithms, alpha, snapping_threshold, orientation, min_contour_area, max_obb_ratio, allow_triangle_contour, allow_overhang, min_hole_ratio, curve_preferred, records);
+				}
+				// regularizer
+				if (regularizer_configs.size() >= 0 && algorithms.find(ALG_EFFICIENT_RANSAC) != algorithms.end())
+				{
+					util::ScopedTimer timer("regularizer");
+					std::vector<std::shared_ptr<util::BuildingLayer>>layers;
+					std::vector<std::pair<int, int>>layers_relationship;
+					generateVectorForAllLayers(building, 0, layers, layers_relationship);
+					building = regularizerBuilding(layers, layers_relationship, regularizer_configs, snapping_threshold);
+				}
+
+				buildings.push_back(building);
+			}
+			catch (...) {}
+		}
+	}
+
 	/**
 	 * This is just for the old interface. This will be depricated in the future.
 	 */
@@ -108,7 +158,8 @@ namespace simp {
 	 * @param records				The statistics will be recorded.
 	 */
 	std::shared_ptr<util::BuildingLayer> BuildingSimplification::simplifyBuildingByAll(int building_id, std::shared_ptr<util::BuildingLayer> layer, const std::vector<util::Polygon>& parent_contours, std::map<int, std::vector<double>>& algorithms, float alpha, float snapping_threshold, float orientation, float min_contour_area, float max_obb_ratio, bool allow_triangle_contour, bool allow_overhang, float min_hole_ratio, bool curve_preferred, std::vector<std::tuple<float, long long, int>>& records) {
-		std::vector<util::Polygon> contours = layer->selectRepresentativeContours();
+		// the representative contours were selected by the layering
+		std::vector<util::Polygon> contours = layer->presentativeContours;
 
 		// get baseline cost
 		std::vector<util::Polygon> baseline_polygons;
@@ -134,6 +185,7 @@ namespace simp {
 			// try Douglas-Peucker
 			if (algorithms.find(ALG_DP) != algorithms.end()) {
 				try {
+					util::ScopedTimer timer("douglas_peucker");
 					double epsilon = algorithms[ALG_DP][0];
 					util::Polygon simplified_polygon = DPSimplification::simplify(contours[i], epsilon, min_hole_ratio);
 					if (!util::isSimple(simplified_polygon.contour)) throw "Contour is self-intersecting.";
@@ -165,6 +217,7 @@ namespace simp {
 			// try right angle
 			if (algorithms.find(ALG_RIGHTANGLE) != algorithms.end()) {
 				try {
+					util::ScopedTimer timer("right_angle");
 					int resolution = algorithms[ALG_RIGHTANGLE][0];
 					bool optimization = algorithms[ALG_RIGHTANGLE][1] > 0.0;
 					util::Polygon simplified_polygon = RightAngleSimplification::simplify(contours[i], resolution, orientation, min_hole_ratio, optimization);
@@ -198,6 +251,7 @@ namespace simp {
 			// try curve
 			if (algorithms.find(ALG_CURVE) != algorithms.end()) {
 				try {
+					util::ScopedTimer timer("curve");
 					float epsilon = algorithms[ALG_CURVE][0];
 					float curve_threshold = algorithms[ALG_CURVE][1];
 					util::Polygon simplified_polygon = CurveSimplification::simplify(contours[i], epsilon, curve_threshold, orientation, min_hole_ratio);
@@ -230,6 +284,7 @@ namespace simp {
 			// try curve + right angle
 			if (algorithms.find(ALG_CURVE_RIGHTANGLE) != algorithms.end()) {
 				try {
+					util::ScopedTimer timer("curvepp");
 					float epsilon = algorithms[ALG_CURVE_RIGHTANGLE][0];
 					float curve_threshold = algorithms[ALG_CURVE_RIGHTANGLE][1];
 					float angle_threshold = algorithms[ALG_CURVE_RIGHTANGLE][2];
@@ -264,6 +319,7 @@ namespace simp {
 			// try efficient ransac
 			if (algorithms.find(ALG_EFFICIENT_RANSAC) != algorithms.end()) {
 				try {
+					util::ScopedTimer timer("efficient_ransac");
 					util::Polygon simplified_polygon = EfficientRansacSimplification::simplify(contours[i], algorithms[ALG_EFFICIENT_RANSAC], orientation, min_hole_ratio);
 					if (!util::isSimple(simplified_polygon.contour)) throw "Contour is self-intersecting.";
 					// check if the shape is a triangle
@@ -287,12 +343,13 @@ namespace simp {
 						best_num_primitive_shapes = costs[2];
 					}
 				}
-				catch (...) { std::cout << "exception" << std::endl; }
+				catch (...) { util::Log::out() << "exception" << std::endl; }
 			}
 
 			if (best_algorithm == ALG_UNKNOWN) {
 				// try Douglas-Peucker when no method works
 				try {
+					util::ScopedTimer timer("douglas_peucker_fallback");
 					float epsilon = 2;
 					util::Polygon simplified_polygon = DPSimplification::simplify(contours[i], epsilon, min_hole_ratio);
 					if (!util::isSimple(simplified_polygon.contour)) throw "Contour is self-intersecting.";
@@ -316,16 +373,16 @@ namespace simp {
 			if (best_algorithm == ALG_UNKNOWN) continue;
 
 			if (best_algorithm == ALG_RIGHTANGLE) {
-				std::cout << "Selected algorithm: RA" << std::endl;
+				util::Log::out() << "Selected algorithm: RA" << std::endl;
 			}
 			else if (best_algorithm == ALG_CURVE || best_algorithm == ALG_CURVE_RIGHTANGLE) {
-				std::cout << "Selected algorithm: CSRA" << std::endl;
+				util::Log::out() << "Selected algorithm: CSRA" << std::endl;
 			}
 			else if (best_algorithm == ALG_EFFICIENT_RANSAC) {
-				std::cout << "Selected algorithm: EFFICIENT RANSAC" << std::endl;
+				util::Log::out() << "Selected algorithm: EFFICIENT RANSAC" << std::endl;
 			}
 			else {
-				std::cout << "Selected algorithm: DP" << std::endl;
+				util::Log::out() << "Selected algorithm: DP" << std::endl;
 			}
 
 			// snap the edges
@@ -437,7 +494,7 @@ namespace simp {
 			bool bUseInter = regularizer_configs[i].bUseInter;
 
 			if (bUseIntra && !bUseInter){
-				std::cout << "Regularizer one layer!!!" << std::endl;
+				util::Log::out() << "Regularizer one layer!!!" << std::endl;
 				if (regularizer_configs[i].bUseSymmetryLineOpt && layers.size() >= 5)
 					continue;
 				// save the original state of layers
@@ -480,7 +537,7 @@ namespace simp {
 
 			}
 			else if (bUseInter){
-				std::cout << "Regularizer all layers!!!" << std::endl;
+				util::Log::out() << "Regularizer all layers!!!" << std::endl;
 				if (layers.size() <= 1)
 					continue;
 				if (regularizer_configs[i].bUseSymmetryLineOpt && layers.size() >= 5)
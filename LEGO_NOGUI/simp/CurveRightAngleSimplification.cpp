@@ -1,6 +1,6 @@
 #include "CurveRightAngleSimplification.h"
 #include "../util/ContourUtils.h"
-#include <boost/math/distributions/normal.hpp>
+#include "../util/Log.h"
 #include <boost/geometry/geometries/segment.hpp> 
 #include <boost/geometry/algorithms/intersection.hpp>
 #include <boost/polygon/polygon.hpp>
@@ -847,7 +847,7 @@ namespace simp {
 			ans.z = starting_point(2);
 		}
 		catch (std::exception& ex) {
-			std::cout << "BFGS optimization failure" << std::endl;
+			util::Log::out() << "BFGS optimization failure" << std::endl;
 		}
 
 		return ans;
@@ -970,56 +970,16 @@ namespace simp {
 		return true;
 	}
 
+	/**
+	 * Estimate the principal orientation of the shape in the image from the orientation histogram of its contours.
+	 *
+	 * @param src	image of the shape
+	 * @return		principal orientation in degree [0, 90)
+	 */
 	float CurveRightAngleSimplification::axis_align(const cv::Mat_<uchar>& src){
-		cv::Mat dst;
-		cv::Canny(src, src, 50, 150, 3);
-		dst = src;
-		std::vector<cv::Vec4i> lines;
-		cv::HoughLinesP(dst, lines, 1, CV_PI / 180, 20, 1, 5);
-		std::vector<std::pair <float, float>> edges;
-		edges.resize(lines.size());
-		for (int i = 0; i < lines.size(); i++)
-		{
-			cv::Vec4i l = lines[i];
-			cv::Point tail(l[0], l[1]);
-			cv::Point head(l[2], l[3]);
-			cv::Point2d vec1(tail.x - head.x, tail.y - head.y);
-			cv::Point2d vec2(1, 0);
-			cv::Point2d vec3(0, 1);
-			if (l[1] > l[3])
-				vec1 = cv::Point2d(tail.x - head.x, tail.y - head.y);
-			else if (l[1] = l[3])
-			{
-				if (l[0] >= l[2])
-					vec1 = cv::Point2d(tail.x - head.x, tail.y - head.y);
-				else
-					vec1 = -cv::Point2d(tail.x - head.x, tail.y - head.y);
-			}
-			else
-				vec1 = -cv::Point2d(tail.x - head.x, tail.y - head.y);
-			float angle = compute_abs_angle(vec1, vec2);
-			edges[i] = std::make_pair(angle, cv::norm(tail - head));
-		}
-
-		std::unordered_map<int, float> mymap;
-		boost::math::normal s(0, 20);
-		for (int i = 0; i < edges.size(); i++){
-			for (int j = 0; j < 180; j++){
-				int index = (int)(j - edges[i].first);
-				float vote = edges[i].second * pdf(s, index);
-				std::pair<int, double> node(j, vote);
-				mymap.insert(node);
-			}
-		}
-		float result = 0;
-		float tmp = 0;
-		for (auto it = mymap.begin(); it != mymap.end(); ++it){
-			if (it->second > tmp){
-				result = it->first;
-				tmp = it->second;
-			}
-		}
-		return result;
+		std::vector<util::Polygon> polygons = util::findContours(src, false);
+		if (polygons.size() == 0) return 0;
+		return util::estimate(polygons) / CV_PI * 180;
 	}
 
 	std::vector<cv::Point2f> CurveRightAngleSimplification::transform_angle(std::vector<cv::Point2f> contour, cv::Mat_<float> &M, float angle){
@@ -1,5 +1,6 @@
 #include "CurveSimplification.h"
 #include "../util/ContourUtils.h"
+#include "../util/Log.h"
 
 namespace simp {
 
@@ -645,7 +646,7 @@ namespace simp {
 			ans.z = starting_point(2);
 		}
 		catch (std::exception& ex) {
-			std::cout << "BFGS optimization failure" << std::endl;
+			util::Log::out() << "BFGS optimization failure" << std::endl;
 		}
 
 		return ans;
@@ -1,5 +1,6 @@
 #include "RightAngleSimplification.h"
 #include "../util/ContourUtils.h"
+#include "../util/RectilinearIOU.h"
 
 namespace simp {
 
@@ -281,100 +282,74 @@ namespace simp {
 				y_map[simplified_contour[i].y] = simplified_contour[i].y;
 			}
 		}
+		std::vector<int> x_keys;
+		std::vector<int> y_keys;
+		for (auto it = x_map.begin(); it != x_map.end(); it++) x_keys.push_back(it->first);
+		for (auto it = y_map.begin(); it != y_map.end(); it++) y_keys.push_back(it->first);
+		std::vector<int> x_coords = x_keys;
+		std::vector<int> y_coords = y_keys;
+
+		// Since a proposal moves only one coordinate line, the IOU is updated incrementally
+		// unless the simplified contour has a non-axis-aligned edge.
+		util::RectilinearIOU evaluator;
+		bool incremental = evaluator.init(img, cv::Point(min_x, min_y), simplified_contour, x_keys, y_keys);
 
 		// optimize the parameters
 		double best_score = 0;
-		std::map<int, int> best_x_map;
-		std::map<int, int> best_y_map;
-
-		int cnt = 0;
 		for (int iter = 0; iter < 3000; iter++) {
-			bool updated = false;
-
-			auto prev_it = x_map.end();
-			auto next_it = x_map.begin();
-			next_it++;
-			for (auto it = x_map.begin(); it != x_map.end(); it++) {
-				std::map<int, int> prop_x_map = x_map;
-				prop_x_map[it->first]++;
-				if ((next_it != x_map.end() && prop_x_map[it->first] <= prop_x_map[next_it->first]) || (next_it == x_map.end() && prop_x_map[it->first] <= max_x)) {
-					std::vector<cv::Point> proposed_contour = proposedContour(simplified_contour, prop_x_map, y_map);
-					cv::Mat_<uchar> img2;
-					util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, proposed_contour, cv::Point(-min_x, -min_y), img2);
-					double score = util::calculateIOU(img, img2);
-					if (score > best_score) {
-						best_score = score;
-						best_x_map = prop_x_map;
-						best_y_map = y_map;
-						updated = true;
-					}
-				}
-
-				prop_x_map = x_map;
-				prop_x_map[it->first]--;
-				if ((prev_it != x_map.end() && prop_x_map[it->first] >= prop_x_map[prev_it->first]) || (prev_it == x_map.end() && prop_x_map[it->first] >= min_x)) {
-					std::vector<cv::Point> proposed_contour = proposedContour(simplified_contour, prop_x_map, y_map);
-					cv::Mat_<uchar> img2;
-					util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, proposed_contour, cv::Point(-min_x, -min_y), img2);
-					double score = util::calculateIOU(img, img2);
-					if (score > best_score) {
-						best_score = score;
-						best_x_map = prop_x_map;
-						best_y_map = y_map;
-						updated = true;
-					}
-				}
-
-				prev_it = it;
-				if (next_it != x_map.end())	next_it++;
-			}
-
-			prev_it = y_map.end();
-			next_it = y_map.begin();
-			next_it++;
-			for (auto it = y_map.begin(); it != y_map.end(); it++) {
-				std::map<int, int> prop_y_map = y_map;
-				prop_y_map[it->first]++;
-				if ((next_it != y_map.end() && prop_y_map[it->first] <= prop_y_map[next_it->first]) || (next_it == y_map.end() && prop_y_map[it->first] <= max_y)) {
-					std::vector<cv::Point> proposed_contour = proposedContour(simplified_contour, x_map, prop_y_map);
-					cv::Mat_<uchar> img2;
-					util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, proposed_contour, cv::Point(-min_x, -min_y), img2);
-					double score = util::calculateIOU(img, img2);
-					if (score > best_score) {
-						best_score = score;
-						best_x_map = x_map;
-						best_y_map = prop_y_map;
-						updated = true;
-					}
-				}
+			int best_axis = -1;
+			int best_index = -1;
+			int best_delta = 0;
+
+			for (int axis = 0; axis < 2; axis++) {
+				std::vector<int>& coords = axis == 0 ? x_coords : y_coords;
+				int lower = axis == 0 ? min_x : min_y;
+				int upper = axis == 0 ? max_x : max_y;
+
+				for (int i = 0; i < coords.size(); i++) {
+					for (int delta = 1; delta >= -1; delta -= 2) {
+						// keep the order of the coordinates
+						int new_coord = coords[i] + delta;
+						if (delta > 0 && new_coord > (i + 1 < coords.size() ? coords[i + 1] : upper)) continue;
+						if (delta < 0 && new_coord < (i > 0 ? coords[i - 1] : lower)) continue;
+
+						double score;
+						if (incremental) {
+							score = axis == 0 ? evaluator.iouAfterMovingX(i, delta) : evaluator.iouAfterMovingY(i, delta);
+						}
+						else {
+							coords[i] += delta;
+							std::vector<cv::Point> proposed_contour = proposedContour(simplified_contour, x_keys, x_coords, y_keys, y_coords);
+							cv::Mat_<uchar> img2;
+							util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, proposed_contour, cv::Point(-min_x, -min_y), img2);
+							score = util::calculateIOU(img, img2);
+							coords[i] -= delta;
+						}
 
-				prop_y_map = y_map;
-				prop_y_map[it->first]--;
-				if ((prev_it != y_map.end() && prop_y_map[it->first] >= prop_y_map[prev_it->first]) || (prev_it == y_map.end() && prop_y_map[it->first] >= min_y)) {
-					std::vector<cv::Point> proposed_contour = proposedContour(simplified_contour, x_map, prop_y_map);
-					cv::Mat_<uchar> img2;
-					util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, proposed_contour, cv::Point(-min_x, -min_y), img2);
-					double score = util::calculateIOU(img, img2);
-					if (score > best_score) {
-						best_score = score;
-						best_x_map = x_map;
-						best_y_map = prop_y_map;
-						updated = true;
+						if (score > best_score) {
+							best_score = score;
+							best_axis = axis;
+							best_index = i;
+							best_delta = delta;
+						}
 					}
 				}
-
-				prev_it = it;
-				if (next_it != y_map.end())	next_it++;
 			}
 
 			// if no update, stop the optimization
-			if (!updated) break;
+			if (best_axis == -1) break;
 
-			x_map = best_x_map;
-			y_map = best_y_map;
+			if (best_axis == 0) {
+				x_coords[best_index] += best_delta;
+				if (incremental) evaluator.moveX(best_index, best_delta);
+			}
+			else {
+				y_coords[best_index] += best_delta;
+				if (incremental) evaluator.moveY(best_index, best_delta);
+			}
 		}
 
-		simplified_contour = proposedContour(simplified_contour, x_map, y_map);
+		simplified_contour = proposedContour(simplified_contour, x_keys, x_coords, y_keys, y_coords);
 
 		// remove redundant points
 		for (int i = simplified_contour.size() - 1; i >= 0; i--) {
@@ -392,10 +367,22 @@ namespace simp {
 		return best_score;
 	}
 
-	std::vector<cv::Point> RightAngleSimplification::proposedContour(const std::vector<cv::Point>& contour, std::map<int, int>& x_map, std::map<int, int>& y_map) {
+	/**
+	 * Replace the coordinates of the contour vertices by the moved ones.
+	 *
+	 * @param contour		contour
+	 * @param x_keys		sorted original x coordinates
+	 * @param x_coords		moved x coordinates corresponding to x_keys
+	 * @param y_keys		sorted original y coordinates
+	 * @param y_coords		moved y coordinates corresponding to y_keys
+	 * @return				moved contour
+	 */
+	std::vector<cv::Point> RightAngleSimplification::proposedContour(const std::vector<cv::Point>& contour, const std::vector<int>& x_keys, const std::vector<int>& x_coords, const std::vector<int>& y_keys, const std::vector<int>& y_coords) {
 		std::vector<cv::Point> prop_contour(contour.size());
 		for (int i = 0; i < contour.size(); i++) {
-			prop_contour[i] = cv::Point(x_map[contour[i].x], y_map[contour[i].y]);
+			int ix = std::lower_bound(x_keys.begin(), x_keys.end(), contour[i].x) - x_keys.begin();
+			int iy = std::lower_bound(y_keys.begin(), y_keys.end(), contour[i].y) - y_keys.begin();
+			prop_contour[i] = cv::Point(x_coords[ix], y_coords[iy]);
 		}
 		return prop_contour;
 	}
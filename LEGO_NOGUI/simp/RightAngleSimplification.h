@@ -20,7 +20,7 @@ namespace simp {
 		static double simplifyContour(const util::Ring& contour, util::Ring& result, int resolution, float angle, int dx, int dy, bool refine, bool vertex_refinement);
 
 		static double optimizeVertices(const std::vector<cv::Point>& contour, std::vector<cv::Point>& simplified_contour);
-		static std::vector<cv::Point> proposedContour(const std::vector<cv::Point>& contour, std::map<int, int>& x_map, std::map<int, int>& y_map);
+		static std::vector<cv::Point> proposedContour(const std::vector<cv::Point>& contour, const std::vector<int>& x_keys, const std::vector<int>& x_coords, const std::vector<int>& y_keys, const std::vector<int>& y_coords);
 		static double optimizeBBox(const std::vector<cv::Point>& contour, std::vector<cv::Point>& simplified_contour);
 		static std::vector<cv::Point> proposedBBox(const std::vector<cv::Point>& contour, int x1, int x2, int y1, int y2, int new_x1, int new_x2, int new_y1, int new_y2);
 
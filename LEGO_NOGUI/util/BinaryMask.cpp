@@ -0,0 +1,393 @@
+#include "BinaryMask.h"
+#include <algorithm>
+#include <limits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace util {
+
+	namespace {
+
+		// fixed-point precision of the edge x coordinates in cv::fillPoly
+		const int XY_SHIFT = 16;
+		const int64_t XY_ONE = (int64_t)1 << XY_SHIFT;
+
+		struct PolyEdge {
+			int y0;
+			int y1;
+			int64_t x;
+			int64_t dx;
+			PolyEdge* next;
+
+			PolyEdge() : y0(0), y1(0), x(0), dx(0), next(NULL) {}
+		};
+
+		struct CmpEdges {
+			bool operator()(const PolyEdge& e1, const PolyEdge& e2) const {
+				return e1.y0 - e2.y0 ? e1.y0 < e2.y0 : e1.x - e2.x ? e1.x < e2.x : e1.dx < e2.dx;
+			}
+		};
+
+		/**
+		 * Clip the line to the image in the same way as cv::clipLine.
+		 *
+		 * @return		false if the line is completely outside the image
+		 */
+		bool clipLine(int width, int height, cv::Point& pt1, cv::Point& pt2) {
+			if (width <= 0 || height <= 0) return false;
+
+			int64_t right = width - 1;
+			int64_t bottom = height - 1;
+			int64_t x1 = pt1.x;
+			int64_t y1 = pt1.y;
+			int64_t x2 = pt2.x;
+			int64_t y2 = pt2.y;
+			int c1 = (x1 < 0) + (x1 > right) * 2 + (y1 < 0) * 4 + (y1 > bottom) * 8;
+			int c2 = (x2 < 0) + (x2 > right) * 2 + (y2 < 0) * 4 + (y2 > bottom) * 8;
+
+			if ((c1 & c2) == 0 && (c1 | c2) != 0) {
+				int64_t a;
+				if (c1 & 12) {
+					a = c1 < 8 ? 0 : bottom;
+					x1 += (int64_t)((double)(a - y1) * (x2 - x1) / (y2 - y1));
+					y1 = a;
+					c1 = (x1 < 0) + (x1 > right) * 2;
+				}
+				if (c2 & 12) {
+					a = c2 < 8 ? 0 : bottom;
+					x2 += (int64_t)((double)(a - y2) * (x2 - x1) / (y2 - y1));
+					y2 = a;
+					c2 = (x2 < 0) + (x2 > right) * 2;
+				}
+				if ((c1 & c2) == 0 && (c1 | c2) != 0) {
+					if (c1) {
+						a = c1 == 1 ? 0 : right;
+						y1 += (int64_t)((double)(a - x1) * (y2 - y1) / (x2 - x1));
+						x1 = a;
+						c1 = 0;
+					}
+					if (c2) {
+						a = c2 == 1 ? 0 : right;
+						y2 += (int64_t)((double)(a - x2) * (y2 - y1) / (x2 - x1));
+						x2 = a;
+						c2 = 0;
+					}
+				}
+			}
+
+			pt1 = cv::Point((int)x1, (int)y1);
+			pt2 = cv::Point((int)x2, (int)y2);
+			return (c1 | c2) == 0;
+		}
+
+	}
+
+	BinaryMask::BinaryMask() : width(0), height(0), words_per_row(0) {
+	}
+
+	BinaryMask::BinaryMask(int width, int height) {
+		reset(width, height);
+	}
+
+	/**
+	 * Resize the mask and clear all the bits.
+	 */
+	void BinaryMask::reset(int width, int height) {
+		this->width = std::max(0, width);
+		this->height = std::max(0, height);
+		words_per_row = (this->width + 63) / 64;
+		bits.assign((size_t)words_per_row * this->height, 0);
+	}
+
+	bool BinaryMask::get(int x, int y) const {
+		return (bits[(size_t)y * words_per_row + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	void BinaryMask::set(int x, int y) {
+		bits[(size_t)y * words_per_row + (x >> 6)] |= (uint64_t)1 << (x & 63);
+	}
+
+	/**
+	 * Set the bits from x1 to x2 (inclusive) in the row y.
+	 */
+	void BinaryMask::fillSpan(int y, int x1, int x2) {
+		if (x1 > x2) return;
+
+		uint64_t* row = &bits[(size_t)y * words_per_row];
+		int w1 = x1 >> 6;
+		int w2 = x2 >> 6;
+		uint64_t head = ~(uint64_t)0 << (x1 & 63);
+		uint64_t tail = ~(uint64_t)0 >> (63 - (x2 & 63));
+		if (w1 == w2) {
+			row[w1] |= head & tail;
+		}
+		else {
+			row[w1] |= head;
+			for (int w = w1 + 1; w < w2; w++) {
+				row[w] = ~(uint64_t)0;
+			}
+			row[w2] |= tail;
+		}
+	}
+
+	void BinaryMask::fillPoly(const std::vector<cv::Point>& contour) {
+		fillPoly(std::vector<std::vector<cv::Point>>(1, contour));
+	}
+
+	/**
+	 * Fill the polygons in the same way as cv::fillPoly(img, contours, color, cv::LINE_4).
+	 * The outlines are drawn by 4-connected lines, and the interior spans are filled by the scanline
+	 * algorithm with the 16-bit fixed-point edge coordinates.
+	 */
+	void BinaryMask::fillPoly(const std::vector<std::vector<cv::Point>>& contours) {
+		std::vector<PolyEdge> edges;
+		int total = 0;
+		for (int i = 0; i < contours.size(); i++) {
+			total += contours[i].size();
+		}
+		edges.reserve(total + 1);
+
+		// collect the edges, and draw the outlines
+		for (int i = 0; i < contours.size(); i++) {
+			const std::vector<cv::Point>& v = contours[i];
+			if (v.size() == 0) continue;
+
+			int64_t x0 = (int64_t)v.back().x << XY_SHIFT;
+			int64_t y0 = v.back().y;
+			for (int j = 0; j < v.size(); j++) {
+				int64_t x1 = (int64_t)v[j].x << XY_SHIFT;
+				int64_t y1 = v[j].y;
+
+				drawLine(cv::Point((int)((x0 + (XY_ONE >> 1)) >> XY_SHIFT), (int)y0), cv::Point((int)((x1 + (XY_ONE >> 1)) >> XY_SHIFT), (int)y1));
+
+				if (y0 != y1) {
+					PolyEdge edge;
+					if (y0 < y1) {
+						edge.y0 = (int)y0;
+						edge.y1 = (int)y1;
+						edge.x = x0;
+					}
+					else {
+						edge.y0 = (int)y1;
+						edge.y1 = (int)y0;
+						edge.x = x1;
+					}
+					edge.dx = (x1 - x0) / (y1 - y0);
+					edges.push_back(edge);
+				}
+
+				x0 = x1;
+				y0 = y1;
+			}
+		}
+
+		total = edges.size();
+		if (total < 2) return;
+
+		int y_max = std::numeric_limits<int>::min();
+		int y_min = std::numeric_limits<int>::max();
+		int64_t x_max = std::numeric_limits<int64_t>::min();
+		int64_t x_min = std::numeric_limits<int64_t>::max();
+		for (int i = 0; i < total; i++) {
+			PolyEdge& e1 = edges[i];
+			int64_t x1 = e1.x + (e1.y1 - e1.y0) * e1.dx;
+			y_min = std::min(y_min, e1.y0);
+			y_max = std::max(y_max, e1.y1);
+			x_min = std::min(x_min, std::min(e1.x, x1));
+			x_max = std::max(x_max, std::max(e1.x, x1));
+		}
+		if (y_max < 0 || y_min >= height || x_max < 0 || x_min >= ((int64_t)width << XY_SHIFT)) return;
+
+		std::sort(edges.begin(), edges.end(), CmpEdges());
+
+		// scan the rows with the active edge list
+		PolyEdge tmp;
+		tmp.y0 = std::numeric_limits<int>::max();
+		edges.push_back(tmp);
+		int i = 0;
+		tmp.next = NULL;
+		PolyEdge* e = &edges[i];
+		y_max = std::min(y_max, height);
+
+		for (int y = e->y0; y < y_max; y++) {
+			PolyEdge* last;
+			PolyEdge* prelast;
+			PolyEdge* keep_prelast;
+			bool sort_flag = false;
+			bool draw = false;
+			bool clipline = y < 0;
+
+			prelast = &tmp;
+			last = tmp.next;
+			while (last || e->y0 == y) {
+				if (last && last->y1 == y) {
+					// exclude the edge if y reaches its lower point
+					prelast->next = last->next;
+					last = last->next;
+					continue;
+				}
+				keep_prelast = prelast;
+				if (last && (e->y0 > y || last->x < e->x)) {
+					// go to the next edge in the active list
+					prelast = last;
+					last = last->next;
+				}
+				else if (i < total) {
+					// insert the new edge into the active list if y reaches its upper point
+					prelast->next = e;
+					e->next = last;
+					prelast = e;
+					e = &edges[++i];
+				}
+				else {
+					break;
+				}
+
+				if (draw) {
+					if (!clipline) {
+						int x1, x2;
+						if (keep_prelast->x > prelast->x) {
+							x1 = (int)((prelast->x + XY_ONE - 1) >> XY_SHIFT);
+							x2 = (int)(keep_prelast->x >> XY_SHIFT);
+						}
+						else {
+							x1 = (int)((keep_prelast->x + XY_ONE - 1) >> XY_SHIFT);
+							x2 = (int)(prelast->x >> XY_SHIFT);
+						}
+
+						if (x1 < width && x2 >= 0) {
+							if (x1 < 0) x1 = 0;
+							if (x2 >= width) x2 = width - 1;
+							fillSpan(y, x1, x2);
+						}
+					}
+					keep_prelast->x += keep_prelast->dx;
+					prelast->x += prelast->dx;
+				}
+				draw = !draw;
+			}
+
+			// sort the active edges by x (bubble sort)
+			keep_prelast = NULL;
+			do {
+				prelast = &tmp;
+				last = tmp.next;
+				PolyEdge* last_exchange = NULL;
+
+				while (last != keep_prelast && last->next != NULL) {
+					PolyEdge* te = last->next;
+					if (last->x > te->x) {
+						prelast->next = te;
+						last->next = te->next;
+						te->next = last;
+						prelast = te;
+						sort_flag = true;
+					}
+					else {
+						prelast = last;
+						last = te;
+					}
+					last_exchange = prelast;
+				}
+				keep_prelast = last_exchange;
+			} while (sort_flag && keep_prelast != tmp.next && keep_prelast != &tmp);
+		}
+	}
+
+	/**
+	 * Draw a 4-connected line in the same way as cv::line(..., cv::LINE_4).
+	 */
+	void BinaryMask::drawLine(cv::Point pt1, cv::Point pt2) {
+		if ((unsigned)pt1.x >= (unsigned)width || (unsigned)pt2.x >= (unsigned)width || (unsigned)pt1.y >= (unsigned)height || (unsigned)pt2.y >= (unsigned)height) {
+			if (!clipLine(width, height, pt1, pt2)) return;
+		}
+
+		// always draw from left to right
+		if (pt2.x < pt1.x) std::swap(pt1, pt2);
+		int dx = pt2.x - pt1.x;
+		int dy = pt2.y - pt1.y;
+
+		// the major axis is the longer one
+		int major_x = 1, major_y = 0;
+		int minor_x = 0, minor_y = dy < 0 ? -1 : 1;
+		dy = std::abs(dy);
+		if (dy > dx) {
+			std::swap(dx, dy);
+			std::swap(major_x, minor_x);
+			std::swap(major_y, minor_y);
+		}
+
+		int err = 0;
+		int x = pt1.x;
+		int y = pt1.y;
+		for (int i = 0; i < dx + dy + 1; i++) {
+			set(x, y);
+			if (err < 0) {
+				err += dx + dx;
+				x += minor_x;
+				y += minor_y;
+			}
+			else {
+				err -= dy + dy;
+				x += major_x;
+				y += major_y;
+			}
+		}
+	}
+
+	/**
+	 * Set the bits of the mask placed at (x, y), which have to be inside this mask.
+	 * Each word of the mask is shifted to the bit offset of x, so that the rows are merged word by word.
+	 */
+	void BinaryMask::paste(const BinaryMask& mask, int x, int y) {
+		CV_Assert(x >= 0 && y >= 0 && x + mask.width <= width && y + mask.height <= height);
+
+		int word_offset = x >> 6;
+		int shift = x & 63;
+		for (int r = 0; r < mask.height; r++) {
+			const uint64_t* src = &mask.bits[(size_t)r * mask.words_per_row];
+			uint64_t* dst = &bits[(size_t)(y + r) * words_per_row + word_offset];
+			for (int w = 0; w < mask.words_per_row; w++) {
+				dst[w] |= src[w] << shift;
+				if (shift > 0 && word_offset + w + 1 < words_per_row) dst[w + 1] |= src[w] >> (64 - shift);
+			}
+		}
+	}
+
+	long long BinaryMask::count() const {
+		long long cnt = 0;
+		for (int i = 0; i < bits.size(); i++) {
+			cnt += popcount64(bits[i]);
+		}
+		return cnt;
+	}
+
+	/**
+	 * Count the pixels of the intersection and the union of two masks of the same size.
+	 */
+	void BinaryMask::countIntersectionAndUnion(const BinaryMask& mask1, const BinaryMask& mask2, long long& inter_cnt, long long& union_cnt) {
+		CV_Assert(mask1.width == mask2.width && mask1.height == mask2.height);
+
+		inter_cnt = 0;
+		union_cnt = 0;
+		for (int i = 0; i < mask1.bits.size(); i++) {
+			inter_cnt += popcount64(mask1.bits[i] & mask2.bits[i]);
+			union_cnt += popcount64(mask1.bits[i] | mask2.bits[i]);
+		}
+	}
+
+	int popcount64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+		return (int)__popcnt64(x);
+#elif defined(__GNUC__)
+		return __builtin_popcountll(x);
+#else
+		x = x - ((x >> 1) & 0x5555555555555555ULL);
+		x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+		return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+	}
+
+}
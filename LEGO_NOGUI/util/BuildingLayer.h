@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <stdint.h>
 #include <opencv2/opencv.hpp>
 #include "ContourUtils.h"
 
@@ -11,6 +12,7 @@ namespace util {
 	public:
 		int building_id;
 		std::vector<std::vector<util::Polygon>> raw_footprints;
+		std::vector<std::vector<uint32_t>> raw_footprint_nodes;	// voxel graph nodes of the raw footprints
 		std::vector<util::Polygon> footprints;
 		std::vector<util::Polygon> presentativeContours;
 		float bottom_height;
@@ -0,0 +1,304 @@
+#include "ComponentStream.h"
+#include <cstdio>
+#include <algorithm>
+
+namespace util {
+
+	/**
+	 * @param slab_budget		the maximum bytes of the runs, the label images, the union-find, and the component records kept in memory
+	 * @param spill_filename	file path where the runs are spilled (the file is removed when the stream is destroyed)
+	 */
+	ComponentStream::ComponentStream(size_t slab_budget, const std::string& spill_filename) : width(0), height(0), depth(0), slab_budget(slab_budget), spill_filename(spill_filename), spill_size(0), num_open_labels(0), num_issued_labels(0), slab_bytes(0), peak_slab_bytes(0), closed_segment_bytes(0) {
+		spill_file.open(spill_filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!spill_file.is_open()) throw "Spill file could not be created.";
+	}
+
+	ComponentStream::~ComponentStream() {
+		spill_file.close();
+		std::remove(spill_filename.c_str());
+	}
+
+	/**
+	 * Label the voxels of the next slice, and close the components that are not extended by the slice.
+	 * An empty image is treated as an empty slice, and all the other slices have to have the same size.
+	 *
+	 * @param slice					slice image
+	 * @param voxel_value_threshold	the voxels with value greater than this threshold are set
+	 */
+	void ComponentStream::addSlice(const cv::Mat_<uchar>& slice, int voxel_value_threshold) {
+		if (!slice.empty()) {
+			if (width == 0 && height == 0) {
+				width = slice.cols;
+				height = slice.rows;
+			}
+			else if (slice.cols != width || slice.rows != height) {
+				throw "Slice images have different sizes.";
+			}
+			labelSlice(slice, voxel_value_threshold);
+		}
+		else {
+			labels_image.release();
+		}
+
+		collectRuns(depth);
+		lower_labels = labels_image;
+		labels_image = cv::Mat_<int>();
+		depth++;
+	}
+
+	/**
+	 * Close all the remaining components, and number them in the scan order of their first voxels.
+	 * The union-find and the label images are released.
+	 */
+	void ComponentStream::finish() {
+		for (auto it = open_components.begin(); it != open_components.end(); ++it) {
+			closeComponent(it->second);
+		}
+		open_components.clear();
+		lower_labels.release();
+		std::vector<int>().swap(labels.parent);
+
+		// the first label of each component is in the scan order of its first voxel
+		std::vector<std::pair<uint64_t, int>> first_labels(closed_components.size());
+		for (int i = 0; i < closed_components.size(); i++) {
+			first_labels[i] = std::make_pair(closed_components[i].first_label, i);
+		}
+		std::sort(first_labels.begin(), first_labels.end());
+		order.resize(first_labels.size());
+		for (int i = 0; i < first_labels.size(); i++) {
+			order[i] = first_labels[i].second;
+		}
+	}
+
+	/**
+	 * Copy the voxels of the component into a local voxel block in its bounding box.
+	 * The runs are read back from the spill file.
+	 *
+	 * @param id	component id in the scan order of the first voxels
+	 * @return		local voxel block (255 for the voxels of the component, 0 otherwise)
+	 */
+	std::vector<cv::Mat_<uchar>> ComponentStream::crop(int id) {
+		const Component& component = closed_components[order[id]];
+		const VoxelBoundingBox& bbox = component.bbox;
+		std::vector<cv::Mat_<uchar>> voxels(bbox.depth());
+		for (int h = 0; h < voxels.size(); h++) {
+			voxels[h] = cv::Mat_<uchar>::zeros(bbox.height(), bbox.width());
+		}
+
+		// read the runs in chunks, so that a large component does not need another copy of its runs
+		const uint64_t chunk_size = 65536;
+		std::vector<Run> runs;
+		for (int i = 0; i < component.segments.size(); i++) {
+			const Segment& segment = component.segments[i];
+			for (uint64_t first = 0; first < segment.num_runs; first += chunk_size) {
+				runs.resize(std::min(chunk_size, segment.num_runs - first));
+				spill_file.seekg(segment.offset + first * sizeof(Run));
+				spill_file.read((char*)runs.data(), runs.size() * sizeof(Run));
+				if (!spill_file) throw "Spill file could not be read.";
+
+				for (int k = 0; k < runs.size(); k++) {
+					uchar* voxel_row = voxels[runs[k].z - bbox.min_z][runs[k].y - bbox.min_y] - bbox.min_x;
+					for (int x = runs[k].x0; x < runs[k].x1; x++) {
+						voxel_row[x] = 255;
+					}
+				}
+			}
+		}
+
+		return voxels;
+	}
+
+	/**
+	 * Assign the provisional labels to the voxels of the slice in the same way as DisjointVoxelData::labelBuildings.
+	 */
+	void ComponentStream::labelSlice(const cv::Mat_<uchar>& slice, int voxel_value_threshold) {
+		labels_image = cv::Mat_<int>(height, width, -1);
+		for (int r = 0; r < height; r++) {
+			const uchar* voxel_row = slice[r];
+			int* label_row = labels_image[r];
+			const int* upper_row = r > 0 ? labels_image[r - 1] : NULL;
+			const int* lower_row = !lower_labels.empty() ? lower_labels[r] : NULL;
+
+			for (int c = 0; c < width; c++) {
+				if (voxel_row[c] <= voxel_value_threshold) continue;
+
+				int label = c > 0 ? label_row[c - 1] : -1;
+				bool continued_run = label >= 0;
+
+				// Inside a run, the neighbor that has the same label as the one of the previous voxel was already merged.
+				if (upper_row != NULL && upper_row[c] >= 0 && !(continued_run && upper_row[c - 1] == upper_row[c])) {
+					if (label < 0) label = upper_row[c];
+					else labels.merge(label, upper_row[c]);
+				}
+				if (lower_row != NULL && lower_row[c] >= 0 && !(continued_run && lower_row[c - 1] == lower_row[c])) {
+					if (label < 0) label = lower_row[c];
+					else labels.merge(label, lower_row[c]);
+				}
+				if (label < 0) label = labels.add();
+
+				label_row[c] = label;
+			}
+		}
+	}
+
+	/**
+	 * Add the runs of the current slice to the open components, and close the open components that have no voxel in the slice.
+	 * The open components that were merged by the slice are merged into the one of the smallest root label beforehand.
+	 * Finally, the labels are renumbered so that the union-find holds only the roots of the open components.
+	 *
+	 * @param h		index of the current slice
+	 */
+	void ComponentStream::collectRuns(int h) {
+		// merge the open components that are connected through the current slice
+		std::vector<int> merged_labels;
+		for (auto it = open_components.begin(); it != open_components.end(); ++it) {
+			if (labels.find(it->first) != it->first) merged_labels.push_back(it->first);
+		}
+		for (int i = 0; i < merged_labels.size(); i++) {
+			Component& source = open_components[merged_labels[i]];
+			Component& target = open_components[labels.find(merged_labels[i])];
+			target.first_label = std::min(target.first_label, source.first_label);
+			target.voxel_count += source.voxel_count;
+			target.bbox.addVoxel(source.bbox.min_x, source.bbox.min_y, source.bbox.min_z);
+			target.bbox.addVoxel(source.bbox.max_x, source.bbox.max_y, source.bbox.max_z);
+			target.runs.insert(target.runs.end(), source.runs.begin(), source.runs.end());
+			target.segments.insert(target.segments.end(), source.segments.begin(), source.segments.end());
+			open_components.erase(merged_labels[i]);
+		}
+
+		// add the runs of the current slice
+		std::vector<int> extended_labels;
+		for (int r = 0; r < labels_image.rows; r++) {
+			const int* label_row = labels_image[r];
+			for (int c = 0; c < labels_image.cols; c++) {
+				if (label_row[c] < 0) continue;
+
+				// all the voxels of a run have the same provisional label
+				Run run;
+				run.z = h;
+				run.y = r;
+				run.x0 = c;
+				while (c < labels_image.cols && label_row[c] >= 0) c++;
+				run.x1 = c;
+
+				int root = labels.find(label_row[run.x0]);
+				Component& component = open_components[root];
+				if (component.voxel_count == 0) {
+					// a new component, whose root is a label issued in the current slice
+					component.first_label = num_issued_labels + (root - num_open_labels);
+				}
+				if (component.runs.empty() || component.runs.back().z != h) extended_labels.push_back(root);
+				component.voxel_count += run.x1 - run.x0;
+				component.bbox.addVoxel(run.x0, r, h);
+				component.bbox.addVoxel(run.x1 - 1, r, h);
+				component.runs.push_back(run);
+				slab_bytes += sizeof(Run);
+			}
+		}
+
+		size_t fixed_bytes = (labels_image.total() + lower_labels.total()) * sizeof(int) + bookkeepingBytes();
+		peak_slab_bytes = std::max(peak_slab_bytes, slab_bytes + fixed_bytes);
+
+		// close the components that are not extended by the current slice
+		std::sort(extended_labels.begin(), extended_labels.end());
+		for (auto it = open_components.begin(); it != open_components.end();) {
+			if (std::binary_search(extended_labels.begin(), extended_labels.end(), it->first)) {
+				++it;
+				continue;
+			}
+			closeComponent(it->second);
+			it = open_components.erase(it);
+		}
+
+		// spill the slab if it exceeds the budget
+		if (slab_bytes + fixed_bytes > slab_budget) {
+			for (auto it = open_components.begin(); it != open_components.end(); ++it) {
+				spill(it->second);
+			}
+		}
+
+		compactLabels();
+	}
+
+	/**
+	 * Renumber the roots of the open components from 0 in the order of their labels, and rewrite the label image of
+	 * the current slice with the new labels. The union-find is replaced by a fresh forest of these roots, so it does
+	 * not grow with the volume. Because the order of the labels is kept, the later merges choose the same roots.
+	 */
+	void ComponentStream::compactLabels() {
+		num_issued_labels += labels.size() - num_open_labels;
+
+		std::vector<int> roots;
+		roots.reserve(open_components.size());
+		for (auto it = open_components.begin(); it != open_components.end(); ++it) {
+			roots.push_back(it->first);
+		}
+		std::sort(roots.begin(), roots.end());
+
+		std::vector<int> new_labels(labels.size(), -1);
+		std::unordered_map<int, Component> components;
+		for (int i = 0; i < roots.size(); i++) {
+			new_labels[roots[i]] = i;
+			components[i] = std::move(open_components[roots[i]]);
+		}
+		open_components.swap(components);
+
+		for (int r = 0; r < labels_image.rows; r++) {
+			int* label_row = labels_image[r];
+			for (int c = 0; c < labels_image.cols; c++) {
+				if (label_row[c] >= 0) label_row[c] = new_labels[labels.find(label_row[c])];
+			}
+		}
+
+		std::vector<int> parent(roots.size());
+		for (int i = 0; i < roots.size(); i++) {
+			parent[i] = i;
+		}
+		labels.parent.swap(parent);
+		num_open_labels = roots.size();
+	}
+
+	/**
+	 * Append the runs of the component in memory to the spill file.
+	 */
+	void ComponentStream::spill(Component& component) {
+		if (component.runs.empty()) return;
+
+		Segment segment;
+		segment.offset = spill_size;
+		segment.num_runs = component.runs.size();
+		spill_file.seekp(spill_size);
+		spill_file.write((const char*)component.runs.data(), component.runs.size() * sizeof(Run));
+		if (!spill_file) throw "Spill file could not be written.";
+		spill_size += component.runs.size() * sizeof(Run);
+		component.segments.push_back(segment);
+
+		slab_bytes -= component.runs.size() * sizeof(Run);
+		std::vector<Run>().swap(component.runs);
+	}
+
+	/**
+	 * Spill the remaining runs of the open component, and move it to the closed components.
+	 */
+	void ComponentStream::closeComponent(Component& component) {
+		spill(component);
+		closed_segment_bytes += component.segments.capacity() * sizeof(Segment);
+		closed_components.push_back(std::move(component));
+	}
+
+	/**
+	 * Return the bytes of the memory that cannot be spilled, i.e., the parent array of the union-find and
+	 * the records of the open and closed components except for their runs in memory.
+	 * The open components are charged with the nodes of the hash map approximately.
+	 */
+	size_t ComponentStream::bookkeepingBytes() const {
+		size_t bytes = labels.parent.capacity() * sizeof(int);
+		bytes += closed_components.capacity() * sizeof(Component) + closed_segment_bytes;
+		bytes += open_components.bucket_count() * sizeof(void*);
+		for (auto it = open_components.begin(); it != open_components.end(); ++it) {
+			bytes += sizeof(std::pair<int, Component>) + sizeof(void*) + it->second.segments.capacity() * sizeof(Segment);
+		}
+		return bytes;
+	}
+
+}
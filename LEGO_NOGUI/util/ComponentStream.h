@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <unordered_map>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+#include "UnionFind.h"
+#include "VoxelBuilding.h"
+
+namespace util {
+
+	/**
+	 * Streaming labeling of the 6-connected components of the voxels, which reads the slices one by one from the bottom.
+	 * Only the labels of the current slice and the one beneath are kept as images. The voxels of each component are kept
+	 * as horizontal runs, and the runs of the open components, i.e., the ones that have voxels in the current slice,
+	 * form the slab in memory. When the slab exceeds the budget, its runs are spilled to a file.
+	 * A component is closed as soon as the current slice has no voxel of it, because no slice above can extend it,
+	 * and its remaining runs are spilled to the file at once.
+	 *
+	 * The union-find holds only the labels of the current slice. At the end of each slice, the roots of the open
+	 * components are renumbered into a fresh forest, and the label image is rewritten accordingly.
+	 * Each component keeps the serial number of its first provisional label in the whole volume instead.
+	 *
+	 * The budget is charged with the runs in memory, the two label images, the parent array of the union-find,
+	 * and the records of the open and closed components (their bounding boxes and the spilled segments).
+	 * Only the runs can be spilled, so the peak exceeds the budget if the other parts alone outgrow it,
+	 * e.g., for a volume of a huge number of tiny components.
+	 *
+	 * The provisional labels are assigned and merged in the same order as DisjointVoxelData::labelBuildings,
+	 * so the components are numbered in the scan order of their first voxels as in the in-memory path.
+	 */
+	class ComponentStream {
+	private:
+		/**
+		 * Voxels from x0 to x1 - 1 in row y of slice z.
+		 */
+		struct Run {
+			int z;
+			int y;
+			int x0;
+			int x1;
+		};
+
+		/**
+		 * Spilled runs of a component in the file.
+		 */
+		struct Segment {
+			uint64_t offset;
+			uint64_t num_runs;
+		};
+
+		struct Component {
+			uint64_t first_label;	// serial number of the first provisional label in the whole volume
+			int voxel_count;
+			VoxelBoundingBox bbox;
+			std::vector<Run> runs;
+			std::vector<Segment> segments;
+
+			Component() : first_label(0), voxel_count(0) {}
+		};
+
+	private:
+		int width;
+		int height;
+		int depth;
+		size_t slab_budget;
+		std::string spill_filename;
+		std::fstream spill_file;
+		uint64_t spill_size;
+
+		UnionFind labels;
+		int num_open_labels;	// the labels below this are the roots of the open components carried from the previous slice
+		uint64_t num_issued_labels;	// the provisional labels issued before the current slice
+		cv::Mat_<int> lower_labels;
+		cv::Mat_<int> labels_image;
+		std::unordered_map<int, Component> open_components;	// keyed by the root label
+		std::vector<Component> closed_components;
+		size_t slab_bytes;
+		size_t peak_slab_bytes;
+		size_t closed_segment_bytes;
+
+		// the index in closed_components of each component id after finish
+		std::vector<int> order;
+
+	public:
+		ComponentStream(size_t slab_budget, const std::string& spill_filename);
+		~ComponentStream();
+
+		void addSlice(const cv::Mat_<uchar>& slice, int voxel_value_threshold = 128);
+		void finish();
+
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+		int getDepth() const { return depth; }
+		int numComponents() const { return order.size(); }
+		int voxelCount(int id) const { return closed_components[order[id]].voxel_count; }
+		const VoxelBoundingBox& boundingBox(int id) const { return closed_components[order[id]].bbox; }
+		std::vector<cv::Mat_<uchar>> crop(int id);
+		size_t peakSlabBytes() const { return peak_slab_bytes; }
+		uint64_t spilledBytes() const { return spill_size; }
+
+	private:
+		ComponentStream(const ComponentStream&);
+		ComponentStream& operator=(const ComponentStream&);
+		void labelSlice(const cv::Mat_<uchar>& slice, int voxel_value_threshold);
+		void collectRuns(int h);
+		void spill(Component& component);
+		void closeComponent(Component& component);
+		void compactLabels();
+		size_t bookkeepingBytes() const;
+	};
+
+}
@@ -0,0 +1,235 @@
+#include "ContourTracer.h"
+#include <limits>
+
+namespace util {
+
+	namespace {
+
+		const uchar LEFT_VISITED = 1;
+		const uchar BOTTOM_VISITED = 2;
+
+		// directions along the pixel corners: right, down, left, and up in the image coordinates
+		const int DX[4] = { 1, 0, -1, 0 };
+		const int DY[4] = { 0, 1, 0, -1 };
+
+		// offset of the pixel ahead on the left side of each direction from the corner (x, y),
+		// where the pixel (r, c) has the corners from (c, r) to (c + 1, r + 1)
+		const int AHEAD_LEFT_DR[4] = { -1, 0, 0, -1 };
+		const int AHEAD_LEFT_DC[4] = { 0, 0, -1, -1 };
+
+		inline int labelAt(const cv::Mat_<int>& labels, int r, int c) {
+			if (r < 0 || r >= labels.rows || c < 0 || c >= labels.cols) return -1;
+			return labels(r, c);
+		}
+
+	}
+
+	/**
+	 * Extract the contours of all the labels.
+	 * The contours of the k-th label are the same as findContours(img, true) for the image of the pixels of the k-th label,
+	 * but the pixels are visited only once for all the labels.
+	 *
+	 * @param labels		labeled image, whose values are from 0 to num_labels - 1 (negative for the background)
+	 * @param num_labels	the number of the labels
+	 * @return				contour polygons of each label in the coordinates of the labeled image
+	 */
+	std::vector<std::vector<Polygon>> ContourTracer::findContours(const cv::Mat_<int>& labels, int num_labels) {
+		// find the labels that have a diagonal connection, and the bounding rectangles of the labels
+		std::vector<uchar> diagonal(num_labels, 0);
+		std::vector<cv::Rect> rects(num_labels);
+		for (int r = 0; r < labels.rows; r++) {
+			for (int c = 0; c < labels.cols; c++) {
+				int k = labels(r, c);
+				if (r < labels.rows - 1 && c < labels.cols - 1) {
+					int right = labels(r, c + 1);
+					int below = labels(r + 1, c);
+					int below_right = labels(r + 1, c + 1);
+					if (k >= 0 && below_right == k && right != k && below != k) diagonal[k] = 1;
+					if (right >= 0 && below == right && k != right && below_right != right) diagonal[right] = 1;
+				}
+
+				if (k < 0) continue;
+				cv::Rect& rect = rects[k];
+				if (rect.width == 0) {
+					rect = cv::Rect(c, r, 1, 1);
+				}
+				else {
+					if (c < rect.x) {
+						rect.width += rect.x - c;
+						rect.x = c;
+					}
+					rect.width = std::max(rect.width, c - rect.x + 1);
+					rect.height = r - rect.y + 1;
+				}
+			}
+		}
+
+		std::vector<std::vector<Ring>> outer_rings(num_labels);
+		std::vector<std::vector<Ring>> hole_rings(num_labels);
+		traceRings(labels, diagonal, outer_rings, hole_rings);
+
+		std::vector<std::vector<Polygon>> polygons(num_labels);
+		for (int k = 0; k < num_labels; k++) {
+			if (!diagonal[k]) {
+				polygons[k] = assemblePolygons(outer_rings[k], hole_rings[k]);
+				continue;
+			}
+
+			// fill the diagonal connections of the label in its bounding rectangle, and trace it separately
+			const cv::Rect& rect = rects[k];
+			cv::Mat_<uchar> img = cv::Mat_<uchar>::zeros(rect.height, rect.width);
+			for (int r = 0; r < rect.height; r++) {
+				for (int c = 0; c < rect.width; c++) {
+					if (labels(rect.y + r, rect.x + c) == k) img(r, c) = 255;
+				}
+			}
+			fillDiagonalConnections(img);
+
+			cv::Mat_<int> filled_labels(img.size(), -1);
+			for (int r = 0; r < img.rows; r++) {
+				for (int c = 0; c < img.cols; c++) {
+					if (img(r, c) == 255) filled_labels(r, c) = 0;
+				}
+			}
+			std::vector<std::vector<Ring>> filled_outer_rings(1);
+			std::vector<std::vector<Ring>> filled_hole_rings(1);
+			traceRings(filled_labels, std::vector<uchar>(1, 0), filled_outer_rings, filled_hole_rings);
+
+			polygons[k] = assemblePolygons(filled_outer_rings[0], filled_hole_rings[0]);
+			for (int i = 0; i < polygons[k].size(); i++) {
+				polygons[k][i].translate(rect.x, rect.y);
+			}
+		}
+
+		return polygons;
+	}
+
+	/**
+	 * Trace the boundaries of the labels in the raster order.
+	 * An outer ring is found at the left side of its top-left pixel, and a hole is found at the bottom side of
+	 * the pixel above its top-left pixel. Since the boundary has no diagonal connection, each corner has at most
+	 * one outgoing edge for each label, and each edge is traced only once.
+	 *
+	 * @param labels		labeled image
+	 * @param skipped		the labels that are not traced
+	 * @param outer_rings	outer rings of each label in the order of the discovery
+	 * @param hole_rings	holes of each label in the order of the discovery
+	 */
+	void ContourTracer::traceRings(const cv::Mat_<int>& labels, const std::vector<uchar>& skipped, std::vector<std::vector<Ring>>& outer_rings, std::vector<std::vector<Ring>>& hole_rings) {
+		cv::Mat_<uchar> visited = cv::Mat_<uchar>::zeros(labels.size());
+		for (int r = 0; r < labels.rows; r++) {
+			for (int c = 0; c < labels.cols; c++) {
+				int k = labels(r, c);
+				if (k < 0 || skipped[k]) continue;
+
+				if (labelAt(labels, r, c - 1) != k && !(visited(r, c) & LEFT_VISITED)) {
+					outer_rings[k].push_back(traceRing(labels, k, c, r, 1, visited));
+				}
+				if (labelAt(labels, r + 1, c) != k && !(visited(r, c) & BOTTOM_VISITED)) {
+					hole_rings[k].push_back(traceRing(labels, k, c, r + 1, 0, visited));
+				}
+			}
+		}
+	}
+
+	/**
+	 * Follow the boundary of the label along the pixel corners, keeping the pixels of the label on the left side.
+	 * Only the corners where the direction changes are added to the ring.
+	 *
+	 * @param labels	labeled image
+	 * @param label		label to trace
+	 * @param x			x coordinate of the starting corner
+	 * @param y			y coordinate of the starting corner
+	 * @param dir		starting direction (0 - right, 1 - down)
+	 * @param visited	the left and bottom sides of the pixels that are traced are marked
+	 * @return			ring
+	 */
+	Ring ContourTracer::traceRing(const cv::Mat_<int>& labels, int label, int x, int y, int dir, cv::Mat_<uchar>& visited) {
+		Ring ring;
+		ring.push_back(cv::Point2f(x, y));
+
+		int x0 = x;
+		int y0 = y;
+		while (true) {
+			if (dir == 0) visited(y - 1, x) |= BOTTOM_VISITED;
+			else if (dir == 1) visited(y, x) |= LEFT_VISITED;
+
+			x += DX[dir];
+			y += DY[dir];
+			if (x == x0 && y == y0) break;
+
+			int right_dir = (dir + 1) % 4;
+			bool ahead_left = labelAt(labels, y + AHEAD_LEFT_DR[dir], x + AHEAD_LEFT_DC[dir]) == label;
+			bool ahead_right = labelAt(labels, y + AHEAD_LEFT_DR[right_dir], x + AHEAD_LEFT_DC[right_dir]) == label;
+
+			int next_dir = dir;
+			if (!ahead_left) next_dir = (dir + 3) % 4;
+			else if (ahead_right) next_dir = right_dir;
+
+			if (next_dir != dir) ring.push_back(cv::Point2f(x, y));
+			dir = next_dir;
+		}
+
+		return ring;
+	}
+
+	/**
+	 * Make the polygons from the rings of a label in the same order as cv::findContours with RETR_CCOMP,
+	 * which lists the contours in the reverse order of the discovery.
+	 *
+	 * @param outer_rings	outer rings in the order of the discovery
+	 * @param hole_rings	holes in the order of the discovery
+	 * @return				polygons
+	 */
+	std::vector<Polygon> ContourTracer::assemblePolygons(const std::vector<Ring>& outer_rings, const std::vector<Ring>& hole_rings) {
+		std::vector<Polygon> polygons(outer_rings.size());
+		for (int i = 0; i < outer_rings.size(); i++) {
+			polygons[i].contour = outer_rings[outer_rings.size() - 1 - i];
+		}
+
+		for (int i = hole_rings.size() - 1; i >= 0; i--) {
+			// the hole belongs to the innermost outer ring that contains its top-left pixel
+			int parent = 0;
+			if (polygons.size() > 1) {
+				cv::Point2f pt = hole_rings[i][0] + cv::Point2f(0.5, 0.5);
+				double min_area = std::numeric_limits<double>::max();
+				for (int j = 0; j < polygons.size(); j++) {
+					if (!withinPolygon(pt, polygons[j].contour)) continue;
+					double a = area(polygons[j].contour.points);
+					if (a < min_area) {
+						min_area = a;
+						parent = j;
+					}
+				}
+			}
+			polygons[parent].holes.push_back(hole_rings[i]);
+		}
+
+		return polygons;
+	}
+
+	/**
+	 * Fill the diagonal connections in the same way as findContours until there is no diagonal connection.
+	 *
+	 * @param img	image (0 - background, 255 - foreground)
+	 */
+	void ContourTracer::fillDiagonalConnections(cv::Mat_<uchar>& img) {
+		while (true) {
+			bool updated = false;
+			for (int r = 0; r < img.rows - 1; r++) {
+				for (int c = 0; c < img.cols - 1; c++) {
+					if (img(r, c) == 255 && img(r + 1, c + 1) == 255 && img(r + 1, c) == 0 && img(r, c + 1) == 0) {
+						updated = true;
+						img(r + 1, c) = 255;
+					}
+					else if (img(r, c) == 0 && img(r + 1, c + 1) == 0 && img(r + 1, c) == 255 && img(r, c + 1) == 255) {
+						updated = true;
+						img(r, c) = 255;
+					}
+				}
+			}
+			if (!updated) break;
+		}
+	}
+
+}
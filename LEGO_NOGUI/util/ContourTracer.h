@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ContourUtils.h"
+
+namespace util {
+
+	/**
+	 * Boundary tracer that extracts the contours of all the labels of a labeled image in one pass.
+	 *
+	 * The boundary between the pixels is followed along the pixel corners, so the contours are exactly
+	 * those of findContours(img, true) for the image of each label: the diagonal connections are resolved
+	 * in the same way, and the rings, their starting points, their orientations, and their order are the same.
+	 * Only a label that has a diagonal connection is filled and traced separately within its bounding rectangle.
+	 */
+	class ContourTracer {
+	protected:
+		ContourTracer() {}
+
+	public:
+		static std::vector<std::vector<Polygon>> findContours(const cv::Mat_<int>& labels, int num_labels);
+
+	private:
+		static void traceRings(const cv::Mat_<int>& labels, const std::vector<uchar>& skipped, std::vector<std::vector<Ring>>& outer_rings, std::vector<std::vector<Ring>>& hole_rings);
+		static Ring traceRing(const cv::Mat_<int>& labels, int label, int x, int y, int dir, cv::Mat_<uchar>& visited);
+		static std::vector<Polygon> assemblePolygons(const std::vector<Ring>& outer_rings, const std::vector<Ring>& hole_rings);
+		static void fillDiagonalConnections(cv::Mat_<uchar>& img);
+	};
+
+}
@@ -1,9 +1,13 @@
 #include "ContourUtils.h"
+#include "BinaryMask.h"
+#include "SimplicityTest.h"
+#include "ContourTracer.h"
 #include <iostream>
 #include <boost/polygon/polygon.hpp>
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point_xy.hpp>
 #include <list>
+#include <algorithm>
 
 namespace util {
 	
@@ -254,12 +258,9 @@ namespace util {
 	}
 	
 	bool Ring::isSimple() const {
-		CDT cdt;
-		CGAL::Partition_traits_2<Kernel>::Polygon_2 polygon;
-		for (int i = 0; i < points.size(); i++) {
-			polygon.push_back(CDT::Point(points[i].x, points[i].y));
-		}
-		return polygon.is_simple();
+		SimplicityTest test;
+		test.addRing(points);
+		return test.isSimple();
 	}
 
 	Polygon::Polygon() {
@@ -329,9 +330,29 @@ namespace util {
 		}
 	}
 
+	/**
+	 * Test whether the polygon is simple, i.e., none of the contour and the holes is self-intersecting,
+	 * and they do not intersect or touch each other.
+	 */
 	bool isSimple(const Polygon& polygon) {
 		if (polygon.contour.size() == 0) return false;
 
+		SimplicityTest test;
+		test.addRing(polygon.contour.getActualPoints().points);
+		for (int i = 0; i < polygon.holes.size(); i++) {
+			if (polygon.holes[i].size() == 0) continue;
+			test.addRing(polygon.holes[i].getActualPoints().points);
+		}
+		return test.isSimple();
+	}
+
+	/**
+	 * Test whether the polygon is simple by CGAL.
+	 * This is much slower than isSimple(), and is kept as the reference implementation for validation.
+	 */
+	bool isSimpleByCGAL(const Polygon& polygon) {
+		if (polygon.contour.size() == 0) return false;
+
 		CGAL::Polygon_2<Kernel> pgn;
 		std::vector<cv::Point2f> contour = polygon.contour.getActualPoints().points;
 		for (int i = 0; i < contour.size(); i++) {
@@ -390,21 +411,13 @@ namespace util {
 	}
 
 	bool isSimple(const Ring& points) {
-		CDT cdt;
-		CGAL::Partition_traits_2<Kernel>::Polygon_2 polygon;
-		for (int i = 0; i < points.size(); i++) {
-			polygon.push_back(CDT::Point(points[i].x, points[i].y));
-		}
-		return polygon.is_simple();
+		return points.isSimple();
 	}
 
 	bool isSimple(const std::vector<cv::Point>& points) {
-		CDT cdt;
-		CGAL::Partition_traits_2<Kernel>::Polygon_2 polygon;
-		for (int i = 0; i < points.size(); i++) {
-			polygon.push_back(CDT::Point(points[i].x, points[i].y));
-		}
-		return polygon.is_simple();
+		SimplicityTest test;
+		test.addRing(points);
+		return test.isSimple();
 	}
 
 	void transform(std::vector<cv::Point2f>& polygon, const cv::Mat_<float>& m) {
@@ -532,33 +545,129 @@ namespace util {
 		return cv::Rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
 	}
 
+	namespace {
+
+		double turn(const cv::Point2f& o, const cv::Point2f& a, const cv::Point2f& b) {
+			return ((double)a.x - o.x) * ((double)b.y - o.y) - ((double)a.y - o.y) * ((double)b.x - o.x);
+		}
+
+		double project(const cv::Point2f& d, const cv::Point2f& p) {
+			return (double)d.x * p.x + (double)d.y * p.y;
+		}
+
+		/**
+		 * Compute the convex hull of the points in the counter-clockwise order by Andrew's monotone chain.
+		 * The duplicate points and the collinear points on the edges are not included.
+		 */
+		void monotoneChainHull(const std::vector<cv::Point2f>& points, std::vector<cv::Point2f>& hull) {
+			std::vector<cv::Point2f> sorted = points;
+			std::sort(sorted.begin(), sorted.end(), [](const cv::Point2f& a, const cv::Point2f& b) {
+				return a.x < b.x || (a.x == b.x && a.y < b.y);
+			});
+			if (sorted.size() <= 1) {
+				hull = sorted;
+				return;
+			}
+
+			hull.resize(sorted.size() * 2);
+			int k = 0;
+			for (int i = 0; i < sorted.size(); i++) {
+				while (k >= 2 && turn(hull[k - 2], hull[k - 1], sorted[i]) <= 0) k--;
+				hull[k++] = sorted[i];
+			}
+			for (int i = (int)sorted.size() - 2, lower_size = k + 1; i >= 0; i--) {
+				while (k >= lower_size && turn(hull[k - 2], hull[k - 1], sorted[i]) <= 0) k--;
+				hull[k++] = sorted[i];
+			}
+			hull.resize(k - 1);
+		}
+
+	}
+
+	/**
+	 * Calculate the oriented bounding box of the polygon that has the minimum area among the boxes aligned to its edges.
+	 * The edge directions are sorted by angle, and the extreme points of the convex hull along each direction and
+	 * its normal are tracked by the rotating calipers, so that it takes O(n log n) time in total.
+	 * Each box is measured by rotating the extreme points by the float rotation matrix and truncating them to integers
+	 * as boundingBox() does, and the first edge in the polygon order is chosen among the boxes of the same area.
+	 *
+	 * @param polygon		polygon
+	 * @param trans_mat		2x2 rotation matrix that aligns the box to the axes
+	 * @return				box in the rotated coordinates
+	 */
 	cv::Rect calculateOBB(const std::vector<cv::Point2f>& polygon, cv::Mat_<float>& trans_mat) {
 		cv::Rect ans(0, 0, 0, 0);
 		trans_mat = (cv::Mat_<float>(2, 2) << 1, 0, 0, 1);
-		int min_area = std::numeric_limits<int>::max();
 
+		// sort the edge directions by angle
+		std::vector<std::pair<float, int>> directions;
+		directions.reserve(polygon.size());
 		for (int i = 0; i < polygon.size(); i++) {
 			int next = (i + 1) % polygon.size();
-			if (length(polygon[next] - polygon[i]) == 0) continue;
-
-			// calculate the angle of the edge
-			float theta = std::atan2(polygon[next].y - polygon[i].y, polygon[next].x - polygon[i].x);
-			cv::Mat_<float> mat = (cv::Mat_<float>(2, 2) << std::cos(theta), std::sin(theta), -std::sin(theta), std::cos(theta));
-			
-			// rotate the polygon
-			std::vector<cv::Point2f> rotated_polygon(polygon.size());
-			for (int j = 0; j < polygon.size(); j++) {
-				cv::Mat_<float> p = (cv::Mat_<float>(2, 1) << polygon[j].x, polygon[j].y);
-				cv::Mat_<float> p2 = mat * p;
-				rotated_polygon[j] = cv::Point2f(p2(0, 0), p2(1, 0));
-			}
-
-			// calculate the bounding box
-			cv::Rect rect = boundingBox(rotated_polygon);
-			if (rect.width * rect.height < min_area) {
+			cv::Point2f d = polygon[next] - polygon[i];
+			if (d.x == 0 && d.y == 0) continue;
+			directions.push_back({ std::atan2(d.y, d.x), i });
+		}
+		if (directions.size() == 0) return ans;
+		std::sort(directions.begin(), directions.end());
+
+		std::vector<cv::Point2f> hull;
+		monotoneChainHull(polygon, hull);
+		int n = hull.size();
+
+		// indices of the hull points that are extreme along the direction (min_u, max_u) and its left normal (min_v, max_v)
+		int min_u = 0;
+		int max_u = 0;
+		int min_v = 0;
+		int max_v = 0;
+		int min_area = std::numeric_limits<int>::max();
+		int min_edge = -1;
+		for (int i = 0; i < directions.size(); i++) {
+			float theta = directions[i].first;
+			float cos_theta = std::cos(theta);
+			float sin_theta = std::sin(theta);
+			cv::Point2f u(cos_theta, sin_theta);
+			cv::Point2f v(-sin_theta, cos_theta);
+
+			// the extreme points move counter-clockwise along the hull as the direction rotates counter-clockwise
+			if (i == 0) {
+				for (int j = 1; j < n; j++) {
+					if (project(u, hull[j]) < project(u, hull[min_u])) min_u = j;
+					if (project(u, hull[j]) > project(u, hull[max_u])) max_u = j;
+					if (project(v, hull[j]) < project(v, hull[min_v])) min_v = j;
+					if (project(v, hull[j]) > project(v, hull[max_v])) max_v = j;
+				}
+			}
+			else {
+				while (project(u, hull[(min_u + 1) % n]) < project(u, hull[min_u])) min_u = (min_u + 1) % n;
+				while (project(u, hull[(max_u + 1) % n]) > project(u, hull[max_u])) max_u = (max_u + 1) % n;
+				while (project(v, hull[(min_v + 1) % n]) < project(v, hull[min_v])) min_v = (min_v + 1) % n;
+				while (project(v, hull[(max_v + 1) % n]) > project(v, hull[max_v])) max_v = (max_v + 1) % n;
+			}
+
+			// calculate the bounding box of the rotated extreme points in the same way as boundingBox()
+			int extreme_points[4] = { min_u, max_u, min_v, max_v };
+			int min_x = std::numeric_limits<int>::max();
+			int max_x = -std::numeric_limits<int>::max();
+			int min_y = std::numeric_limits<int>::max();
+			int max_y = -std::numeric_limits<int>::max();
+			for (int j = 0; j < 4; j++) {
+				const cv::Point2f& p = hull[extreme_points[j]];
+				int x = (int)(cos_theta * p.x + sin_theta * p.y);
+				int y = (int)(-sin_theta * p.x + cos_theta * p.y);
+				min_x = std::min(min_x, x);
+				max_x = std::max(max_x, x);
+				min_y = std::min(min_y, y);
+				max_y = std::max(max_y, y);
+			}
+			cv::Rect rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+
+			int edge = directions[i].second;
+			if (rect.width * rect.height < min_area || (rect.width * rect.height == min_area && edge < min_edge)) {
 				min_area = rect.width * rect.height;
+				min_edge = edge;
 				ans = rect;
-				trans_mat = mat;
+				trans_mat = (cv::Mat_<float>(2, 2) << cos_theta, sin_theta, -sin_theta, cos_theta);
 			}
 		}
 
@@ -641,6 +750,7 @@ namespace util {
 	 * Calculate the intersection over union (IOU) between two polygons.
 	 * Since calculating the polygon intersecion and union exactly is very expensive,
 	 * we resort to an image-based approach that can quickly calculate the approximate IOU.
+	 * The polygons are rasterized into bit-packed masks, and the pixels are counted by popcount.
 	 */
 	double calculateIOU(const Polygon& polygon1, const Polygon& polygon2) {
 		Ring contour1 = polygon1.contour.getActualPoints();
@@ -663,7 +773,7 @@ namespace util {
 			max_y = std::max(max_y, (int)(contour2[i].y + 0.5));
 		}
 
-		cv::Mat_<uchar> img1 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask1(max_x - min_x + 1, max_y - min_y + 1);
 		
 		std::vector<std::vector<cv::Point>> contour_points1(1 + polygon1.holes.size());
 		contour_points1[0].resize(contour1.size());
@@ -677,9 +787,9 @@ namespace util {
 				contour_points1[i + 1][j] = cv::Point(hole[j].x - min_x, hole[j].y - min_y);
 			}
 		}
-		cv::fillPoly(img1, contour_points1, cv::Scalar(255), cv::LINE_4);
+		mask1.fillPoly(contour_points1);
 
-		cv::Mat_<uchar> img2 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask2(max_x - min_x + 1, max_y - min_y + 1);
 
 		std::vector<std::vector<cv::Point>> contour_points2(1 + polygon2.holes.size());
 		contour_points2[0].resize(contour2.size());
@@ -693,16 +803,11 @@ namespace util {
 				contour_points2[i + 1][j] = cv::Point(hole[j].x - min_x, hole[j].y - min_y);
 			}
 		}
-		cv::fillPoly(img2, contour_points2, cv::Scalar(255), cv::LINE_4);
+		mask2.fillPoly(contour_points2);
 
-		int inter_cnt = 0;
-		int union_cnt = 0;
-		for (int r = 0; r < img1.rows; r++) {
-			for (int c = 0; c < img1.cols; c++) {
-				if (img1(r, c) == 255 && img2(r, c) == 255) inter_cnt++;
-				if (img1(r, c) == 255 || img2(r, c) == 255) union_cnt++;
-			}
-		}
+		long long inter_cnt;
+		long long union_cnt;
+		BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
 
 		return (double)inter_cnt / union_cnt;
 	}
@@ -725,32 +830,27 @@ namespace util {
 			max_y = std::max(max_y, (int)(polygon2[i].y + 0.5));
 		}
 
-		cv::Mat_<uchar> img1 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask1(max_x - min_x + 1, max_y - min_y + 1);
 
 		std::vector<std::vector<cv::Point>> contour_points1(1);
 		contour_points1[0].resize(polygon1.size());
 		for (int i = 0; i < polygon1.size(); i++) {
 			contour_points1[0][i] = cv::Point(polygon1[i].x - min_x, polygon1[i].y - min_y);
 		}
-		cv::fillPoly(img1, contour_points1, cv::Scalar(255), cv::LINE_4);
+		mask1.fillPoly(contour_points1);
 
-		cv::Mat_<uchar> img2 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask2(max_x - min_x + 1, max_y - min_y + 1);
 
 		std::vector<std::vector<cv::Point>> contour_points2(1);
 		contour_points2[0].resize(polygon2.size());
 		for (int i = 0; i < polygon2.size(); i++) {
 			contour_points2[0][i] = cv::Point(polygon2[i].x - min_x, polygon2[i].y - min_y);
 		}
-		cv::fillPoly(img2, contour_points2, cv::Scalar(255), cv::LINE_4);
+		mask2.fillPoly(contour_points2);
 
-		int inter_cnt = 0;
-		int union_cnt = 0;
-		for (int r = 0; r < img1.rows; r++) {
-			for (int c = 0; c < img1.cols; c++) {
-				if (img1(r, c) == 255 && img2(r, c) == 255) inter_cnt++;
-				if (img1(r, c) == 255 || img2(r, c) == 255) union_cnt++;
-			}
-		}
+		long long inter_cnt;
+		long long union_cnt;
+		BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
 
 		return (double)inter_cnt / union_cnt;
 	}
@@ -815,34 +915,29 @@ namespace util {
 
 		float scale = (float)image_size / std::max(max_x - min_x, max_y - min_y);
 
-		cv::Mat_<uchar> img1 = cv::Mat_<uchar>::zeros(image_size, image_size);
+		BinaryMask mask1(image_size, image_size);
 		if (polygon1.size() > 0) {
 			std::vector<std::vector<cv::Point>> contour_points1(1);
 			contour_points1[0].resize(polygon1.size());
 			for (int i = 0; i < polygon1.size(); i++) {
 				contour_points1[0][i] = cv::Point((polygon1[i].x - min_x) * scale, (polygon1[i].y - min_y) * scale);
 			}
-			cv::fillPoly(img1, contour_points1, cv::Scalar(255), cv::LINE_4);
+			mask1.fillPoly(contour_points1);
 		}
 
-		cv::Mat_<uchar> img2 = cv::Mat_<uchar>::zeros(image_size, image_size);
+		BinaryMask mask2(image_size, image_size);
 		if (polygon2.size() > 0) {
 			std::vector<std::vector<cv::Point>> contour_points2(1);
 			contour_points2[0].resize(polygon2.size());
 			for (int i = 0; i < polygon2.size(); i++) {
 				contour_points2[0][i] = cv::Point((polygon2[i].x - min_x) * scale, (polygon2[i].y - min_y) * scale);
 			}
-			cv::fillPoly(img2, contour_points2, cv::Scalar(255), cv::LINE_4);
+			mask2.fillPoly(contour_points2);
 		}
 
-		int inter_cnt = 0;
-		int union_cnt = 0;
-		for (int r = 0; r < img1.rows; r++) {
-			for (int c = 0; c < img1.cols; c++) {
-				if (img1(r, c) == 255 && img2(r, c) == 255) inter_cnt++;
-				if (img1(r, c) == 255 || img2(r, c) == 255) union_cnt++;
-			}
-		}
+		long long inter_cnt;
+		long long union_cnt;
+		BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
 		if (union_cnt == 0){
 			return 0;
 		}
@@ -873,7 +968,7 @@ namespace util {
 			}
 		}
 
-		cv::Mat_<uchar> img1 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask1(max_x - min_x + 1, max_y - min_y + 1);
 		for (auto& polygon : polygons1) {
 			std::vector<std::vector<cv::Point>> contour_points(1 + polygon.holes.size());
 			Ring contour = polygon.contour.getActualPoints();
@@ -888,10 +983,10 @@ namespace util {
 					contour_points[i + 1][j] = cv::Point(hole[j].x - min_x, hole[j].y - min_y);
 				}
 			}
-			cv::fillPoly(img1, contour_points, cv::Scalar(255), cv::LINE_4);
+			mask1.fillPoly(contour_points);
 		}
 
-		cv::Mat_<uchar> img2 = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+		BinaryMask mask2(max_x - min_x + 1, max_y - min_y + 1);
 		for (auto& polygon : polygons2) {
 			std::vector<std::vector<cv::Point>> contour_points(1 + polygon.holes.size());
 			Ring contour = polygon.contour.getActualPoints();
@@ -906,17 +1001,12 @@ namespace util {
 					contour_points[i + 1][j] = cv::Point(hole[j].x - min_x, hole[j].y - min_y);
 				}
 			}
-			cv::fillPoly(img2, contour_points, cv::Scalar(255), cv::LINE_4);
+			mask2.fillPoly(contour_points);
 		}
 
-		int inter_cnt = 0;
-		int union_cnt = 0;
-		for (int r = 0; r < img1.rows; r++) {
-			for (int c = 0; c < img1.cols; c++) {
-				if (img1(r, c) == 255 && img2(r, c) == 255) inter_cnt++;
-				if (img1(r, c) == 255 || img2(r, c) == 255) union_cnt++;
-			}
-		}
+		long long inter_cnt;
+		long long union_cnt;
+		BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
 
 		return (double)inter_cnt / union_cnt;
 	}
@@ -954,94 +1044,22 @@ namespace util {
 
 	/**
 	 * Helper function to extract contours from the input image.
-	 * The image has to be of type CV_8U, and has values either 0 or 255.
+	 * The image has to be of type CV_8U, and every non-zero pixel is the foreground, as in cv::findContours.
 	 * Note that the input image is not modified by this function.
+	 *
+	 * The boundary is traced along the pixel corners at the native resolution, which gives the same polygons as
+	 * filling the diagonal connections, upscaling the image by 4x, dilating it, and calling cv::findContours.
+	 * Since the traced contours consist of the right-angle corners only, add_right_corner does not change the result.
 	 */
 	std::vector<Polygon> findContours(const cv::Mat_<uchar>& img, bool add_right_corner) {
-		std::vector<Polygon> ans;
-
-		cv::Mat_<uchar> img2 = img.clone();
-		while (true) {
-			bool updated = false;
-			for (int r = 0; r < img.rows - 1; r++) {
-				for (int c = 0; c < img.cols - 1; c++) {
-					if (img2(r, c) == 255 && img2(r + 1, c + 1) == 255 && img2(r + 1, c) == 0 && img2(r, c + 1) == 0) {
-						updated = true;
-						img2(r + 1, c) = 255;
-					}
-					else if (img2(r, c) == 0 && img2(r + 1, c + 1) == 0 && img2(r + 1, c) == 255 && img2(r, c + 1) == 255) {
-						updated = true;
-						img2(r, c) = 255;
-					}
-				}
-			}
-			if (!updated) break;
-		}
-
-		// resize x4
-		cv::Mat_<uchar> img3;
-		cv::resize(img2, img3, cv::Size(img.cols * 4, img.rows * 4), 0, 0, cv::INTER_NEAREST);
-
-		// add padding
-		cv::Mat_<uchar> padded = cv::Mat_<uchar>::zeros(img3.rows + 1, img3.cols + 1);
-		img3.copyTo(padded(cv::Rect(0, 0, img3.cols, img3.rows)));
-
-		// dilate image
-		cv::Mat_<uchar> kernel = (cv::Mat_<uchar>(3, 3) << 1, 1, 0, 1, 1, 0, 0, 0, 0);
-		cv::dilate(padded, padded, kernel);
-		
-		// extract contours
-		std::vector<std::vector<cv::Point>> contours;
-		std::vector<cv::Vec4i> hierarchy;
-		cv::findContours(padded, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
-
-		for (int i = 0; i < hierarchy.size(); i++) {
-			if (hierarchy[i][3] != -1) continue;
-			if (contours[i].size() < 3) continue;
-
-			Polygon polygon;
-			if (add_right_corner) {
-				Ring contour = addCornerToOpenCVContour(contours[i], padded);
-				polygon.contour.resize(contour.size());
-				for (int j = 0; j < contour.size(); j++) {
-					polygon.contour[j] = cv::Point2f(std::round(contour[j].x * 0.25), std::round(contour[j].y * 0.25));
-				}
-			}
-			else {
-				polygon.contour.resize(contours[i].size());
-				for (int j = 0; j < contours[i].size(); j++) {
-					polygon.contour[j] = cv::Point2f(std::round(contours[i][j].x * 0.25), std::round(contours[i][j].y * 0.25));
-				}
-			}
-			polygon.contour = removeRedundantPoint(polygon.contour);
-			
-			if (polygon.contour.size() >= 3) {
-				// obtain all the holes inside this contour
-				int hole_id = hierarchy[i][2];
-				while (hole_id != -1) {
-					Ring hole;
-					if (add_right_corner) {
-						hole = addCornerToOpenCVContour(contours[hole_id], padded);
-						for (int j = 0; j < hole.size(); j++) {
-							hole[j] = cv::Point2f(std::round(hole[j].x * 0.25), std::round(hole[j].y * 0.25));
-						}
-					}
-					else {
-						hole.resize(contours[hole_id].size());
-						for (int j = 0; j < contours[hole_id].size(); j++) {
-							hole[j] = cv::Point2f(std::round(contours[hole_id][j].x * 0.25), std::round(contours[hole_id][j].y * 0.25));
-						}
-					}
-					hole = removeRedundantPoint(hole);
-					polygon.holes.push_back(hole);
-					hole_id = hierarchy[hole_id][0];
-				}
-
-				ans.push_back(polygon);
+		cv::Mat_<int> labels(img.size(), -1);
+		for (int r = 0; r < img.rows; r++) {
+			for (int c = 0; c < img.cols; c++) {
+				if (img(r, c) != 0) labels(r, c) = 0;
 			}
 		}
 
-		return ans;
+		return ContourTracer::findContours(labels, 1)[0];
 	}
 
 	/**
@@ -1053,6 +1071,9 @@ namespace util {
 		cv::Mat mat = image.clone();
 		cv::threshold(mat, mat, threshold, 255, cv::THRESH_BINARY);
 
+		// the dilated contours without diagonal connections are traced at the native resolution
+		if (simplify && !allow_diagonal && dilate) return findContours(cv::Mat_<uchar>(mat), false);
+
 		cv::Mat_<uchar> mat2 = mat.clone();
 
 		// if diagonal is not allowwd, dilate the diagonal connection.
@@ -1495,6 +1516,16 @@ namespace util {
 	void snapPolygon(const std::vector<util::Polygon>& ref_polygons, std::vector<cv::Point2f>& polygon, float snapping_threshold) {
 		std::vector<cv::Point2f> orig_polygon = polygon;
 
+		// transform the reference polygons only once
+		std::vector<Ring> ref_contours(ref_polygons.size());
+		std::vector<std::vector<Ring>> ref_holes(ref_polygons.size());
+		for (int j = 0; j < ref_polygons.size(); j++) {
+			ref_contours[j] = ref_polygons[j].contour.getActualPoints();
+			for (int k = 0; k < ref_polygons[j].holes.size(); k++) {
+				ref_holes[j].push_back(ref_polygons[j].holes[k].getActualPoints());
+			}
+		}
+
 		for (int i = 0; i < polygon.size(); i++) {
 			int i2 = (i + 1) % polygon.size();
 			float len = length(polygon[i] - polygon[i2]);
@@ -1504,7 +1535,7 @@ namespace util {
 			cv::Point2f pt1, pt2;
 
 			for (int j = 0; j < ref_polygons.size(); j++) {
-				std::vector<cv::Point2f> contour = ref_polygons[j].contour.getActualPoints().points;
+				const std::vector<cv::Point2f>& contour = ref_contours[j].points;
 
 				for (int k = 0; k < contour.size(); k++) {
 					int k2 = (k + 1) % contour.size();
@@ -1533,7 +1564,7 @@ namespace util {
 				}
 
 				for (int k = 0; k < ref_polygons[j].holes.size(); k++) {
-					std::vector<cv::Point2f> hole = ref_polygons[j].holes[k].getActualPoints().points;
+					const std::vector<cv::Point2f>& hole = ref_holes[j][k].points;
 					for (int l = 0; l < hole.size(); l++) {
 						int l2 = (l + 1) % hole.size();
 
@@ -1627,6 +1658,16 @@ namespace util {
 	void snapPolygon2(const std::vector<util::Polygon>& ref_polygons, std::vector<cv::Point2f>& polygon, float snapping_threshold) {
 		std::vector<cv::Point2f> orig_polygon = polygon;
 
+		// transform the reference polygons only once
+		std::vector<Ring> ref_contours(ref_polygons.size());
+		std::vector<std::vector<Ring>> ref_holes(ref_polygons.size());
+		for (int j = 0; j < ref_polygons.size(); j++) {
+			ref_contours[j] = ref_polygons[j].contour.getActualPoints();
+			for (int k = 0; k < ref_polygons[j].holes.size(); k++) {
+				ref_holes[j].push_back(ref_polygons[j].holes[k].getActualPoints());
+			}
+		}
+
 		for (int i = 0; i < polygon.size(); i++) {
 			int i2 = (i + 1) % polygon.size();
 			float len = length(polygon[i] - polygon[i2]);
@@ -1636,7 +1677,7 @@ namespace util {
 			cv::Point2f pt1, pt2;
 
 			for (int j = 0; j < ref_polygons.size(); j++) {
-				std::vector<cv::Point2f> contour = ref_polygons[j].contour.getActualPoints().points;
+				const std::vector<cv::Point2f>& contour = ref_contours[j].points;
 
 				for (int k = 0; k < contour.size(); k++) {
 					int k2 = (k + 1) % contour.size();
@@ -1665,7 +1706,7 @@ namespace util {
 				}
 
 				for (int k = 0; k < ref_polygons[j].holes.size(); k++) {
-					std::vector<cv::Point2f> hole = ref_polygons[j].holes[k].getActualPoints().points;
+					const std::vector<cv::Point2f>& hole = ref_holes[j][k].points;
 					for (int l = 0; l < hole.size(); l++) {
 						int l2 = (l + 1) % hole.size();
 
@@ -1734,13 +1775,20 @@ namespace util {
 
 	void snapPolygon3(const std::vector<util::Polygon>& ref_polygons, std::vector<cv::Point2f>& polygon, float snapping_threshold) {
 		std::vector<cv::Point2f> orig_polygon = polygon;
+
+		// transform the reference polygons only once
+		std::vector<Ring> ref_contours(ref_polygons.size());
+		for (int j = 0; j < ref_polygons.size(); j++) {
+			ref_contours[j] = ref_polygons[j].contour.getActualPoints();
+		}
+
 		for (int i = 0; i < polygon.size(); i++) {
 			float min_length = std::numeric_limits<float>::max();
 			// find the closest point from the reference polygons
 			cv::Point2f pt1;
 
 			for (int j = 0; j < ref_polygons.size(); j++) {
-				std::vector<cv::Point2f> contour = ref_polygons[j].contour.getActualPoints().points;
+				const std::vector<cv::Point2f>& contour = ref_contours[j].points;
 
 				for (int k = 0; k < contour.size(); k++) {
 					float ref_len = length(contour[k] - polygon[i]);
@@ -2007,90 +2055,146 @@ namespace util {
 	}
 
 
-	/**
-	* Estimate the orientation of the polygons using Hough Transform.
-	*/
-	float estimate(const std::vector<util::Polygon>& polygons) {
-		int max_rho = 0;
-		for (auto& polygon : polygons) {
-			for (auto& pt : polygon.contour.points) {
-				max_rho = std::max(max_rho, (int)std::ceil(pt.x * pt.x + pt.y * pt.y));
+	namespace {
+
+		// the orientations modulo 90 degrees are voted to the bins of 0.25 degrees
+		const int ORIENTATION_BINS = 360;
+		const double ORIENTATION_SIGMA = 8;			// standard deviation of the smoothing kernel in bins (2 degrees)
+		const int ORIENTATION_REFINE_RADIUS = 20;	// half width of the window of the sub-bin refinement in bins (5 degrees)
+		const double ORIENTATION_MAX_SPAN = 16;		// maximum arc length spanned by a chord
+
+		/**
+		 * Point that moves forward along a ring by arc length. The ring has to have a positive perimeter.
+		 */
+		class RingWalker {
+		private:
+			const std::vector<cv::Point2f>& ring;
+			int edge;
+			double offset;
+
+		public:
+			RingWalker(const std::vector<cv::Point2f>& ring) : ring(ring), edge(0), offset(0) {
+				// skip the zero-length edges at the beginning
+				advance(0);
 			}
-		}
 
-		cv::Mat_<float> HT(max_rho * 2 + 1, 180, 0.0f);
-		for (auto& polygon : polygons) {
-			for (auto& pt : polygon.contour.points) {
-				for (int angle = 0; angle < 180; angle++) {
-					float rho = pt.x * std::cos((float)angle / 180.0f * CV_PI) + pt.y * std::sin((float)angle / 180.0f * CV_PI);
-					HT(std::round(rho) + max_rho, angle)++;
+			void advance(double distance) {
+				offset += distance;
+				while (true) {
+					double edge_length = length(ring[(edge + 1) % ring.size()] - ring[edge]);
+					if (offset < edge_length) break;
+					offset -= edge_length;
+					edge = (edge + 1) % ring.size();
 				}
 			}
-		}
 
-		HT = HT.mul(HT);
-		cv::Mat sumHT;
-		cv::reduce(HT, sumHT, 0, cv::REDUCE_SUM);
-
-		/*
-		std::ofstream out("result.txt");
-		for (int c = 0; c < sumHT.cols; c++) {
-		out << sumHT.at<float>(0, c) << std::endl;
-		}
-		out.close();
-		*/
+			cv::Point2f point() const {
+				const cv::Point2f& p1 = ring[edge];
+				const cv::Point2f& p2 = ring[(edge + 1) % ring.size()];
+				return p1 + (p2 - p1) * (float)(offset / length(p2 - p1));
+			}
+		};
+
+		/**
+		 * Vote the orientations of the chords of the ring to the histogram with the linear interpolation.
+		 * The chords are sampled uniformly along the ring, and each chord spans a fixed arc length, so that
+		 * the staircase of a pixel contour votes for the direction of the line, not for the axes of the pixels.
+		 * Each chord is weighted by the arc length it represents.
+		 *
+		 * @param ring			ring
+		 * @param histogram		histogram of ORIENTATION_BINS bins
+		 */
+		void voteOrientations(const std::vector<cv::Point2f>& ring, double* histogram) {
+			double perimeter = 0;
+			for (int i = 0; i < ring.size(); i++) {
+				perimeter += length(ring[(i + 1) % ring.size()] - ring[i]);
+			}
+			if (perimeter == 0) return;
+
+			double span = std::min(ORIENTATION_MAX_SPAN, perimeter / 8);
+			int num_samples = std::max(64, (int)std::ceil(perimeter));
+			double step = perimeter / num_samples;
+
+			RingWalker tail(ring);
+			RingWalker head(ring);
+			head.advance(span);
+			for (int i = 0; i < num_samples; i++) {
+				cv::Point2f d = head.point() - tail.point();
+				double angle = std::fmod(std::atan2((double)d.y, (double)d.x) + CV_PI * 2, CV_PI * 0.5);
+				double bin = angle / (CV_PI * 0.5) * ORIENTATION_BINS;
+				int k = std::min((int)bin, ORIENTATION_BINS - 1);
+				double t = bin - k;
+				histogram[k] += step * (1 - t);
+				histogram[(k + 1) % ORIENTATION_BINS] += step * t;
+
+				tail.advance(step);
+				head.advance(step);
+			}
+		}
+
+		/**
+		 * Find the peak of the histogram smoothed by the Gaussian kernel, and refine it by the weighted mean
+		 * of the votes around the peak. The histogram is circular.
+		 *
+		 * @param histogram		histogram of ORIENTATION_BINS bins
+		 * @return				orientation in radian [0, PI/2)
+		 */
+		float findPrincipalOrientation(const double* histogram) {
+			int radius = (int)std::ceil(ORIENTATION_SIGMA * 3);
+			int peak = 0;
+			double max_votes = -1;
+			for (int i = 0; i < ORIENTATION_BINS; i++) {
+				double votes = 0;
+				for (int j = -radius; j <= radius; j++) {
+					votes += histogram[(i + j + ORIENTATION_BINS) % ORIENTATION_BINS] * std::exp(-0.5 * j * j / ORIENTATION_SIGMA / ORIENTATION_SIGMA);
+				}
+				if (votes > max_votes) {
+					max_votes = votes;
+					peak = i;
+				}
+			}
 
-		float max_votes = 0;
-		int max_angle;
-		for (int c = 0; c < sumHT.cols; c++) {
-			if (sumHT.at<float>(0, c) > max_votes) {
-				max_votes = sumHT.at<float>(0, c);
-				max_angle = c;
+			double sum = 0;
+			double weighted_sum = 0;
+			for (int j = -ORIENTATION_REFINE_RADIUS; j <= ORIENTATION_REFINE_RADIUS; j++) {
+				double votes = histogram[(peak + j + ORIENTATION_BINS) % ORIENTATION_BINS];
+				sum += votes;
+				weighted_sum += votes * j;
 			}
+			double bin = sum > 0 ? peak + weighted_sum / sum : peak;
+
+			double angle = std::fmod(bin / ORIENTATION_BINS * CV_PI * 0.5 + CV_PI * 0.5, CV_PI * 0.5);
+			return (float)angle;
 		}
 
-		return max_angle / 180.0f * CV_PI;
 	}
 
 	/**
-	* Estimate the orientation of the polygon using Hough Transform.
-	*/
-	float estimate(const std::vector<cv::Point2f>& polygon) {
-		int max_rho = 0;
-		for (auto& pt : polygon) {
-			max_rho = std::max(max_rho, (int)std::ceil(pt.x * pt.x + pt.y * pt.y));
-		}
-
-		cv::Mat_<float> HT(max_rho * 2 + 1, 180, 0.0f);
-		for (auto& pt : polygon) {
-			for (int angle = 0; angle < 180; angle++) {
-				float rho = pt.x * std::cos((float)angle / 180.0f * CV_PI) + pt.y * std::sin((float)angle / 180.0f * CV_PI);
-				HT(std::round(rho) + max_rho, angle)++;
-			}
-		}
-
-		HT = HT.mul(HT);
-		cv::Mat sumHT;
-		cv::reduce(HT, sumHT, 0, cv::REDUCE_SUM);
-
-		/*
-		std::ofstream out("result.txt");
-		for (int c = 0; c < sumHT.cols; c++) {
-		out << sumHT.at<float>(0, c) << std::endl;
-		}
-		out.close();
-		*/
-
-		float max_votes = 0;
-		int max_angle;
-		for (int c = 0; c < sumHT.cols; c++) {
-			if (sumHT.at<float>(0, c) > max_votes) {
-				max_votes = sumHT.at<float>(0, c);
-				max_angle = c;
-			}
+	 * Estimate the principal orientation of the polygons from the length-weighted histogram of the orientations
+	 * of their contour edges modulo 90 degrees. The histogram has a fixed number of bins regardless of the size of the polygons.
+	 *
+	 * @param polygons	polygons
+	 * @return			principal orientation in radian [0, PI/2)
+	 */
+	float estimate(const std::vector<util::Polygon>& polygons) {
+		double histogram[ORIENTATION_BINS] = { 0 };
+		for (int i = 0; i < polygons.size(); i++) {
+			voteOrientations(polygons[i].contour.points, histogram);
 		}
+		return findPrincipalOrientation(histogram);
+	}
 
-		return max_angle / 180.0f * CV_PI;
+	/**
+	 * Estimate the principal orientation of the polygon from the length-weighted histogram of the orientations
+	 * of its edges modulo 90 degrees.
+	 *
+	 * @param polygon	polygon
+	 * @return			principal orientation in radian [0, PI/2)
+	 */
+	float estimate(const std::vector<cv::Point2f>& polygon) {
+		double histogram[ORIENTATION_BINS] = { 0 };
+		voteOrientations(polygon, histogram);
+		return findPrincipalOrientation(histogram);
 	}
 
 	/**
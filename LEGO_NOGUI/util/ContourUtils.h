@@ -158,6 +158,7 @@ namespace util {
 	void clockwise(std::vector<cv::Point2f>& polygon);
 	void counterClockwise(std::vector<cv::Point2f>& polygon);
 	bool isSimple(const Polygon& polygon);
+	bool isSimpleByCGAL(const Polygon& polygon);
 	bool isSimple(const Ring& points);
 	bool isSimple(const std::vector<cv::Point>& points);
 	void transform(std::vector<cv::Point2f>& polygon, const cv::Mat_<float>& m);
@@ -1,5 +1,8 @@
 #include "DisjointVoxelData.h"
 #include "ContourUtils.h"
+#include "UnionFind.h"
+#include "LayeringTree.h"
+#include "Log.h"
 
 namespace util {
 
@@ -14,40 +17,61 @@ namespace util {
 	 * - Too small contours will be discarded.
 	 */
 	std::vector<VoxelBuilding> DisjointVoxelData::disjoint(const std::vector<cv::Mat_<uchar>>& voxel_data, int voxel_value_threshold, float min_voxel_count_ratio) {
-		// initialize the clustering
-		std::vector<cv::Mat_<short>> building_clustering(voxel_data.size());
-		for (int h = 0; h < voxel_data.size(); h++) {
-			building_clustering[h] = cv::Mat_<short>(voxel_data[h].size(), -1);
-		}
+		VoxelVolume volume;
+		volume.build(voxel_data, voxel_value_threshold);
+		return disjoint(volume, min_voxel_count_ratio);
+	}
 
+	/**
+	 * Disjoint the buildings in the bit-packed voxel volume.
+	 */
+	std::vector<VoxelBuilding> DisjointVoxelData::disjoint(const VoxelVolume& volume, float min_voxel_count_ratio) {
 		// Cluster the connected components in the voxel data.
-		// The clustering information will be stored in building_clustering.
-		setbuf(stdout, NULL);
-		printf("Clustering the voxel data...\n");
-		int building_id = 0;
-		int max_voxel_count = 0;
+		// The voxels of each cluster will be stored as runs, which are grouped by cluster.
+		Log::out() << "Clustering the voxel data..." << std::endl;
+		std::vector<Run> runs;
+		std::vector<size_t> run_offsets;	// the runs of cluster i are runs[run_offsets[i]] to runs[run_offsets[i + 1] - 1].
 		std::vector<int> voxel_counts;	// this array stores the number of voxels for each cluster.
-		for (int h = 0; h < voxel_data.size(); h++) {
-			for (int r = 0; r < voxel_data[h].rows; r++) {
-				for (int c = 0; c < voxel_data[h].cols; c++) {
-					if (voxel_data[h](r, c) > voxel_value_threshold && building_clustering[h](r, c) == -1) {
-						int voxel_count = disjointBuilding(voxel_data, building_clustering, r, c, h, building_id, voxel_value_threshold);
-						voxel_counts.push_back(voxel_count);
-						max_voxel_count = std::max(max_voxel_count, voxel_count);
-						building_id++;
-					}
-				}
-			}
+		std::vector<VoxelBoundingBox> bboxes;	// this array stores the bounding box of each cluster.
+		int num_buildings = labelBuildings(volume, runs, run_offsets, voxel_counts, bboxes);
+		int max_voxel_count = 0;
+		for (int i = 0; i < voxel_counts.size(); i++) {
+			max_voxel_count = std::max(max_voxel_count, voxel_counts[i]);
 		}
 
-		int num_buildings = building_id;
-
 		// Construct a graph structure for each connected component.
 		// The node of the graph represents a connected component in each slice.
+		// Each connected component is cropped by its bounding box, so that the memory for the graph construction
+		// scales with the size of the building instead of the size of the whole volume.
 		std::vector<VoxelBuilding> buildings;
 		for (int i = 0; i < num_buildings; i++) {
 			if (voxel_counts[i] < max_voxel_count * min_voxel_count_ratio) continue;
-			VoxelBuilding building_voxels = constructGraph(building_clustering, i);
+			std::vector<cv::Mat_<uchar>> voxels = cropBuilding(runs, run_offsets[i], run_offsets[i + 1], bboxes[i]);
+			VoxelBuilding building_voxels = constructGraph(voxels, i, bboxes[i], volume.getWidth(), volume.getHeight());
+			buildings.push_back(building_voxels);
+		}
+
+		return buildings;
+	}
+
+	/**
+	 * Disjoint the buildings whose components were labeled by the streaming labeling.
+	 * The buildings are the same as the ones of the in-memory path for the same slices, but only the voxels of
+	 * one building are in memory at a time while its graph is constructed.
+	 *
+	 * @param stream	the streaming labeling after all the slices are added and finished
+	 */
+	std::vector<VoxelBuilding> DisjointVoxelData::disjoint(ComponentStream& stream, float min_voxel_count_ratio) {
+		int max_voxel_count = 0;
+		for (int i = 0; i < stream.numComponents(); i++) {
+			max_voxel_count = std::max(max_voxel_count, stream.voxelCount(i));
+		}
+
+		std::vector<VoxelBuilding> buildings;
+		for (int i = 0; i < stream.numComponents(); i++) {
+			if (stream.voxelCount(i) < max_voxel_count * min_voxel_count_ratio) continue;
+			std::vector<cv::Mat_<uchar>> voxels = stream.crop(i);
+			VoxelBuilding building_voxels = constructGraph(voxels, i, stream.boundingBox(i), stream.getWidth(), stream.getHeight());
 			buildings.push_back(building_voxels);
 		}
 
@@ -57,390 +81,364 @@ namespace util {
 	/**
 	 * Layer the building based on the threshold.
 	 * Similar contour of slices will be merged into one layer.
-	 * 
+	 * The merge tree of the slices, which is built by constructGraph, is reused for the other thresholds.
 	 */
 	std::vector<std::shared_ptr<BuildingLayer>> DisjointVoxelData::layering(const util::VoxelBuilding& building_voxels, float threshold, int min_num_slices_per_layer) {
-		std::vector<std::shared_ptr<BuildingLayer>> bottom_building_layers;
-
-		// layer buildings
-		for (int z = 0; z < building_voxels.node_stack.size(); z++) {
-			for (int i = 0; i < building_voxels.node_stack[z].size(); i++) {
-				if (building_voxels.node_stack[z][i]->parents.size() == 0) {
-					std::vector<std::shared_ptr<BuildingLayer>> layers = layeringBuilding(building_voxels.building_id, building_voxels.node_stack[z][i], threshold, min_num_slices_per_layer);
-					bottom_building_layers.insert(bottom_building_layers.end(), layers.begin(), layers.end());
-				}
+		if (!building_voxels.layering_tree) throw "No layering tree was built for the building.";
+		return building_voxels.layering_tree->layers(building_voxels, threshold, min_num_slices_per_layer);
+	}
+
+	/**
+	 * Copy the voxels of the building in its bounding box into a local voxel block.
+	 *
+	 * @param runs			runs of all the buildings grouped by building
+	 * @param first_run		index of the first run of the building
+	 * @param last_run		index past the last run of the building
+	 * @param bbox			bounding box of the building
+	 * @return				local voxel block (255 for the voxels of the building, 0 otherwise)
+	 */
+	std::vector<cv::Mat_<uchar>> DisjointVoxelData::cropBuilding(const std::vector<Run>& runs, size_t first_run, size_t last_run, const VoxelBoundingBox& bbox) {
+		std::vector<cv::Mat_<uchar>> voxels(bbox.depth());
+		for (int h = 0; h < voxels.size(); h++) {
+			voxels[h] = cv::Mat_<uchar>::zeros(bbox.height(), bbox.width());
+		}
+		for (size_t i = first_run; i < last_run; i++) {
+			uchar* voxel_row = voxels[runs[i].z - bbox.min_z][runs[i].y - bbox.min_y] - bbox.min_x;
+			for (int x = runs[i].x0; x < runs[i].x1; x++) {
+				voxel_row[x] = 255;
 			}
 		}
-
-		return bottom_building_layers;
+		return voxels;
 	}
 
 	/**
 	 * Construct a graph structure of the building.
 	 * Each connected component in the slice will be a node of the graph. Too small contours will be discarded at this moment.
+	 * The slices are clustered in the local coordinates of the bounding box, and the voxels of each node are
+	 * stored as a bit mask over its bounding rectangle in the coordinates of the whole volume.
+	 * The nodes and the edges are first collected in one pass over the slices, the noisy nodes are marked as removed,
+	 * and then the remaining nodes are compacted into the node arrays and the adjacency arrays of the building.
+	 *
+	 * @param voxels		local voxel block of the building cropped by its bounding box
+	 * @param building_id	building id
+	 * @param bbox			bounding box of the building
+	 * @param width			width of the whole volume
+	 * @param height		height of the whole volume
 	 */
-	VoxelBuilding DisjointVoxelData::constructGraph(const std::vector<cv::Mat_<short>>& building_clustering, int building_id) {
-		VoxelBuilding building_voxels(building_id);
-
-		std::vector<std::shared_ptr<VoxelNode>> all_nodes;
-
-		// initialize the clustering
-		std::vector<cv::Mat_<int>> clustering(building_clustering.size());
-		for (int h = 0; h < building_clustering.size(); h++) {
-			clustering[h] = cv::Mat_<int>(building_clustering[h].size(), -1);
-		}
-
-		// perform 3D dfs to cluster the voxel data
-		int cluster_id = 0;
-		int max_voxel_count = 0;
-		std::vector<int> voxel_counts;	// this array stores the number of voxels for each cluster.
-		for (int h = 0; h < building_clustering.size(); h++) {
-			std::vector<std::shared_ptr<VoxelNode>> voxel_nodes_in_slice;
-			int max_voxel_count = 0;
+	VoxelBuilding DisjointVoxelData::constructGraph(const std::vector<cv::Mat_<uchar>>& voxels, int building_id, const VoxelBoundingBox& bbox, int width, int height) {
+		int num_slices = voxels.size();
+
+		// Cluster the voxels slice by slice. Only the clustering of the current slice and the one beneath is kept.
+		std::vector<int> voxel_counts;
+		std::vector<cv::Rect> rects;
+		std::vector<BinaryMask> masks;
+		std::vector<uint32_t> slice_offsets(1, 0);
+		std::vector<std::pair<uint32_t, uint32_t>> edges;	// pairs of (parent, child) in the order of the children
+		cv::Mat_<int> lower_clustering;
+		for (int h = 0; h < num_slices; h++) {
+			cv::Mat_<int> clustering(voxels[h].size(), -1);
 
 			// find connected components
-			for (int r = 0; r < building_clustering[h].rows; r++) {
-				for (int c = 0; c < building_clustering[h].cols; c++) {
-					if (building_clustering[h](r, c) == building_id && clustering[h](r, c) == -1) {
-						// create a voxel node
-						std::shared_ptr<VoxelNode> voxel_node(new VoxelNode(cluster_id, h));
-						all_nodes.push_back(voxel_node);
-						voxel_nodes_in_slice.push_back(voxel_node);
-
-						voxel_node->voxel_count = clusterBuilding(building_clustering[h], building_id, clustering, r, c, h, cluster_id, all_nodes);
-						int max_voxel_count = std::max(max_voxel_count, voxel_node->voxel_count);
-
-						// extract contour
-						voxel_node->contour = getPolygonFromCluster(clustering[h], cluster_id);
-						convertCoordinatesOfPolygon(voxel_node->contour, clustering[0].cols, clustering[0].rows);
-
-						cluster_id++;
+			for (int r = 0; r < voxels[h].rows; r++) {
+				for (int c = 0; c < voxels[h].cols; c++) {
+					if (voxels[h](r, c) && clustering(r, c) == -1) {
+						int cluster_id = voxel_counts.size();
+						cv::Rect rect;
+						voxel_counts.push_back(clusterBuilding(voxels[h], lower_clustering, clustering, r, c, cluster_id, edges, rect));
+
+						// keep the voxels as a bit mask
+						masks.push_back(BinaryMask(rect.width, rect.height));
+						for (int r2 = 0; r2 < rect.height; r2++) {
+							const int* cluster_row = clustering[rect.y + r2] + rect.x;
+							for (int c2 = 0; c2 < rect.width; c2++) {
+								if (cluster_row[c2] == cluster_id) masks.back().set(c2, r2);
+							}
+						}
+						rects.push_back(rect + cv::Point(bbox.min_x, bbox.min_y));
 					}
 				}
 			}
 
-			building_voxels.node_stack.push_back(voxel_nodes_in_slice);
+			slice_offsets.push_back(voxel_counts.size());
+			lower_clustering = clustering;
+		}
+
+		int num_nodes = voxel_counts.size();
+		std::vector<uchar> removed(num_nodes, 0);
+
+		// the parent edges of node v are edges[parent_offsets[v]] to edges[parent_offsets[v + 1] - 1]
+		std::vector<uint32_t> parent_offsets(num_nodes + 1, 0);
+		for (int i = 0; i < edges.size(); i++) {
+			parent_offsets[edges[i].second + 1]++;
+		}
+		for (int i = 0; i < num_nodes; i++) {
+			parent_offsets[i + 1] += parent_offsets[i];
 		}
 
 		// Find the height where the voxel count sum is the largest
+		std::vector<int> voxel_count_sums(num_slices, 0);
 		int max_voxel_count_sum = 0;
 		int max_voxel_count_height = -1;
-		for (int i = 0; i < building_voxels.node_stack.size(); i++) {
-			int voxel_count_sum = building_voxels.voxelCountSum(i);
-			if (voxel_count_sum > max_voxel_count_sum) {
-				max_voxel_count_sum = voxel_count_sum;
-				max_voxel_count_height = i;
+		for (int z = 0; z < num_slices; z++) {
+			for (uint32_t node = slice_offsets[z]; node < slice_offsets[z + 1]; node++) {
+				voxel_count_sums[z] += voxel_counts[node];
+			}
+			if (voxel_count_sums[z] > max_voxel_count_sum) {
+				max_voxel_count_sum = voxel_count_sums[z];
+				max_voxel_count_height = z;
 			}
 		}
 
 		// Start scanning downward to find the noisy slices at the bottom
-		for (int i = max_voxel_count_height - 1; i >= 0; i--) {
-			int voxel_count_sum = building_voxels.voxelCountSum(i);
-			if (voxel_count_sum < max_voxel_count_sum * 0.5) {
-				// remove the noisy small bottom slices
-				building_voxels.node_stack.erase(building_voxels.node_stack.begin(), building_voxels.node_stack.begin() + i + 1);
-
-				// clear the parent edges
-				for (auto voxel_node : building_voxels.node_stack[0]) {
-					voxel_node->parents.clear();
+		int bottom_slice = 0;
+		for (int z = max_voxel_count_height - 1; z >= 0; z--) {
+			if (voxel_count_sums[z] < max_voxel_count_sum * 0.5) {
+				// remove the noisy small bottom slices, so that the nodes in the new bottom slice do not have parents
+				bottom_slice = z + 1;
+				for (uint32_t node = 0; node < slice_offsets[bottom_slice]; node++) {
+					removed[node] = 1;
 				}
-
 				break;
 			}
 		}
 
-		// remove relatively small contours in each slice
-		for (int z = 0; z < building_voxels.node_stack.size(); z++) {
-			if (building_voxels.node_stack[z].size() == 0) continue;
-
+		// Remove relatively small contours in each slice.
+		// The nodes whose parents are all removed are also removed.
+		for (int z = bottom_slice; z < num_slices; z++) {
 			int max_area = 0;
-			for (int i = 0; i < building_voxels.node_stack[z].size(); i++) {
-				max_area = std::max(max_area, building_voxels.node_stack[z][i]->voxel_count);
+			for (uint32_t node = slice_offsets[z]; node < slice_offsets[z + 1]; node++) {
+				if (z > bottom_slice && parent_offsets[node] < parent_offsets[node + 1]) {
+					bool orphan = true;
+					for (uint32_t i = parent_offsets[node]; i < parent_offsets[node + 1]; i++) {
+						if (!removed[edges[i].first]) orphan = false;
+					}
+					if (orphan) removed[node] = 1;
+				}
+				if (!removed[node]) max_area = std::max(max_area, voxel_counts[node]);
 			}
 
-			for (int i = building_voxels.node_stack[z].size() - 1; i >= 0; i--) {
-				if (building_voxels.node_stack[z][i]->voxel_count < max_area * 0.1) {
-					building_voxels.removeNode(z, i);
-				}
+			for (uint32_t node = slice_offsets[z]; node < slice_offsets[z + 1]; node++) {
+				if (voxel_counts[node] < max_area * 0.1) removed[node] = 1;
 			}
 		}
 
-		// Convert the graph to tree for now by removing extra parent nodes.
+		// compact the remaining nodes
+		VoxelBuilding building_voxels(building_id);
+		building_voxels.bbox = bbox;
+		building_voxels.volume_size = cv::Size(width, height);
+		std::vector<uint32_t> new_ids(num_nodes, 0);
+		building_voxels.slice_offsets.push_back(0);
+		for (int z = bottom_slice; z < num_slices; z++) {
+			for (uint32_t node = slice_offsets[z]; node < slice_offsets[z + 1]; node++) {
+				if (removed[node]) continue;
+				new_ids[node] = building_voxels.heights.size();
+				building_voxels.heights.push_back(bbox.min_z + z);
+				building_voxels.voxel_counts.push_back(voxel_counts[node]);
+				building_voxels.rects.push_back(rects[node]);
+				building_voxels.masks.push_back(std::move(masks[node]));
+			}
+			building_voxels.slice_offsets.push_back(building_voxels.heights.size());
+		}
+
+		// Convert the graph to tree for now by keeping only the largest parent of each node (the smallest id for a tie).
+		// The child edges are kept as they are, so that the layering visits the same children as before.
 		// This should work for now, but the graph structure may be desired in the future.
-		for (int z = 1; z < building_voxels.node_stack.size(); z++) {
-			for (int i = 0; i < building_voxels.node_stack[z].size(); i++) {
-				if (building_voxels.node_stack[z][i]->parents.size() > 1) {
-					int max_area = 0;
-					std::shared_ptr<VoxelNode> max_parent_node;
-					for (auto it = building_voxels.node_stack[z][i]->parents.begin(); it != building_voxels.node_stack[z][i]->parents.end(); it++) {
-						if (it->first->voxel_count > max_area) {
-							max_area = it->first->voxel_count;
-							max_parent_node = it->first;
-						}
-					}
+		std::vector<std::pair<uint32_t, uint32_t>> parent_edges;
+		std::vector<std::pair<uint32_t, uint32_t>> child_edges;
+		for (uint32_t node = slice_offsets[bottom_slice]; node < num_nodes; node++) {
+			if (removed[node]) continue;
 
-					building_voxels.node_stack[z][i]->parents.clear();
-					building_voxels.node_stack[z][i]->parents[max_parent_node] = true;
+			int max_area = 0;
+			uint32_t max_parent_node = 0;
+			for (uint32_t i = parent_offsets[node]; i < parent_offsets[node + 1]; i++) {
+				uint32_t parent_node = edges[i].first;
+				if (removed[parent_node]) continue;
+				child_edges.push_back(std::make_pair(new_ids[parent_node], new_ids[node]));
+				if (voxel_counts[parent_node] > max_area || (voxel_counts[parent_node] == max_area && parent_node < max_parent_node)) {
+					max_area = voxel_counts[parent_node];
+					max_parent_node = parent_node;
 				}
 			}
+			if (max_area > 0) parent_edges.push_back(std::make_pair(new_ids[node], new_ids[max_parent_node]));
 		}
+		building_voxels.setEdges(parent_edges, child_edges);
+
+		// The merge tree is built here rather than by the first layering, so that the buildings can be layered concurrently.
+		building_voxels.layering_tree = std::make_shared<LayeringTree>(building_voxels);
 
 		return building_voxels;
 	}
 
 	/**
-	 * Traverse the connected voxels with value greater than the threshold and are not visited yet.
+	 * Label the 6-connected components of the set voxels.
+	 * This is a two-pass labeling over the slices row by row. The first pass assigns provisional labels
+	 * and merges the labels of the left, upper, and lower-slice neighbors by union-find.
+	 * Only the labels of the current slice and the one beneath are kept as images, and the voxels are recorded as
+	 * horizontal runs with the provisional label of their first voxel. The second pass replaces the labels with
+	 * the final building ids, which are numbered in the scan order of the first voxel of each component,
+	 * and groups the runs by building in the scan order.
 	 *
-	 * @param voxel_data			voxel data
-	 * @param building_clustering	save the clustering information
-	 * @param r						row of current voxel
-	 * @param c						column of current voxel
-	 * @param h						height of current voxel
-	 * @param building_id			building id
-	 * @param voxel_value_threshold	threshold
-	 * @return						the voxel count of the connected component
+	 * @param volume		bit-packed voxel volume
+	 * @param runs			the runs of the voxels grouped by building
+	 * @param run_offsets	the runs of building i are runs[run_offsets[i]] to runs[run_offsets[i + 1] - 1]
+	 * @param voxel_counts	the voxel count of each connected component
+	 * @param bboxes		the bounding box of each connected component
+	 * @return				the number of connected components
 	 */
-	int DisjointVoxelData::disjointBuilding(const std::vector<cv::Mat_<uchar>>&voxel_data, std::vector<cv::Mat_<short>>& building_clustering, int r, int c, int h, int building_id, int voxel_value_threshold) {
-		const std::vector<std::pair<int, std::pair<int, int>>> dirs = { { 0, { 1, 0 } }, { 0, { -1, 0 } }, { 0, { 0, 1 } }, { 0, { 0, -1 } }, { 1, { 0, 0 } }, { -1, { 0, 0 } } };
-
-		int R = voxel_data[0].rows;
-		int C = voxel_data[0].cols;
-
-		std::queue<std::pair<int, std::pair<int, int>>> Q;
-		Q.push({ h, { r, c } });
-
-		building_clustering[h](r, c) = building_id;
-		int count = 0;
+	int DisjointVoxelData::labelBuildings(const VoxelVolume& volume, std::vector<Run>& runs, std::vector<size_t>& run_offsets, std::vector<int>& voxel_counts, std::vector<VoxelBoundingBox>& bboxes) {
+		cv::Mat_<int> labels_image(volume.getHeight(), volume.getWidth(), -1);
+		cv::Mat_<int> lower_labels(volume.getHeight(), volume.getWidth(), -1);
+
+		// first pass: provisional labels
+		UnionFind labels;
+		std::vector<Run> scan_runs;
+		std::vector<int> run_labels;	// the provisional label of each run
+		for (int h = 0; h < volume.getDepth(); h++) {
+			labels_image.setTo(-1);
+			for (int r = 0; r < volume.getHeight(); r++) {
+				const uint64_t* voxel_row = volume.row(h, r);
+				int* label_row = labels_image[r];
+				const int* upper_row = r > 0 ? labels_image[r - 1] : NULL;
+				const int* lower_row = h > 0 ? lower_labels[r] : NULL;
+
+				for (int c = 0; c < volume.getWidth(); c++) {
+					uint64_t word = voxel_row[c >> 6];
+					if (word == 0) {
+						// skip the empty 64 voxels at once
+						c |= 63;
+						continue;
+					}
+					if (!((word >> (c & 63)) & 1)) continue;
 
-		while (!Q.empty()) {
-			int h = Q.front().first;
-			int r = Q.front().second.first;
-			int c = Q.front().second.second;
-			Q.pop();
-			count++;
+					int label = c > 0 ? label_row[c - 1] : -1;
+					bool continued_run = label >= 0;
 
-			for (int i = 0; i < dirs.size(); i++) {
-				int h2 = h + dirs[i].first;
-				int r2 = r + dirs[i].second.first;
-				int c2 = c + dirs[i].second.second;
+					// Inside a run, the neighbor that has the same label as the one of the previous voxel was already merged.
+					if (upper_row != NULL && upper_row[c] >= 0 && !(continued_run && upper_row[c - 1] == upper_row[c])) {
+						if (label < 0) label = upper_row[c];
+						else labels.merge(label, upper_row[c]);
+					}
+					if (lower_row != NULL && lower_row[c] >= 0 && !(continued_run && lower_row[c - 1] == lower_row[c])) {
+						if (label < 0) label = lower_row[c];
+						else labels.merge(label, lower_row[c]);
+					}
+					if (label < 0) label = labels.add();
 
-				if (r2 >= 0 && r2 < R && c2 >= 0 && c2 < C && h2 >= 0 && h2 < voxel_data.size() && voxel_data[h2](r2, c2) > voxel_value_threshold && building_clustering[h2](r2, c2) == -1) {
-					building_clustering[h2](r2, c2) = building_id;
-					Q.push({ h2, { r2, c2 } });
+					label_row[c] = label;
+					if (continued_run) {
+						scan_runs.back().x1 = c + 1;
+					}
+					else {
+						Run run;
+						run.z = h;
+						run.y = r;
+						run.x0 = c;
+						run.x1 = c + 1;
+						scan_runs.push_back(run);
+						run_labels.push_back(label);
+					}
 				}
 			}
+			cv::swap(labels_image, lower_labels);
+		}
+		labels_image.release();
+		lower_labels.release();
+
+		// second pass: final building ids
+		std::vector<int> ids;
+		int num_buildings = labels.flatten(ids);
+		std::vector<int>().swap(labels.parent);
+		voxel_counts.assign(num_buildings, 0);
+		bboxes.assign(num_buildings, VoxelBoundingBox());
+		run_offsets.assign(num_buildings + 1, 0);
+		for (size_t i = 0; i < scan_runs.size(); i++) {
+			int id = ids[run_labels[i]];
+			run_labels[i] = id;
+			voxel_counts[id] += scan_runs[i].x1 - scan_runs[i].x0;
+			bboxes[id].addVoxel(scan_runs[i].x0, scan_runs[i].y, scan_runs[i].z);
+			bboxes[id].addVoxel(scan_runs[i].x1 - 1, scan_runs[i].y, scan_runs[i].z);
+			run_offsets[id + 1]++;
+		}
+		std::vector<int>().swap(ids);
+		for (int i = 0; i < num_buildings; i++) {
+			run_offsets[i + 1] += run_offsets[i];
 		}
 
-		return count;
+		// group the runs by building
+		runs.resize(scan_runs.size());
+		std::vector<size_t> next_runs(run_offsets.begin(), run_offsets.end() - 1);
+		for (size_t i = 0; i < scan_runs.size(); i++) {
+			runs[next_runs[run_labels[i]]++] = scan_runs[i];
+		}
+
+		return num_buildings;
 	}
 
 	/**
-	 * Traverse the voxels with specified building id in the slice and are not visited yet.
+	 * Traverse the voxels of the building in the slice that are not visited yet,
+	 * and add the edges from the clusters of the overlapping voxels in the slice beneath.
 	 *
-	 * @param building_clustering	building clustering data (only the voxels with value of building_id will be traversed)
-	 * @param building_id			building id
-	 * @param clustering			save the clustering information
-	 * @param r						row of current voxel
-	 * @param c						column of current voxel
-	 * @param h						height of current voxel
-	 * @param cluster_id			current cluster id
-	 * @param voxel_nodes			generated voxel nodes
-	 * @return						the voxel count of the connected component
+	 * @param voxels			slice of the local voxel block (only the non-zero voxels will be traversed)
+	 * @param lower_clustering	clustering information of the slice beneath (empty for the bottom slice)
+	 * @param clustering		save the clustering information of the slice
+	 * @param r					row of the first voxel
+	 * @param c					column of the first voxel
+	 * @param cluster_id		current cluster id
+	 * @param edges				the pairs of (parent, child) for the current cluster are added without duplicates
+	 * @param rect				bounding rectangle of the connected component
+	 * @return					the voxel count of the connected component
 	 */
-	int DisjointVoxelData::clusterBuilding(const cv::Mat_<short>& building_clustering, int building_id, std::vector<cv::Mat_<int>>&clustering, int r, int c, int h, int cluster_id, std::vector<std::shared_ptr<VoxelNode>>& voxel_nodes) {
+	int DisjointVoxelData::clusterBuilding(const cv::Mat_<uchar>& voxels, const cv::Mat_<int>& lower_clustering, cv::Mat_<int>& clustering, int r, int c, int cluster_id, std::vector<std::pair<uint32_t, uint32_t>>& edges, cv::Rect& rect) {
 		const std::vector<std::pair<int, int>> dirs = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
 
-		int R = building_clustering.rows;
-		int C = building_clustering.cols;
+		int R = voxels.rows;
+		int C = voxels.cols;
 
 		std::queue<std::pair<int, int>> Q;
 		Q.push({ r, c });
 
-		clustering[h](r, c) = cluster_id;
+		clustering(r, c) = cluster_id;
 		int count = 0;
+		size_t first_edge = edges.size();
+		int last_parent_cluster_id = -1;
+		int min_x = c;
+		int min_y = r;
+		int max_x = c;
+		int max_y = r;
 
 		while (!Q.empty()) {
 			int r = Q.front().first;
 			int c = Q.front().second;
 			Q.pop();
 			count++;
-			if (h > 0 && clustering[h - 1](r, c) >= 0) {
+			min_x = std::min(min_x, c);
+			min_y = std::min(min_y, r);
+			max_x = std::max(max_x, c);
+			max_y = std::max(max_y, r);
+			if (!lower_clustering.empty() && lower_clustering(r, c) >= 0 && lower_clustering(r, c) != last_parent_cluster_id) {
 				// update the edges
-				int parent_cluster_id = clustering[h - 1](r, c);
-				voxel_nodes[parent_cluster_id]->children[voxel_nodes[cluster_id]] = true;
-				voxel_nodes[cluster_id]->parents[voxel_nodes[parent_cluster_id]] = true;
+				last_parent_cluster_id = lower_clustering(r, c);
+				bool found = false;
+				for (size_t i = first_edge; i < edges.size(); i++) {
+					if (edges[i].first == last_parent_cluster_id) found = true;
+				}
+				if (!found) edges.push_back(std::make_pair((uint32_t)last_parent_cluster_id, (uint32_t)cluster_id));
 			}
 
 			for (int i = 0; i < dirs.size(); i++) {
 				int r2 = r + dirs[i].first;
 				int c2 = c + dirs[i].second;
 
-				if (r2 >= 0 && r2 < R && c2 >= 0 && c2 < C && building_clustering(r2, c2) == building_id && clustering[h](r2, c2) == -1) {
-					clustering[h](r2, c2) = cluster_id;
+				if (r2 >= 0 && r2 < R && c2 >= 0 && c2 < C && voxels(r2, c2) && clustering(r2, c2) == -1) {
+					clustering(r2, c2) = cluster_id;
 					Q.push({ r2, c2 });
 				}
 			}
 		}
 
-		return count;
-	}
+		rect = cv::Rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
 
-	cv::Mat_<uchar> DisjointVoxelData::getSliceOfCluster(const cv::Mat_<int>& clustering, int cluster_id, int& min_x, int& min_y, int& max_x, int& max_y) {
-		min_x = std::numeric_limits<int>::max();
-		min_y = std::numeric_limits<int>::max();
-		max_x = 0;
-		max_y = 0;
-
-		bool found = false;
-
-		cv::Mat_<uchar> ans = cv::Mat_<uchar>::zeros(clustering.size());
-		for (int r = 0; r < clustering.rows; r++) {
-			for (int c = 0; c < clustering.cols; c++) {
-				if (clustering(r, c) == cluster_id) {
-					ans(r, c) = 255;
-					min_x = std::min(min_x, c);
-					min_y = std::min(min_y, r);
-					max_x = std::max(max_x, c);
-					max_y = std::max(max_y, r);
-					found = true;
-				}
-			}
-		}
-
-		if (!found) throw "No specified cluster was found.";
-
-		return ans;
-	}
-
-	Polygon DisjointVoxelData::getPolygonFromCluster(const cv::Mat_<int>& clustering, int cluster_id) {
-		int min_x, min_y, max_x, max_y;
-		cv::Mat_<uchar> slice = getSliceOfCluster(clustering, cluster_id, min_x, min_y, max_x, max_y);
-		cv::Mat_<uchar> roi_slice(slice, cv::Rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1));
-		std::vector<Polygon> polygons = findContours(roi_slice, true);
-		for (int i = 0; i < polygons.size(); i++) {
-			polygons[i].translate(min_x, min_y);
-		}
-
-		return polygons[0];
-	}
-
-	/**
-	 * Convert the coordinates of polygon such that the center of the slice will be the origin
-	 * and the y direction is upward.
-	 *
-	 * @param polygon	polygon
-	 * @param width		width of the slice
-	 * @param height	height of the slice
-	 */
-	void DisjointVoxelData::convertCoordinatesOfPolygon(Polygon& polygon, int width, int height) {
-		// convert the polygon coordinates to the world coordinate system
-		for (int i = 0; i < polygon.contour.size(); i++) {
-			polygon.contour[i].x = polygon.contour[i].x - width / 2;
-			polygon.contour[i].y = height / 2 - polygon.contour[i].y;
-		}
-		for (auto& hole : polygon.holes) {
-			for (int j = 0; j < hole.size(); j++) {
-				hole[j].x = hole[j].x - width / 2;
-				hole[j].y = height / 2 - hole[j].y;
-			}
-		}
-	}
-	
-	/**
-	 * Layer the building.
-	 */
-	std::vector<std::shared_ptr<BuildingLayer>> DisjointVoxelData::layeringBuilding(int building_id, const std::shared_ptr<VoxelNode>& voxel_node, float threshold, int min_num_slices_per_layer) {
-		// create the bottom layer
-		std::shared_ptr<BuildingLayer> bottom_building_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, voxel_node->height, voxel_node->height + 1)));
-		bottom_building_layer->raw_footprints.push_back({ voxel_node->contour });
-
-		// initialize queue
-		std::queue<std::pair<std::shared_ptr<VoxelNode>, std::shared_ptr<BuildingLayer>>> Q;
-		Q.push({ voxel_node, bottom_building_layer });
-
-		while (!Q.empty()) {
-			std::shared_ptr<VoxelNode> voxel_node = Q.front().first;
-			std::shared_ptr<BuildingLayer> layer = Q.front().second;
-			Q.pop();
-
-			std::vector<Polygon> cur_polygon;
-			cur_polygon.push_back(voxel_node->contour);
-
-			std::unordered_map<std::shared_ptr<VoxelNode>, bool> child_nodes = voxel_node->children;
-
-			while (child_nodes.size() > 0) {
-				std::vector<Polygon> child_polygons;
-				for (auto it = child_nodes.begin(); it != child_nodes.end(); it++) {
-					child_polygons.push_back(it->first->contour);
-				}
-
-				if (calculateIOU(cur_polygon, child_polygons) >= threshold) {
-					// merge nodes
-					std::unordered_map<std::shared_ptr<VoxelNode>, bool> old_children = child_nodes;
-					child_nodes.clear();
-					layer->raw_footprints.push_back({});
-					for (auto it = old_children.begin(); it != old_children.end(); it++) {
-						for (auto it2 = it->first->children.begin(); it2 != it->first->children.end(); it2++) {
-							child_nodes[it2->first] = true;
-						}
-						layer->raw_footprints.back().push_back(it->first->contour);
-						layer->top_height = it->first->height + 1;
-					}
-				}
-				else {
-					// create new layers
-					for (auto it = child_nodes.begin(); it != child_nodes.end(); it++) {
-						std::shared_ptr<BuildingLayer> child_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, it->first->height, it->first->height + 1)));
-						child_layer->raw_footprints.push_back({ it->first->contour });
-						layer->children.push_back(child_layer);
-						Q.push({ it->first, child_layer });
-					}
-
-					break;
-				}
-			}
-		}
-
-		std::shared_ptr<BuildingLayer> root_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, -1, 0)));
-		root_layer->children.push_back(bottom_building_layer);
-
-		// Merge too thin layer to the one beneath
-		removeThinLayers(root_layer, min_num_slices_per_layer);
-
-		return root_layer->children;
-	}
-
-	/**
-	* Remove too thin layer by merging it to the one beneath.
-	*
-	* @param layer		the bottom layer of the building
-	*/
-	void DisjointVoxelData::removeThinLayers(std::shared_ptr<BuildingLayer> layer, int min_num_slices_per_layer) {
-		for (int i = layer->children.size() - 1; i >= 0; i--) {
-			removeThinLayers(layer->children[i], min_num_slices_per_layer);
-
-			if (layer->children[i]->top_height - layer->children[i]->bottom_height < min_num_slices_per_layer) {
-				if (layer->children[i]->children.size() == 0) {
-					// remove too thin layer if it does not have any children.
-					layer->children.erase(layer->children.begin() + i);
-				}
-				else {
-					// merge the child with its children
-					std::shared_ptr<BuildingLayer> child_layer = layer->children[i];
-					layer->children.erase(layer->children.begin() + i);
-					for (auto grandchild_layer : child_layer->children) {
-						layer->children.insert(layer->children.begin() + i, grandchild_layer);
-						grandchild_layer->bottom_height = child_layer->bottom_height;
-						//grandchild_layer->raw_footprints.insert(grandchild_layer->raw_footprints.begin(), child_layer->raw_footprints.begin(), child_layer->raw_footprints.end());
-
-						// add the bottom slice of the grandchild layer for N times, where N is the number of the slices in the child layer
-						for (int j = 0; j < child_layer->raw_footprints.size(); j++) {
-							grandchild_layer->raw_footprints.insert(grandchild_layer->raw_footprints.begin(), grandchild_layer->raw_footprints[0]);
-						}
-					}
-				}
-			}
-		}
+		return count;
 	}
 
 }
\ No newline at end of file
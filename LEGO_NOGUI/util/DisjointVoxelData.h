@@ -6,26 +6,37 @@
 #include "BuildingLayer.h"
 #include "ContourUtils.h"
 #include "VoxelBuilding.h"
+#include "VoxelVolume.h"
+#include "ComponentStream.h"
 
 namespace util {
 
 	class DisjointVoxelData {
+	private:
+		/**
+		 * Voxels from x0 to x1 - 1 in row y of slice z.
+		 */
+		struct Run {
+			int z;
+			int y;
+			int x0;
+			int x1;
+		};
+
 	protected:
 		DisjointVoxelData();
 
 	public:
 		static std::vector<VoxelBuilding> disjoint(const std::vector<cv::Mat_<uchar>>& voxel_data, int voxel_value_threshold = 128, float min_voxel_count_ratio = 0.1);
+		static std::vector<VoxelBuilding> disjoint(const VoxelVolume& volume, float min_voxel_count_ratio = 0.1);
+		static std::vector<VoxelBuilding> disjoint(ComponentStream& stream, float min_voxel_count_ratio = 0.1);
 		static std::vector<std::shared_ptr<BuildingLayer>> layering(const util::VoxelBuilding& building_voxels, float threshold, int min_num_slices_per_layer);
 
 	private:
-		static VoxelBuilding constructGraph(const std::vector<cv::Mat_<short>>& building_clustering, int building_id);
-		static int disjointBuilding(const std::vector<cv::Mat_<uchar>>& voxel_data, std::vector<cv::Mat_<short>>& building_clustering, int r, int c, int h, int building_id, int voxel_value_threshold);
-		static int clusterBuilding(const cv::Mat_<short>& building_clustering, int building_id, std::vector<cv::Mat_<int>>& clustering, int r, int c, int h, int cluster_id, std::vector<std::shared_ptr<VoxelNode>>& voxel_nodes);
-		static cv::Mat_<uchar> getSliceOfCluster(const cv::Mat_<int>& clustering, int cluster_id, int& min_x, int& min_y, int& max_x, int& max_y);
-		static Polygon getPolygonFromCluster(const cv::Mat_<int>& clustering, int cluster_id);
-		static void convertCoordinatesOfPolygon(Polygon& polygon, int width, int height);
-		static std::vector<std::shared_ptr<BuildingLayer>> layeringBuilding(int building_id, const std::shared_ptr<VoxelNode>& voxel_node, float threshold, int min_num_slices_per_layer);
-		static void removeThinLayers(std::shared_ptr<BuildingLayer> layer, int min_num_slices_per_layer);
+		static std::vector<cv::Mat_<uchar>> cropBuilding(const std::vector<Run>& runs, size_t first_run, size_t last_run, const VoxelBoundingBox& bbox);
+		static VoxelBuilding constructGraph(const std::vector<cv::Mat_<uchar>>& voxels, int building_id, const VoxelBoundingBox& bbox, int width, int height);
+		static int labelBuildings(const VoxelVolume& volume, std::vector<Run>& runs, std::vector<size_t>& run_offsets, std::vector<int>& voxel_counts, std::vector<VoxelBoundingBox>& bboxes);
+		static int clusterBuilding(const cv::Mat_<uchar>& voxels, const cv::Mat_<int>& lower_clustering, cv::Mat_<int>& clustering, int r, int c, int cluster_id, std::vector<std::pair<uint32_t, uint32_t>>& edges, cv::Rect& rect);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "LayeringTree.h"
+#include <queue>
+#include <algorithm>
+
+namespace util {
+
+	LayeringTree::LayeringTree(const VoxelBuilding& building_voxels) : chains(building_voxels.numNodes()), contours(building_voxels.numNodes()), extracted(building_voxels.numNodes(), 0), num_ious(0) {
+	}
+
+	/**
+	 * Cut the layers of the building at the threshold.
+	 * Similar contour of slices will be merged into one layer.
+	 *
+	 * @param building_voxels				voxel graph of the building, from which this tree was built
+	 * @param threshold						minimum IOU for merging the slices
+	 * @param min_num_slices_per_layer		thinner layers are merged to the one beneath
+	 * @return								bottom layers of the building
+	 */
+	std::vector<std::shared_ptr<BuildingLayer>> LayeringTree::layers(const VoxelBuilding& building_voxels, float threshold, int min_num_slices_per_layer) {
+		std::lock_guard<std::mutex> lock(mtx);
+		std::vector<std::shared_ptr<BuildingLayer>> bottom_building_layers;
+
+		// layer buildings
+		for (int z = 0; z < building_voxels.numSlices(); z++) {
+			for (uint32_t node = building_voxels.sliceBegin(z); node < building_voxels.sliceEnd(z); node++) {
+				if (building_voxels.parents(node).empty()) {
+					std::vector<std::shared_ptr<BuildingLayer>> layers = layersFrom(building_voxels, node, threshold, min_num_slices_per_layer);
+					bottom_building_layers.insert(bottom_building_layers.end(), layers.begin(), layers.end());
+				}
+			}
+		}
+
+		// Extract the contours of the nodes in the final layers.
+		for (int i = 0; i < bottom_building_layers.size(); i++) {
+			extractFootprints(building_voxels, bottom_building_layers[i]);
+		}
+
+		return bottom_building_layers;
+	}
+
+	/**
+	 * Calculate the IOU of the voxels of two sets of nodes in the same slice.
+	 * The bit masks of the nodes are merged into the bounding rectangle of all the nodes,
+	 * and the intersection and the union are counted word by word.
+	 *
+	 * @param building_voxels	voxel graph of the building
+	 * @param nodes1			first set of nodes
+	 * @param nodes2			second set of nodes
+	 * @return					IOU
+	 */
+	double LayeringTree::calculateVoxelIOU(const VoxelBuilding& building_voxels, const std::vector<uint32_t>& nodes1, const std::vector<uint32_t>& nodes2) {
+		cv::Rect rect = building_voxels.rects[nodes1[0]];
+		for (int i = 0; i < nodes1.size(); i++) rect |= building_voxels.rects[nodes1[i]];
+		for (int i = 0; i < nodes2.size(); i++) rect |= building_voxels.rects[nodes2[i]];
+
+		BinaryMask mask1(rect.width, rect.height);
+		for (int i = 0; i < nodes1.size(); i++) {
+			const cv::Rect& node_rect = building_voxels.rects[nodes1[i]];
+			mask1.paste(building_voxels.masks[nodes1[i]], node_rect.x - rect.x, node_rect.y - rect.y);
+		}
+
+		BinaryMask mask2(rect.width, rect.height);
+		for (int i = 0; i < nodes2.size(); i++) {
+			const cv::Rect& node_rect = building_voxels.rects[nodes2[i]];
+			mask2.paste(building_voxels.masks[nodes2[i]], node_rect.x - rect.x, node_rect.y - rect.y);
+		}
+
+		long long inter_cnt;
+		long long union_cnt;
+		BinaryMask::countIntersectionAndUnion(mask1, mask2, inter_cnt, union_cnt);
+
+		return (double)inter_cnt / union_cnt;
+	}
+
+	/**
+	 * Layer the building from the root node.
+	 * Each layer absorbs the spans of its starting node that are at or above the threshold,
+	 * and the nodes of the first span below the threshold start the child layers.
+	 * The layers keep the node ids of their raw footprints, whose contours are extracted later.
+	 */
+	std::vector<std::shared_ptr<BuildingLayer>> LayeringTree::layersFrom(const VoxelBuilding& building_voxels, uint32_t root_node, float threshold, int min_num_slices_per_layer) {
+		int building_id = building_voxels.building_id;
+
+		// create the bottom layer
+		std::shared_ptr<BuildingLayer> bottom_building_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, building_voxels.heights[root_node], building_voxels.heights[root_node] + 1)));
+		bottom_building_layer->raw_footprint_nodes.push_back({ root_node });
+
+		// initialize queue
+		std::queue<std::pair<uint32_t, std::shared_ptr<BuildingLayer>>> Q;
+		Q.push({ root_node, bottom_building_layer });
+
+		while (!Q.empty()) {
+			uint32_t node = Q.front().first;
+			std::shared_ptr<BuildingLayer> layer = Q.front().second;
+			Q.pop();
+
+			int length = mergeLength(building_voxels, node, threshold);
+			const Chain& chain = chains[node];
+
+			// merge nodes
+			for (int i = 0; i < length; i++) {
+				layer->raw_footprint_nodes.push_back(chain.spans[i]);
+				layer->top_height = building_voxels.heights[chain.spans[i][0]] + 1;
+			}
+
+			// create new layers
+			if (length < chain.spans.size()) {
+				const std::vector<uint32_t>& child_nodes = chain.spans[length];
+				for (int i = 0; i < child_nodes.size(); i++) {
+					int child_height = building_voxels.heights[child_nodes[i]];
+					std::shared_ptr<BuildingLayer> child_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, child_height, child_height + 1)));
+					child_layer->raw_footprint_nodes.push_back({ child_nodes[i] });
+					layer->children.push_back(child_layer);
+					Q.push({ child_nodes[i], child_layer });
+				}
+			}
+		}
+
+		std::shared_ptr<BuildingLayer> root_layer(std::shared_ptr<BuildingLayer>(new BuildingLayer(building_id, -1, 0)));
+		root_layer->children.push_back(bottom_building_layer);
+
+		// Merge too thin layer to the one beneath
+		removeThinLayers(root_layer, min_num_slices_per_layer);
+
+		return root_layer->children;
+	}
+
+	/**
+	 * Return the number of the spans that the layer starting at the node absorbs for the threshold.
+	 * The chain of the node is extended until its merge level goes below the threshold or the top of the building is reached.
+	 *
+	 * @param building_voxels	voxel graph of the building
+	 * @param node				starting node of the layer
+	 * @param threshold			minimum IOU for merging the slices
+	 * @return					the number of the absorbed spans
+	 */
+	int LayeringTree::mergeLength(const VoxelBuilding& building_voxels, uint32_t node, float threshold) {
+		Chain& chain = chains[node];
+
+		while (!chain.complete && (chain.merge_levels.size() == 0 || chain.merge_levels.back() >= threshold)) {
+			// the next span is the set of the children of the current top span
+			std::vector<uint32_t> next_nodes;
+			if (chain.spans.size() == 0) {
+				NodeRange children = building_voxels.children(node);
+				next_nodes.assign(children.begin(), children.end());
+			}
+			else {
+				const std::vector<uint32_t>& top_nodes = chain.spans.back();
+				for (int i = 0; i < top_nodes.size(); i++) {
+					NodeRange children = building_voxels.children(top_nodes[i]);
+					next_nodes.insert(next_nodes.end(), children.begin(), children.end());
+				}
+				std::sort(next_nodes.begin(), next_nodes.end());
+				next_nodes.erase(std::unique(next_nodes.begin(), next_nodes.end()), next_nodes.end());
+			}
+
+			if (next_nodes.size() == 0) {
+				chain.complete = true;
+				break;
+			}
+
+			double iou = calculateVoxelIOU(building_voxels, std::vector<uint32_t>(1, node), next_nodes);
+			num_ious++;
+			chain.merge_levels.push_back(chain.merge_levels.size() == 0 ? iou : std::min(chain.merge_levels.back(), iou));
+			chain.spans.push_back(next_nodes);
+		}
+
+		int length = 0;
+		while (length < chain.merge_levels.size() && chain.merge_levels[length] >= threshold) length++;
+		return length;
+	}
+
+	/**
+	 * Convert the node ids of the raw footprints of the layer and its descendants to the contours,
+	 * and select their representative contours.
+	 * The contours are extracted slice by slice. The contour of each node and the representative contours of
+	 * each distinct sequence of the raw footprints are computed only once, and are reused for the other thresholds.
+	 *
+	 * @param building_voxels	voxel graph of the building
+	 * @param layer				layer
+	 */
+	void LayeringTree::extractFootprints(const VoxelBuilding& building_voxels, std::shared_ptr<BuildingLayer> layer) {
+		const std::vector<std::vector<uint32_t>>& nodes = layer->raw_footprint_nodes;
+		layer->raw_footprints.resize(nodes.size());
+		for (int i = 0; i < nodes.size(); i++) {
+			layer->raw_footprints[i].resize(nodes[i].size());
+			for (int j = 0; j < nodes[i].size(); j++) {
+				uint32_t node = nodes[i][j];
+				if (!extracted[node]) {
+					// the contours of all the nodes in the slice are extracted by one tracing
+					int z = building_voxels.sliceOf(node);
+					std::vector<Polygon> slice_contours = building_voxels.contours(z);
+					for (int k = 0; k < slice_contours.size(); k++) {
+						contours[building_voxels.sliceBegin(z) + k] = slice_contours[k];
+						extracted[building_voxels.sliceBegin(z) + k] = 1;
+					}
+				}
+				layer->raw_footprints[i][j] = contours[node];
+			}
+		}
+
+		// The raw footprints of a layer are the spans of its starting node, which may be preceded by copies of
+		// the starting node by removeThinLayers. Thus, they are identified by the starting node, the number of the
+		// copies, and the number of the footprints.
+		int num_copies = 1;
+		while (num_copies < nodes.size() && nodes[num_copies] == nodes[0]) num_copies++;
+		std::tuple<uint32_t, int, int> key(nodes[0][0], num_copies, (int)nodes.size());
+		auto it = representative_contours.find(key);
+		if (it == representative_contours.end()) {
+			representative_contours[key] = layer->selectRepresentativeContours();
+		}
+		else {
+			layer->footprints = it->second;
+			layer->presentativeContours = it->second;
+		}
+
+		for (int i = 0; i < layer->children.size(); i++) {
+			extractFootprints(building_voxels, layer->children[i]);
+		}
+	}
+
+	/**
+	* Remove too thin layer by merging it to the one beneath.
+	*
+	* @param layer		the bottom layer of the building
+	*/
+	void LayeringTree::removeThinLayers(std::shared_ptr<BuildingLayer> layer, int min_num_slices_per_layer) {
+		for (int i = layer->children.size() - 1; i >= 0; i--) {
+			removeThinLayers(layer->children[i], min_num_slices_per_layer);
+
+			if (layer->children[i]->top_height - layer->children[i]->bottom_height < min_num_slices_per_layer) {
+				if (layer->children[i]->children.size() == 0) {
+					// remove too thin layer if it does not have any children.
+					layer->children.erase(layer->children.begin() + i);
+				}
+				else {
+					// merge the child with its children
+					std::shared_ptr<BuildingLayer> child_layer = layer->children[i];
+					layer->children.erase(layer->children.begin() + i);
+					for (auto grandchild_layer : child_layer->children) {
+						layer->children.insert(layer->children.begin() + i, grandchild_layer);
+						grandchild_layer->bottom_height = child_layer->bottom_height;
+						//grandchild_layer->raw_footprints.insert(grandchild_layer->raw_footprints.begin(), child_layer->raw_footprints.begin(), child_layer->raw_footprints.end());
+
+						// add the bottom slice of the grandchild layer for N times, where N is the number of the slices in the child layer
+						for (int j = 0; j < child_layer->raw_footprint_nodes.size(); j++) {
+							grandchild_layer->raw_footprint_nodes.insert(grandchild_layer->raw_footprint_nodes.begin(), grandchild_layer->raw_footprint_nodes[0]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include "BuildingLayer.h"
+#include "ContourUtils.h"
+#include "VoxelBuilding.h"
+
+namespace util {
+
+	/**
+	 * Merge tree of the slices of a building, from which the layers for any layering threshold can be cut.
+	 *
+	 * A layer that starts at a node absorbs the children of its top slice as long as the IOU between the
+	 * starting node and the absorbed slice is at least the threshold. Since the IOU does not depend on the threshold,
+	 * the sequence of the absorbed spans and the running minimum of their IOUs is stored for each starting node.
+	 * The running minimum is the merge level of the span, and it only decreases upward, so the layer for a threshold
+	 * is found by a linear walk along the sequence. The sequences are extended lazily, and each IOU is computed only once.
+	 *
+	 * The contours of the nodes and the representative contours of the layers are also cached, so that
+	 * a sweep of the layering threshold costs about one layering pass.
+	 * The caches are guarded by a mutex, so the copies of a building that share the tree can be layered from multiple threads.
+	 */
+	class LayeringTree {
+	private:
+		/**
+		 * Spans absorbed by the layer that starts at a node.
+		 */
+		struct Chain {
+			std::vector<std::vector<uint32_t>> spans;	// nodes of each absorbed slice
+			std::vector<double> merge_levels;			// running minimum of the IOUs
+			bool complete;								// true if the top of the building was reached
+
+			Chain() : complete(false) {}
+		};
+
+		std::vector<Chain> chains;
+		std::vector<Polygon> contours;
+		std::vector<uchar> extracted;
+		std::map<std::tuple<uint32_t, int, int>, std::vector<Polygon>> representative_contours;
+		long long num_ious;
+		std::mutex mtx;
+
+	public:
+		LayeringTree(const VoxelBuilding& building_voxels);
+
+		std::vector<std::shared_ptr<BuildingLayer>> layers(const VoxelBuilding& building_voxels, float threshold, int min_num_slices_per_layer);
+		long long numIOUs() const { return num_ious; }
+
+		static double calculateVoxelIOU(const VoxelBuilding& building_voxels, const std::vector<uint32_t>& nodes1, const std::vector<uint32_t>& nodes2);
+
+	private:
+		std::vector<std::shared_ptr<BuildingLayer>> layersFrom(const VoxelBuilding& building_voxels, uint32_t root_node, float threshold, int min_num_slices_per_layer);
+		int mergeLength(const VoxelBuilding& building_voxels, uint32_t node, float threshold);
+		void extractFootprints(const VoxelBuilding& building_voxels, std::shared_ptr<BuildingLayer> layer);
+		static void removeThinLayers(std::shared_ptr<BuildingLayer> layer, int min_num_slices_per_layer);
+	};
+
+}
@@ -0,0 +1,20 @@
+#include "Log.h"
+#include <cstdio>
+
+namespace util {
+
+	bool Log::enabled = false;
+
+	// a stream without a buffer discards all the output
+	std::ostream Log::null_stream(NULL);
+
+	/**
+	 * Enable or disable the progress messages.
+	 * The stdout is unbuffered while the log is enabled, so that the messages of a long run are shown immediately.
+	 */
+	void Log::setEnabled(bool enabled) {
+		Log::enabled = enabled;
+		if (enabled) setbuf(stdout, NULL);
+	}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+
+namespace util {
+
+	/**
+	 * Switch of the progress messages of the simplification.
+	 * The messages are printed to stdout only if the log is enabled by the application, e.g., the command line tool,
+	 * so that the simplification used as a library does not write to the stdout of the host process.
+	 */
+	class Log {
+	private:
+		static bool enabled;
+		static std::ostream null_stream;
+
+	protected:
+		Log() {}
+
+	public:
+		static void setEnabled(bool enabled);
+		static bool isEnabled() { return enabled; }
+		static std::ostream& out() { return enabled ? std::cout : null_stream; }
+	};
+
+}
@@ -2,12 +2,179 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <clocale>
 #include "ContourUtils.h"
 
+// std::to_chars of floating-point values needs C++17 and a recent standard library (GCC 11, Visual Studio 2019 16.4).
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define LEGO_FLOAT_TO_CHARS
+#endif
+
 namespace util {
 
 	namespace obj {
 
+		namespace {
+
+			struct Point2fLess {
+				bool operator()(const cv::Point2f& p1, const cv::Point2f& p2) const {
+					return std::tie(p1.x, p1.y) < std::tie(p2.x, p2.y);
+				}
+			};
+
+			struct Point3fLess {
+				bool operator()(const cv::Point3f& p1, const cv::Point3f& p2) const {
+					return std::tie(p1.x, p1.y, p1.z) < std::tie(p2.x, p2.y, p2.z);
+				}
+			};
+
+			/**
+			 * Return the 1-based index of the value in the list, and append it if it is not in the list yet.
+			 * NaN cannot be ordered in the map, so such a value always gets a new index.
+			 */
+			template<typename T, typename Less>
+			int findOrAdd(std::map<T, int, Less>& index_map, std::vector<T>& values, const T& value) {
+				if (!(value == value)) {
+					values.push_back(value);
+					return values.size();
+				}
+
+				auto it = index_map.find(value);
+				if (it != index_map.end()) return it->second;
+
+				values.push_back(value);
+				index_map[value] = values.size();
+				return values.size();
+			}
+
+#ifndef LEGO_FLOAT_TO_CHARS
+			/**
+			 * Replace the decimal point of the C locale (e.g., "," of de_DE) with ".", which OBJ requires.
+			 * sprintf and strtod use the same decimal point, so the round-trip check is not affected by the locale.
+			 */
+			void normalizeDecimalPoint(char* str) {
+				const char* point = localeconv()->decimal_point;
+				if (point == NULL || point[0] == '\0' || strcmp(point, ".") == 0) return;
+
+				char* pos = strstr(str, point);
+				if (pos == NULL) return;
+				*pos = '.';
+				size_t len = strlen(point);
+				if (len > 1) memmove(pos + 1, pos + len, strlen(pos + len) + 1);
+			}
+#endif
+
+		}
+
+		OutputBuffer::OutputBuffer(const std::string& filename, size_t capacity) : buffer(capacity), size(0) {
+			fp = fopen(filename.c_str(), "wb");
+		}
+
+		OutputBuffer::~OutputBuffer() {
+			if (fp != NULL) {
+				flush();
+				fclose(fp);
+			}
+		}
+
+		void OutputBuffer::flush() {
+			if (fp != NULL && size > 0) {
+				fwrite(buffer.data(), 1, size, fp);
+			}
+			size = 0;
+		}
+
+		OutputBuffer& OutputBuffer::operator<<(const char* str) {
+			append(str, strlen(str));
+			return *this;
+		}
+
+		OutputBuffer& OutputBuffer::operator<<(const std::string& str) {
+			append(str.c_str(), str.size());
+			return *this;
+		}
+
+		OutputBuffer& OutputBuffer::operator<<(char c) {
+			if (size == buffer.size()) flush();
+			buffer[size++] = c;
+			return *this;
+		}
+
+		OutputBuffer& OutputBuffer::operator<<(int value) {
+			char str[16];
+			int len = 0;
+			unsigned int v = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+			do {
+				str[sizeof(str) - 1 - len++] = '0' + v % 10;
+				v /= 10;
+			} while (v > 0);
+			if (value < 0) str[sizeof(str) - 1 - len++] = '-';
+			append(str + sizeof(str) - len, len);
+			return *this;
+		}
+
+		/**
+		 * Write the value with the fewest significant digits that are read back to the same float.
+		 * The decimal point is always ".", regardless of the locale.
+		 * std::to_chars is used if the standard library provides it. Otherwise, the precision is increased
+		 * until sprintf gives back the same value, and the decimal point of the locale is replaced.
+		 */
+		OutputBuffer& OutputBuffer::operator<<(float value) {
+			char str[32];
+#ifdef LEGO_FLOAT_TO_CHARS
+			std::to_chars_result result = std::to_chars(str, str + sizeof(str), value);
+			append(str, result.ptr - str);
+#else
+			for (int precision = 6; precision <= 9; precision++) {
+				sprintf(str, "%.*g", precision, value);
+				if (precision == 9 || (float)strtod(str, NULL) == value) break;
+			}
+			normalizeDecimalPoint(str);
+			append(str, strlen(str));
+#endif
+			return *this;
+		}
+
+		/**
+		 * Write the value with the fewest significant digits that are read back to the same double.
+		 * The decimal point is always ".", regardless of the locale.
+		 */
+		OutputBuffer& OutputBuffer::operator<<(double value) {
+			char str[32];
+#ifdef LEGO_FLOAT_TO_CHARS
+			std::to_chars_result result = std::to_chars(str, str + sizeof(str), value);
+			append(str, result.ptr - str);
+#else
+			for (int precision = 15; precision <= 17; precision++) {
+				sprintf(str, "%.*g", precision, value);
+				if (precision == 17 || strtod(str, NULL) == value) break;
+			}
+			normalizeDecimalPoint(str);
+			append(str, strlen(str));
+#endif
+			return *this;
+		}
+
+		void OutputBuffer::append(const char* data, size_t length) {
+			if (size + length > buffer.size()) {
+				flush();
+				if (length > buffer.size()) {
+					if (fp != NULL) fwrite(data, 1, length, fp);
+					return;
+				}
+			}
+			memcpy(buffer.data() + size, data, length);
+			size += length;
+		}
+
 		bool Material::equals(const Material& other) {
 			if (type != other.type) return false;
 			if (type == TYPE_COLOR) {
@@ -51,9 +218,27 @@ namespace util {
 		}
 		
 		void OBJWriter::write(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<std::shared_ptr<BuildingLayer>>& buildings) {
-			std::vector<Vertex> vertices;
-			std::vector<Face> faces;
+			OutputBuffer file(filename);
+
+			int index = filename.rfind('.');
+			std::string mat_filename;
+			if (index >= 0) {
+				mat_filename = filename.substr(0, index) + ".mtl";
+			}
+			index = mat_filename.rfind('/');
+			std::ofstream mat_file(mat_filename);
+			if (index >= 0) {
+				mat_filename = mat_filename.substr(index + 1);
+			}
+
+			file << "mtllib " << mat_filename << "\n";
+			file << "\n";
 
+			// the faces are generated and written building by building, so that the vertices are shared within each building
+			std::map<Material, int> material_ids;
+			int num_positions = 0;
+			int num_tex_coords = 0;
+			int num_normals = 0;
 			for (int i = 0; i < buildings.size(); i++) {
 				// randomly select a texture file for the facade
 				srand(time(NULL));
@@ -104,198 +289,200 @@ namespace util {
 				std::stringstream facade_texture;
 				facade_texture << "textures/window_tile" << facade_texture_id << ".png";
 				
+				std::vector<Face> faces;
 				writeBuilding(buildings[i], scale, color, facade_texture.str(), "textures/roof_texture.png", faces);
+				writeFaces(file, faces, width, height, offset_x, offset_y, offset_z, -0.5, scale, true, &material_ids, num_positions, num_tex_coords, num_normals);
 			}
 
-			std::ofstream file(filename);
-
-			int index = filename.rfind('.');
-			std::string mat_filename;
-			if (index >= 0) {
-				mat_filename = filename.substr(0, index) + ".mtl";
+			// output materials in the order of their ids
+			std::vector<Material> materials(material_ids.size());
+			for (auto it = material_ids.begin(); it != material_ids.end(); it++) {
+				materials[it->second - 1] = it->first;
 			}
-			index = mat_filename.rfind('/');
-			std::ofstream mat_file(mat_filename);
-			if (index >= 0) {
-				mat_filename = mat_filename.substr(index + 1);
+			for (int i = 0; i < materials.size(); i++) {
+				mat_file << "newmtl Material" << i + 1 << std::endl;
+				mat_file << materials[i].to_string() << std::endl;
 			}
+		}
 
-			file << "mtllib " << mat_filename << std::endl;
-			file << std::endl;
-
-			// grouping the faces based on their materials
-			int positionId = 1;
-			int texCoordId = 1;
-			int materialId = 1;
-			Material material;
-			std::map<Material, std::vector<Face>> mapped_faces;
-			for (auto& face : faces) {
-				Material new_material;
-				if (face.texture_enabled) {
-					new_material = Material(face.texture);
-				}
-				else {
-					new_material = Material(face.color);
-				}
-				mapped_faces[new_material].push_back(face);
-			}
+		void OBJWriter::writeVoxels(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings) {
+			OutputBuffer file(filename);
 
-			// output vertex coordinates
-			file << "# List of geometric vertices" << std::endl;
-			for (auto it = mapped_faces.begin(); it != mapped_faces.end(); it++) {
-				for (auto& face : it->second) {
-					for (auto& vertex : face.vertices) {
-						float x = (vertex.position.x + width * 0.5 - 0.5) * scale + offset_x;
-						float y = (vertex.position.y - height * 0.5 + 0.5) * scale + offset_y;
-						float z = (vertex.position.z - 0.5) * scale + offset_z;
-						file << std::setprecision(20) << "v " << x << " " << y << " " << z << std::endl;
+			int num_positions = 0;
+			int num_tex_coords = 0;
+			int num_normals = 0;
+			for (auto& voxel_building : voxel_buildings) {
+				std::vector<Face> faces;
+				for (int z = 0; z < voxel_building.numSlices(); z++) {
+					std::vector<Polygon> footprints = voxel_building.contours(z);
+					for (int i = 0; i < footprints.size(); i++) {
+						writeVoxelNode(footprints[i], voxel_building.heights[voxel_building.sliceBegin(z) + i], scale, cv::Point3f(1, 1, 1), faces);
 					}
 				}
+				writeFaces(file, faces, width, height, offset_x, offset_y, offset_z, 0, scale, false, NULL, num_positions, num_tex_coords, num_normals);
 			}
-			file << std::endl;
+		}
 
-			// output texture coordinates
-			file << "# List of texture coordinates" << std::endl;
-			for (auto it = mapped_faces.begin(); it != mapped_faces.end(); it++) {
-				for (auto& face : it->second) {
-					if (face.texture_enabled) {
-						for (auto& vertex : face.vertices) {
-							file << "vt " << vertex.tex_coord.x << " " << vertex.tex_coord.y << std::endl;
-						}
-					}
-				}
-			}
-			file << std::endl;
+		/**
+		 * Generate the polygon mesh of the buildings in memory in the same coordinates as the obj file.
+		 * The positions are shared among the faces of each building, and the faces are not triangulated.
+		 *
+		 * @param positions			positions of the vertices
+		 * @param face_offsets		offsets of the faces in the indices (the number of the faces + 1 values)
+		 * @param indices			0-based indices of the positions of the vertices of the faces
+		 * @param face_buildings	index of the building of each face
+		 */
+		void OBJWriter::createMesh(double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<std::shared_ptr<BuildingLayer>>& buildings, std::vector<cv::Point3d>& positions, std::vector<int>& face_offsets, std::vector<int>& indices, std::vector<int>& face_buildings) {
+			positions.clear();
+			face_offsets.assign(1, 0);
+			indices.clear();
+			face_buildings.clear();
 
-			// output normal vectors
-			file << "# List of vertex normals" << std::endl;
-			for (auto it = mapped_faces.begin(); it != mapped_faces.end(); it++) {
-				for (auto& face : it->second) {
-					for (auto& vertex : face.vertices) {
-						file << "vn " << vertex.normal.x << " " << vertex.normal.y << " " << vertex.normal.z << std::endl;
+			for (int i = 0; i < buildings.size(); i++) {
+				std::vector<Face> faces;
+				writeBuilding(buildings[i], scale, cv::Point3f(1, 1, 1), "", "", faces);
+
+				std::map<cv::Point3f, int, Point3fLess> position_map;
+				std::vector<cv::Point3f> building_positions;
+				int num_positions = positions.size();
+				for (int j = 0; j < faces.size(); j++) {
+					for (auto& vertex : faces[j].vertices) {
+						indices.push_back(num_positions + findOrAdd(position_map, building_positions, vertex.position) - 1);
 					}
+					face_offsets.push_back(indices.size());
+					face_buildings.push_back(i);
 				}
-			}
-			file << std::endl;
-
-			// output face information
-			for (auto it = mapped_faces.begin(); it != mapped_faces.end(); it++) {
-				Material material = it->first;
-
-				mat_file << "newmtl Material" << materialId << std::endl;
-				mat_file << material.to_string() << std::endl;
-
-				file << std::endl;
-				file << "usemtl Material" << materialId << std::endl;
-				materialId++;
-
-				for (auto& face : it->second) {
-					file << "f";
-					for (int k = 0; k < face.vertices.size(); k++) {
-						file << " " << positionId;
-
-						file << "/";
-						if (face.texture_enabled) {
-							file << texCoordId++;
-						}
-
-						file << "/" << positionId++;
-					}
-					file << std::endl;
 
+				for (auto& position : building_positions) {
+					double x = (position.x + width * 0.5 - 0.5) * scale + offset_x;
+					double y = (position.y - height * 0.5 + 0.5) * scale + offset_y;
+					double z = (position.z - 0.5) * scale + offset_z;
+					positions.push_back(cv::Point3d(x, y, z));
 				}
 			}
-
-			file.close();
 		}
 
-		void OBJWriter::writeVoxels(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings) {
+		void OBJWriter::writePointCloud_XYZN(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings) {
 			std::vector<Vertex> vertices;
 			std::vector<Face> faces;
 
 			for (auto& voxel_building : voxel_buildings) {
-				for (int z = 0; z < voxel_building.node_stack.size(); z++) {
-					for (auto voxel_node : voxel_building.node_stack[z]) {
-						writeVoxelNode(voxel_node, scale, cv::Point3f(1, 1, 1), faces);
+				for (int z = 0; z < voxel_building.numSlices(); z++) {
+					std::vector<Polygon> footprints = voxel_building.contours(z);
+					for (int i = 0; i < footprints.size(); i++) {
+						writeVoxelNode(footprints[i], voxel_building.heights[voxel_building.sliceBegin(z) + i], scale, cv::Point3f(1, 1, 1), faces);
 					}
 				}
 			}
 
-			std::ofstream file(filename);
-
-			// grouping the faces based on their materials
-			int positionId = 1;
+			OutputBuffer file(filename);
 
 			// output vertex coordinates
-			file << "# List of geometric vertices" << std::endl;
+			file << "# List of geometric vertices\n";
 			for (auto& face : faces) {
 				for (auto& vertex : face.vertices) {
-					file << std::setprecision(20) << "v " << (vertex.position.x + width * 0.5 - 0.5) * scale + offset_x << " " << (vertex.position.y - height * 0.5 + 0.5) * scale + offset_y << " " << vertex.position.z * scale + offset_z << std::endl;
+					if (util::genRand() < 0.2)
+						file << (vertex.position.x + width * 0.5 - 0.5) * scale + offset_x << ' ' << (vertex.position.y - height * 0.5 + 0.5) * scale + offset_y << ' ' << vertex.position.z * scale + offset_z << ' ' << vertex.normal.x << ' ' << vertex.normal.y << ' ' << vertex.normal.z << '\n';
 				}
 			}
-			file << std::endl;
+			file << "\n";
+		}
 
-			// output texture coordinates
-			file << "# List of texture coordinates" << std::endl;
-			for (auto& face : faces) {
-				if (face.texture_enabled) {
-					for (auto& vertex : face.vertices) {
-						file << "vt " << vertex.tex_coord.x << " " << vertex.tex_coord.y << std::endl;
-					}
+		/**
+		 * Write the faces of one building with indexed vertices.
+		 * The positions, texture coordinates, and normals are shared among the faces of the building,
+		 * and the faces are grouped by their materials.
+		 *
+		 * @param file				output file
+		 * @param faces				faces of the building
+		 * @param offset_height		offset added to the z coordinate of the vertices before scaling
+		 * @param float_positions	true if the positions are written in single precision
+		 * @param material_ids		ids of the materials shared among the buildings (NULL if the materials are not used)
+		 * @param num_positions		number of the positions written so far
+		 * @param num_tex_coords	number of the texture coordinates written so far
+		 * @param num_normals		number of the normals written so far
+		 */
+		void OBJWriter::writeFaces(OutputBuffer& file, const std::vector<Face>& faces, double width, double height, double offset_x, double offset_y, double offset_z, double offset_height, double scale, bool float_positions, std::map<Material, int>* material_ids, int& num_positions, int& num_tex_coords, int& num_normals) {
+			std::map<cv::Point3f, int, Point3fLess> position_map;
+			std::map<cv::Point2f, int, Point2fLess> tex_coord_map;
+			std::map<cv::Point3f, int, Point3fLess> normal_map;
+			std::vector<cv::Point3f> positions;
+			std::vector<cv::Point2f> tex_coords;
+			std::vector<cv::Point3f> normals;
+			std::vector<int> face_offsets(faces.size());
+			std::vector<int> position_indices;
+			std::vector<int> tex_coord_indices;
+			std::vector<int> normal_indices;
+			for (int i = 0; i < faces.size(); i++) {
+				face_offsets[i] = position_indices.size();
+				for (auto& vertex : faces[i].vertices) {
+					position_indices.push_back(num_positions + findOrAdd(position_map, positions, vertex.position));
+					tex_coord_indices.push_back(faces[i].texture_enabled ? num_tex_coords + findOrAdd(tex_coord_map, tex_coords, vertex.tex_coord) : 0);
+					normal_indices.push_back(num_normals + findOrAdd(normal_map, normals, vertex.normal));
 				}
 			}
-			file << std::endl;
 
-			// output normal vectors
-			file << "# List of vertex normals" << std::endl;
-			for (auto& face : faces) {
-				for (auto& vertex : face.vertices) {
-					file << "vn " << vertex.normal.x << " " << vertex.normal.y << " " << vertex.normal.z << std::endl;
+			// group the faces based on their materials
+			std::vector<int> face_materials(faces.size(), 0);
+			if (material_ids != NULL) {
+				for (int i = 0; i < faces.size(); i++) {
+					Material material = faces[i].texture_enabled ? Material(faces[i].texture) : Material(faces[i].color);
+					auto it = material_ids->find(material);
+					if (it == material_ids->end()) {
+						int id = material_ids->size() + 1;
+						(*material_ids)[material] = id;
+						face_materials[i] = id;
+					}
+					else {
+						face_materials[i] = it->second;
+					}
 				}
 			}
-			file << std::endl;
+			std::vector<int> order(faces.size());
+			for (int i = 0; i < faces.size(); i++) order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&face_materials](int a, int b) { return face_materials[a] < face_materials[b]; });
 
-			// output face information
-			for (auto& face : faces) {
-				file << "f";
-				for (int k = 0; k < face.vertices.size(); k++) {
-					file << " " << positionId;
-					file << "/";
-					file << "/" << positionId++;
+			for (auto& position : positions) {
+				double x = (position.x + width * 0.5 - 0.5) * scale + offset_x;
+				double y = (position.y - height * 0.5 + 0.5) * scale + offset_y;
+				double z = (position.z + offset_height) * scale + offset_z;
+				if (float_positions) {
+					file << "v " << (float)x << ' ' << (float)y << ' ' << (float)z << '\n';
+				}
+				else {
+					file << "v " << x << ' ' << y << ' ' << z << '\n';
 				}
-				file << std::endl;
+			}
+			for (auto& tex_coord : tex_coords) {
+				file << "vt " << tex_coord.x << ' ' << tex_coord.y << '\n';
+			}
+			for (auto& normal : normals) {
+				file << "vn " << normal.x << ' ' << normal.y << ' ' << normal.z << '\n';
 			}
 
-			file.close();
-		}
-
-		void OBJWriter::writePointCloud_XYZN(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings) {
-			std::vector<Vertex> vertices;
-			std::vector<Face> faces;
+			int material_id = 0;
+			for (int i : order) {
+				if (face_materials[i] != material_id) {
+					material_id = face_materials[i];
+					file << "usemtl Material" << material_id << '\n';
+				}
 
-			for (auto& voxel_building : voxel_buildings) {
-				for (int z = 0; z < voxel_building.node_stack.size(); z++) {
-					for (auto voxel_node : voxel_building.node_stack[z]) {
-						writeVoxelNode(voxel_node, scale, cv::Point3f(1, 1, 1), faces);
+				file << 'f';
+				for (int k = 0; k < faces[i].vertices.size(); k++) {
+					file << ' ' << position_indices[face_offsets[i] + k] << '/';
+					if (faces[i].texture_enabled) {
+						file << tex_coord_indices[face_offsets[i] + k];
 					}
+					file << '/' << normal_indices[face_offsets[i] + k];
 				}
+				file << '\n';
 			}
 
-			std::ofstream file(filename);
-
-			// output vertex coordinates
-			file << "# List of geometric vertices" << std::endl;
-			for (auto& face : faces) {
-				for (auto& vertex : face.vertices) {
-					if(util::genRand() < 0.2)
-						file << (vertex.position.x + width * 0.5 - 0.5) * scale + offset_x << " " << (vertex.position.y - height * 0.5 + 0.5) * scale + offset_y << " " << vertex.position.z * scale + offset_z << " " << vertex.normal.x << " " << vertex.normal.y << " " << vertex.normal.z<<std::endl;
-				}
-			}
-			file << std::endl;
-			file.close();
+			num_positions += positions.size();
+			num_tex_coords += tex_coords.size();
+			num_normals += normals.size();
 		}
 
-
 		void OBJWriter::writeBuilding(std::shared_ptr<BuildingLayer> building, double scale, const cv::Point3f& color, const std::string& facade_texture, const std::string& roof_texture, std::vector<Face>& faces) {
 			double roof_tile_size = 20.0 / scale;
 
@@ -498,14 +685,14 @@ namespace util {
 			return ans;
 		}
 
-		void OBJWriter::writeVoxelNode(std::shared_ptr<VoxelNode> voxel_node, double scale, const cv::Point3f& color, std::vector<Face>& faces) {
+		void OBJWriter::writeVoxelNode(const Polygon& footprint, int slice_height, double scale, const cv::Point3f& color, std::vector<Face>& faces) {
 			double height = 1;
-			double z = voxel_node->height;
+			double z = slice_height;
 
-			Ring contour = voxel_node->contour.contour.getActualPoints();
-			std::vector<Ring> holes(voxel_node->contour.holes.size());
-			for (int i = 0; i < voxel_node->contour.holes.size(); i++) {
-				holes[i] = voxel_node->contour.holes[i].getActualPoints();
+			Ring contour = footprint.contour.getActualPoints();
+			std::vector<Ring> holes(footprint.holes.size());
+			for (int i = 0; i < footprint.holes.size(); i++) {
+				holes[i] = footprint.holes[i].getActualPoints();
 			}
 
 			std::vector<std::vector<cv::Point2f>> polygons;
@@ -533,7 +720,7 @@ namespace util {
 			}
 
 			// side faces
-			util::Ring polygon = voxel_node->contour.contour.getActualPoints();
+			util::Ring polygon = footprint.contour.getActualPoints();
 			polygon.counterClockwise();
 
 			for (int i = 0; i < polygon.size(); i++) {
@@ -556,7 +743,7 @@ namespace util {
 			}
 					
 			// side faces of holes
-			for (auto& bh : voxel_node->contour.holes) {
+			for (auto& bh : footprint.holes) {
 				util::Ring hole = bh.getActualPoints();
 				hole.clockwise();
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <cstdio>
 #include <opencv2/opencv.hpp>
 #include "BuildingLayer.h"
 #include "VoxelBuilding.h"
@@ -56,6 +58,35 @@ namespace util {
 			}
 		};
 
+		/**
+		 * Output file with a large user-space buffer.
+		 * Floating point numbers are written by the shortest representation that is read back to the same value.
+		 */
+		class OutputBuffer {
+		private:
+			FILE* fp;
+			std::vector<char> buffer;
+			size_t size;
+
+		public:
+			OutputBuffer(const std::string& filename, size_t capacity = 1 << 22);
+			~OutputBuffer();
+
+			bool isOpen() const { return fp != NULL; }
+			void flush();
+			OutputBuffer& operator<<(const char* str);
+			OutputBuffer& operator<<(const std::string& str);
+			OutputBuffer& operator<<(char c);
+			OutputBuffer& operator<<(int value);
+			OutputBuffer& operator<<(float value);
+			OutputBuffer& operator<<(double value);
+
+		private:
+			OutputBuffer(const OutputBuffer&);
+			OutputBuffer& operator=(const OutputBuffer&);
+			void append(const char* data, size_t length);
+		};
+
 		class OBJWriter {
 		protected:
 			OBJWriter() {}
@@ -63,6 +94,7 @@ namespace util {
 		public:
 			static void write(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<std::shared_ptr<BuildingLayer>>& buildings);
 			static void writeVoxels(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings);
+			static void createMesh(double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<std::shared_ptr<BuildingLayer>>& buildings, std::vector<cv::Point3d>& positions, std::vector<int>& face_offsets, std::vector<int>& indices, std::vector<int>& face_buildings);
 			static void writePointCloud_XYZN(const std::string& filename, double width, double height, double offset_x, double offset_y, double offset_z, double scale, const std::vector<VoxelBuilding>& voxel_buildings);
 
 		private:
@@ -70,7 +102,8 @@ namespace util {
 			static void createFace(const std::vector<cv::Point2f>& coords, double z, double h, float floor_tile_width, float floor_tile_height, const cv::Point3f& color, const std::string& facade_texture, std::vector<Face>& faces);
 			static double dotProductBetweenThreePoints(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c);
 			static double getLength(const std::vector<cv::Point2f>& points);
-			static void writeVoxelNode(std::shared_ptr<VoxelNode> voxel_node, double scale, const cv::Point3f& color, std::vector<Face>& faces);
+			static void writeVoxelNode(const Polygon& footprint, int slice_height, double scale, const cv::Point3f& color, std::vector<Face>& faces);
+			static void writeFaces(OutputBuffer& file, const std::vector<Face>& faces, double width, double height, double offset_x, double offset_y, double offset_z, double offset_height, double scale, bool float_positions, std::map<Material, int>* material_ids, int& num_positions, int& num_tex_coords, int& num_normals);
 		};
 
 	}
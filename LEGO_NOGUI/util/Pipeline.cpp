@@ -0,0 +1,233 @@
+#include "Pipeline.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <iomanip>
+#include <algorithm>
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+namespace util {
+
+	namespace {
+
+		/**
+		 * FIFO queue of the item indices whose push blocks while the queue is full.
+		 * After the queue is closed, pop returns false once the queue is drained.
+		 */
+		class BoundedQueue {
+		private:
+			std::deque<int> items;
+			int capacity;
+			bool closed;
+			std::mutex mtx;
+			std::condition_variable not_empty;
+			std::condition_variable not_full;
+
+		public:
+			BoundedQueue(int capacity) : capacity(std::max(1, capacity)), closed(false) {}
+
+			void push(int item) {
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					while (items.size() >= capacity) not_full.wait(lock);
+					items.push_back(item);
+				}
+				not_empty.notify_one();
+			}
+
+			bool pop(int& item) {
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					while (items.empty() && !closed) not_empty.wait(lock);
+					if (items.empty()) return false;
+					item = items.front();
+					items.pop_front();
+				}
+				not_full.notify_one();
+				return true;
+			}
+
+			void close() {
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					closed = true;
+				}
+				not_empty.notify_all();
+			}
+		};
+
+	}
+
+	/**
+	 * @param queue_capacity	the maximum number of the items waiting in the queue in front of each stage
+	 */
+	Pipeline::Pipeline(int queue_capacity) : queue_capacity(queue_capacity), memory_budget(0), release_stage(0), elapsed(0), throttled(0), peak_memory(0) {
+	}
+
+	/**
+	 * Append a stage to the pipeline.
+	 *
+	 * @param name			name of the stage
+	 * @param num_threads	the number of worker threads of the stage (0 or negative means the number of hardware threads)
+	 * @param func			function that processes the item of the given index
+	 */
+	void Pipeline::addStage(const std::string& name, int num_threads, const std::function<void(int)>& func) {
+		Stage stage;
+		stage.name = name;
+		stage.num_threads = ThreadPool::resolveNumThreads(num_threads);
+		stage.func = func;
+		stages.push_back(stage);
+	}
+
+	/**
+	 * Limit the total cost of the items in flight.
+	 *
+	 * @param memory_budget		the maximum total cost of the items in flight (0 means unlimited)
+	 * @param item_cost			function that returns the cost of the item of the given index, e.g., its size in bytes
+	 * @param release_stage		index of the stage after which the cost of the item is released
+	 * @param resident_cost		function that returns the cost of the item after a stage before the release stage finishes it
+	 *							(the cost charged at the admission is kept if it is empty)
+	 */
+	void Pipeline::setMemoryBudget(size_t memory_budget, const std::function<size_t(int)>& item_cost, int release_stage, const std::function<size_t(int)>& resident_cost) {
+		this->memory_budget = memory_budget;
+		this->item_cost = item_cost;
+		this->release_stage = release_stage;
+		this->resident_cost = resident_cost;
+	}
+
+	/**
+	 * Process the items 0, 1, ..., num_items - 1 through all the stages, and block until all of them are finished.
+	 * The items are admitted to the first stage in the order of the indices, but a stage with multiple threads
+	 * may pass them to the next stage out of order.
+	 *
+	 * @param num_items		the number of the items
+	 */
+	void Pipeline::run(int num_items) {
+		stats.assign(stages.size(), StageStats());
+		elapsed = 0;
+		throttled = 0;
+		peak_memory = 0;
+		if (stages.size() == 0) return;
+
+		long long start = Profiler::now();
+		bool budgeted = memory_budget > 0 && item_cost;
+		int last_stage = std::min(std::max(0, release_stage), (int)stages.size() - 1);
+
+		std::vector<std::unique_ptr<BoundedQueue>> queues;
+		for (int i = 0; i < stages.size(); i++) {
+			queues.push_back(std::unique_ptr<BoundedQueue>(new BoundedQueue(queue_capacity)));
+		}
+
+		std::mutex mtx;
+		std::condition_variable memory_released;
+		std::vector<size_t> costs(num_items, 0);
+		size_t memory_in_use = 0;
+		int num_charged = 0;
+		std::vector<int> num_running(stages.size());
+
+		std::vector<std::thread> workers;
+		for (int s = 0; s < stages.size(); s++) {
+			num_running[s] = stages[s].num_threads;
+			for (int t = 0; t < stages[s].num_threads; t++) {
+				workers.push_back(std::thread([&, s]() {
+					StageStats local;
+					while (true) {
+						long long t0 = Profiler::now();
+						int item;
+						bool popped = queues[s]->pop(item);
+						long long t1 = Profiler::now();
+						local.starved += t1 - t0;
+						if (!popped) break;
+
+						stages[s].func(item);
+						long long t2 = Profiler::now();
+						local.busy += t2 - t1;
+						local.num_items++;
+
+						if (budgeted && s == last_stage) {
+							{
+								std::unique_lock<std::mutex> lock(mtx);
+								memory_in_use -= costs[item];
+								num_charged--;
+							}
+							memory_released.notify_all();
+						}
+						else if (budgeted && s < last_stage && resident_cost) {
+							size_t cost = resident_cost(item);
+							{
+								std::unique_lock<std::mutex> lock(mtx);
+								memory_in_use = memory_in_use - costs[item] + cost;
+								costs[item] = cost;
+								peak_memory = std::max(peak_memory, memory_in_use);
+							}
+							memory_released.notify_all();
+						}
+
+						if (s + 1 < stages.size()) {
+							queues[s + 1]->push(item);
+							local.blocked += Profiler::now() - t2;
+						}
+					}
+
+					// the last worker of the stage closes the queue of the next stage
+					std::unique_lock<std::mutex> lock(mtx);
+					stats[s].num_items += local.num_items;
+					stats[s].busy += local.busy;
+					stats[s].starved += local.starved;
+					stats[s].blocked += local.blocked;
+					if (--num_running[s] == 0 && s + 1 < stages.size()) queues[s + 1]->close();
+				}));
+			}
+		}
+
+		// admit the items to the first stage
+		for (int i = 0; i < num_items; i++) {
+			if (budgeted) {
+				costs[i] = item_cost(i);
+				long long t0 = Profiler::now();
+				std::unique_lock<std::mutex> lock(mtx);
+				while (num_charged > 0 && memory_in_use + costs[i] > memory_budget) memory_released.wait(lock);
+				memory_in_use += costs[i];
+				num_charged++;
+				peak_memory = std::max(peak_memory, memory_in_use);
+				throttled += Profiler::now() - t0;
+			}
+			queues[0]->push(i);
+		}
+		queues[0]->close();
+
+		for (int i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+		elapsed = Profiler::now() - start;
+	}
+
+	/**
+	 * Print the utilization of each stage of the last run, i.e., the ratio of the busy, starved, and blocked time
+	 * to the elapsed time of all the threads of the stage.
+	 */
+	void Pipeline::printUtilization(std::ostream& out) const {
+		out << "------------------------------------------------" << std::endl;
+		out << "Pipeline utilization (" << elapsed * 1e-6 << " sec)" << std::endl;
+		out << std::fixed << std::setprecision(1);
+		for (int i = 0; i < stats.size(); i++) {
+			double total = (double)std::max(1LL, elapsed) * stages[i].num_threads;
+			out << std::left << std::setw(20) << stages[i].name << std::right
+				<< " threads " << std::setw(3) << stages[i].num_threads
+				<< "  items " << std::setw(6) << stats[i].num_items
+				<< "  busy " << std::setw(5) << stats[i].busy * 100.0 / total << "%"
+				<< "  starved " << std::setw(5) << stats[i].starved * 100.0 / total << "%"
+				<< "  blocked " << std::setw(5) << stats[i].blocked * 100.0 / total << "%" << std::endl;
+		}
+		if (memory_budget > 0 && item_cost) {
+			out << "Memory budget: peak " << peak_memory / 1024.0 / 1024.0 << " of " << memory_budget / 1024.0 / 1024.0 << " MB,"
+				<< " admission waited " << throttled * 1e-6 << " sec" << std::endl;
+		}
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+
+}
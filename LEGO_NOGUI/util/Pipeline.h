@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <functional>
+
+namespace util {
+
+	/**
+	 * Executor of the items 0, 1, ..., N-1 through a sequence of stages, each of which has its own worker threads.
+	 * The stages are connected by bounded FIFO queues, so a stage that runs ahead blocks when the next stage cannot keep up,
+	 * and the items in flight between two stages never exceed the queue capacity.
+	 *
+	 * The items can be admitted under a memory budget. The cost of an item is charged when it is admitted to the first stage,
+	 * and released when the given stage finishes it. An item is admitted only if it fits in the budget, or nothing is in flight.
+	 * The cost can be re-charged after each of the earlier stages, e.g., when the peak memory of a stage is larger than
+	 * the memory that the item keeps for the following stages.
+	 *
+	 * For each stage, the time that the workers are busy, starved (waiting for the input), and blocked (waiting for the room
+	 * in the output queue) is counted, so that the bottleneck stage is the one that is busy all the time.
+	 * The stage functions have to catch their own exceptions.
+	 */
+	class Pipeline {
+	public:
+		struct StageStats {
+			int num_items;
+			long long busy;
+			long long starved;
+			long long blocked;
+
+			StageStats() : num_items(0), busy(0), starved(0), blocked(0) {}
+		};
+
+	private:
+		struct Stage {
+			std::string name;
+			int num_threads;
+			std::function<void(int)> func;
+		};
+
+		int queue_capacity;
+		std::vector<Stage> stages;
+
+		// memory budget
+		size_t memory_budget;
+		std::function<size_t(int)> item_cost;
+		std::function<size_t(int)> resident_cost;
+		int release_stage;
+
+		// statistics of the last run
+		std::vector<StageStats> stats;
+		long long elapsed;
+		long long throttled;
+		size_t peak_memory;
+
+	public:
+		Pipeline(int queue_capacity);
+
+		void addStage(const std::string& name, int num_threads, const std::function<void(int)>& func);
+		void setMemoryBudget(size_t memory_budget, const std::function<size_t(int)>& item_cost, int release_stage, const std::function<size_t(int)>& resident_cost = std::function<size_t(int)>());
+		void run(int num_items);
+
+		const StageStats& stageStats(int stage) const { return stats[stage]; }
+		void printUtilization(std::ostream& out) const;
+
+	private:
+		Pipeline(const Pipeline&);
+		Pipeline& operator=(const Pipeline&);
+	};
+
+}
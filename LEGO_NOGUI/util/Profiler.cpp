@@ -0,0 +1,314 @@
+#include "Profiler.h"
+#include <map>
+#include <cstdio>
+#include <memory>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+namespace util {
+
+	namespace {
+
+		const int RING_BUFFER_SIZE = 1 << 16;
+		const int MAX_DEPTH = 64;
+
+		/**
+		 * Ring buffer of the scopes finished in one thread.
+		 * When it is full, the oldest scopes are overwritten.
+		 */
+		struct ThreadBuffer {
+			int thread_id;
+			std::vector<Profiler::Event> events;
+			long long num_recorded;
+			int depth;
+			int building_ids[MAX_DEPTH];
+
+			ThreadBuffer(int thread_id) : thread_id(thread_id), events(RING_BUFFER_SIZE), num_recorded(0), depth(0) {}
+		};
+
+		std::mutex buffers_mtx;
+		// the buffers outlive their threads so that the scopes can be collected after the threads finish
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		PROFILER_THREAD_LOCAL ThreadBuffer* thread_buffer = NULL;
+
+		ThreadBuffer* getThreadBuffer() {
+			if (thread_buffer == NULL) {
+				std::lock_guard<std::mutex> lock(buffers_mtx);
+				buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer(buffers.size())));
+				thread_buffer = buffers.back().get();
+			}
+			return thread_buffer;
+		}
+
+		struct Stats {
+			int count;
+			long long total;
+			long long max;
+
+			Stats() : count(0), total(0), max(0) {}
+			void add(long long duration) {
+				count++;
+				total += duration;
+				max = std::max(max, duration);
+			}
+		};
+
+		void writeJSONString(std::ostream& file, const std::string& str) {
+			file << '"';
+			for (int i = 0; i < str.size(); i++) {
+				if (str[i] == '"' || str[i] == '\\') file << '\\';
+				file << str[i];
+			}
+			file << '"';
+		}
+
+	}
+
+	bool Profiler::enabled = false;
+
+	void Profiler::setEnabled(bool enabled) {
+		Profiler::enabled = enabled;
+	}
+
+	/**
+	 * Return the wall-clock time in microseconds from an arbitrary origin.
+	 */
+	long long Profiler::now() {
+#ifdef _WIN32
+		// std::chrono::steady_clock of VS2013 does not have the sub-millisecond resolution.
+		static LARGE_INTEGER frequency = { 0 };
+		if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/**
+	 * Return the current resident set size of the process in bytes.
+	 * The peak resident set size is returned on the platforms other than Windows and Linux.
+	 */
+	size_t Profiler::residentSetSize() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.WorkingSetSize;
+#elif defined(__linux__)
+		FILE* file = fopen("/proc/self/statm", "r");
+		if (file == NULL) return 0;
+		long long num_pages = 0;
+		long long num_resident_pages = 0;
+		int num_read = fscanf(file, "%lld %lld", &num_pages, &num_resident_pages);
+		fclose(file);
+		if (num_read != 2) return 0;
+		return (size_t)num_resident_pages * sysconf(_SC_PAGESIZE);
+#else
+		return peakRSS();
+#endif
+	}
+
+	/**
+	 * Return the peak resident set size of the process in bytes, which never decreases.
+	 */
+	size_t Profiler::peakRSS() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return usage.ru_maxrss;
+#else
+		return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	/**
+	 * Start a scope in the current thread.
+	 *
+	 * @param building_id	building of the scope, or negative to use the building of the enclosing scope
+	 * @return				building of the scope
+	 */
+	int Profiler::enter(int building_id) {
+		ThreadBuffer* buffer = getThreadBuffer();
+		if (building_id < 0 && buffer->depth > 0) {
+			building_id = buffer->building_ids[std::min(buffer->depth, MAX_DEPTH) - 1];
+		}
+		if (buffer->depth < MAX_DEPTH) buffer->building_ids[buffer->depth] = building_id;
+		buffer->depth++;
+		return building_id;
+	}
+
+	/**
+	 * Finish the scope started by enter() in the current thread, and record it.
+	 */
+	void Profiler::leave(const char* name, int building_id, long long start) {
+		long long end = now();
+		ThreadBuffer* buffer = getThreadBuffer();
+		buffer->depth--;
+
+		Event& event = buffer->events[buffer->num_recorded % RING_BUFFER_SIZE];
+		event.name = name;
+		event.building_id = building_id;
+		event.depth = buffer->depth;
+		event.start = start;
+		event.end = end;
+		event.rss = buffer->depth == 0 ? residentSetSize() : 0;
+		buffer->num_recorded++;
+	}
+
+	/**
+	 * Discard the recorded scopes.
+	 * This has to be called when no scope is active in any thread.
+	 */
+	void Profiler::clear() {
+		std::lock_guard<std::mutex> lock(buffers_mtx);
+		for (int i = 0; i < buffers.size(); i++) {
+			buffers[i]->num_recorded = 0;
+		}
+	}
+
+	/**
+	 * Print the total time of each stage, in which the nested stages are indented under their parents,
+	 * and the time of each stage per building.
+	 */
+	void Profiler::printSummary(std::ostream& out) {
+		int num_dropped = 0;
+		std::vector<std::vector<Event>> events = collectEvents(num_dropped);
+
+		// aggregate by the path of the nested scopes
+		std::map<std::string, Stats> stage_stats;
+		std::map<int, std::map<std::string, Stats>> building_stats;
+		for (int i = 0; i < events.size(); i++) {
+			std::vector<std::string> path;
+			for (int j = 0; j < events[i].size(); j++) {
+				const Event& event = events[i][j];
+				path.resize(event.depth);
+				path.push_back((path.size() > 0 ? path.back() + "/" : "") + event.name);
+
+				stage_stats[path.back()].add(event.end - event.start);
+				if (event.building_id >= 0) building_stats[event.building_id][event.name].add(event.end - event.start);
+			}
+		}
+
+		out << "------------------------------------------------" << std::endl;
+		out << "Profile (wall time in sec)" << std::endl;
+		out << std::fixed << std::setprecision(3);
+		for (auto it = stage_stats.begin(); it != stage_stats.end(); ++it) {
+			int depth = std::count(it->first.begin(), it->first.end(), '/');
+			std::string name = it->first.substr(it->first.find_last_of('/') + 1);
+			out << std::string(depth * 2, ' ') << std::left << std::setw(40 - depth * 2) << name << std::right
+				<< " count " << std::setw(6) << it->second.count
+				<< "  total " << std::setw(10) << it->second.total * 1e-6
+				<< "  max " << std::setw(10) << it->second.max * 1e-6 << std::endl;
+		}
+
+		for (auto it = building_stats.begin(); it != building_stats.end(); ++it) {
+			out << "Building " << it->first << ":";
+			for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+				out << " " << it2->first << " " << it2->second.total * 1e-6;
+			}
+			out << std::endl;
+		}
+
+		out << "Peak RSS: " << peakRSS() / 1024.0 / 1024.0 << " MB" << std::endl;
+		if (num_dropped > 0) out << num_dropped << " scopes were dropped because the ring buffers were full." << std::endl;
+		out.unsetf(std::ios::floatfield);
+		out << std::setprecision(6);
+	}
+
+	/**
+	 * Write the recorded scopes in the Chrome trace-event format.
+	 *
+	 * @param filename	file path of the trace
+	 * @return			false if the file could not be written
+	 */
+	bool Profiler::writeChromeTrace(const std::string& filename) {
+		int num_dropped = 0;
+		std::vector<std::vector<Event>> events = collectEvents(num_dropped);
+
+		std::ofstream file(filename);
+		if (!file) return false;
+
+		long long origin = std::numeric_limits<long long>::max();
+		for (int i = 0; i < events.size(); i++) {
+			if (events[i].size() > 0) origin = std::min(origin, events[i][0].start);
+		}
+
+		file << "{\"traceEvents\":[\n";
+		bool first = true;
+		for (int i = 0; i < events.size(); i++) {
+			for (int j = 0; j < events[i].size(); j++) {
+				const Event& event = events[i][j];
+				if (!first) file << ",\n";
+				first = false;
+
+				file << "{\"name\":";
+				writeJSONString(file, event.name);
+				file << ",\"cat\":\"lego\",\"ph\":\"X\",\"pid\":0,\"tid\":" << i << ",\"ts\":" << event.start - origin << ",\"dur\":" << event.end - event.start;
+				if (event.building_id >= 0) file << ",\"args\":{\"building\":" << event.building_id << "}";
+				file << "}";
+
+				if (event.rss > 0) {
+					file << ",\n{\"name\":\"rss\",\"ph\":\"C\",\"pid\":0,\"tid\":" << i << ",\"ts\":" << event.end - origin << ",\"args\":{\"MB\":" << event.rss / 1024.0 / 1024.0 << "}}";
+				}
+			}
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+		return file.good();
+	}
+
+	/**
+	 * Copy the recorded scopes of each thread in the order of their start times, so that
+	 * each scope comes after its enclosing scope.
+	 */
+	std::vector<std::vector<Profiler::Event>> Profiler::collectEvents(int& num_dropped) {
+		std::lock_guard<std::mutex> lock(buffers_mtx);
+
+		std::vector<std::vector<Event>> events(buffers.size());
+		num_dropped = 0;
+		for (int i = 0; i < buffers.size(); i++) {
+			long long num_recorded = buffers[i]->num_recorded;
+			long long first = std::max(0LL, num_recorded - RING_BUFFER_SIZE);
+			num_dropped += first;
+			for (long long j = first; j < num_recorded; j++) {
+				events[i].push_back(buffers[i]->events[j % RING_BUFFER_SIZE]);
+			}
+
+			std::sort(events[i].begin(), events[i].end(), [](const Event& e1, const Event& e2) {
+				if (e1.start != e2.start) return e1.start < e2.start;
+				else return e1.depth < e2.depth;
+			});
+		}
+
+		return events;
+	}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+namespace util {
+
+	/**
+	 * Hierarchical wall-clock profiler of the pipeline stages.
+	 * Each thread records the finished scopes into its own ring buffer, so that recording does not take any lock.
+	 * When the profiler is disabled, a scoped timer only reads one flag.
+	 *
+	 * After the pipeline finishes, the recorded scopes are summarized per stage and per building,
+	 * and written as a Chrome trace-event JSON file (chrome://tracing or Perfetto), in which the resident set size
+	 * is shown as a counter. The resident set size is sampled only at the end of the top-level scopes of each thread,
+	 * e.g., once per building in the simplification threads, so that the nested scopes do not make a system call.
+	 */
+	class Profiler {
+	public:
+		struct Event {
+			const char* name;
+			int building_id;
+			int depth;
+			long long start;
+			long long end;
+			size_t rss;		// resident set size at the end of the scope (0 if not sampled)
+		};
+
+	private:
+		static bool enabled;
+
+	protected:
+		Profiler() {}
+
+	public:
+		static void setEnabled(bool enabled);
+		static bool isEnabled() { return enabled; }
+		static long long now();
+		static size_t residentSetSize();
+		static size_t peakRSS();
+		static int enter(int building_id);
+		static void leave(const char* name, int building_id, long long start);
+		static void clear();
+		static void printSummary(std::ostream& out);
+		static bool writeChromeTrace(const std::string& filename);
+
+	private:
+		static std::vector<std::vector<Event>> collectEvents(int& num_dropped);
+	};
+
+	/**
+	 * Record the wall-clock time from the construction to the destruction as a scope of the profiler.
+	 * If building_id is negative, the building of the enclosing scope is used.
+	 * The name has to be a string literal because only the pointer is recorded.
+	 */
+	class ScopedTimer {
+	private:
+		const char* name;
+		int building_id;
+		long long start;
+		bool active;
+
+	public:
+		ScopedTimer(const char* name, int building_id = -1) : name(name), building_id(building_id), start(0), active(Profiler::isEnabled()) {
+			if (active) {
+				this->building_id = Profiler::enter(building_id);
+				start = Profiler::now();
+			}
+		}
+		~ScopedTimer() {
+			if (active) Profiler::leave(name, building_id, start);
+		}
+
+	private:
+		ScopedTimer(const ScopedTimer&);
+		ScopedTimer& operator=(const ScopedTimer&);
+	};
+
+}
@@ -0,0 +1,192 @@
+#include "RectilinearIOU.h"
+#include <algorithm>
+
+namespace util {
+
+	RectilinearIOU::RectilinearIOU() : width(0), height(0), target_cnt(0), polygon_cnt(0), inter_cnt(0) {
+	}
+
+	/**
+	 * Build the summed-area table of the target image and classify the grid cells of the polygon.
+	 * The polygon is given by its vertices, all of whose coordinates have to be in x_coords and y_coords.
+	 *
+	 * @param target		target image (CV_8U, non-zero pixels are foreground)
+	 * @param origin		coordinates of the top-left pixel of the target image
+	 * @param contour		polygon vertices
+	 * @param x_coords		sorted distinct x coordinates of the vertices
+	 * @param y_coords		sorted distinct y coordinates of the vertices
+	 * @return				false if the polygon is not rectilinear
+	 */
+	bool RectilinearIOU::init(const cv::Mat_<uchar>& target, const cv::Point& origin, const std::vector<cv::Point>& contour, const std::vector<int>& x_coords, const std::vector<int>& y_coords) {
+		if (x_coords.size() < 2 || y_coords.size() < 2) return false;
+
+		width = target.cols;
+		height = target.rows;
+		this->origin = origin;
+		this->x_coords = x_coords;
+		this->y_coords = y_coords;
+
+		// summed-area table of the target image
+		sat.assign((width + 1) * (height + 1), 0);
+		target_cnt = 0;
+		for (int r = 0; r < height; r++) {
+			int row_sum = 0;
+			for (int c = 0; c < width; c++) {
+				if (target(r, c) > 0) row_sum++;
+				sat[(r + 1) * (width + 1) + c + 1] = sat[r * (width + 1) + c + 1] + row_sum;
+			}
+			target_cnt += row_sum;
+		}
+
+		// each vertical edge flips the inside/outside of the cells on its right
+		int num_cols = x_coords.size() - 1;
+		int num_rows = y_coords.size() - 1;
+		std::vector<uchar> flip(num_rows * (num_cols + 1), 0);
+		for (int i = 0; i < contour.size(); i++) {
+			const cv::Point& p1 = contour[i];
+			const cv::Point& p2 = contour[(i + 1) % contour.size()];
+			if (p1.y == p2.y) continue;
+			if (p1.x != p2.x) return false;
+
+			int ix = std::lower_bound(x_coords.begin(), x_coords.end(), p1.x) - x_coords.begin();
+			int iy1 = std::lower_bound(y_coords.begin(), y_coords.end(), std::min(p1.y, p2.y)) - y_coords.begin();
+			int iy2 = std::lower_bound(y_coords.begin(), y_coords.end(), std::max(p1.y, p2.y)) - y_coords.begin();
+			for (int j = iy1; j < iy2; j++) {
+				flip[j * (num_cols + 1) + ix] ^= 1;
+			}
+		}
+
+		inside.assign(num_rows * num_cols, 0);
+		polygon_cnt = 0;
+		inter_cnt = 0;
+		for (int j = 0; j < num_rows; j++) {
+			uchar parity = 0;
+			for (int i = 0; i < num_cols; i++) {
+				parity ^= flip[j * (num_cols + 1) + i];
+				inside[j * num_cols + i] = parity;
+				if (parity) {
+					polygon_cnt += (long long)(x_coords[i + 1] - x_coords[i]) * (y_coords[j + 1] - y_coords[j]);
+					inter_cnt += targetCount(x_coords[i], y_coords[j], x_coords[i + 1], y_coords[j + 1]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	double RectilinearIOU::iou() const {
+		return calculateIOU(polygon_cnt, inter_cnt);
+	}
+
+	/**
+	 * Return the IOU when the index-th x coordinate is moved by delta.
+	 * The caller has to keep the order of the x coordinates.
+	 */
+	double RectilinearIOU::iouAfterMovingX(int index, int delta) const {
+		long long polygon_delta;
+		long long inter_delta;
+		deltaMovingX(index, delta, polygon_delta, inter_delta);
+		return calculateIOU(polygon_cnt + polygon_delta, inter_cnt + inter_delta);
+	}
+
+	/**
+	 * Return the IOU when the index-th y coordinate is moved by delta.
+	 * The caller has to keep the order of the y coordinates.
+	 */
+	double RectilinearIOU::iouAfterMovingY(int index, int delta) const {
+		long long polygon_delta;
+		long long inter_delta;
+		deltaMovingY(index, delta, polygon_delta, inter_delta);
+		return calculateIOU(polygon_cnt + polygon_delta, inter_cnt + inter_delta);
+	}
+
+	void RectilinearIOU::moveX(int index, int delta) {
+		long long polygon_delta;
+		long long inter_delta;
+		deltaMovingX(index, delta, polygon_delta, inter_delta);
+		polygon_cnt += polygon_delta;
+		inter_cnt += inter_delta;
+		x_coords[index] += delta;
+	}
+
+	void RectilinearIOU::moveY(int index, int delta) {
+		long long polygon_delta;
+		long long inter_delta;
+		deltaMovingY(index, delta, polygon_delta, inter_delta);
+		polygon_cnt += polygon_delta;
+		inter_cnt += inter_delta;
+		y_coords[index] += delta;
+	}
+
+	/**
+	 * Check if the cell between the i-th and (i+1)-th x coordinates and the j-th and (j+1)-th y coordinates is inside the polygon.
+	 */
+	bool RectilinearIOU::isInside(int i, int j) const {
+		if (i < 0 || i >= (int)x_coords.size() - 1 || j < 0 || j >= (int)y_coords.size() - 1) return false;
+		return inside[j * (x_coords.size() - 1) + i] != 0;
+	}
+
+	/**
+	 * Count the foreground pixels of the target image in [x1, x2) x [y1, y2).
+	 */
+	long long RectilinearIOU::targetCount(int x1, int y1, int x2, int y2) const {
+		x1 = std::max(0, std::min(width, x1 - origin.x));
+		x2 = std::max(0, std::min(width, x2 - origin.x));
+		y1 = std::max(0, std::min(height, y1 - origin.y));
+		y2 = std::max(0, std::min(height, y2 - origin.y));
+		if (x1 >= x2 || y1 >= y2) return 0;
+		return sat[y2 * (width + 1) + x2] - sat[y1 * (width + 1) + x2] - sat[y2 * (width + 1) + x1] + sat[y1 * (width + 1) + x1];
+	}
+
+	/**
+	 * Calculate the change of the pixel counts when the index-th x coordinate is moved by delta.
+	 * Only the pixel columns between the old and the new coordinates change their owner cell column.
+	 */
+	void RectilinearIOU::deltaMovingX(int index, int delta, long long& polygon_delta, long long& inter_delta) const {
+		polygon_delta = 0;
+		inter_delta = 0;
+		if (delta == 0) return;
+
+		int x1 = std::min(x_coords[index], x_coords[index] + delta);
+		int x2 = std::max(x_coords[index], x_coords[index] + delta);
+		int new_col = delta > 0 ? index - 1 : index;
+		int old_col = delta > 0 ? index : index - 1;
+		for (int j = 0; j < (int)y_coords.size() - 1; j++) {
+			int diff = (int)isInside(new_col, j) - (int)isInside(old_col, j);
+			if (diff == 0) continue;
+
+			polygon_delta += diff * (long long)(x2 - x1) * (y_coords[j + 1] - y_coords[j]);
+			inter_delta += diff * targetCount(x1, y_coords[j], x2, y_coords[j + 1]);
+		}
+	}
+
+	/**
+	 * Calculate the change of the pixel counts when the index-th y coordinate is moved by delta.
+	 * Only the pixel rows between the old and the new coordinates change their owner cell row.
+	 */
+	void RectilinearIOU::deltaMovingY(int index, int delta, long long& polygon_delta, long long& inter_delta) const {
+		polygon_delta = 0;
+		inter_delta = 0;
+		if (delta == 0) return;
+
+		int y1 = std::min(y_coords[index], y_coords[index] + delta);
+		int y2 = std::max(y_coords[index], y_coords[index] + delta);
+		int new_row = delta > 0 ? index - 1 : index;
+		int old_row = delta > 0 ? index : index - 1;
+		for (int i = 0; i < (int)x_coords.size() - 1; i++) {
+			int diff = (int)isInside(i, new_row) - (int)isInside(i, old_row);
+			if (diff == 0) continue;
+
+			polygon_delta += diff * (long long)(y2 - y1) * (x_coords[i + 1] - x_coords[i]);
+			inter_delta += diff * targetCount(x_coords[i], y1, x_coords[i + 1], y2);
+		}
+	}
+
+	/**
+	 * The polygon pixels are always inside the target image, so the union is |polygon| + |target| - |intersection|.
+	 */
+	double RectilinearIOU::calculateIOU(long long polygon_cnt, long long inter_cnt) const {
+		return (double)inter_cnt / (polygon_cnt + target_cnt - inter_cnt);
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace util {
+
+	/**
+	 * Incremental IOU between a fixed target image and a rectilinear polygon whose x/y coordinate lines move.
+	 * The coordinate lines of the polygon split the plane into grid cells, and whether each cell is inside the polygon
+	 * does not change as long as the order of the coordinates is kept. Thus, the rasterized polygon is the union of
+	 * the pixel rectangles of the inside cells, and the pixels of the target image inside a cell are counted by
+	 * the summed-area table. Moving one coordinate line only transfers the pixels of the strip between the old and
+	 * the new coordinates from one cell column (row) to the adjacent one, so the IOU change is computed in time
+	 * proportional to the number of the cell rows (columns).
+	 *
+	 * The rasterization matches createImageFromContour(..., erode = true), i.e., a pixel belongs to the polygon
+	 * if the unit square starting at the pixel is inside the polygon.
+	 */
+	class RectilinearIOU {
+	private:
+		int width;
+		int height;
+		cv::Point origin;
+		std::vector<int> sat;
+		std::vector<int> x_coords;
+		std::vector<int> y_coords;
+		std::vector<uchar> inside;
+		long long target_cnt;
+		long long polygon_cnt;
+		long long inter_cnt;
+
+	public:
+		RectilinearIOU();
+
+		bool init(const cv::Mat_<uchar>& target, const cv::Point& origin, const std::vector<cv::Point>& contour, const std::vector<int>& x_coords, const std::vector<int>& y_coords);
+		double iou() const;
+		double iouAfterMovingX(int index, int delta) const;
+		double iouAfterMovingY(int index, int delta) const;
+		void moveX(int index, int delta);
+		void moveY(int index, int delta);
+		const std::vector<int>& xCoords() const { return x_coords; }
+		const std::vector<int>& yCoords() const { return y_coords; }
+
+	private:
+		bool isInside(int i, int j) const;
+		long long targetCount(int x1, int y1, int x2, int y2) const;
+		void deltaMovingX(int index, int delta, long long& polygon_delta, long long& inter_delta) const;
+		void deltaMovingY(int index, int delta, long long& polygon_delta, long long& inter_delta) const;
+		double calculateIOU(long long polygon_cnt, long long inter_cnt) const;
+	};
+
+}
@@ -0,0 +1,305 @@
+#include "SimplicityTest.h"
+#include <set>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace util {
+
+	namespace {
+
+		// error bound of the orientation determinant evaluated in double (Shewchuk, 1997)
+		const double ORIENTATION_ERROR_BOUND = (3.0 + 8.0 * DBL_EPSILON) * DBL_EPSILON * 0.5;
+
+		void twoSum(double a, double b, double& x, double& y) {
+			x = a + b;
+			double bv = x - a;
+			double av = x - bv;
+			y = (a - av) + (b - bv);
+		}
+
+		void twoDiff(double a, double b, double& x, double& y) {
+			x = a - b;
+			double bv = a - x;
+			double av = x + bv;
+			y = (a - av) + (bv - b);
+		}
+
+		void twoProduct(double a, double b, double& x, double& y) {
+			x = a * b;
+			y = std::fma(a, b, -x);
+		}
+
+		/**
+		 * Add a number to the nonoverlapping expansion whose components are in the increasing order of magnitude.
+		 */
+		void growExpansion(double* e, int& n, double b) {
+			double q = b;
+			for (int i = 0; i < n; i++) {
+				double h;
+				twoSum(q, e[i], q, h);
+				e[i] = h;
+			}
+			e[n++] = q;
+		}
+
+		/**
+		 * Return the exact sign of (a - c) x (b - c).
+		 */
+		int exactOrientation(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& c) {
+			double acx[2], acy[2], bcx[2], bcy[2];
+			twoDiff(a.x, c.x, acx[0], acx[1]);
+			twoDiff(a.y, c.y, acy[0], acy[1]);
+			twoDiff(b.x, c.x, bcx[0], bcx[1]);
+			twoDiff(b.y, c.y, bcy[0], bcy[1]);
+
+			double e[17];
+			int n = 0;
+			for (int i = 0; i < 2; i++) {
+				for (int j = 0; j < 2; j++) {
+					double x, y;
+					twoProduct(acx[i], bcy[j], x, y);
+					growExpansion(e, n, x);
+					growExpansion(e, n, y);
+					twoProduct(-acy[i], bcx[j], x, y);
+					growExpansion(e, n, x);
+					growExpansion(e, n, y);
+				}
+			}
+
+			// the most significant nonzero component determines the sign
+			for (int i = n - 1; i >= 0; i--) {
+				if (e[i] > 0) return 1;
+				else if (e[i] < 0) return -1;
+			}
+			return 0;
+		}
+
+	}
+
+	/**
+	 * Compare two edges in the sweep line status. One of them is the edge being inserted, and the other one is
+	 * an edge that crosses the sweep line at the left endpoint of the edge being inserted.
+	 * When the left endpoint lies on the other edge, the rings are touching and the flag is set.
+	 *
+	 * @return	true if e1 is below e2
+	 */
+	bool SimplicityTest::EdgeLess::operator()(int e1, int e2) const {
+		if (e1 == e2) return false;
+
+		int l1 = test->leftVertex(e1);
+		int l2 = test->leftVertex(e2);
+		const cv::Point2d& p1 = test->vertices[l1];
+		const cv::Point2d& p2 = test->vertices[l2];
+
+		if (l1 == l2) {
+			// both edges start at the same vertex
+			int o = orientation(p1, test->vertices[test->rightVertex(e1)], test->vertices[test->rightVertex(e2)]);
+			if (o == 0) test->touching = true;
+			return o > 0;
+		}
+		else if (test->lexLess(l2, l1)) {
+			int o = orientation(p2, test->vertices[test->rightVertex(e2)], p1);
+			if (o == 0) test->touching = true;
+			return o < 0;
+		}
+		else {
+			int o = orientation(p1, test->vertices[test->rightVertex(e1)], p2);
+			if (o == 0) test->touching = true;
+			return o > 0;
+		}
+	}
+
+	SimplicityTest::SimplicityTest() : touching(false) {
+		ring_begin.push_back(0);
+	}
+
+	void SimplicityTest::addRing(const std::vector<cv::Point2f>& ring) {
+		for (int i = 0; i < ring.size(); i++) {
+			addVertex(ring[i].x, ring[i].y);
+		}
+		closeRing();
+	}
+
+	void SimplicityTest::addRing(const std::vector<cv::Point>& ring) {
+		for (int i = 0; i < ring.size(); i++) {
+			addVertex(ring[i].x, ring[i].y);
+		}
+		closeRing();
+	}
+
+	/**
+	 * Test whether the rings added so far are simple.
+	 */
+	bool SimplicityTest::isSimple() {
+		if (vertices.size() == 0) return false;
+		for (int i = 0; i + 1 < ring_begin.size(); i++) {
+			if (ring_begin[i + 1] - ring_begin[i] < 3) return false;
+		}
+
+		// sort the vertices in the lexicographic order, and check whether they are distinct
+		std::vector<int> order(vertices.size());
+		for (int i = 0; i < order.size(); i++) order[i] = i;
+		std::sort(order.begin(), order.end(), [this](int v1, int v2) { return lexLess(v1, v2); });
+		for (int i = 0; i + 1 < order.size(); i++) {
+			if (vertices[order[i]] == vertices[order[i + 1]]) return false;
+		}
+
+		// the consecutive edges must not overlap
+		for (int v = 0; v < vertices.size(); v++) {
+			int prev = prev_vertex[v];
+			int next = next_vertex[v];
+			if (orientation(vertices[prev], vertices[v], vertices[next]) == 0 && lexLess(v, prev) == lexLess(v, next)) return false;
+		}
+
+		// sweep the vertices
+		touching = false;
+		typedef std::set<int, EdgeLess> Status;
+		Status status(EdgeLess(this));
+		std::vector<Status::iterator> positions(vertices.size(), status.end());
+		for (int i = 0; i < order.size(); i++) {
+			int v = order[i];
+
+			// the edges incident to the vertex
+			int edges[2] = { prev_vertex[v], v };
+
+			// remove the edges that end at this vertex
+			for (int k = 0; k < 2; k++) {
+				int e = edges[k];
+				if (rightVertex(e) != v) continue;
+
+				Status::iterator it = positions[e];
+				Status::iterator below = it;
+				Status::iterator above = it;
+				++above;
+				bool has_below = it != status.begin();
+				if (has_below) --below;
+				bool has_above = above != status.end();
+				status.erase(it);
+				positions[e] = status.end();
+
+				if (has_below && has_above && intersects(*below, *above)) return false;
+			}
+
+			// insert the edges that start at this vertex
+			for (int k = 0; k < 2; k++) {
+				int e = edges[k];
+				if (leftVertex(e) != v) continue;
+
+				Status::iterator it = status.insert(e).first;
+				if (touching) return false;
+				positions[e] = it;
+
+				if (it != status.begin()) {
+					Status::iterator below = it;
+					--below;
+					if (intersects(*below, e)) return false;
+				}
+				Status::iterator above = it;
+				++above;
+				if (above != status.end() && intersects(e, *above)) return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Return the sign of the orientation of the triangle (a, b, c).
+	 * 1 if c is on the left side of the directed line from a to b, -1 if it is on the right side, and 0 if they are collinear.
+	 */
+	int SimplicityTest::orientation(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& c) {
+		double left = (a.x - c.x) * (b.y - c.y);
+		double right = (a.y - c.y) * (b.x - c.x);
+		double det = left - right;
+
+		double det_sum;
+		if (left > 0) {
+			if (right <= 0) return det > 0 ? 1 : (det < 0 ? -1 : 0);
+			det_sum = left + right;
+		}
+		else if (left < 0) {
+			if (right >= 0) return det > 0 ? 1 : (det < 0 ? -1 : 0);
+			det_sum = -left - right;
+		}
+		else {
+			return det > 0 ? 1 : (det < 0 ? -1 : 0);
+		}
+
+		double err_bound = ORIENTATION_ERROR_BOUND * det_sum;
+		if (det > err_bound) return 1;
+		else if (-det > err_bound) return -1;
+
+		return exactOrientation(a, b, c);
+	}
+
+	void SimplicityTest::addVertex(double x, double y) {
+		vertices.push_back(cv::Point2d(x, y));
+	}
+
+	void SimplicityTest::closeRing() {
+		int begin = ring_begin.back();
+		int end = vertices.size();
+		ring_begin.push_back(end);
+
+		next_vertex.resize(end);
+		prev_vertex.resize(end);
+		for (int i = begin; i < end; i++) {
+			next_vertex[i] = i + 1 < end ? i + 1 : begin;
+			prev_vertex[i] = i > begin ? i - 1 : end - 1;
+		}
+	}
+
+	/**
+	 * Return the lexicographically smaller endpoint of the edge from the e-th vertex to the next one.
+	 */
+	int SimplicityTest::leftVertex(int e) const {
+		return lexLess(e, next_vertex[e]) ? e : next_vertex[e];
+	}
+
+	/**
+	 * Return the lexicographically larger endpoint of the edge from the e-th vertex to the next one.
+	 */
+	int SimplicityTest::rightVertex(int e) const {
+		return lexLess(e, next_vertex[e]) ? next_vertex[e] : e;
+	}
+
+	bool SimplicityTest::lexLess(int v1, int v2) const {
+		if (vertices[v1].x != vertices[v2].x) return vertices[v1].x < vertices[v2].x;
+		else return vertices[v1].y < vertices[v2].y;
+	}
+
+	/**
+	 * Return true if the point p, which is collinear with a and b, lies on the segment ab.
+	 */
+	bool SimplicityTest::onSegment(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& p) const {
+		return std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) && std::min(a.y, b.y) <= p.y && p.y <= std::max(a.y, b.y);
+	}
+
+	/**
+	 * Test whether two edges have any common point.
+	 * The consecutive edges are not tested because they share the vertex, and their overlap is checked beforehand.
+	 */
+	bool SimplicityTest::intersects(int e1, int e2) const {
+		if (next_vertex[e1] == e2 || next_vertex[e2] == e1) return false;
+
+		const cv::Point2d& a = vertices[e1];
+		const cv::Point2d& b = vertices[next_vertex[e1]];
+		const cv::Point2d& c = vertices[e2];
+		const cv::Point2d& d = vertices[next_vertex[e2]];
+
+		int o1 = orientation(a, b, c);
+		int o2 = orientation(a, b, d);
+		int o3 = orientation(c, d, a);
+		int o4 = orientation(c, d, b);
+		if (o1 * o2 < 0 && o3 * o4 < 0) return true;
+
+		if (o1 == 0 && onSegment(a, b, c)) return true;
+		if (o2 == 0 && onSegment(a, b, d)) return true;
+		if (o3 == 0 && onSegment(c, d, a)) return true;
+		if (o4 == 0 && onSegment(c, d, b)) return true;
+
+		return false;
+	}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace util {
+
+	/**
+	 * Simplicity test of a set of rings (e.g., the outer contour and the holes of a polygon) by the Shamos-Hoey sweep.
+	 * The rings are simple if no two edges have any common point except the shared vertex of the consecutive edges
+	 * of the same ring. That is, the rings are not allowed to touch each other, and all the vertices have to be distinct.
+	 * A ring that has less than 3 vertices is not simple.
+	 *
+	 * The vertices are swept in the lexicographic order of (x, y), and only the edges that become adjacent
+	 * in the sweep line status are tested for intersection, which takes O(n log n) time in total.
+	 * The orientation predicate is evaluated in double with an error bound, and evaluated exactly
+	 * by the floating-point expansion only when the sign cannot be determined by the error bound,
+	 * so that the collinear and touching cases are decided exactly.
+	 */
+	class SimplicityTest {
+	private:
+		std::vector<cv::Point2d> vertices;
+		std::vector<int> ring_begin;
+		std::vector<int> next_vertex;
+		std::vector<int> prev_vertex;
+		bool touching;
+
+		class EdgeLess {
+		private:
+			SimplicityTest* test;
+
+		public:
+			EdgeLess(SimplicityTest* test) : test(test) {}
+			bool operator()(int e1, int e2) const;
+		};
+
+	public:
+		SimplicityTest();
+
+		void addRing(const std::vector<cv::Point2f>& ring);
+		void addRing(const std::vector<cv::Point>& ring);
+		bool isSimple();
+
+		static int orientation(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& c);
+
+	private:
+		void addVertex(double x, double y);
+		void closeRing();
+		int leftVertex(int e) const;
+		int rightVertex(int e) const;
+		bool lexLess(int v1, int v2) const;
+		bool onSegment(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& p) const;
+		bool intersects(int e1, int e2) const;
+	};
+
+}
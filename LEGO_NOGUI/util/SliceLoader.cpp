@@ -0,0 +1,250 @@
+#include "SliceLoader.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+namespace util {
+
+	/**
+	 * @param num_threads	the number of decoding threads (0 or negative means the number of hardware threads)
+	 */
+	SliceLoader::SliceLoader(int num_threads) : num_threads(ThreadPool::resolveNumThreads(num_threads)), num_slices(0), num_unreadable(0), num_bytes(0), elapsed(0) {
+	}
+
+	/**
+	 * Decode all the slices into one contiguous buffer, which is allocated after decoding the first readable slice.
+	 * The other slices are decoded directly into their places in the buffer.
+	 *
+	 * @param filenames		file paths of the slice images from the bottom to the top
+	 * @return				slice images, which share the contiguous buffer
+	 */
+	std::vector<cv::Mat_<uchar>> SliceLoader::load(const std::vector<std::string>& filenames) {
+		ScopedTimer timer("decode_slices");
+		start();
+
+		// decode the first readable slice to get the size of the slices
+		int first = 0;
+		cv::Mat first_slice;
+		for (; first < filenames.size(); first++) {
+			size_t bytes = 0;
+			bool readable = decode(filenames[first], first_slice, bytes);
+			num_bytes += bytes;
+			if (readable) break;
+			std::cerr << "Slice image could not be read: " << filenames[first] << std::endl;
+			num_unreadable++;
+		}
+		if (first >= filenames.size()) throw "No slice image could be read.";
+
+		int width = first_slice.cols;
+		int height = first_slice.rows;
+		cv::Mat_<uchar> volume = cv::Mat_<uchar>::zeros(height * filenames.size(), width);
+		std::vector<cv::Mat_<uchar>> slices(filenames.size());
+		for (int i = 0; i < filenames.size(); i++) {
+			slices[i] = volume.rowRange(i * height, (i + 1) * height);
+		}
+		first_slice.copyTo(slices[first]);
+
+		std::vector<uchar> readable(filenames.size(), 1);
+		std::vector<uchar> size_mismatch(filenames.size(), 0);
+		std::vector<size_t> bytes(filenames.size(), 0);
+		{
+			ThreadPool pool(std::min(num_threads, std::max(1, (int)filenames.size() - first - 1)));
+			for (int i = first + 1; i < filenames.size(); i++) {
+				pool.enqueue([&, i]() {
+					cv::Mat slice = slices[i];
+					if (!decode(filenames[i], slice, bytes[i])) {
+						readable[i] = 0;
+						slices[i].setTo(0);
+					}
+					else if (slice.data != slices[i].data) {
+						// the slice was reallocated because its size is different
+						size_mismatch[i] = 1;
+					}
+				});
+			}
+			pool.wait();
+		}
+
+		for (int i = first + 1; i < filenames.size(); i++) {
+			num_bytes += bytes[i];
+			if (size_mismatch[i]) throw "Slice images have different sizes.";
+			if (!readable[i]) {
+				std::cerr << "Slice image could not be read: " << filenames[i] << std::endl;
+				num_unreadable++;
+			}
+		}
+
+		num_slices = filenames.size();
+		finish();
+
+		return slices;
+	}
+
+	/**
+	 * Decode the slices concurrently, and pass them to the consumer one by one in the order of the filenames.
+	 * Only a few slices per thread are kept in memory at a time. An unreadable slice is passed as an empty image.
+	 *
+	 * @param filenames		file paths of the slice images from the bottom to the top
+	 * @param consumer		function that is called with the index and the image of each slice in the caller thread
+	 */
+	void SliceLoader::stream(const std::vector<std::string>& filenames, const std::function<void(int, const cv::Mat_<uchar>&)>& consumer) {
+		ScopedTimer timer("decode_slices");
+		start();
+
+		int window = num_threads * 2;
+		std::vector<cv::Mat_<uchar>> slots(window);
+		std::vector<int> decoded_index(window, -1);
+		std::vector<size_t> bytes(window, 0);
+		std::mutex mtx;
+		std::condition_variable decoded;
+		cv::Size size;
+
+		ThreadPool pool(std::min(num_threads, std::max(1, (int)filenames.size())));
+		auto enqueue = [&](int i) {
+			pool.enqueue([&, i]() {
+				cv::Mat slice;
+				size_t slice_bytes = 0;
+				if (!decode(filenames[i], slice, slice_bytes)) slice = cv::Mat();
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					slots[i % window] = slice;
+					bytes[i % window] = slice_bytes;
+					decoded_index[i % window] = i;
+				}
+				decoded.notify_all();
+			});
+		};
+
+		for (int i = 0; i < std::min(window, (int)filenames.size()); i++) {
+			enqueue(i);
+		}
+		for (int i = 0; i < filenames.size(); i++) {
+			cv::Mat_<uchar> slice;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				while (decoded_index[i % window] != i) decoded.wait(lock);
+				slice = slots[i % window];
+				slots[i % window] = cv::Mat_<uchar>();
+				num_bytes += bytes[i % window];
+			}
+			if (i + window < filenames.size()) enqueue(i + window);
+
+			if (slice.empty()) {
+				std::cerr << "Slice image could not be read: " << filenames[i] << std::endl;
+				num_unreadable++;
+			}
+			else if (size.area() == 0) {
+				size = slice.size();
+			}
+			else if (slice.size() != size) {
+				throw "Slice images have different sizes.";
+			}
+
+			consumer(i, slice);
+		}
+
+		num_slices = filenames.size();
+		finish();
+	}
+
+	void SliceLoader::printThroughput(std::ostream& out) const {
+		double sec = elapsed * 1e-6;
+		double mb = num_bytes / 1024.0 / 1024.0;
+		out << num_slices << " slices (" << mb << " MB) were decoded in " << sec << " sec by " << num_threads << " threads";
+		if (sec > 0) out << ": " << num_slices / sec << " slices/sec, " << mb / sec << " MB/sec";
+		out << std::endl;
+		if (num_unreadable > 0) out << num_unreadable << " slices could not be read." << std::endl;
+	}
+
+	/**
+	 * Make the file paths of the slice images in the directory.
+	 *
+	 * @param dir				directory path
+	 * @param files				file names in the directory in the order of the slices
+	 * @param skip_first_file	true if the first file is not a slice (e.g., the JSON interface, where the first file is skipped)
+	 * @return					file paths of the slice images
+	 */
+	std::vector<std::string> SliceLoader::sliceFilenames(const std::string& dir, const std::vector<std::string>& files, bool skip_first_file) {
+		std::vector<std::string> filenames;
+		for (int i = skip_first_file ? 1 : 0; i < files.size(); i++) {
+			filenames.push_back(dir + "/" + files[i]);
+		}
+		return filenames;
+	}
+
+	/**
+	 * Read the compressed bytes of the slice image, and decode them as a grayscale image.
+	 * If the slice already has the same size as the image, the image is decoded into its buffer.
+	 *
+	 * @param filename		file path of the slice image
+	 * @param slice			decoded slice image
+	 * @param num_bytes		the number of the compressed bytes
+	 * @return				false if the file could not be read or decoded
+	 */
+	bool SliceLoader::decode(const std::string& filename, cv::Mat& slice, size_t& num_bytes) {
+		num_bytes = 0;
+		std::ifstream in(filename, std::ios::binary);
+		if (!in) return false;
+
+		in.seekg(0, std::ios::end);
+		std::streamoff size = in.tellg();
+		in.seekg(0, std::ios::beg);
+		if (size <= 0) return false;
+
+		std::vector<uchar> buffer((size_t)size);
+		if (!in.read((char*)buffer.data(), size)) return false;
+		num_bytes = buffer.size();
+
+		try {
+			cv::imdecode(buffer, cv::IMREAD_GRAYSCALE, &slice);
+		}
+		catch (...) {
+			return false;
+		}
+		return !slice.empty();
+	}
+
+	/**
+	 * Read the size of the slice image without decoding its pixels.
+	 * The size of a PNG image is read from its header, and the other formats are decoded.
+	 *
+	 * @param filename	file path of the slice image
+	 * @param size		the size of the image
+	 * @return			true if the size is read
+	 */
+	bool SliceLoader::readSize(const std::string& filename, cv::Size& size) {
+		std::ifstream in(filename, std::ios::binary);
+		if (!in) return false;
+
+		// PNG signature followed by the IHDR chunk, which stores the width and the height in big endian
+		static const uchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		uchar header[24];
+		if (in.read((char*)header, sizeof(header)) && std::equal(signature, signature + 8, header) && std::equal(header + 12, header + 16, "IHDR")) {
+			size.width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+			size.height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+			return true;
+		}
+
+		cv::Mat slice;
+		size_t num_bytes;
+		if (!decode(filename, slice, num_bytes)) return false;
+		size = slice.size();
+		return true;
+	}
+
+	void SliceLoader::start() {
+		num_slices = 0;
+		num_unreadable = 0;
+		num_bytes = 0;
+		elapsed = Profiler::now();
+	}
+
+	void SliceLoader::finish() {
+		elapsed = Profiler::now() - elapsed;
+	}
+
+}
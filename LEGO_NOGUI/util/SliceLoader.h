@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <opencv2/opencv.hpp>
+
+namespace util {
+
+	/**
+	 * Decoder of the slice images that decodes multiple slices concurrently.
+	 * Each worker reads the compressed bytes of its slice and inflates them, so that the file reads of
+	 * the following slices are prefetched while the preceding slices are being decoded.
+	 * The slices are always returned in the order of the filenames, and all of them have to have the same size.
+	 * A slice that cannot be read is treated as an empty slice.
+	 */
+	class SliceLoader {
+	private:
+		int num_threads;
+		int num_slices;
+		int num_unreadable;
+		size_t num_bytes;
+		long long elapsed;
+
+	public:
+		SliceLoader(int num_threads = 0);
+
+		std::vector<cv::Mat_<uchar>> load(const std::vector<std::string>& filenames);
+		void stream(const std::vector<std::string>& filenames, const std::function<void(int, const cv::Mat_<uchar>&)>& consumer);
+		void printThroughput(std::ostream& out) const;
+
+		static std::vector<std::string> sliceFilenames(const std::string& dir, const std::vector<std::string>& files, bool skip_first_file);
+		static bool decode(const std::string& filename, cv::Mat& slice, size_t& num_bytes);
+		static bool readSize(const std::string& filename, cv::Size& size);
+
+	private:
+		void start();
+		void finish();
+	};
+
+}
@@ -0,0 +1,91 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace util {
+
+	/**
+	 * Start the worker threads.
+	 *
+	 * @param num_threads	the number of worker threads (0 or negative means the number of hardware threads)
+	 */
+	ThreadPool::ThreadPool(int num_threads) : num_active(0), stopping(false) {
+		num_threads = resolveNumThreads(num_threads);
+		for (int i = 0; i < num_threads; i++) {
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+		}
+	}
+
+	/**
+	 * Finish all the pending tasks, and join the worker threads.
+	 */
+	ThreadPool::~ThreadPool() {
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		task_available.notify_all();
+		for (int i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	void ThreadPool::enqueue(const std::function<void()>& task) {
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			tasks.push(task);
+		}
+		task_available.notify_one();
+	}
+
+	/**
+	 * Block until the queue is empty and no worker is running a task.
+	 */
+	void ThreadPool::wait() {
+		std::unique_lock<std::mutex> lock(mtx);
+		while (!tasks.empty() || num_active > 0) {
+			all_done.wait(lock);
+		}
+	}
+
+	int ThreadPool::size() const {
+		return workers.size();
+	}
+
+	/**
+	 * Convert the user-specified number of threads to the actual one.
+	 * Zero or negative value means that all the hardware threads are used.
+	 */
+	int ThreadPool::resolveNumThreads(int num_threads) {
+		if (num_threads > 0) return num_threads;
+		return std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				while (!stopping && tasks.empty()) {
+					task_available.wait(lock);
+				}
+				if (tasks.empty()) return;
+
+				task = tasks.front();
+				tasks.pop();
+				num_active++;
+			}
+
+			try {
+				task();
+			}
+			catch (...) {}
+
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				num_active--;
+				if (tasks.empty() && num_active == 0) all_done.notify_all();
+			}
+		}
+	}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace util {
+
+	/**
+	 * Fixed-size pool of worker threads that execute the enqueued tasks in FIFO order.
+	 * The tasks have to catch their own exceptions; an exception leaking out of a task is swallowed.
+	 */
+	class ThreadPool {
+	private:
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mtx;
+		std::condition_variable task_available;
+		std::condition_variable all_done;
+		int num_active;
+		bool stopping;
+
+	public:
+		ThreadPool(int num_threads);
+		~ThreadPool();
+
+		void enqueue(const std::function<void()>& task);
+		void wait();
+		int size() const;
+
+		static int resolveNumThreads(int num_threads);
+
+	private:
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+		void workerLoop();
+	};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+namespace util {
+
+	/**
+	 * Disjoint-set forest over consecutive 32-bit labels.
+	 * The root of each set is always its smallest label, so the order of the first
+	 * appearance of the sets is preserved when the labels are made consecutive.
+	 */
+	class UnionFind {
+	public:
+		std::vector<int> parent;
+
+	public:
+		UnionFind() {}
+
+		int add() {
+			parent.push_back(parent.size());
+			return parent.size() - 1;
+		}
+
+		int size() const {
+			return parent.size();
+		}
+
+		int find(int label) {
+			while (parent[label] != label) {
+				// path halving
+				parent[label] = parent[parent[label]];
+				label = parent[label];
+			}
+			return label;
+		}
+
+		int merge(int label1, int label2) {
+			int root1 = find(label1);
+			int root2 = find(label2);
+			if (root1 < root2) {
+				parent[root2] = root1;
+				return root1;
+			}
+			else {
+				parent[root1] = root2;
+				return root2;
+			}
+		}
+
+		/**
+		 * Assign consecutive ids to the sets in the order of their smallest labels.
+		 *
+		 * @param ids	the resultant id of each label
+		 * @return		the number of sets
+		 */
+		int flatten(std::vector<int>& ids) {
+			ids.resize(parent.size());
+			int num_sets = 0;
+			for (int i = 0; i < parent.size(); i++) {
+				int root = find(i);
+				if (root == i) ids[i] = num_sets++;
+				else ids[i] = ids[root];
+			}
+			return num_sets;
+		}
+	};
+
+}
@@ -1,40 +1,167 @@
 #include "DisjointVoxelData.h"
 #include "ContourUtils.h"
+#include "ContourTracer.h"
+#include <algorithm>
 
 namespace util {
 
-	int VoxelBuilding::voxelCountSum(int height) {
+	void VoxelBoundingBox::addVoxel(int x, int y, int z) {
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		min_z = std::min(min_z, z);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+		max_z = std::max(max_z, z);
+	}
+
+	int VoxelBuilding::voxelCountSum(int z) const {
 		int ans = 0;
-		for (auto voxel_node : node_stack[height]) {
-			ans += voxel_node->voxel_count;
+		for (uint32_t node = sliceBegin(z); node < sliceEnd(z); node++) {
+			ans += voxel_counts[node];
 		}
 		return ans;
 	}
 
-	void VoxelBuilding::removeNode(int z, int index) {
-		std::shared_ptr<VoxelNode> node = node_stack[z][index];
+	/**
+	 * Return the bytes of the node arrays, the bit masks, and the adjacency arrays.
+	 * The merge tree of the layering is not included.
+	 */
+	size_t VoxelBuilding::memoryBytes() const {
+		size_t bytes = sizeof(VoxelBuilding);
+		bytes += heights.capacity() * sizeof(int) + voxel_counts.capacity() * sizeof(int) + rects.capacity() * sizeof(cv::Rect) + masks.capacity() * sizeof(BinaryMask);
+		for (int i = 0; i < masks.size(); i++) {
+			bytes += masks[i].bits.capacity() * sizeof(uint64_t);
+		}
+		bytes += (slice_offsets.capacity() + parent_offsets.capacity() + parent_ids.capacity() + child_offsets.capacity() + child_ids.capacity()) * sizeof(uint32_t);
+		return bytes;
+	}
 
-		for (auto it = node->children.begin(); it != node->children.end(); it++) {
-			it->first->parents.erase(node);
-			if (it->first->parents.size() == 0) {
-				removeNode(z + 1, it->first);
+	/**
+	 * Return the index of the slice that contains the node.
+	 */
+	int VoxelBuilding::sliceOf(uint32_t node) const {
+		return std::upper_bound(slice_offsets.begin(), slice_offsets.end(), node) - slice_offsets.begin() - 1;
+	}
+
+	/**
+	 * Extract the contour of the node from its voxel mask.
+	 * The contour is in the world coordinate system, in which the center of the slice is the origin and the y direction is upward.
+	 *
+	 * @param node	node id
+	 * @return		contour of the node
+	 */
+	Polygon VoxelBuilding::contour(uint32_t node) const {
+		const cv::Rect& rect = rects[node];
+		cv::Mat_<int> labels(rect.size(), -1);
+		for (int r = 0; r < rect.height; r++) {
+			for (int c = 0; c < rect.width; c++) {
+				if (masks[node].get(c, r)) labels(r, c) = 0;
 			}
 		}
-		
-		for (auto it = node->parents.begin(); it != node->parents.end(); it++) {
-			it->first->children.erase(node);
+
+		std::vector<std::vector<Polygon>> polygons = ContourTracer::findContours(labels, 1);
+		if (polygons[0].size() == 0) throw "No contour was found in the voxel mask.";
+		polygons[0][0].translate(rect.x, rect.y);
+		convertCoordinatesOfPolygon(polygons[0][0], volume_size.width, volume_size.height);
+
+		return polygons[0][0];
+	}
+
+	/**
+	 * Extract the contours of all the nodes in the slice.
+	 * The masks of the nodes are labeled in the bounding rectangle of the nodes, which is traced only once.
+	 * The contours are the same as the ones extracted by contour() for each node.
+	 *
+	 * @param z		slice index
+	 * @return		contours of the nodes from sliceBegin(z) to sliceEnd(z) - 1
+	 */
+	std::vector<Polygon> VoxelBuilding::contours(int z) const {
+		std::vector<Polygon> ans;
+		if (sliceBegin(z) == sliceEnd(z)) return ans;
+
+		cv::Rect rect = rects[sliceBegin(z)];
+		for (uint32_t node = sliceBegin(z); node < sliceEnd(z); node++) {
+			rect |= rects[node];
+		}
+
+		cv::Mat_<int> labels(rect.size(), -1);
+		for (uint32_t node = sliceBegin(z); node < sliceEnd(z); node++) {
+			const cv::Rect& node_rect = rects[node];
+			int label = node - sliceBegin(z);
+			for (int r = 0; r < node_rect.height; r++) {
+				int* labels_row = labels[node_rect.y - rect.y + r] + node_rect.x - rect.x;
+				for (int c = 0; c < node_rect.width; c++) {
+					if (masks[node].get(c, r)) labels_row[c] = label;
+				}
+			}
 		}
 
-		node_stack[z].erase(node_stack[z].begin() + index);
+		std::vector<std::vector<Polygon>> polygons = ContourTracer::findContours(labels, sliceEnd(z) - sliceBegin(z));
+		for (int i = 0; i < polygons.size(); i++) {
+			if (polygons[i].size() == 0) throw "No contour was found in the voxel mask.";
+			polygons[i][0].translate(rect.x, rect.y);
+			convertCoordinatesOfPolygon(polygons[i][0], volume_size.width, volume_size.height);
+			ans.push_back(polygons[i][0]);
+		}
+
+		return ans;
 	}
 
-	void VoxelBuilding::removeNode(int z, std::shared_ptr<VoxelNode> node) {
-		for (int i = 0; i < node_stack[z].size(); i++) {
-			if (node_stack[z][i] == node) {
-				removeNode(z, i);
-				break;
+	/**
+	 * Build the adjacency of the nodes.
+	 * The parent edges and the child edges are given separately because they do not have to be symmetric.
+	 *
+	 * @param parent_edges	pairs of (node, parent)
+	 * @param child_edges	pairs of (node, child)
+	 */
+	void VoxelBuilding::setEdges(const std::vector<std::pair<uint32_t, uint32_t>>& parent_edges, const std::vector<std::pair<uint32_t, uint32_t>>& child_edges) {
+		buildAdjacency(numNodes(), parent_edges, parent_offsets, parent_ids);
+		buildAdjacency(numNodes(), child_edges, child_offsets, child_ids);
+	}
+
+	/**
+	 * Convert the coordinates of polygon such that the center of the slice will be the origin
+	 * and the y direction is upward.
+	 *
+	 * @param polygon	polygon
+	 * @param width		width of the slice
+	 * @param height	height of the slice
+	 */
+	void VoxelBuilding::convertCoordinatesOfPolygon(Polygon& polygon, int width, int height) {
+		// convert the polygon coordinates to the world coordinate system
+		for (int i = 0; i < polygon.contour.size(); i++) {
+			polygon.contour[i].x = polygon.contour[i].x - width / 2;
+			polygon.contour[i].y = height / 2 - polygon.contour[i].y;
+		}
+		for (auto& hole : polygon.holes) {
+			for (int j = 0; j < hole.size(); j++) {
+				hole[j].x = hole[j].x - width / 2;
+				hole[j].y = height / 2 - hole[j].y;
 			}
 		}
 	}
 
-}
\ No newline at end of file
+	/**
+	 * Build the compressed sparse row arrays from the edges by the counting sort.
+	 * The adjacent nodes of each node are sorted in the ascending order of the ids.
+	 */
+	void VoxelBuilding::buildAdjacency(int num_nodes, const std::vector<std::pair<uint32_t, uint32_t>>& edges, std::vector<uint32_t>& offsets, std::vector<uint32_t>& ids) {
+		offsets.assign(num_nodes + 1, 0);
+		for (int i = 0; i < edges.size(); i++) {
+			offsets[edges[i].first + 1]++;
+		}
+		for (int i = 0; i < num_nodes; i++) {
+			offsets[i + 1] += offsets[i];
+		}
+
+		ids.resize(edges.size());
+		std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < edges.size(); i++) {
+			ids[next[edges[i].first]++] = edges[i].second;
+		}
+		for (int i = 0; i < num_nodes; i++) {
+			std::sort(ids.begin() + offsets[i], ids.begin() + offsets[i + 1]);
+		}
+	}
+
+}
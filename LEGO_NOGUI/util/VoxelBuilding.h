@@ -1,46 +1,113 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
+#include <limits>
+#include <cstdint>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include "BuildingLayer.h"
 #include "ContourUtils.h"
+#include "BinaryMask.h"
 
 namespace util {
 
+	class LayeringTree;
+
 	/**
-	 * This class represents the connected voxels in the slice.
+	 * Tight 3D bounding box of the voxels in the coordinates of the voxel volume.
+	 * The min and max are inclusive, and an empty box has min greater than max.
 	 */
-	class VoxelNode {
+	class VoxelBoundingBox {
+	public:
+		int min_x;
+		int min_y;
+		int min_z;
+		int max_x;
+		int max_y;
+		int max_z;
+
 	public:
-		int cluster_id;		// cluster id (mainly for debug)
-		int height;
-		int voxel_count;
-		Polygon contour;
-		std::unordered_map<std::shared_ptr<VoxelNode>, bool> parents;
-		std::unordered_map<std::shared_ptr<VoxelNode>, bool> children;
+		VoxelBoundingBox() : min_x(std::numeric_limits<int>::max()), min_y(std::numeric_limits<int>::max()), min_z(std::numeric_limits<int>::max()), max_x(-1), max_y(-1), max_z(-1) {}
+
+		void addVoxel(int x, int y, int z);
+		bool empty() const { return max_x < min_x; }
+		int width() const { return empty() ? 0 : max_x - min_x + 1; }
+		int height() const { return empty() ? 0 : max_y - min_y + 1; }
+		int depth() const { return empty() ? 0 : max_z - min_z + 1; }
+	};
+
+	/**
+	 * Range of node ids in the adjacency arrays of the voxel graph, which can be used in a range-based for loop.
+	 */
+	class NodeRange {
+	private:
+		const uint32_t* first;
+		const uint32_t* last;
 
 	public:
-		VoxelNode() {}
-		VoxelNode(int cluster_id, int height) : cluster_id(cluster_id), height(height) {}
-		VoxelNode(int cluster_id, int height, int voxel_count, const Polygon& contour) : cluster_id(cluster_id), height(height), voxel_count(voxel_count), contour(contour) {}
+		NodeRange(const uint32_t* first, const uint32_t* last) : first(first), last(last) {}
+
+		const uint32_t* begin() const { return first; }
+		const uint32_t* end() const { return last; }
+		int size() const { return last - first; }
+		bool empty() const { return first == last; }
+		uint32_t operator[](int index) const { return first[index]; }
 	};
 
 	/**
 	 * Voxel representation of the building using the graph structure.
+	 * Each node represents the connected voxels in a slice, and is identified by a 32-bit id.
+	 * The attributes of the nodes are stored as a struct of arrays, and the nodes of each slice have
+	 * consecutive ids from the bottom slice to the top one. The voxels of each node are kept as a bit mask
+	 * over its bounding rectangle, and its contour is extracted from the mask only when it is needed.
+	 * The contours of all the nodes in a slice can be extracted at once by tracing the slice only once.
+	 * The edges between the nodes in the adjacent slices are stored in the compressed sparse row format
+	 * for each direction.
 	 */
 	class VoxelBuilding {
 	public:
 		int building_id;
-		std::vector<std::vector<std::shared_ptr<VoxelNode>>> node_stack;
+		VoxelBoundingBox bbox;
+		cv::Size volume_size;
+
+		// attributes of the nodes
+		std::vector<int> heights;
+		std::vector<int> voxel_counts;
+		std::vector<cv::Rect> rects;		// bounding rectangle in the coordinates of the slice
+		std::vector<BinaryMask> masks;		// voxels in the bounding rectangle
+
+		// the nodes of the z-th slice are from slice_offsets[z] to slice_offsets[z + 1] - 1
+		std::vector<uint32_t> slice_offsets;
+
+		// the parents of node v are parent_ids[parent_offsets[v]] to parent_ids[parent_offsets[v + 1] - 1]
+		std::vector<uint32_t> parent_offsets;
+		std::vector<uint32_t> parent_ids;
+		std::vector<uint32_t> child_offsets;
+		std::vector<uint32_t> child_ids;
+
+		// merge tree of the slices, which is built with the graph and is shared by the copies of the building
+		std::shared_ptr<LayeringTree> layering_tree;
 
 	public:
 		VoxelBuilding() : building_id(-1) {}
 		VoxelBuilding(int building_id) : building_id(building_id) {}
 
-		int voxelCountSum(int height);
-		void removeNode(int z, int index);
-		void removeNode(int z, std::shared_ptr<VoxelNode> node);
+		int numNodes() const { return heights.size(); }
+		int numSlices() const { return slice_offsets.size() > 0 ? slice_offsets.size() - 1 : 0; }
+		uint32_t sliceBegin(int z) const { return slice_offsets[z]; }
+		uint32_t sliceEnd(int z) const { return slice_offsets[z + 1]; }
+		int sliceOf(uint32_t node) const;
+		NodeRange parents(uint32_t node) const { return NodeRange(parent_ids.data() + parent_offsets[node], parent_ids.data() + parent_offsets[node + 1]); }
+		NodeRange children(uint32_t node) const { return NodeRange(child_ids.data() + child_offsets[node], child_ids.data() + child_offsets[node + 1]); }
+		int voxelCountSum(int z) const;
+		size_t memoryBytes() const;
+		Polygon contour(uint32_t node) const;
+		std::vector<Polygon> contours(int z) const;
+		void setEdges(const std::vector<std::pair<uint32_t, uint32_t>>& parent_edges, const std::vector<std::pair<uint32_t, uint32_t>>& child_edges);
+
+	private:
+		static void convertCoordinatesOfPolygon(Polygon& polygon, int width, int height);
+		static void buildAdjacency(int num_nodes, const std::vector<std::pair<uint32_t, uint32_t>>& edges, std::vector<uint32_t>& offsets, std::vector<uint32_t>& ids);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,370 @@
+#include "VoxelVolume.h"
+#include "SliceLoader.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+	namespace {
+
+		const char CACHE_MAGIC[8] = { 'L', 'E', 'G', 'O', 'V', 'O', 'X', 0 };
+		const uint32_t CACHE_VERSION = 1;
+
+		struct CacheHeader {
+			char magic[8];
+			uint32_t version;
+			int32_t width;
+			int32_t height;
+			int32_t depth;
+			int32_t words_per_row;
+			int32_t threshold;
+			uint64_t checksum;
+		};
+
+		uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+	}
+
+	VoxelVolume::VoxelVolume() : width(0), height(0), depth(0), words_per_row(0), threshold(0), data(NULL), mapped_data(NULL), mapped_size(0), file_handle(NULL), mapping_handle(NULL) {
+	}
+
+	VoxelVolume::~VoxelVolume() {
+		close();
+	}
+
+	/**
+	 * Build the volume from the decoded slice images.
+	 * Empty slices (e.g., the images that could not be read) are treated as slices without voxels.
+	 *
+	 * @param slices				slice images
+	 * @param voxel_value_threshold	the voxels with value greater than this threshold are set
+	 */
+	void VoxelVolume::build(const std::vector<cv::Mat_<uchar>>& slices, int voxel_value_threshold) {
+		int w = 0;
+		int h = 0;
+		for (int i = 0; i < slices.size(); i++) {
+			if (!slices[i].empty()) {
+				w = slices[i].cols;
+				h = slices[i].rows;
+				break;
+			}
+		}
+
+		reset(w, h, slices.size(), voxel_value_threshold);
+		for (int i = 0; i < slices.size(); i++) {
+			packSlice(slices[i], i);
+		}
+	}
+
+	/**
+	 * Build the volume by decoding the slice images concurrently.
+	 * The decoded slices are packed in order, and only a few decoded slices per thread are kept in memory at a time.
+	 *
+	 * @param filenames				file paths of the slice images from the bottom to the top
+	 * @param voxel_value_threshold	the voxels with value greater than this threshold are set
+	 * @param num_threads			the number of decoding threads (0 - all the hardware threads)
+	 */
+	void VoxelVolume::build(const std::vector<std::string>& filenames, int voxel_value_threshold, int num_threads) {
+		reset(0, 0, filenames.size(), voxel_value_threshold);
+		bool initialized = false;
+		SliceLoader loader(num_threads);
+		loader.stream(filenames, [&](int i, const cv::Mat_<uchar>& slice) {
+			if (slice.empty()) return;
+
+			if (!initialized) {
+				reset(slice.cols, slice.rows, filenames.size(), voxel_value_threshold);
+				initialized = true;
+			}
+			packSlice(slice, i);
+		});
+		loader.printThroughput(std::cout);
+	}
+
+	/**
+	 * Build the volume from the voxel values in memory without copying them.
+	 * The value of the voxel (x, y, z) is voxels[z * slice_stride + y * row_stride + x], where x and y correspond to
+	 * the column and the row of the slice image, and z is the index of the slice from the bottom.
+	 *
+	 * @param voxels				voxel values (1 byte per voxel)
+	 * @param width					the number of the voxels in x direction
+	 * @param height				the number of the voxels in y direction
+	 * @param depth					the number of the slices
+	 * @param row_stride			the number of the bytes between two consecutive rows (at least width)
+	 * @param slice_stride			the number of the bytes between two consecutive slices (at least height * row_stride if depth > 1)
+	 * @param voxel_value_threshold	the voxels with value greater than this threshold are set
+	 */
+	void VoxelVolume::build(const uchar* voxels, int width, int height, int depth, size_t row_stride, size_t slice_stride, int voxel_value_threshold) {
+		if (width < 0 || height < 0 || depth < 0 || row_stride < (size_t)width || (depth > 1 && slice_stride < height * row_stride)) throw "Invalid layout of the voxel values.";
+
+		reset(width, height, depth, voxel_value_threshold);
+		if (width == 0 || height == 0) return;
+		for (int i = 0; i < depth; i++) {
+			cv::Mat_<uchar> slice(height, width, const_cast<uchar*>(voxels + i * slice_stride), row_stride);
+			packSlice(slice, i);
+		}
+	}
+
+	/**
+	 * Load the volume from the cache file if it is valid for the slice images.
+	 * Otherwise, build the volume from the slice images and save it to the cache file for the next time.
+	 *
+	 * @param filenames				file paths of the slice images from the bottom to the top
+	 * @param cache_filename		file path of the cache
+	 * @param voxel_value_threshold	the voxels with value greater than this threshold are set
+	 * @param num_threads			the number of decoding threads (0 - all the hardware threads)
+	 * @return						true if the volume was loaded from the cache file
+	 */
+	bool VoxelVolume::load(const std::vector<std::string>& filenames, const std::string& cache_filename, int voxel_value_threshold, int num_threads) {
+		uint64_t sum = checksum(filenames, voxel_value_threshold);
+		if (open(cache_filename, sum, voxel_value_threshold)) return true;
+
+		build(filenames, voxel_value_threshold, num_threads);
+		if (!save(cache_filename, sum)) {
+			std::cerr << "Voxel cache could not be written: " << cache_filename << std::endl;
+		}
+		return false;
+	}
+
+	/**
+	 * Memory-map the cache file.
+	 *
+	 * @param cache_filename		file path of the cache
+	 * @param checksum				checksum of the source slice images
+	 * @param voxel_value_threshold	threshold that the cache has to be built with
+	 * @return						false if the cache file does not exist or is not valid
+	 */
+	bool VoxelVolume::open(const std::string& cache_filename, uint64_t checksum, int voxel_value_threshold) {
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(cache_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(CacheHeader)) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			return false;
+		}
+		void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (ptr == NULL) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		file_handle = file;
+		mapping_handle = mapping;
+		mapped_data = ptr;
+		mapped_size = (size_t)file_size.QuadPart;
+#else
+		int fd = ::open(cache_filename.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader)) {
+			::close(fd);
+			return false;
+		}
+		void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (ptr == MAP_FAILED) return false;
+		mapped_data = ptr;
+		mapped_size = st.st_size;
+#endif
+
+		// validate the header
+		CacheHeader header;
+		memcpy(&header, mapped_data, sizeof(CacheHeader));
+		bool valid = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.version == CACHE_VERSION && header.checksum == checksum && header.threshold == voxel_value_threshold
+			&& header.width >= 0 && header.height >= 0 && header.depth >= 0 && header.words_per_row == (header.width + 63) / 64
+			&& sizeof(CacheHeader) + (uint64_t)header.depth * sizeof(uint64_t) <= mapped_size;
+		if (valid) {
+			const unsigned char* base = (const unsigned char*)mapped_data;
+			uint64_t slice_size = (uint64_t)header.height * header.words_per_row * sizeof(uint64_t);
+			slice_offsets.resize(header.depth);
+			memcpy(slice_offsets.data(), base + sizeof(CacheHeader), header.depth * sizeof(uint64_t));
+			for (int i = 0; i < header.depth && valid; i++) {
+				if (slice_offsets[i] % sizeof(uint64_t) != 0 || slice_offsets[i] + slice_size > mapped_size) valid = false;
+			}
+		}
+		if (!valid) {
+			close();
+			return false;
+		}
+
+		width = header.width;
+		height = header.height;
+		depth = header.depth;
+		words_per_row = header.words_per_row;
+		threshold = header.threshold;
+		data = (const unsigned char*)mapped_data;
+
+		return true;
+	}
+
+	/**
+	 * Save the volume to the cache file.
+	 *
+	 * @param cache_filename	file path of the cache
+	 * @param checksum			checksum of the source slice images
+	 * @return					false if the file could not be written
+	 */
+	bool VoxelVolume::save(const std::string& cache_filename, uint64_t checksum) const {
+		std::ofstream out(cache_filename, std::ios::binary);
+		if (!out) return false;
+
+		CacheHeader header;
+		memset(&header, 0, sizeof(CacheHeader));
+		memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = CACHE_VERSION;
+		header.width = width;
+		header.height = height;
+		header.depth = depth;
+		header.words_per_row = words_per_row;
+		header.threshold = threshold;
+		header.checksum = checksum;
+		out.write((const char*)&header, sizeof(CacheHeader));
+
+		uint64_t slice_size = (uint64_t)height * words_per_row * sizeof(uint64_t);
+		std::vector<uint64_t> offsets(depth);
+		for (int i = 0; i < depth; i++) {
+			offsets[i] = sizeof(CacheHeader) + (uint64_t)depth * sizeof(uint64_t) + i * slice_size;
+		}
+		out.write((const char*)offsets.data(), depth * sizeof(uint64_t));
+
+		for (int i = 0; i < depth; i++) {
+			out.write((const char*)(data + slice_offsets[i]), slice_size);
+		}
+
+		return out.good();
+	}
+
+	void VoxelVolume::close() {
+		if (mapped_data != NULL) {
+#ifdef _WIN32
+			UnmapViewOfFile(mapped_data);
+			CloseHandle((HANDLE)mapping_handle);
+			CloseHandle((HANDLE)file_handle);
+#else
+			munmap(mapped_data, mapped_size);
+#endif
+		}
+		mapped_data = NULL;
+		mapped_size = 0;
+		file_handle = NULL;
+		mapping_handle = NULL;
+
+		width = 0;
+		height = 0;
+		depth = 0;
+		words_per_row = 0;
+		slice_offsets.clear();
+		owned_bits.clear();
+		data = NULL;
+	}
+
+	/**
+	 * Return the packed bits of the r-th row of the h-th slice.
+	 * The c-th voxel of the row is the (c % 64)-th bit of the (c / 64)-th word.
+	 */
+	const uint64_t* VoxelVolume::row(int h, int r) const {
+		return (const uint64_t*)(data + slice_offsets[h]) + (size_t)r * words_per_row;
+	}
+
+	bool VoxelVolume::get(int c, int r, int h) const {
+		return (row(h, r)[c >> 6] >> (c & 63)) & 1;
+	}
+
+	/**
+	 * Return the h-th slice as an image, in which the set voxels are 255 and the others are 0.
+	 */
+	cv::Mat_<uchar> VoxelVolume::slice(int h) const {
+		cv::Mat_<uchar> img = cv::Mat_<uchar>::zeros(height, width);
+		for (int r = 0; r < height; r++) {
+			const uint64_t* bits = row(h, r);
+			for (int c = 0; c < width; c++) {
+				if ((bits[c >> 6] >> (c & 63)) & 1) img(r, c) = 255;
+			}
+		}
+		return img;
+	}
+
+	/**
+	 * Calculate the checksum of the slice images from their paths and file contents.
+	 * The encoded files are hashed without being decoded, so that validating the cache is much faster than decoding the images.
+	 */
+	uint64_t VoxelVolume::checksum(const std::vector<std::string>& filenames, int voxel_value_threshold) {
+		uint64_t hash = 14695981039346656037ULL;
+		hash = fnv1a(hash, &voxel_value_threshold, sizeof(int));
+		std::vector<char> buffer(1 << 20);
+		for (int i = 0; i < filenames.size(); i++) {
+			hash = fnv1a(hash, filenames[i].c_str(), filenames[i].size() + 1);
+
+			// the size separates the contents of the consecutive files (-1 for a missing file)
+			int64_t file_size = 0;
+			std::ifstream in(filenames[i].c_str(), std::ios::binary);
+			if (!in) file_size = -1;
+			while (in) {
+				in.read(buffer.data(), buffer.size());
+				hash = fnv1a(hash, buffer.data(), in.gcount());
+				file_size += in.gcount();
+			}
+			hash = fnv1a(hash, &file_size, sizeof(file_size));
+		}
+		return hash;
+	}
+
+	void VoxelVolume::reset(int width, int height, int depth, int voxel_value_threshold) {
+		close();
+
+		this->width = width;
+		this->height = height;
+		this->depth = depth;
+		this->words_per_row = (width + 63) / 64;
+		this->threshold = voxel_value_threshold;
+
+		size_t slice_words = (size_t)height * words_per_row;
+		slice_offsets.resize(depth);
+		for (int i = 0; i < depth; i++) {
+			slice_offsets[i] = i * slice_words * sizeof(uint64_t);
+		}
+		owned_bits.assign(slice_words * depth, 0);
+		data = (const unsigned char*)owned_bits.data();
+	}
+
+	void VoxelVolume::packSlice(const cv::Mat_<uchar>& slice, int h) {
+		if (slice.empty()) return;
+		if (slice.cols != width || slice.rows != height) throw "Slice images have different sizes.";
+
+		uint64_t* bits = &owned_bits[(size_t)h * height * words_per_row];
+		for (int r = 0; r < height; r++) {
+			const uchar* voxel_row = slice[r];
+			for (int c = 0; c < width; c++) {
+				if (voxel_row[c] > threshold) bits[c >> 6] |= (uint64_t)1 << (c & 63);
+			}
+			bits += words_per_row;
+		}
+	}
+
+}
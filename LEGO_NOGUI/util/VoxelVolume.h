@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+namespace util {
+
+	/**
+	 * Read-only binary voxel volume whose rows are packed into 64-bit words (1 bit per voxel).
+	 * A voxel is set if the value of the corresponding pixel in the slice image is greater than the threshold.
+	 *
+	 * The volume can be cached in a file, which is memory-mapped when it is loaded again.
+	 * The cache file consists of a header, the byte offsets of the slices, and the packed rows of each slice.
+	 * The header stores the dimensions, the threshold, and a checksum of the names and the file contents
+	 * of the source slice images, so that the cache is rebuilt when the source images are changed.
+	 */
+	class VoxelVolume {
+	private:
+		int width;
+		int height;
+		int depth;
+		int words_per_row;
+		int threshold;
+		std::vector<uint64_t> slice_offsets;
+		std::vector<uint64_t> owned_bits;
+		const unsigned char* data;
+
+		// memory mapping of the cache file
+		void* mapped_data;
+		size_t mapped_size;
+		void* file_handle;
+		void* mapping_handle;
+
+	public:
+		VoxelVolume();
+		~VoxelVolume();
+
+		void build(const std::vector<cv::Mat_<uchar>>& slices, int voxel_value_threshold = 128);
+		void build(const std::vector<std::string>& filenames, int voxel_value_threshold = 128, int num_threads = 0);
+		void build(const uchar* voxels, int width, int height, int depth, size_t row_stride, size_t slice_stride, int voxel_value_threshold = 128);
+		bool load(const std::vector<std::string>& filenames, const std::string& cache_filename, int voxel_value_threshold = 128, int num_threads = 0);
+		bool open(const std::string& cache_filename, uint64_t checksum, int voxel_value_threshold);
+		bool save(const std::string& cache_filename, uint64_t checksum) const;
+		void close();
+
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+		int getDepth() const { return depth; }
+		int getWordsPerRow() const { return words_per_row; }
+		bool isMapped() const { return mapped_data != NULL; }
+		const uint64_t* row(int h, int r) const;
+		bool get(int c, int r, int h) const;
+		cv::Mat_<uchar> slice(int h) const;
+
+		static uint64_t checksum(const std::vector<std::string>& filenames, int voxel_value_threshold);
+
+	private:
+		VoxelVolume(const VoxelVolume&);
+		VoxelVolume& operator=(const VoxelVolume&);
+		void reset(int width, int height, int depth, int voxel_value_threshold);
+		void packSlice(const cv::Mat_<uchar>& slice, int h);
+	};
+
+}
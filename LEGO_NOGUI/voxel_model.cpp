@@ -61,7 +61,7 @@ namespace voxel_model {
             for (int i=0; i<mat.rows; i++) {
                 for (int j=0; j<mat.cols; j++) {
                     
-					if (k>0 && k<nslices && i>0 && i<mat.rows - 1 && j>0 && j<mat.cols - 1)
+					if (k>0 && k<nslices - 1 && i>0 && i<mat.rows - 1 && j>0 && j<mat.cols - 1)
 						if (voxel_data[k - 1](i, j) >= thresh && voxel_data[k + 1](i, j) >= thresh)
 							if (voxel_data[k](i - 1, j) >= thresh && voxel_data[k](i + 1, j) >= thresh)
 								if (voxel_data[k](i, j - 1) >= thresh && voxel_data[k](i, j + 1) >= thresh)
@@ -1,5 +1,15 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <clocale>
+#include <cfloat>
 #include "util/ContourUtils.h"
+#include "util/BinaryMask.h"
+#include "util/RectilinearIOU.h"
+#include "util/OBJWriter.h"
+#include "regularizer/ScoreGradient.h"
+#include "efficient_ransac/EfficientRANSAC.h"
 #include "simp/RightAngleSimplification.h"
 #include "simp/CurveRightAngleSimplification.h"
 
@@ -71,6 +81,857 @@ void testSimplification(const char* filename) {
 	}
 }
 
+/**
+ * Reference implementation of util::findContours, which fills the diagonal connections, upscales the image by 4x,
+ * dilates it, and calls cv::findContours.
+ */
+std::vector<util::Polygon> findContoursByUpscaling(const cv::Mat_<uchar>& img) {
+	std::vector<util::Polygon> ans;
+
+	cv::Mat_<uchar> img2 = img.clone();
+	while (true) {
+		bool updated = false;
+		for (int r = 0; r < img.rows - 1; r++) {
+			for (int c = 0; c < img.cols - 1; c++) {
+				if (img2(r, c) == 255 && img2(r + 1, c + 1) == 255 && img2(r + 1, c) == 0 && img2(r, c + 1) == 0) {
+					updated = true;
+					img2(r + 1, c) = 255;
+				}
+				else if (img2(r, c) == 0 && img2(r + 1, c + 1) == 0 && img2(r + 1, c) == 255 && img2(r, c + 1) == 255) {
+					updated = true;
+					img2(r, c) = 255;
+				}
+			}
+		}
+		if (!updated) break;
+	}
+
+	cv::Mat_<uchar> img3;
+	cv::resize(img2, img3, cv::Size(img.cols * 4, img.rows * 4), 0, 0, cv::INTER_NEAREST);
+	cv::Mat_<uchar> padded = cv::Mat_<uchar>::zeros(img3.rows + 1, img3.cols + 1);
+	img3.copyTo(padded(cv::Rect(0, 0, img3.cols, img3.rows)));
+	cv::Mat_<uchar> kernel = (cv::Mat_<uchar>(3, 3) << 1, 1, 0, 1, 1, 0, 0, 0, 0);
+	cv::dilate(padded, padded, kernel);
+
+	std::vector<std::vector<cv::Point>> contours;
+	std::vector<cv::Vec4i> hierarchy;
+	cv::findContours(padded, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
+
+	for (int i = 0; i < hierarchy.size(); i++) {
+		if (hierarchy[i][3] != -1) continue;
+		if (contours[i].size() < 3) continue;
+
+		util::Polygon polygon;
+		util::Ring contour = util::addCornerToOpenCVContour(contours[i], padded);
+		for (int j = 0; j < contour.size(); j++) {
+			polygon.contour.push_back(cv::Point2f(std::round(contour[j].x * 0.25), std::round(contour[j].y * 0.25)));
+		}
+		polygon.contour = util::removeRedundantPoint(polygon.contour);
+
+		if (polygon.contour.size() >= 3) {
+			int hole_id = hierarchy[i][2];
+			while (hole_id != -1) {
+				util::Ring hole = util::addCornerToOpenCVContour(contours[hole_id], padded);
+				for (int j = 0; j < hole.size(); j++) {
+					hole[j] = cv::Point2f(std::round(hole[j].x * 0.25), std::round(hole[j].y * 0.25));
+				}
+				polygon.holes.push_back(util::removeRedundantPoint(hole));
+				hole_id = hierarchy[hole_id][0];
+			}
+			ans.push_back(polygon);
+		}
+	}
+
+	return ans;
+}
+
+/**
+ * Compare the contours traced at the native resolution with the reference that upscales the image.
+ * The polygons have to have the same vertices, and their IOU has to be exactly 1.
+ */
+void testFindContoursByTracing() {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "findContours tracing testing..." << std::endl;
+
+	const char* filenames[13] = { "complex_contour.png", "contour_test1.png", "contour_test2.png", "contour_test3.png", "contour_test4.png", "contour_test5.png", "contour_test6.png", "contour_test7.png", "contour_test8.png", "simplify_test1.png", "simplify_test2.png", "simplify_test3.png", "simplify_test4.png" };
+	int num_errors = 0;
+	for (int i = 0; i < 13; i++) {
+		cv::Mat_<uchar> img = cv::imread(filenames[i], cv::IMREAD_GRAYSCALE);
+		if (img.empty()) continue;
+		cv::threshold(img, img, 128, 255, cv::THRESH_BINARY);
+
+		int64 start = cv::getTickCount();
+		std::vector<util::Polygon> ref_polygons = findContoursByUpscaling(img);
+		double ref_time = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+		start = cv::getTickCount();
+		std::vector<util::Polygon> polygons = util::findContours(img, true);
+		double time = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+		bool same = polygons.size() == ref_polygons.size();
+		for (int j = 0; j < polygons.size() && same; j++) {
+			if (polygons[j].contour.points != ref_polygons[j].contour.points || polygons[j].holes.size() != ref_polygons[j].holes.size()) same = false;
+			for (int k = 0; k < polygons[j].holes.size() && same; k++) {
+				if (polygons[j].holes[k].points != ref_polygons[j].holes[k].points) same = false;
+			}
+		}
+		double iou = polygons.size() > 0 ? util::calculateIOU(polygons, ref_polygons) : 1;
+		if (!same || iou != 1) num_errors++;
+
+		std::cout << filenames[i] << ": " << polygons.size() << " polygons, IOU " << iou << (same ? "" : " (different vertices)") << ", " << ref_time * 1000 << " ms -> " << time * 1000 << " ms" << std::endl;
+	}
+
+	std::cout << num_errors << " errors" << std::endl;
+}
+
+/**
+ * Compare the bit-packed IOU with the one computed by the CV_8U image-based approach.
+ * Both the rasterized pixels and the resultant IOU values have to match exactly.
+ */
+void testCalculateIOU(int num_trials) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "calculateIOU testing..." << std::endl;
+
+	cv::RNG rng(12345);
+	int num_mask_errors = 0;
+	int num_iou_errors = 0;
+	for (int trial = 0; trial < num_trials; trial++) {
+		int width = rng.uniform(1, 200);
+		int height = rng.uniform(1, 200);
+
+		std::vector<std::vector<cv::Point2f>> polygons(2);
+		for (int k = 0; k < 2; k++) {
+			int num_points = rng.uniform(3, 12);
+			for (int i = 0; i < num_points; i++) {
+				polygons[k].push_back(cv::Point2f(rng.uniform(0.0f, (float)width), rng.uniform(0.0f, (float)height)));
+			}
+		}
+
+		// rasterize the polygons by OpenCV
+		int min_x = INT_MAX;
+		int min_y = INT_MAX;
+		int max_x = INT_MIN;
+		int max_y = INT_MIN;
+		for (int k = 0; k < 2; k++) {
+			for (int i = 0; i < polygons[k].size(); i++) {
+				min_x = std::min(min_x, (int)polygons[k][i].x);
+				min_y = std::min(min_y, (int)polygons[k][i].y);
+				max_x = std::max(max_x, (int)(polygons[k][i].x + 0.5));
+				max_y = std::max(max_y, (int)(polygons[k][i].y + 0.5));
+			}
+		}
+
+		cv::Mat_<uchar> imgs[2];
+		for (int k = 0; k < 2; k++) {
+			std::vector<std::vector<cv::Point>> contour_points(1);
+			for (int i = 0; i < polygons[k].size(); i++) {
+				contour_points[0].push_back(cv::Point(polygons[k][i].x - min_x, polygons[k][i].y - min_y));
+			}
+			imgs[k] = cv::Mat_<uchar>::zeros(max_y - min_y + 1, max_x - min_x + 1);
+			cv::fillPoly(imgs[k], contour_points, cv::Scalar(255), cv::LINE_4);
+
+			util::BinaryMask mask(max_x - min_x + 1, max_y - min_y + 1);
+			mask.fillPoly(contour_points);
+			for (int r = 0; r < imgs[k].rows; r++) {
+				for (int c = 0; c < imgs[k].cols; c++) {
+					if ((imgs[k](r, c) == 255) != mask.get(c, r)) {
+						num_mask_errors++;
+						r = imgs[k].rows;
+						break;
+					}
+				}
+			}
+		}
+
+		int inter_cnt = 0;
+		int union_cnt = 0;
+		for (int r = 0; r < imgs[0].rows; r++) {
+			for (int c = 0; c < imgs[0].cols; c++) {
+				if (imgs[0](r, c) == 255 && imgs[1](r, c) == 255) inter_cnt++;
+				if (imgs[0](r, c) == 255 || imgs[1](r, c) == 255) union_cnt++;
+			}
+		}
+		double expected = (double)inter_cnt / union_cnt;
+		double actual = util::calculateIOU(polygons[0], polygons[1]);
+		if (expected != actual) num_iou_errors++;
+	}
+
+	std::cout << num_trials << " trials: " << num_mask_errors << " mask mismatches, " << num_iou_errors << " IOU mismatches" << std::endl;
+}
+
+/**
+ * Generate a rectilinear polygon of integer coordinates whose top is a staircase over random columns.
+ */
+std::vector<cv::Point> generateStaircase(cv::RNG& rng, int x, int y, int size) {
+	int num_columns = rng.uniform(1, 6);
+	std::vector<int> xs;
+	xs.push_back(x);
+	for (int i = 0; i < num_columns; i++) {
+		xs.push_back(xs.back() + rng.uniform(2, size / num_columns + 3));
+	}
+
+	// the polygon goes along the bottom from the left to the right, and comes back along the top of each column
+	std::vector<cv::Point> polygon;
+	polygon.push_back(cv::Point(xs.front(), y + size));
+	polygon.push_back(cv::Point(xs.back(), y + size));
+	for (int i = num_columns - 1; i >= 0; i--) {
+		int top = y + rng.uniform(0, size - 1);
+		polygon.push_back(cv::Point(xs[i + 1], top));
+		polygon.push_back(cv::Point(xs[i], top));
+	}
+	return polygon;
+}
+
+/**
+ * Compare the incremental IOU of RectilinearIOU with the image-based IOUs on random rectilinear polygons.
+ * After each move of a coordinate line, the IOU has to match the one of the re-rasterized images
+ * (createImageFromContour and calculateIOU) exactly, as optimizeVertices of RightAngleSimplification relies on it.
+ * It also has to agree with calculateIOUbyImage, which rasterizes the polygons at a different resolution, within the tolerance.
+ * The largest difference is printed, and it was 0.0038 for these 300 trials.
+ */
+void testRectilinearIOU(int num_trials, float tolerance) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "RectilinearIOU testing..." << std::endl;
+
+	cv::RNG rng(12345);
+	int num_checks = 0;
+	int num_exact_errors = 0;
+	int num_image_errors = 0;
+	double max_image_error = 0;
+	for (int trial = 0; trial < num_trials; trial++) {
+		std::vector<cv::Point> target = generateStaircase(rng, rng.uniform(0, 20), rng.uniform(0, 20), rng.uniform(10, 60));
+		std::vector<cv::Point> polygon = generateStaircase(rng, rng.uniform(0, 20), rng.uniform(0, 20), rng.uniform(10, 60));
+
+		// the image covers both polygons, as in optimizeVertices
+		int min_x = INT_MAX;
+		int min_y = INT_MAX;
+		int max_x = INT_MIN;
+		int max_y = INT_MIN;
+		for (int i = 0; i < target.size() + polygon.size(); i++) {
+			const cv::Point& p = i < target.size() ? target[i] : polygon[i - target.size()];
+			min_x = std::min(min_x, p.x);
+			min_y = std::min(min_y, p.y);
+			max_x = std::max(max_x, p.x);
+			max_y = std::max(max_y, p.y);
+		}
+		cv::Mat_<uchar> img;
+		util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, target, cv::Point(-min_x, -min_y), img);
+
+		std::vector<int> x_keys;
+		std::vector<int> y_keys;
+		for (int i = 0; i < polygon.size(); i++) {
+			x_keys.push_back(polygon[i].x);
+			y_keys.push_back(polygon[i].y);
+		}
+		std::sort(x_keys.begin(), x_keys.end());
+		x_keys.erase(std::unique(x_keys.begin(), x_keys.end()), x_keys.end());
+		std::sort(y_keys.begin(), y_keys.end());
+		y_keys.erase(std::unique(y_keys.begin(), y_keys.end()), y_keys.end());
+
+		util::RectilinearIOU evaluator;
+		if (!evaluator.init(img, cv::Point(min_x, min_y), polygon, x_keys, y_keys)) {
+			num_exact_errors++;
+			continue;
+		}
+
+		for (int step = 0; step < 10; step++) {
+			// the moved polygon, in which each vertex takes the current coordinate lines
+			std::vector<cv::Point> moved_polygon(polygon.size());
+			std::vector<cv::Point2f> moved_polygon_f(polygon.size());
+			for (int i = 0; i < polygon.size(); i++) {
+				int ix = std::lower_bound(x_keys.begin(), x_keys.end(), polygon[i].x) - x_keys.begin();
+				int iy = std::lower_bound(y_keys.begin(), y_keys.end(), polygon[i].y) - y_keys.begin();
+				moved_polygon[i] = cv::Point(evaluator.xCoords()[ix], evaluator.yCoords()[iy]);
+				moved_polygon_f[i] = cv::Point2f(moved_polygon[i].x, moved_polygon[i].y);
+			}
+			std::vector<cv::Point2f> target_f(target.begin(), target.end());
+
+			cv::Mat_<uchar> img2;
+			util::createImageFromContour(max_x - min_x + 1, max_y - min_y + 1, moved_polygon, cv::Point(-min_x, -min_y), img2);
+			num_checks++;
+			if (evaluator.iou() != util::calculateIOU(img, img2)) num_exact_errors++;
+			double image_error = std::abs(evaluator.iou() - util::calculateIOUbyImage(target_f, moved_polygon_f, 1000));
+			max_image_error = std::max(max_image_error, image_error);
+			if (image_error > tolerance) num_image_errors++;
+
+			// move a random coordinate line by one within the image, keeping the order of the coordinates
+			int axis = rng.uniform(0, 2);
+			const std::vector<int>& coords = axis == 0 ? evaluator.xCoords() : evaluator.yCoords();
+			int index = rng.uniform(0, (int)coords.size());
+			int delta = rng.uniform(0, 2) == 0 ? -1 : 1;
+			int lower = index > 0 ? coords[index - 1] : (axis == 0 ? min_x : min_y);
+			int upper = index + 1 < coords.size() ? coords[index + 1] : (axis == 0 ? max_x : max_y);
+			if (coords[index] + delta < lower || coords[index] + delta > upper) continue;
+			double expected = axis == 0 ? evaluator.iouAfterMovingX(index, delta) : evaluator.iouAfterMovingY(index, delta);
+			if (axis == 0) evaluator.moveX(index, delta);
+			else evaluator.moveY(index, delta);
+			if (evaluator.iou() != expected) num_exact_errors++;
+		}
+	}
+
+	std::cout << num_trials << " trials (" << num_checks << " checks): " << num_exact_errors << " mismatches with calculateIOU, " << num_image_errors << " differences from calculateIOUbyImage over " << tolerance << " (max " << max_image_error << ")" << std::endl;
+}
+
+/**
+ * Generate an L-shaped polygon whose vertices are perturbed randomly.
+ */
+std::vector<cv::Point2f> generateLShape(cv::RNG& rng, float cx, float cy, float w, float h, float noise) {
+	std::vector<cv::Point2f> polygon;
+	polygon.push_back(cv::Point2f(cx - w, cy - h));
+	polygon.push_back(cv::Point2f(cx + w, cy - h));
+	polygon.push_back(cv::Point2f(cx + w, cy + h));
+	polygon.push_back(cv::Point2f(cx - w * 0.2f, cy + h));
+	polygon.push_back(cv::Point2f(cx - w * 0.2f, cy + h * 0.3f));
+	polygon.push_back(cv::Point2f(cx - w, cy + h * 0.3f));
+	for (int i = 0; i < polygon.size(); i++) {
+		polygon[i].x += rng.uniform(-noise, noise);
+		polygon[i].y += rng.uniform(-noise, noise);
+	}
+	return polygon;
+}
+
+/**
+ * Compare the analytic gradient with the central finite difference of the score function.
+ * The scores are only piecewise smooth, so the vertices whose finite differences with
+ * step h and h/2 do not agree are skipped as kinks.
+ */
+void checkGradient(const std::function<double(const std::vector<cv::Point2f>&)>& score, const std::vector<cv::Point2f>& polygon, const std::vector<cv::Point2d>& grad, int& num_checks, int& num_errors) {
+	const double h = 1e-3;
+	for (int i = 0; i < polygon.size(); i++) {
+		for (int c = 0; c < 2; c++) {
+			double fd[2];
+			for (int k = 0; k < 2; k++) {
+				double step = h / (k + 1);
+				std::vector<cv::Point2f> p1 = polygon;
+				std::vector<cv::Point2f> p2 = polygon;
+				if (c == 0) {
+					p1[i].x += step;
+					p2[i].x -= step;
+				}
+				else {
+					p1[i].y += step;
+					p2[i].y -= step;
+				}
+				fd[k] = (score(p1) - score(p2)) / (step * 2);
+			}
+			if (std::abs(fd[0] - fd[1]) > 0.002 * std::max(1.0, std::abs(fd[0]))) continue;
+
+			num_checks++;
+			double analytic = c == 0 ? grad[i].x : grad[i].y;
+			if (std::abs(analytic - fd[0]) > 0.02 * std::max(1.0, std::abs(fd[0]))) num_errors++;
+		}
+	}
+}
+
+void testScoreGradient(int num_trials) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "ScoreGradient testing..." << std::endl;
+
+	cv::RNG rng(12345);
+	int num_checks = 0;
+	int num_errors = 0;
+	int num_value_errors = 0;
+	int num_image_errors = 0;
+	for (int trial = 0; trial < num_trials; trial++) {
+		std::vector<cv::Point2d> grad;
+
+		// right angle
+		std::vector<cv::Point2f> init_polygon = generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.0f);
+		std::vector<cv::Point2f> polygon = init_polygon;
+		for (int i = 0; i < polygon.size(); i++) {
+			polygon[i].x += rng.uniform(-0.02f, 0.02f);
+			polygon[i].y += rng.uniform(-0.02f, 0.02f);
+		}
+		float score = regularizer::scoreRaOpt(polygon, init_polygon, 10, grad);
+		if (score != util::calculateScoreRaOpt(polygon, init_polygon, 10)) num_value_errors++;
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScoreRaOpt(p, init_polygon, 10); }, polygon, grad, num_checks, num_errors);
+
+		// parallel
+		std::vector<cv::Point2f> init_parallel_polygon;
+		init_parallel_polygon.push_back(cv::Point2f(0.1f, 0.1f));
+		init_parallel_polygon.push_back(cv::Point2f(0.5f, 0.135f));
+		init_parallel_polygon.push_back(cv::Point2f(0.9f, 0.1f));
+		init_parallel_polygon.push_back(cv::Point2f(0.9f, 0.8f));
+		init_parallel_polygon.push_back(cv::Point2f(0.1f, 0.8f));
+		std::vector<cv::Point2f> parallel_polygon = init_parallel_polygon;
+		for (int i = 0; i < parallel_polygon.size(); i++) {
+			parallel_polygon[i].x += rng.uniform(-0.01f, 0.01f);
+			parallel_polygon[i].y += rng.uniform(-0.01f, 0.01f);
+		}
+		score = regularizer::scoreParallelOpt(parallel_polygon, init_parallel_polygon, 10, grad);
+		if (score != util::calculateScoreParallelOpt(parallel_polygon, init_parallel_polygon, 10)) num_value_errors++;
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScoreParallelOpt(p, init_parallel_polygon, 10); }, parallel_polygon, grad, num_checks, num_errors);
+
+		// point and segment snapping to the parent layer
+		std::vector<cv::Point2f> init_src = generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.0f);
+		std::vector<cv::Point2f> src = generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.02f);
+		std::vector<std::vector<cv::Point2f>> init_des(1, generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.0f));
+		std::vector<std::vector<cv::Point2f>> des(1, generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.03f));
+		std::vector<std::vector<cv::Point2d>> grad_des;
+		score = regularizer::scorePointOpt(src, init_src, des, init_des, 0.08f, grad, grad_des);
+		if (std::abs(score - util::calculateScorePointOpt(src, init_src, des, init_des, 0.08f)) > 1e-5) num_value_errors++;
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScorePointOpt(p, init_src, des, init_des, 0.08f); }, src, grad, num_checks, num_errors);
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScorePointOpt(src, init_src, std::vector<std::vector<cv::Point2f>>(1, p), init_des, 0.08f); }, des[0], grad_des[0], num_checks, num_errors);
+		score = regularizer::scoreSegOpt(src, init_src, des, init_des, 0.08f, 10, grad, grad_des);
+		if (std::abs(score - util::calculateScoreSegOpt(src, init_src, des, init_des, 0.08f, 10)) > 1e-5) num_value_errors++;
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScoreSegOpt(p, init_src, des, init_des, 0.08f, 10); }, src, grad, num_checks, num_errors);
+		checkGradient([&](const std::vector<cv::Point2f>& p) { return util::calculateScoreSegOpt(src, init_src, std::vector<std::vector<cv::Point2f>>(1, p), init_des, 0.08f, 10); }, des[0], grad_des[0], num_checks, num_errors);
+
+		// IOU
+		std::vector<cv::Point2f> polygon1 = generateLShape(rng, 0.5f, 0.5f, 0.3f, 0.25f, 0.05f);
+		std::vector<cv::Point2f> polygon2 = generateLShape(rng, 0.55f, 0.45f, 0.28f, 0.3f, 0.05f);
+		std::vector<cv::Point2d> grad2;
+		double iou = regularizer::iouGradient(polygon1, polygon2, grad, grad2);
+		if (util::isSimple(polygon1) && util::isSimple(polygon2) && std::abs(iou - util::calculateIOUbyCGAL(polygon1, polygon2)) > 1e-4) num_value_errors++;
+		checkGradient([&](const std::vector<cv::Point2f>& p) { std::vector<cv::Point2d> g1, g2; return regularizer::iouGradient(p, polygon2, g1, g2); }, polygon1, grad, num_checks, num_errors);
+		checkGradient([&](const std::vector<cv::Point2f>& p) { std::vector<cv::Point2d> g1, g2; return regularizer::iouGradient(polygon1, p, g1, g2); }, polygon2, grad2, num_checks, num_errors);
+
+		cv::Point2f a(0.5f, 0.0f);
+		cv::Point2f b(0.52f, 1.0f);
+		regularizer::symmetryIOUGradient(polygon1, a, b, grad);
+		checkGradient([&](const std::vector<cv::Point2f>& p) { std::vector<cv::Point2d> g; return regularizer::symmetryIOUGradient(p, a, b, g); }, polygon1, grad, num_checks, num_errors);
+
+		// IOU by the image, which is piecewise constant, so a step along the gradient has to increase it
+		iou = regularizer::imageIOUGradient(polygon1, polygon2, regularizer::IOU_IMAGE_SIZE, grad, grad2);
+		if (iou != util::calculateIOUbyImage(polygon1, polygon2, regularizer::IOU_IMAGE_SIZE)) num_value_errors++;
+		double norm = 0;
+		for (int i = 0; i < grad.size(); i++) norm += grad[i].dot(grad[i]);
+		if (norm > 0) {
+			std::vector<cv::Point2f> stepped = polygon1;
+			for (int i = 0; i < stepped.size(); i++) {
+				stepped[i] += cv::Point2f(grad[i].x, grad[i].y) * (float)(0.01 / std::sqrt(norm));
+			}
+			if (util::calculateIOUbyImage(stepped, polygon2, regularizer::IOU_IMAGE_SIZE) <= iou) num_image_errors++;
+		}
+	}
+
+	std::cout << num_trials << " trials: " << num_value_errors << " score mismatches, " << num_errors << " gradient mismatches out of " << num_checks << " checks, " << num_image_errors << " image IOU steps that do not increase the IOU" << std::endl;
+}
+
+/**
+ * Compare the shapes detected by the efficient RANSAC with and without the preemptive verification by SPRT.
+ * The numbers of the shapes have to be the same, and the start/end indices of the corresponding shapes
+ * have to match within the given ratio of the number of the contour points.
+ */
+void testEfficientRansac(const char* filename, float tolerance) {
+	cv::Mat img = cv::imread(filename, cv::IMREAD_GRAYSCALE);
+
+	// extract contours
+	std::vector<util::Polygon> contours = util::findContours(img, false);
+
+	for (int i = 0; i < contours.size(); i++) {
+		const std::vector<cv::Point2f>& contour = contours[i].contour.points;
+		int N = contour.size();
+		if (N < 100) continue;
+
+		// use the principal orientation, +45, +90, +135 degrees as principal orientations
+		float principal_orientation = util::estimate(contour);
+		std::vector<float> principal_orientations;
+		for (int j = 0; j < 4; j++) {
+			principal_orientations.push_back(principal_orientation + CV_PI * j / 4);
+		}
+
+		// same parameters as the default ones of the efficient RANSAC simplification
+		cv::Rect bbox = cv::boundingRect(contour);
+		float line_cluster_epsilon = std::max(3.0f, 0.02f * N);
+		float line_min_length = 0.03f * sqrt(bbox.width * bbox.width + bbox.height * bbox.height);
+
+		std::vector<std::pair<int, std::shared_ptr<efficient_ransac::PrimitiveShape>>> shapes[2];
+		efficient_ransac::EfficientRANSAC er[2];
+		for (int k = 0; k < 2; k++) {
+			er[k].setPreemptiveVerification(k == 1);
+			shapes[k] = er[k].detect(contour, 200000, 200, 0.02f, 30, CV_PI * 0.5f, 80, 400, 20000, 0.03f * N, 5, line_cluster_epsilon, line_min_length, 15.0f / 180.0f * CV_PI, principal_orientations);
+			std::sort(shapes[k].begin(), shapes[k].end());
+		}
+
+		int num_errors = 0;
+		if (shapes[0].size() != shapes[1].size()) {
+			num_errors = std::max(shapes[0].size(), shapes[1].size());
+		}
+		else {
+			for (int j = 0; j < shapes[0].size(); j++) {
+				if (std::abs(shapes[0][j].second->startIndex() - shapes[1][j].second->startIndex()) > tolerance * N || std::abs(shapes[0][j].second->endIndex() - shapes[1][j].second->endIndex()) > tolerance * N) {
+					num_errors++;
+				}
+			}
+		}
+
+		std::cout << filename << " contour " << i << ": " << shapes[0].size() << " / " << shapes[1].size() << " shapes, " << num_errors << " mismatches, " << er[1].numAcceptedHypotheses() << " accepted and " << er[1].numRejectedHypotheses() << " rejected by SPRT" << std::endl;
+	}
+}
+
+/**
+ * Compare the sweep-based simplicity test with CGAL.
+ * Each ring is compared with CGAL::Polygon_2::is_simple on random rings, whose vertices are on a small grid
+ * in half of the trials so that duplicate vertices, collinear edges, and touching edges often occur.
+ * The polygons with holes are compared with the CGAL-based reference on random rings in general position.
+ */
+void testIsSimple(int num_trials) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "isSimple testing..." << std::endl;
+
+	cv::RNG rng(12345);
+	int num_ring_errors = 0;
+	int num_polygon_errors = 0;
+	for (int trial = 0; trial < num_trials; trial++) {
+		bool degenerate = trial % 2 == 0;
+		int grid_size = rng.uniform(3, 10);
+
+		util::Polygon polygon;
+		int num_rings = rng.uniform(1, 4);
+		for (int k = 0; k < num_rings; k++) {
+			util::Ring ring;
+			int num_points = rng.uniform(3, 10);
+			for (int i = 0; i < num_points; i++) {
+				if (degenerate) {
+					ring.push_back(cv::Point2f(rng.uniform(0, grid_size) * 0.5f, rng.uniform(0, grid_size) * 0.5f));
+				}
+				else {
+					ring.push_back(cv::Point2f(rng.uniform(0.0f, 100.0f), rng.uniform(0.0f, 100.0f)));
+				}
+			}
+
+			CGAL::Polygon_2<util::Kernel> pgn;
+			for (int i = 0; i < ring.size(); i++) {
+				pgn.push_back(util::Kernel::Point_2(ring[i].x, ring[i].y));
+			}
+			if (util::isSimple(ring) != pgn.is_simple()) num_ring_errors++;
+
+			if (k == 0) polygon.contour = ring;
+			else polygon.holes.push_back(ring);
+		}
+
+		if (!degenerate && util::isSimple(polygon) != util::isSimpleByCGAL(polygon)) num_polygon_errors++;
+	}
+
+	// degenerate polygons with holes
+	int num_fixture_errors = 0;
+	util::Polygon polygon;
+	polygon.contour = std::vector<cv::Point2f>{ cv::Point2f(0, 0), cv::Point2f(10, 0), cv::Point2f(10, 10), cv::Point2f(0, 10) };
+	polygon.holes.push_back(std::vector<cv::Point2f>{ cv::Point2f(2, 2), cv::Point2f(2, 8), cv::Point2f(8, 8), cv::Point2f(8, 2) });
+	if (!util::isSimple(polygon)) num_fixture_errors++;
+	polygon.holes.push_back(std::vector<cv::Point2f>{ cv::Point2f(8, 5), cv::Point2f(9, 4), cv::Point2f(9, 6) });
+	if (util::isSimple(polygon)) num_fixture_errors++;
+	polygon.holes.back() = std::vector<cv::Point2f>{ cv::Point2f(10, 5), cv::Point2f(9, 4), cv::Point2f(9, 6) };
+	if (util::isSimple(polygon)) num_fixture_errors++;
+	polygon.holes.back() = std::vector<cv::Point2f>{ cv::Point2f(8, 8), cv::Point2f(9, 9), cv::Point2f(8, 9) };
+	if (util::isSimple(polygon)) num_fixture_errors++;
+	polygon.holes.back() = std::vector<cv::Point2f>{ cv::Point2f(0.1f, 0.1f), cv::Point2f(0.7f, 0.7f), cv::Point2f(0.3f, 0.3f) };
+	if (util::isSimple(polygon)) num_fixture_errors++;
+
+	std::cout << num_trials << " trials: " << num_ring_errors << " ring mismatches, " << num_polygon_errors << " polygon mismatches, " << num_fixture_errors << " fixture errors" << std::endl;
+}
+
+/**
+ * Reference implementation of the oriented bounding box, which rotates all the points for every edge direction.
+ */
+cv::Rect calculateOBBByAllEdges(const std::vector<cv::Point2f>& polygon, cv::Mat_<float>& trans_mat) {
+	cv::Rect ans(0, 0, 0, 0);
+	trans_mat = (cv::Mat_<float>(2, 2) << 1, 0, 0, 1);
+	int min_area = std::numeric_limits<int>::max();
+
+	for (int i = 0; i < polygon.size(); i++) {
+		int next = (i + 1) % polygon.size();
+		if (util::length(polygon[next] - polygon[i]) == 0) continue;
+
+		float theta = std::atan2(polygon[next].y - polygon[i].y, polygon[next].x - polygon[i].x);
+		cv::Mat_<float> mat = (cv::Mat_<float>(2, 2) << std::cos(theta), std::sin(theta), -std::sin(theta), std::cos(theta));
+
+		std::vector<cv::Point2f> rotated_polygon(polygon.size());
+		for (int j = 0; j < polygon.size(); j++) {
+			cv::Mat_<float> p = (cv::Mat_<float>(2, 1) << polygon[j].x, polygon[j].y);
+			cv::Mat_<float> p2 = mat * p;
+			rotated_polygon[j] = cv::Point2f(p2(0, 0), p2(1, 0));
+		}
+
+		cv::Rect rect = util::boundingBox(rotated_polygon);
+		if (rect.width * rect.height < min_area) {
+			min_area = rect.width * rect.height;
+			ans = rect;
+			trans_mat = mat;
+		}
+	}
+
+	return ans;
+}
+
+/**
+ * Generate a random star-shaped ring, whose vertices are optionally snapped to the integer grid.
+ */
+std::vector<cv::Point2f> generateStarRing(cv::RNG& rng, int num_points, bool snap) {
+	std::vector<cv::Point2f> ring(num_points);
+	float cx = rng.uniform(0.0f, 500.0f);
+	float cy = rng.uniform(0.0f, 500.0f);
+	for (int i = 0; i < num_points; i++) {
+		float angle = CV_PI * 2 * i / num_points;
+		float radius = rng.uniform(5.0f, 100.0f);
+		ring[i] = cv::Point2f(cx + radius * std::cos(angle), cy + radius * std::sin(angle));
+		if (snap) ring[i] = cv::Point2f(std::round(ring[i].x), std::round(ring[i].y));
+	}
+	return ring;
+}
+
+/**
+ * Compare the rotating-calipers oriented bounding box with the reference that tries all the edges for all the points.
+ * The contours of the test images and random rings are used. The box has to have the same orientation
+ * (modulo 90 degrees) and the same size, or at least the same area up to the truncation to the integer grid.
+ */
+void testOBB(int num_trials) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "calculateOBB testing..." << std::endl;
+
+	std::vector<std::vector<cv::Point2f>> rings;
+	const char* filenames[13] = { "complex_contour.png", "contour_test1.png", "contour_test2.png", "contour_test3.png", "contour_test4.png", "contour_test5.png", "contour_test6.png", "contour_test7.png", "contour_test8.png", "simplify_test1.png", "simplify_test2.png", "simplify_test3.png", "simplify_test4.png" };
+	for (int i = 0; i < 13; i++) {
+		cv::Mat img = cv::imread(filenames[i], cv::IMREAD_GRAYSCALE);
+		if (img.empty()) continue;
+		std::vector<util::Polygon> polygons = util::findContours(img, false);
+		for (int j = 0; j < polygons.size(); j++) {
+			rings.push_back(polygons[j].contour.points);
+			for (int k = 0; k < polygons[j].holes.size(); k++) {
+				rings.push_back(polygons[j].holes[k].points);
+			}
+
+			// the simplified contours have edges of arbitrary directions
+			util::Polygon simplified_polygon;
+			util::approxPolyDP(polygons[j].contour.points, simplified_polygon.contour.points, 2, true);
+			rings.push_back(simplified_polygon.contour.points);
+		}
+	}
+	int num_contours = rings.size();
+
+	cv::RNG rng(12345);
+	for (int trial = 0; trial < num_trials; trial++) {
+		rings.push_back(generateStarRing(rng, rng.uniform(3, 60), trial % 2 == 0));
+	}
+
+	int num_differences = 0;
+	int num_errors = 0;
+	for (int i = 0; i < rings.size(); i++) {
+		cv::Mat_<float> ref_mat;
+		cv::Mat_<float> mat;
+		cv::Rect ref_obb = calculateOBBByAllEdges(rings[i], ref_mat);
+		cv::Rect obb = util::calculateOBB(rings[i], mat);
+
+		float diff = std::fmod(std::abs(std::atan2(mat(0, 1), mat(0, 0)) - std::atan2(ref_mat(0, 1), ref_mat(0, 0))), (float)CV_PI * 0.5f);
+		diff = std::min(diff, (float)CV_PI * 0.5f - diff);
+		bool same_size = (obb.width == ref_obb.width && obb.height == ref_obb.height) || (obb.width == ref_obb.height && obb.height == ref_obb.width);
+		if (diff < 0.001f && same_size) continue;
+
+		num_differences++;
+		if (std::abs(obb.area() - ref_obb.area()) > ref_obb.width + ref_obb.height + 1) num_errors++;
+	}
+
+	std::cout << num_contours << " contours and " << num_trials << " random rings: " << num_differences << " differences, " << num_errors << " errors" << std::endl;
+}
+
+/**
+ * Measure the time of calculating the oriented bounding box of random rings of 10 to 10,000 vertices,
+ * and compare it with the reference. The reference is skipped for 10,000 vertices, which takes too long.
+ */
+void benchmarkOBB(int num_iterations) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "calculateOBB benchmark..." << std::endl;
+
+	cv::RNG rng(12345);
+	int num_points[4] = { 10, 100, 1000, 10000 };
+	for (int k = 0; k < 4; k++) {
+		std::vector<cv::Point2f> ring = generateStarRing(rng, num_points[k], false);
+
+		cv::Mat_<float> mat;
+		int checksum = 0;
+		int64 start = cv::getTickCount();
+		for (int iter = 0; iter < num_iterations; iter++) {
+			checksum += util::calculateOBB(ring, mat).area();
+		}
+		double new_time = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+		std::cout << num_points[k] << " points (checksum " << checksum << "): ";
+		if (num_points[k] <= 1000) {
+			int ref_iterations = std::max(1, num_iterations * 10 / num_points[k]);
+			start = cv::getTickCount();
+			for (int iter = 0; iter < ref_iterations; iter++) {
+				checksum += calculateOBBByAllEdges(ring, mat).area();
+			}
+			double ref_time = (cv::getTickCount() - start) / cv::getTickFrequency();
+			std::cout << ref_time / ref_iterations * 1e6 << " us -> ";
+		}
+		std::cout << new_time / num_iterations * 1e6 << " us" << std::endl;
+	}
+}
+
+/**
+ * Reference implementation of the principal orientation, which votes the contour points to the Hough accumulator.
+ * It returns the orientation of the normal of the lines in radian [0, PI).
+ */
+float estimateByHough(const std::vector<cv::Point2f>& polygon) {
+	int max_rho = 0;
+	for (auto& pt : polygon) {
+		max_rho = std::max(max_rho, (int)std::ceil(pt.x * pt.x + pt.y * pt.y));
+	}
+
+	cv::Mat_<float> HT(max_rho * 2 + 1, 180, 0.0f);
+	for (auto& pt : polygon) {
+		for (int angle = 0; angle < 180; angle++) {
+			float rho = pt.x * std::cos((float)angle / 180.0f * CV_PI) + pt.y * std::sin((float)angle / 180.0f * CV_PI);
+			HT(std::round(rho) + max_rho, angle)++;
+		}
+	}
+
+	HT = HT.mul(HT);
+	cv::Mat sumHT;
+	cv::reduce(HT, sumHT, 0, cv::REDUCE_SUM);
+
+	float max_votes = 0;
+	int max_angle = 0;
+	for (int c = 0; c < sumHT.cols; c++) {
+		if (sumHT.at<float>(0, c) > max_votes) {
+			max_votes = sumHT.at<float>(0, c);
+			max_angle = c;
+		}
+	}
+
+	return max_angle / 180.0f * CV_PI;
+}
+
+/**
+ * Return the difference between two orientations modulo 90 degrees in degree.
+ */
+float orientationError(float angle1, float angle2) {
+	float diff = std::fmod(std::abs(angle1 - angle2), (float)CV_PI * 0.5f);
+	return std::min(diff, (float)CV_PI * 0.5f - diff) / CV_PI * 180;
+}
+
+/**
+ * Compare the histogram-based principal orientation with the Hough-based reference on rotated synthetic footprints.
+ * A rectangle, an L shape, or a U shape is rotated by a random angle, rasterized, and traced by util::findContours.
+ * The estimated orientations are compared with the true rotation modulo 90 degrees.
+ * The footprints are kept small because the Hough accumulator grows with the squared distance from the origin.
+ */
+void testEstimate(int num_trials, float tolerance) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "estimate testing..." << std::endl;
+
+	cv::RNG rng(12345);
+	double sum_error = 0;
+	double sum_ref_error = 0;
+	float max_error = 0;
+	float max_ref_error = 0;
+	int num_errors = 0;
+	for (int trial = 0; trial < num_trials; trial++) {
+		float size = rng.uniform(15.0f, 40.0f);
+		float angle = rng.uniform(0.0f, (float)CV_PI * 0.5f);
+
+		std::vector<cv::Point2f> shape;
+		if (trial % 3 == 0) {
+			shape = { cv::Point2f(-1, -0.6f), cv::Point2f(1, -0.6f), cv::Point2f(1, 0.6f), cv::Point2f(-1, 0.6f) };
+		}
+		else if (trial % 3 == 1) {
+			shape = { cv::Point2f(-1, -1), cv::Point2f(1, -1), cv::Point2f(1, 0), cv::Point2f(0, 0), cv::Point2f(0, 1), cv::Point2f(-1, 1) };
+		}
+		else {
+			shape = { cv::Point2f(-1, -1), cv::Point2f(1, -1), cv::Point2f(1, 1), cv::Point2f(0.3f, 1), cv::Point2f(0.3f, 0.4f), cv::Point2f(-0.3f, 0.4f), cv::Point2f(-0.3f, 1), cv::Point2f(-1, 1) };
+		}
+
+		int img_size = size * 3 + 20;
+		std::vector<std::vector<cv::Point>> polygon(1);
+		for (int i = 0; i < shape.size(); i++) {
+			float x = img_size * 0.5f + size * (std::cos(angle) * shape[i].x - std::sin(angle) * shape[i].y);
+			float y = img_size * 0.5f + size * (std::sin(angle) * shape[i].x + std::cos(angle) * shape[i].y);
+			polygon[0].push_back(cv::Point(std::round(x * 16), std::round(y * 16)));
+		}
+		cv::Mat_<uchar> img = cv::Mat_<uchar>::zeros(img_size, img_size);
+		cv::fillPoly(img, polygon, cv::Scalar(255), cv::LINE_8, 4);
+
+		std::vector<util::Polygon> contours = util::findContours(img, false);
+		if (contours.size() == 0) continue;
+
+		float error = orientationError(util::estimate(contours[0].contour.points), angle);
+		float ref_error = orientationError(estimateByHough(contours[0].contour.points), angle);
+		sum_error += error;
+		sum_ref_error += ref_error;
+		max_error = std::max(max_error, error);
+		max_ref_error = std::max(max_ref_error, ref_error);
+		if (error > tolerance) num_errors++;
+	}
+
+	std::cout << num_trials << " footprints:" << std::endl;
+	std::cout << "  histogram error: mean " << sum_error / num_trials << " deg, max " << max_error << " deg" << std::endl;
+	std::cout << "  Hough error:     mean " << sum_ref_error / num_trials << " deg, max " << max_ref_error << " deg" << std::endl;
+	std::cout << num_errors << " errors above " << tolerance << " deg" << std::endl;
+}
+
+/**
+ * Write random vertices to an OBJ file in single and double precision, and parse the file back.
+ * Each coordinate has to be read back to the same value, and "." has to be the decimal point.
+ * The test is repeated with each C locale of the decimal comma that is installed.
+ */
+void testOBJRoundTrip(int num_vertices) {
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "OBJ round trip testing..." << std::endl;
+
+	const char* locales[4] = { "C", "de_DE.UTF-8", "de_DE", "German_Germany.1252" };
+	int num_errors = 0;
+	for (int k = 0; k < 4; k++) {
+		if (setlocale(LC_NUMERIC, locales[k]) == NULL) {
+			std::cout << locales[k] << ": not installed" << std::endl;
+			continue;
+		}
+
+		cv::RNG rng(12345);
+		std::vector<cv::Point3f> float_points(num_vertices);
+		std::vector<cv::Point3d> double_points(num_vertices);
+		for (int i = 0; i < num_vertices; i++) {
+			double scale = std::pow(10.0, rng.uniform(-8, 9));
+			float_points[i] = cv::Point3f(rng.uniform(-1.0f, 1.0f) * scale, rng.uniform(-1.0f, 1.0f) * scale, (float)i / 10);
+			double_points[i] = cv::Point3d(rng.uniform(-1.0, 1.0) * scale, rng.uniform(-1.0, 1.0) * scale, (double)i / 10);
+		}
+		float_points[0] = cv::Point3f(0.1f, FLT_MIN, FLT_MAX);
+		float_points[1] = cv::Point3f(-0.0f, 1e-45f, -123456.789f);
+		double_points[0] = cv::Point3d(0.1, DBL_MIN, DBL_MAX);
+		double_points[1] = cv::Point3d(-0.0, 5e-324, -123456.789);
+
+		{
+			// a small buffer so that the values are also written across the flushes
+			util::obj::OutputBuffer file("obj_round_trip.obj", 256);
+			for (int i = 0; i < num_vertices; i++) {
+				file << "v " << float_points[i].x << " " << float_points[i].y << " " << float_points[i].z << "\n";
+			}
+			for (int i = 0; i < num_vertices; i++) {
+				file << "v " << double_points[i].x << " " << double_points[i].y << " " << double_points[i].z << "\n";
+			}
+		}
+		setlocale(LC_NUMERIC, "C");
+
+		std::ifstream in("obj_round_trip.obj");
+		std::string line;
+		int num_lines = 0;
+		while (std::getline(in, line)) {
+			if (line.find(',') != std::string::npos) num_errors++;
+
+			std::istringstream iss(line);
+			iss.imbue(std::locale::classic());
+			std::string tag;
+			iss >> tag;
+			if (num_lines < num_vertices) {
+				cv::Point3f pt;
+				iss >> pt.x >> pt.y >> pt.z;
+				if (tag != "v" || iss.fail() || memcmp(&pt, &float_points[num_lines], sizeof(pt)) != 0) num_errors++;
+			}
+			else if (num_lines < num_vertices * 2) {
+				cv::Point3d pt;
+				iss >> pt.x >> pt.y >> pt.z;
+				if (tag != "v" || iss.fail() || memcmp(&pt, &double_points[num_lines - num_vertices], sizeof(pt)) != 0) num_errors++;
+			}
+			num_lines++;
+		}
+		if (num_lines != num_vertices * 2) num_errors++;
+		std::cout << locales[k] << ": " << num_lines << " vertices read" << std::endl;
+	}
+
+	std::cout << num_errors << " mismatches" << std::endl;
+}
+
 int main() {
 	testApproxPolyDP("complex_contour.png");
 
@@ -82,11 +943,34 @@ int main() {
 	testFindContour("contour_test6.png");
 	testFindContour("contour_test7.png");
 	testFindContour("contour_test8.png");
+
+	testFindContoursByTracing();
 	
 	testSimplification("simplify_test1.png");
 	testSimplification("simplify_test2.png");
 	testSimplification("simplify_test3.png");
 	testSimplification("simplify_test4.png");
 
+	testCalculateIOU(1000);
+
+	testOBJRoundTrip(10000);
+
+	testRectilinearIOU(300, 0.01f);
+
+	testScoreGradient(300);
+
+	testIsSimple(10000);
+
+
+	testOBB(10000);
+	benchmarkOBB(1000);
+
+	testEstimate(300, 2.0f);
+
+	testEfficientRansac("simplify_test1.png", 0.01f);
+	testEfficientRansac("simplify_test2.png", 0.01f);
+	testEfficientRansac("simplify_test3.png", 0.01f);
+	testEfficientRansac("simplify_test4.png", 0.01f);
+
 	return 0;
 }
\ No newline at end of file
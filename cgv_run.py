@@ -1,5 +1,7 @@
 #######################################################################
 # Process all the buildings in the data folder
+#
+# All the clusters are listed in a manifest, and processed by one LEGO_NOGUI process in the batch mode.
 
 from os.path import isfile, join
 from PIL import Image
@@ -10,38 +12,110 @@ import json
 import subprocess
 import sys
 
-def main(data_dir, weight, algorithm, output_dir):
+def legacy_layering_threshold(alpha):
+	# the same table as the layering threshold of the legacy command line interface
+	for upper, threshold in [(0.1, 0.1), (0.2, 0.3), (0.3, 0.4), (0.4, 0.5), (0.5, 0.6), (0.7, 0.6), (0.9, 0.7)]:
+		if alpha < upper:
+			return threshold
+	return 0.99
+
+def legacy_epsilon(alpha):
+	# the same table as the DP epsilon and the right angle resolution of the legacy command line interface
+	if alpha <= 0.06:
+		return 24
+	for upper, epsilon in [(0.1, 18), (0.2, 12), (0.4, 10), (0.6, 8), (0.8, 4), (0.9, 4)]:
+		if alpha < upper:
+			return epsilon
+	return 2
+
+def default_config(weight, algorithm):
+	# The parameters are derived from the weight in the same way as the legacy command line interface,
+	# so that the same geometry is generated. The legacy interface always uses all the algorithms
+	# regardless of the algorithm option, and so does this configuration.
+	alpha = min(max(0.0, float(weight)), 1.0)
+	epsilon = legacy_epsilon(alpha)
+	angle_threshold = 20 if alpha < 0.2 else 10
+	return {
+		"contour_simplification_weight": alpha,
+		"layering_threshold": legacy_layering_threshold(alpha),
+		"contour_snapping_threshold": 0.0,
+		"bulk_orientation": 0.0,
+		"minimum_contour_area": 0.0,
+		"maximum_obb_ratio": 10.0,
+		"allow_triangle_contour": True,
+		"allow_overhang": True,
+		"min_hole_ratio": 0.02,
+		"minimum_layer_height": 2.5,
+		"skip_first_slice_file": False,
+		"contour_simplification_algorithms": {
+			"douglas_peucker": { "use": True, "epsilon": epsilon },
+			"right_angle": { "use": True, "epsilon": epsilon, "optimization": True },
+			"curve": { "use": True, "epsilon": epsilon, "curve_threshold": 2.0 },
+			"curvepp": { "use": True, "epsilon": epsilon, "curve_threshold": 2.0, "angle_threshold": angle_threshold }
+		},
+		"regularizer": { "num_runs": 0 }
+	}
+
+def main(data_dir, weight, algorithm, output_dir, config_file, num_concurrent_clusters, num_concurrent_loads, memory_budget_mb, streaming_slab_budget_mb, voxel_cache):
 	# Create the output directory if not exists
 	if not os.path.exists(output_dir):
 		os.mkdir(output_dir)
-	
+
+	cur_path = os.path.dirname(os.path.realpath(__file__))
+
+	clusters = []
 	for cluster_folder in sorted(os.listdir(data_dir + "/BuildingClusters/")):
-		print(cluster_folder)
-		
 		cluster_path = data_dir + "/BuildingClusters/" + cluster_folder
-		
+
 		# read metadata.json
 		metadata = json.load(open(cluster_path + "/cluster_" + cluster_folder + "__metadata.json"))
 
-		# set the cgv tool arguments
-		cur_path = os.path.dirname(os.path.realpath(__file__))
-		intput_file_path = cur_path + "/" + cluster_path + "/Slices/slice_000000.png"
-		output_obj_path = cur_path + "/" + output_dir + "/" + cluster_folder + "_building.obj"
-		output_topface_path = cur_path + "/" + output_dir + "/" + cluster_folder + "_building.txt"
-		
-		# run cgv tool
-		subprocess.call(["cgv/LEGO_NOGUI", intput_file_path, weight, algorithm, str(metadata["position"][0]), str(metadata["position"][1]), "0", str(metadata["voxel_size"]), output_obj_path, output_topface_path], cwd = "cgv")
+		# set the parameters of the cluster
+		clusters.append({
+			"name": cluster_folder,
+			"input_slice_dir": cur_path + "/" + cluster_path + "/Slices",
+			"offset_x": float(metadata["position"][0]),
+			"offset_y": float(metadata["position"][1]),
+			"offset_z": 0.0,
+			"scale": float(metadata["voxel_size"])
+		})
+		if streaming_slab_budget_mb > 0:
+			clusters[-1]["streaming_slab_budget_mb"] = streaming_slab_budget_mb
+		if voxel_cache:
+			clusters[-1]["use_voxel_cache"] = True
+
+	# the outputs of each cluster are written to <output_dir>/<cluster>/
+	manifest = {
+		"config": os.path.abspath(config_file) if config_file else default_config(weight, algorithm),
+		"output_dir": cur_path + "/" + output_dir,
+		"num_concurrent_clusters": num_concurrent_clusters,
+		"num_concurrent_loads": num_concurrent_loads,
+		"memory_budget_mb": memory_budget_mb,
+		"clusters": clusters
+	}
+	manifest_path = cur_path + "/" + output_dir + "/manifest.json"
+	with open(manifest_path, "w") as f:
+		json.dump(manifest, f, indent=2)
+
+	# run cgv tool
+	return subprocess.call(["cgv/LEGO_NOGUI", "--batch", manifest_path], cwd = "cgv")
 
 if __name__ == "__main__":
 	parser = argparse.ArgumentParser()
 	parser.add_argument("data_dir", help="path to site data folder (e.g., AOI-D1-WPAFB)")
 	parser.add_argument("weight", help="weight (0 - 1)")
-	parser.add_argument("algorithm", help="algorithm option (1 - All, 2 - DP)")
+	parser.add_argument("algorithm", help="algorithm option (1 - All, 2 - DP), which is ignored by the legacy interface as well")
 	parser.add_argument("output_dir", help="path to folder to save the output")
+	parser.add_argument("--config", help="base json configuration, which replaces the weight and the algorithm option")
+	parser.add_argument("--num_concurrent_clusters", type=int, default=1, help="the number of clusters simplified concurrently (0 - the number of hardware threads)")
+	parser.add_argument("--num_concurrent_loads", type=int, default=1, help="the number of clusters loaded concurrently (0 - the number of hardware threads)")
+	parser.add_argument("--memory_budget_mb", type=int, default=0, help="the maximum memory of the clusters being loaded or waiting to be simplified (0 - unlimited)")
+	parser.add_argument("--streaming_slab_budget_mb", type=int, default=0, help="label the slices one by one within this memory budget instead of loading the whole volume (0 - disabled)")
+	parser.add_argument("--voxel_cache", action="store_true", help="cache the bit-packed voxels of each cluster in its output folder to skip decoding the slices next time")
 	args = parser.parse_args()
-	
+
 	if not os.path.exists(args.data_dir):
 		print("Directory not found: " + args.data_dir)
 		sys.exit(0)
 
-	main(args.data_dir, args.weight, args.algorithm, args.output_dir)
\ No newline at end of file
+	sys.exit(main(args.data_dir, args.weight, args.algorithm, args.output_dir, args.config, args.num_concurrent_clusters, args.num_concurrent_loads, args.memory_budget_mb, args.streaming_slab_budget_mb, args.voxel_cache))
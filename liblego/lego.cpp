@@ -0,0 +1,312 @@
+#include "lego.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include "../LEGO_NOGUI/util/VoxelVolume.h"
+#include "../LEGO_NOGUI/util/DisjointVoxelData.h"
+#include "../LEGO_NOGUI/util/OBJWriter.h"
+#include "../LEGO_NOGUI/simp/BuildingSimplification.h"
+
+#ifdef _MSC_VER
+#define LEGO_THREAD_LOCAL __declspec(thread)
+#else
+#define LEGO_THREAD_LOCAL __thread
+#endif
+
+namespace {
+
+	const int MAX_ERROR_LENGTH = 256;
+
+	LEGO_THREAD_LOCAL char last_error[MAX_ERROR_LENGTH];
+
+	void setLastError(const char* msg) {
+		strncpy(last_error, msg, MAX_ERROR_LENGTH - 1);
+		last_error[MAX_ERROR_LENGTH - 1] = 0;
+	}
+
+	/**
+	 * Layer of a simplified building in the world coordinates.
+	 */
+	struct Layer {
+		int building;
+		double bottom_height;
+		double top_height;
+		std::vector<double> contour;
+		std::vector<double> hole_points;
+		std::vector<int> hole_offsets;
+	};
+
+}
+
+struct lego_result {
+	std::vector<lego_building> buildings;
+	std::vector<Layer> layers;
+	std::vector<cv::Point3d> positions;
+	std::vector<int> indices;
+	std::vector<int> face_offsets;
+	std::vector<int> face_buildings;
+};
+
+namespace {
+
+	/**
+	 * Append the points of the ring to the coordinate list in the world coordinates of the top face file.
+	 */
+	void appendRing(const util::Ring& ring, int width, int height, const lego_params& params, std::vector<double>& coords) {
+		util::Ring points = ring.getActualPoints();
+		for (int i = 0; i < (int)points.size(); i++) {
+			coords.push_back((points[i].x + width * 0.5 - 0.5) * params.scale + params.offset_x);
+			coords.push_back((points[i].y - height * 0.5 + 0.5) * params.scale + params.offset_y);
+		}
+	}
+
+	/**
+	 * Collect the layers of the building and its descendants in the same order as the top face file.
+	 */
+	void collectLayers(std::shared_ptr<util::BuildingLayer> building, int building_index, int width, int height, const lego_params& params, std::vector<Layer>& layers) {
+		for (auto& footprint : building->footprints) {
+			Layer layer;
+			layer.building = building_index;
+			layer.bottom_height = (building->bottom_height - 0.5) * params.scale + params.offset_z;
+			layer.top_height = (building->top_height - 0.5) * params.scale + params.offset_z;
+			appendRing(footprint.contour, width, height, params, layer.contour);
+			layer.hole_offsets.push_back(0);
+			for (int i = 0; i < (int)footprint.holes.size(); i++) {
+				appendRing(footprint.holes[i], width, height, params, layer.hole_points);
+				layer.hole_offsets.push_back(layer.hole_points.size() / 2);
+			}
+			layers.push_back(layer);
+		}
+
+		for (auto child : building->children) {
+			collectLayers(child, building_index, width, height, params, layers);
+		}
+	}
+
+	/**
+	 * Count the layers, the vertices, and the faces of each building, and find its height range.
+	 * The vertices and the faces of the buildings are contiguous in the building order in the mesh.
+	 */
+	void summarizeBuildings(lego_result& result, int num_buildings) {
+		lego_building empty = { 0, 0, 0, 0, 0, 0.0, 0.0 };
+		result.buildings.assign(num_buildings, empty);
+
+		for (int i = 0; i < (int)result.layers.size(); i++) {
+			lego_building& building = result.buildings[result.layers[i].building];
+			if (building.num_layers == 0 || result.layers[i].bottom_height < building.bottom_height) building.bottom_height = result.layers[i].bottom_height;
+			if (building.num_layers == 0 || result.layers[i].top_height > building.top_height) building.top_height = result.layers[i].top_height;
+			building.num_layers++;
+		}
+
+		int face = 0;
+		int position = 0;
+		for (int i = 0; i < num_buildings; i++) {
+			lego_building& building = result.buildings[i];
+			building.first_face = face;
+			building.first_position = position;
+			int end_position = position;
+			while (face < (int)result.face_buildings.size() && result.face_buildings[face] == i) {
+				for (int k = result.face_offsets[face]; k < result.face_offsets[face + 1]; k++) {
+					end_position = std::max(end_position, result.indices[k] + 1);
+				}
+				face++;
+			}
+			building.num_faces = face - building.first_face;
+			building.num_positions = end_position - position;
+			position = end_position;
+		}
+	}
+
+	/**
+	 * Convert the parameters to the arguments of BuildingSimplification::simplifyBuildings in the same way as the json configuration.
+	 */
+	std::map<int, std::vector<double>> algorithmParams(const lego_params& params) {
+		std::map<int, std::vector<double>> algorithms;
+		if (params.use_douglas_peucker) {
+			algorithms[simp::BuildingSimplification::ALG_DP] = { params.douglas_peucker_epsilon };
+		}
+		if (params.use_right_angle) {
+			algorithms[simp::BuildingSimplification::ALG_RIGHTANGLE] = { params.right_angle_epsilon, params.right_angle_optimization ? 1.0 : 0.0 };
+		}
+		if (params.use_curve) {
+			algorithms[simp::BuildingSimplification::ALG_CURVE] = { params.curve_epsilon, params.curve_curve_threshold };
+		}
+		if (params.use_curvepp) {
+			algorithms[simp::BuildingSimplification::ALG_CURVE_RIGHTANGLE] = { params.curvepp_epsilon, params.curvepp_curve_threshold, params.curvepp_angle_threshold / 180.0 * CV_PI };
+		}
+		return algorithms;
+	}
+
+}
+
+/**
+ * Set the default values to the parameters.
+ */
+void lego_params_init(lego_params* params) {
+	if (params == NULL) return;
+
+	params->offset_x = 0.0;
+	params->offset_y = 0.0;
+	params->offset_z = 0.0;
+	params->scale = 1.0;
+	params->contour_simplification_weight = 0.5;
+	params->layering_threshold = 0.7;
+	params->contour_snapping_threshold = 2.5;
+	params->bulk_orientation = 0.0;
+	params->minimum_contour_area = 2.0;
+	params->maximum_obb_ratio = 10.0;
+	params->min_hole_ratio = 0.02;
+	params->minimum_layer_height = 2.5;
+	params->allow_triangle_contour = 0;
+	params->allow_overhang = 0;
+	params->num_threads = 1;
+
+	params->use_douglas_peucker = 0;
+	params->douglas_peucker_epsilon = 16;
+	params->use_right_angle = 1;
+	params->right_angle_epsilon = 20;
+	params->right_angle_optimization = 1;
+	params->use_curve = 0;
+	params->curve_epsilon = 16;
+	params->curve_curve_threshold = 2;
+	params->use_curvepp = 1;
+	params->curvepp_epsilon = 18;
+	params->curvepp_curve_threshold = 2.5;
+	params->curvepp_angle_threshold = 12;
+}
+
+/**
+ * Generate the simplified buildings from the voxels.
+ * On failure, the message of the error is returned by lego_last_error in the same thread.
+ *
+ * @param voxels	voxel values owned by the caller, which are not modified
+ * @param params	parameters
+ * @param result	the result, which has to be freed by lego_result_free (NULL on failure)
+ * @return			LEGO_OK on success
+ */
+int lego_simplify(const lego_voxels* voxels, const lego_params* params, lego_result** result) {
+	if (result != NULL) *result = NULL;
+	if (voxels == NULL || params == NULL || result == NULL) {
+		setLastError("Null argument.");
+		return LEGO_ERROR_INVALID_ARGUMENT;
+	}
+	if (voxels->width < 0 || voxels->height < 0 || voxels->depth < 0 || (voxels->data == NULL && (size_t)voxels->width * voxels->height * voxels->depth > 0)) {
+		setLastError("Invalid voxels.");
+		return LEGO_ERROR_INVALID_ARGUMENT;
+	}
+	if (params->scale <= 0) {
+		setLastError("Scale has to be positive.");
+		return LEGO_ERROR_INVALID_ARGUMENT;
+	}
+
+	std::map<int, std::vector<double>> algorithms = algorithmParams(*params);
+	if (algorithms.size() == 0) {
+		setLastError("No contour simplification algorithm is selected.");
+		return LEGO_ERROR_INVALID_ARGUMENT;
+	}
+
+	try {
+		std::unique_ptr<lego_result> res(new lego_result());
+
+		std::vector<util::VoxelBuilding> voxel_buildings;
+		{
+			util::VoxelVolume volume;
+			volume.build(voxels->data, voxels->width, voxels->height, voxels->depth, voxels->row_stride, voxels->slice_stride, voxels->threshold);
+			voxel_buildings = util::DisjointVoxelData::disjoint(volume);
+		}
+
+		double scale = params->scale;
+		std::vector<std::shared_ptr<util::BuildingLayer>> buildings = simp::BuildingSimplification::simplifyBuildings(voxel_buildings, algorithms, false, params->minimum_layer_height / scale, params->contour_simplification_weight, params->layering_threshold, params->contour_snapping_threshold / scale, params->bulk_orientation / 180.0 * CV_PI, params->minimum_contour_area / scale / scale, params->maximum_obb_ratio, params->allow_triangle_contour != 0, params->allow_overhang != 0, params->min_hole_ratio, std::vector<regularizer::Config>(), params->num_threads);
+		std::vector<util::VoxelBuilding>().swap(voxel_buildings);
+
+		for (int i = 0; i < (int)buildings.size(); i++) {
+			collectLayers(buildings[i], i, voxels->width, voxels->height, *params, res->layers);
+		}
+		util::obj::OBJWriter::createMesh(voxels->width, voxels->height, params->offset_x, params->offset_y, params->offset_z, scale, buildings, res->positions, res->face_offsets, res->indices, res->face_buildings);
+		summarizeBuildings(*res, buildings.size());
+
+		*result = res.release();
+		return LEGO_OK;
+	}
+	catch (const char* msg) {
+		setLastError(msg);
+	}
+	catch (const std::exception& ex) {
+		setLastError(ex.what());
+	}
+	catch (...) {
+		setLastError("Unknown error.");
+	}
+	return LEGO_ERROR_FAILED;
+}
+
+/**
+ * Return the message of the last error in the calling thread.
+ */
+const char* lego_last_error(void) {
+	return last_error;
+}
+
+int lego_result_num_buildings(const lego_result* result) {
+	return result != NULL ? (int)result->buildings.size() : 0;
+}
+
+/**
+ * Get the statistics of the building of the index.
+ *
+ * @return		LEGO_OK, or LEGO_ERROR_INVALID_ARGUMENT if the index is out of range
+ */
+int lego_result_building(const lego_result* result, int index, lego_building* building) {
+	if (result == NULL || building == NULL || index < 0 || index >= (int)result->buildings.size()) return LEGO_ERROR_INVALID_ARGUMENT;
+
+	*building = result->buildings[index];
+	return LEGO_OK;
+}
+
+int lego_result_num_layers(const lego_result* result) {
+	return result != NULL ? (int)result->layers.size() : 0;
+}
+
+/**
+ * Get the layer of the index. The buffers of the layer are valid until the result is freed.
+ *
+ * @return		LEGO_OK, or LEGO_ERROR_INVALID_ARGUMENT if the index is out of range
+ */
+int lego_result_layer(const lego_result* result, int index, lego_layer* layer) {
+	if (result == NULL || layer == NULL || index < 0 || index >= (int)result->layers.size()) return LEGO_ERROR_INVALID_ARGUMENT;
+
+	const Layer& src = result->layers[index];
+	layer->building = src.building;
+	layer->bottom_height = src.bottom_height;
+	layer->top_height = src.top_height;
+	layer->contour = src.contour.data();
+	layer->num_contour_points = src.contour.size() / 2;
+	layer->hole_points = src.hole_points.data();
+	layer->hole_offsets = src.hole_offsets.data();
+	layer->num_holes = src.hole_offsets.size() - 1;
+	return LEGO_OK;
+}
+
+/**
+ * Get the mesh of all the buildings. The buffers of the mesh are valid until the result is freed.
+ */
+void lego_result_mesh(const lego_result* result, lego_mesh* mesh) {
+	if (mesh == NULL) return;
+	memset(mesh, 0, sizeof(lego_mesh));
+	if (result == NULL) return;
+
+	mesh->positions = result->positions.size() > 0 ? &result->positions[0].x : NULL;
+	mesh->num_positions = result->positions.size();
+	mesh->indices = result->indices.data();
+	mesh->face_offsets = result->face_offsets.data();
+	mesh->face_buildings = result->face_buildings.data();
+	mesh->num_faces = result->face_buildings.size();
+}
+
+void lego_result_free(lego_result* result) {
+	delete result;
+}
@@ -0,0 +1,149 @@
+#ifndef LEGO_H
+#define LEGO_H
+
+#include <stddef.h>
+
+/**
+ * C API of the LEGO building simplification library.
+ *
+ * The voxel data is read directly from a buffer owned by the caller, so that the slices do not have to be
+ * written to and decoded from image files. The simplified buildings and their meshes are returned in a result
+ * object, whose buffers are owned by the library and are valid until the result is freed.
+ *
+ * The functions can be called from multiple threads concurrently for different inputs.
+ */
+
+#if defined(LEGO_SHARED)
+#if defined(_WIN32)
+#if defined(LEGO_EXPORTS)
+#define LEGO_API __declspec(dllexport)
+#else
+#define LEGO_API __declspec(dllimport)
+#endif
+#else
+#define LEGO_API __attribute__((visibility("default")))
+#endif
+#else
+#define LEGO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* status codes */
+#define LEGO_OK							0
+#define LEGO_ERROR_INVALID_ARGUMENT		1
+#define LEGO_ERROR_FAILED				2
+
+/**
+ * Voxel values in memory (1 byte per voxel).
+ * The value of the voxel (x, y, z) is data[z * slice_stride + y * row_stride + x], where x and y correspond to
+ * the column and the row of a slice image, and z is the index of the slice from the bottom.
+ */
+typedef struct lego_voxels {
+	const unsigned char* data;
+	int width;
+	int height;
+	int depth;
+	size_t row_stride;		/* bytes between two consecutive rows (at least width) */
+	size_t slice_stride;	/* bytes between two consecutive slices (at least height * row_stride) */
+	int threshold;			/* the voxels with value greater than this threshold are occupied (128 for the slice images) */
+} lego_voxels;
+
+/**
+ * Parameters of the same names and units as the json configuration (config.json).
+ * lego_params_init sets the same default values as the json configuration, and selects the right angle and the curvepp
+ * algorithms as config.json does.
+ */
+typedef struct lego_params {
+	double offset_x;
+	double offset_y;
+	double offset_z;
+	double scale;
+	double contour_simplification_weight;
+	double layering_threshold;
+	double contour_snapping_threshold;
+	double bulk_orientation;				/* in degrees */
+	double minimum_contour_area;
+	double maximum_obb_ratio;
+	double min_hole_ratio;
+	double minimum_layer_height;
+	int allow_triangle_contour;
+	int allow_overhang;
+	int num_threads;						/* 0 - use all the hardware threads */
+
+	/* contour_simplification_algorithms */
+	int use_douglas_peucker;
+	double douglas_peucker_epsilon;
+	int use_right_angle;
+	double right_angle_epsilon;
+	int right_angle_optimization;
+	int use_curve;
+	double curve_epsilon;
+	double curve_curve_threshold;
+	int use_curvepp;
+	double curvepp_epsilon;
+	double curvepp_curve_threshold;
+	double curvepp_angle_threshold;			/* in degrees */
+} lego_params;
+
+/**
+ * Layer of a simplified building, which is a polygon with holes extruded from the bottom height to the top height.
+ * The coordinates are the world coordinates of the output files.
+ */
+typedef struct lego_layer {
+	int building;					/* index of the building */
+	double bottom_height;
+	double top_height;
+	const double* contour;			/* x and y of the points of the outer contour */
+	int num_contour_points;
+	const double* hole_points;		/* x and y of the points of all the holes */
+	const int* hole_offsets;		/* offsets of the holes in the points (num_holes + 1 values) */
+	int num_holes;
+} lego_layer;
+
+/**
+ * Polygon mesh of all the buildings in the world coordinates of the output obj file.
+ */
+typedef struct lego_mesh {
+	const double* positions;		/* x, y, and z of the vertices */
+	int num_positions;
+	const int* indices;				/* 0-based indices of the vertices of the faces */
+	const int* face_offsets;		/* offsets of the faces in the indices (num_faces + 1 values) */
+	const int* face_buildings;		/* index of the building of each face */
+	int num_faces;
+} lego_mesh;
+
+/**
+ * Statistics of a simplified building.
+ * The vertices and the faces of each building are contiguous in the mesh.
+ */
+typedef struct lego_building {
+	int num_layers;
+	int first_position;
+	int num_positions;
+	int first_face;
+	int num_faces;
+	double bottom_height;
+	double top_height;
+} lego_building;
+
+typedef struct lego_result lego_result;
+
+LEGO_API void lego_params_init(lego_params* params);
+LEGO_API int lego_simplify(const lego_voxels* voxels, const lego_params* params, lego_result** result);
+LEGO_API const char* lego_last_error(void);
+
+LEGO_API int lego_result_num_buildings(const lego_result* result);
+LEGO_API int lego_result_building(const lego_result* result, int index, lego_building* building);
+LEGO_API int lego_result_num_layers(const lego_result* result);
+LEGO_API int lego_result_layer(const lego_result* result, int index, lego_layer* layer);
+LEGO_API void lego_result_mesh(const lego_result* result, lego_mesh* mesh);
+LEGO_API void lego_result_free(lego_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Smoke test of the C API: a box of voxels is simplified into one building, and an empty volume into nothing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lego.h"
+
+#define WIDTH	32
+#define HEIGHT	24
+#define DEPTH	12
+
+static int num_errors = 0;
+
+static void check(int condition, const char* msg) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", msg);
+		num_errors++;
+	}
+}
+
+static void testBox(void) {
+	unsigned char* data;
+	lego_voxels voxels;
+	lego_params params;
+	lego_result* result = NULL;
+	lego_mesh mesh;
+	lego_building building;
+	int x, y, z, i;
+
+	/* a box of 16 x 12 x 8 voxels in the middle of the volume */
+	data = (unsigned char*)calloc(WIDTH * HEIGHT * DEPTH, 1);
+	for (z = 0; z < 8; z++) {
+		for (y = 6; y < 18; y++) {
+			for (x = 8; x < 24; x++) {
+				data[z * WIDTH * HEIGHT + y * WIDTH + x] = 255;
+			}
+		}
+	}
+	voxels.data = data;
+	voxels.width = WIDTH;
+	voxels.height = HEIGHT;
+	voxels.depth = DEPTH;
+	voxels.row_stride = WIDTH;
+	voxels.slice_stride = WIDTH * HEIGHT;
+	voxels.threshold = 128;
+
+	lego_params_init(&params);
+	check(lego_simplify(&voxels, &params, &result) == LEGO_OK, lego_last_error());
+	check(result != NULL, "result of the box");
+	if (result != NULL) {
+		check(lego_result_num_buildings(result) == 1, "one building for the box");
+		check(lego_result_num_layers(result) >= 1, "layers of the box");
+
+		lego_result_mesh(result, &mesh);
+		check(mesh.positions != NULL && mesh.num_positions >= 8, "vertices of the box");
+		check(mesh.num_faces >= 6, "faces of the box");
+		check(mesh.face_offsets[0] == 0, "first face offset");
+		for (i = 0; i < mesh.num_faces; i++) {
+			check(mesh.face_offsets[i + 1] - mesh.face_offsets[i] >= 3, "face has at least 3 vertices");
+			check(mesh.face_buildings[i] == 0, "face belongs to the building");
+		}
+		for (i = 0; i < mesh.face_offsets[mesh.num_faces]; i++) {
+			check(mesh.indices[i] >= 0 && mesh.indices[i] < mesh.num_positions, "vertex index in range");
+		}
+
+		check(lego_result_building(result, 0, &building) == LEGO_OK, "building statistics");
+		check(building.num_positions == mesh.num_positions && building.num_faces == mesh.num_faces, "building covers the mesh");
+		check(building.top_height > building.bottom_height, "building height");
+		check(lego_result_building(result, 1, &building) == LEGO_ERROR_INVALID_ARGUMENT, "building index out of range");
+	}
+	lego_result_free(result);
+	free(data);
+}
+
+static void testEmpty(void) {
+	unsigned char data[4 * 4 * 2];
+	lego_voxels voxels;
+	lego_params params;
+	lego_result* result = NULL;
+	lego_mesh mesh;
+
+	memset(data, 0, sizeof(data));
+	voxels.data = data;
+	voxels.width = 4;
+	voxels.height = 4;
+	voxels.depth = 2;
+	voxels.row_stride = 4;
+	voxels.slice_stride = 16;
+	voxels.threshold = 128;
+
+	lego_params_init(&params);
+	check(lego_simplify(&voxels, &params, &result) == LEGO_OK, lego_last_error());
+	check(lego_result_num_buildings(result) == 0, "no building in the empty volume");
+	lego_result_mesh(result, &mesh);
+	check(mesh.positions == NULL && mesh.num_positions == 0 && mesh.num_faces == 0, "empty mesh");
+	lego_result_free(result);
+
+	/* invalid arguments */
+	check(lego_simplify(NULL, &params, &result) == LEGO_ERROR_INVALID_ARGUMENT && result == NULL, "null voxels");
+	params.scale = 0;
+	check(lego_simplify(&voxels, &params, &result) == LEGO_ERROR_INVALID_ARGUMENT, "zero scale");
+	check(strlen(lego_last_error()) > 0, "error message");
+}
+
+int main(void) {
+	testBox();
+	testEmpty();
+	if (num_errors > 0) {
+		fprintf(stderr, "%d checks failed\n", num_errors);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "lego.h"
+
+namespace py = pybind11;
+
+namespace {
+
+	struct DoubleParam {
+		const char* name;
+		double lego_params::*member;
+	};
+
+	struct IntParam {
+		const char* name;
+		int lego_params::*member;
+	};
+
+	const DoubleParam DOUBLE_PARAMS[] = {
+		{ "offset_x", &lego_params::offset_x },
+		{ "offset_y", &lego_params::offset_y },
+		{ "offset_z", &lego_params::offset_z },
+		{ "scale", &lego_params::scale },
+		{ "contour_simplification_weight", &lego_params::contour_simplification_weight },
+		{ "layering_threshold", &lego_params::layering_threshold },
+		{ "contour_snapping_threshold", &lego_params::contour_snapping_threshold },
+		{ "bulk_orientation", &lego_params::bulk_orientation },
+		{ "minimum_contour_area", &lego_params::minimum_contour_area },
+		{ "maximum_obb_ratio", &lego_params::maximum_obb_ratio },
+		{ "min_hole_ratio", &lego_params::min_hole_ratio },
+		{ "minimum_layer_height", &lego_params::minimum_layer_height },
+		{ "douglas_peucker_epsilon", &lego_params::douglas_peucker_epsilon },
+		{ "right_angle_epsilon", &lego_params::right_angle_epsilon },
+		{ "curve_epsilon", &lego_params::curve_epsilon },
+		{ "curve_curve_threshold", &lego_params::curve_curve_threshold },
+		{ "curvepp_epsilon", &lego_params::curvepp_epsilon },
+		{ "curvepp_curve_threshold", &lego_params::curvepp_curve_threshold },
+		{ "curvepp_angle_threshold", &lego_params::curvepp_angle_threshold }
+	};
+
+	const IntParam INT_PARAMS[] = {
+		{ "allow_triangle_contour", &lego_params::allow_triangle_contour },
+		{ "allow_overhang", &lego_params::allow_overhang },
+		{ "num_threads", &lego_params::num_threads },
+		{ "use_douglas_peucker", &lego_params::use_douglas_peucker },
+		{ "use_right_angle", &lego_params::use_right_angle },
+		{ "right_angle_optimization", &lego_params::right_angle_optimization },
+		{ "use_curve", &lego_params::use_curve },
+		{ "use_curvepp", &lego_params::use_curvepp }
+	};
+
+	/**
+	 * Set the parameter of the name, which is the same as the member of lego_params.
+	 */
+	void setParam(lego_params& params, const std::string& name, py::handle value) {
+		for (const DoubleParam& param : DOUBLE_PARAMS) {
+			if (name == param.name) {
+				params.*(param.member) = value.cast<double>();
+				return;
+			}
+		}
+		for (const IntParam& param : INT_PARAMS) {
+			if (name == param.name) {
+				params.*(param.member) = value.cast<int>();
+				return;
+			}
+		}
+		throw py::type_error("Unknown parameter: " + name);
+	}
+
+	/**
+	 * Make a read-only numpy array that views a buffer of the result without copying it.
+	 * The capsule frees the result when all the arrays that share it are released.
+	 * An empty buffer (e.g., the vertices of an empty volume, which are NULL) is returned as an empty array of its own.
+	 */
+	template<typename T>
+	py::array_t<T> view(const T* data, const std::vector<py::ssize_t>& shape, const py::capsule& owner) {
+		py::array_t<T> array = data != NULL ? py::array_t<T>(shape, data, owner) : py::array_t<T>(shape);
+		array.attr("flags").attr("writeable") = false;
+		return array;
+	}
+
+	/**
+	 * Check whether the voxels can be read in place, i.e., each row is contiguous and the rows and the slices do not overlap.
+	 */
+	bool readableInPlace(const py::array& voxels) {
+		if (voxels.strides(2) != 1 || voxels.strides(1) < 0 || voxels.strides(0) < 0) return false;
+		if (voxels.strides(1) < voxels.shape(2)) return false;
+		if (voxels.shape(0) > 1 && voxels.strides(0) < voxels.shape(1) * voxels.strides(1)) return false;
+		return true;
+	}
+
+	/**
+	 * Generate the simplified buildings from the voxels.
+	 * The GIL is released during the computation, so that multiple clusters can be processed by Python threads concurrently.
+	 */
+	py::dict simplify(py::array voxels, py::object threshold, py::kwargs kwargs) {
+		if (voxels.ndim() != 3) throw py::value_error("Voxels have to be a 3D array indexed by (z, y, x).");
+		char kind = voxels.dtype().kind();
+		if (voxels.itemsize() != 1 || (kind != 'u' && kind != 'b')) throw py::type_error("Voxels have to be uint8 or bool.");
+
+		// the voxels are copied only if their layout cannot be read in place
+		if (!readableInPlace(voxels)) {
+			voxels = py::array::ensure(voxels, py::array::c_style);
+		}
+
+		lego_voxels input;
+		input.data = (const unsigned char*)voxels.data();
+		input.depth = voxels.shape(0);
+		input.height = voxels.shape(1);
+		input.width = voxels.shape(2);
+		input.slice_stride = voxels.strides(0);
+		input.row_stride = voxels.strides(1);
+		input.threshold = threshold.is_none() ? (kind == 'b' ? 0 : 128) : threshold.cast<int>();
+
+		lego_params params;
+		lego_params_init(&params);
+		for (auto item : kwargs) {
+			setParam(params, item.first.cast<std::string>(), item.second);
+		}
+
+		lego_result* result = NULL;
+		int status;
+		std::string error;
+		{
+			py::gil_scoped_release release;
+			status = lego_simplify(&input, &params, &result);
+			if (status != LEGO_OK) error = lego_last_error();
+		}
+		if (status == LEGO_ERROR_INVALID_ARGUMENT) throw py::value_error(error);
+		if (status != LEGO_OK) throw std::runtime_error(error);
+
+		py::capsule owner(result, [](void* ptr) { lego_result_free((lego_result*)ptr); });
+
+		lego_mesh mesh;
+		lego_result_mesh(result, &mesh);
+		py::dict output;
+		output["vertices"] = view(mesh.positions, { mesh.num_positions, 3 }, owner);
+		output["faces"] = view(mesh.indices, { mesh.face_offsets[mesh.num_faces] }, owner);
+		output["face_offsets"] = view(mesh.face_offsets, { mesh.num_faces + 1 }, owner);
+		output["face_buildings"] = view(mesh.face_buildings, { mesh.num_faces }, owner);
+
+		py::list buildings;
+		for (int i = 0; i < lego_result_num_buildings(result); i++) {
+			lego_building building;
+			lego_result_building(result, i, &building);
+			py::dict stats;
+			stats["num_layers"] = building.num_layers;
+			stats["first_vertex"] = building.first_position;
+			stats["num_vertices"] = building.num_positions;
+			stats["first_face"] = building.first_face;
+			stats["num_faces"] = building.num_faces;
+			stats["bottom_height"] = building.bottom_height;
+			stats["top_height"] = building.top_height;
+			buildings.append(stats);
+		}
+		output["buildings"] = buildings;
+
+		py::list layers;
+		for (int i = 0; i < lego_result_num_layers(result); i++) {
+			lego_layer layer;
+			lego_result_layer(result, i, &layer);
+			py::dict item;
+			item["building"] = layer.building;
+			item["bottom_height"] = layer.bottom_height;
+			item["top_height"] = layer.top_height;
+			item["contour"] = view(layer.contour, { layer.num_contour_points, 2 }, owner);
+			py::list holes;
+			for (int j = 0; j < layer.num_holes; j++) {
+				holes.append(view(layer.hole_points + layer.hole_offsets[j] * 2, { layer.hole_offsets[j + 1] - layer.hole_offsets[j], 2 }, owner));
+			}
+			item["holes"] = holes;
+			layers.append(item);
+		}
+		output["layers"] = layers;
+
+		return output;
+	}
+
+}
+
+PYBIND11_MODULE(lego, m) {
+	m.doc() = "Simplification of voxel buildings into crisp 3D building models";
+
+	m.def("simplify", &simplify, py::arg("voxels"), py::arg("threshold") = py::none(),
+		"Generate the simplified buildings from a uint8 or bool array indexed by (z, y, x).\n\n"
+		"The array is read in place if each row is contiguous. The voxels with value greater than the threshold are occupied\n"
+		"(128 for uint8 and 0 for bool by default). The keyword arguments are the parameters of the json configuration,\n"
+		"e.g., offset_x, scale, contour_simplification_weight, use_right_angle, and right_angle_epsilon.\n\n"
+		"Returns a dict of the mesh (vertices, faces, face_offsets, and face_buildings as numpy arrays),\n"
+		"the statistics of each building (buildings), and the layers of the buildings (layers).");
+}
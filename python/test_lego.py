@@ -0,0 +1,106 @@
+#######################################################################
+# Tests of the Python module (run by pytest with the built module in PYTHONPATH)
+
+import gc
+import numpy as np
+import pytest
+
+import lego
+
+
+def make_voxels():
+	# two boxes of different heights, which are separated buildings
+	voxels = np.zeros((12, 24, 40), dtype=np.uint8)
+	voxels[0:8, 4:16, 4:18] = 255
+	voxels[0:5, 6:20, 24:36] = 200
+	return voxels
+
+
+def test_contiguous_uint8():
+	voxels = make_voxels()
+	result = lego.simplify(voxels)
+	assert len(result["buildings"]) == 2
+	assert result["vertices"].ndim == 2 and result["vertices"].shape[1] == 3
+	assert result["vertices"].dtype == np.float64
+	assert len(result["face_offsets"]) == len(result["face_buildings"]) + 1
+	assert result["face_offsets"][-1] == len(result["faces"])
+	assert result["faces"].max() < len(result["vertices"])
+	assert not result["vertices"].flags.writeable
+
+	num_faces = 0
+	for building in result["buildings"]:
+		assert building["first_face"] == num_faces
+		num_faces += building["num_faces"]
+		assert building["top_height"] > building["bottom_height"]
+	assert num_faces == len(result["face_buildings"])
+
+
+def test_bool_same_as_uint8():
+	voxels = make_voxels()
+	expected = lego.simplify(voxels)
+	result = lego.simplify(voxels > 128)
+	np.testing.assert_array_equal(result["vertices"], expected["vertices"])
+	np.testing.assert_array_equal(result["faces"], expected["faces"])
+
+
+def test_in_place_and_copy_paths():
+	voxels = make_voxels()
+
+	# rows are contiguous, but the rows and the slices are not packed (read in place)
+	cropped = voxels[:, 2:22, 2:38]
+	assert not cropped.flags.c_contiguous
+	np.testing.assert_array_equal(lego.simplify(cropped)["vertices"], lego.simplify(np.ascontiguousarray(cropped))["vertices"])
+
+	# every other column (copied)
+	strided = np.repeat(voxels, 2, axis=2)[:, :, ::2]
+	assert strided.strides[2] != 1
+	np.testing.assert_array_equal(lego.simplify(strided)["vertices"], lego.simplify(voxels)["vertices"])
+
+	# negative row stride (copied)
+	flipped = np.flip(np.flip(voxels, 1).copy(), 1)
+	assert flipped.strides[1] < 0
+	np.testing.assert_array_equal(lego.simplify(flipped)["vertices"], lego.simplify(voxels)["vertices"])
+
+
+def test_empty_volume():
+	result = lego.simplify(np.zeros((4, 8, 8), dtype=np.uint8))
+	assert result["vertices"].shape == (0, 3)
+	assert result["faces"].shape == (0,)
+	assert result["face_offsets"].tolist() == [0]
+	assert result["face_buildings"].shape == (0,)
+	assert result["buildings"] == []
+	assert result["layers"] == []
+
+
+def test_views_outlive_the_dict():
+	result = lego.simplify(make_voxels())
+	vertices = result["vertices"]
+	faces = result["faces"]
+	contour = result["layers"][0]["contour"]
+	expected_vertices = vertices.copy()
+	expected_faces = faces.copy()
+	expected_contour = contour.copy()
+
+	del result
+	gc.collect()
+	lego.simplify(make_voxels())	# reuse the freed memory if the views were dangling
+
+	np.testing.assert_array_equal(vertices, expected_vertices)
+	np.testing.assert_array_equal(faces, expected_faces)
+	np.testing.assert_array_equal(contour, expected_contour)
+
+
+def test_parameters():
+	voxels = make_voxels()
+	base = lego.simplify(voxels, scale=0.5, use_curvepp=False)
+	shifted = lego.simplify(voxels, scale=0.5, use_curvepp=False, offset_x=100.0, num_threads=2)
+	np.testing.assert_allclose(shifted["vertices"][:, 0], base["vertices"][:, 0] + 100.0)
+
+	with pytest.raises(TypeError):
+		lego.simplify(voxels, no_such_parameter=1)
+	with pytest.raises(ValueError):
+		lego.simplify(voxels, scale=0.0)
+	with pytest.raises(ValueError):
+		lego.simplify(np.zeros((8, 8), dtype=np.uint8))
+	with pytest.raises(TypeError):
+		lego.simplify(np.zeros((2, 8, 8), dtype=np.float32))